@@ -0,0 +1,252 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "coroutine.hpp"
+#include "work_scheduler.hpp"
+
+/// @brief Resume the coroutine on the `work_scheduler_t`. Resumed inline if the scheduler is stopped
+inline void resume_on_scheduler(work_scheduler_t& scheduler, coro::coroutine_handle<void> handle,
+                                int32_t priority = 0) noexcept {
+    auto resume = [](void* address) noexcept { coro::coroutine_handle<void>::from_address(address).resume(); };
+    if (scheduler.put(work_item_t{resume, handle.address()}, priority) != std::errc{})
+        handle.resume();
+}
+
+/// @brief Same role with `resume_on_queue` of the test_main.cpp
+[[nodiscard]] inline auto resume_on(work_scheduler_t& scheduler, int32_t priority = 0) noexcept {
+    struct awaitable_t final {
+        work_scheduler_t& scheduler;
+        int32_t priority;
+
+        constexpr bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(coro::coroutine_handle<void> handle) noexcept {
+            resume_on_scheduler(scheduler, handle, priority);
+        }
+        constexpr void await_resume() const noexcept {
+        }
+    };
+    return awaitable_t{scheduler, priority};
+}
+
+/**
+ * @brief Coroutine which reads ahead. The body runs on the `work_scheduler_t` and `co_yield`s the items
+ *        until `depth` items are waiting for the consumer, so the next items are fetched while the consumer works.
+ *
+ * @code
+ * async_generator_t<int> produce() {
+ *     for (int i = 0; i < 10; ++i)
+ *         co_yield i;
+ * }
+ * auto items = produce();
+ * items.start(scheduler, 4);
+ * while (std::optional<int> item = co_await items.next())
+ *     consume(*item);
+ * @endcode
+ *
+ * @note  The consumer is resumed on the scheduler when it had to wait for the item.
+ *        The destructor waits until the body is suspended, and then destroys it
+ */
+template <typename T>
+class async_generator_t final {
+    /// @note shared with the coroutine frame, so the awaiters can touch it after the frame is destroyed
+    struct state_t final {
+        std::mutex mtx{};
+        std::condition_variable cv{};
+        std::deque<T> items{};
+        size_t depth = 1;
+        work_scheduler_t* scheduler = nullptr;
+        coro::coroutine_handle<void> consumer{};
+        bool running = false; // the body is running or scheduled
+        bool done = false;
+        bool canceled = false;
+        std::exception_ptr error{};
+    };
+
+  public:
+    struct promise_type final {
+        std::shared_ptr<state_t> state = std::make_shared<state_t>();
+
+      public:
+        async_generator_t get_return_object() noexcept {
+            return async_generator_t{coro::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        coro::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        /// @brief Suspend if the consumer is far behind, and wake the consumer if it is waiting
+        auto yield_value(T value) noexcept(false) {
+            struct awaitable_t final {
+                std::shared_ptr<state_t> state;
+
+                constexpr bool await_ready() const noexcept {
+                    return false;
+                }
+                /// @note the frame may be resumed or destroyed by the other thread after `unlock`
+                bool await_suspend(coro::coroutine_handle<void>) noexcept {
+                    const std::shared_ptr<state_t> s = state;
+                    coro::coroutine_handle<void> consumer{};
+                    bool suspend = true;
+                    {
+                        std::lock_guard lck{s->mtx};
+                        consumer = std::exchange(s->consumer, nullptr);
+                        suspend = s->canceled || s->items.size() >= s->depth;
+                        if (suspend) {
+                            s->running = false;
+                            s->cv.notify_all();
+                        }
+                    }
+                    if (consumer)
+                        resume_on_scheduler(*s->scheduler, consumer);
+                    return suspend;
+                }
+                constexpr void await_resume() const noexcept {
+                }
+            };
+            {
+                std::lock_guard lck{state->mtx};
+                state->items.emplace_back(std::move(value));
+            }
+            return awaitable_t{state};
+        }
+
+        void return_void() noexcept {
+        }
+        void unhandled_exception() noexcept {
+            std::lock_guard lck{state->mtx};
+            state->error = std::current_exception();
+        }
+
+        auto final_suspend() noexcept {
+            struct awaitable_t final {
+                std::shared_ptr<state_t> state;
+
+                constexpr bool await_ready() const noexcept {
+                    return false;
+                }
+                void await_suspend(coro::coroutine_handle<void>) noexcept {
+                    const std::shared_ptr<state_t> s = state;
+                    coro::coroutine_handle<void> consumer{};
+                    {
+                        std::lock_guard lck{s->mtx};
+                        s->done = true;
+                        s->running = false;
+                        consumer = std::exchange(s->consumer, nullptr);
+                        s->cv.notify_all();
+                    }
+                    if (consumer)
+                        resume_on_scheduler(*s->scheduler, consumer);
+                }
+                constexpr void await_resume() const noexcept {
+                }
+            };
+            return awaitable_t{state};
+        }
+    };
+
+  private:
+    coro::coroutine_handle<promise_type> handle{};
+    std::shared_ptr<state_t> state{};
+
+    explicit async_generator_t(coro::coroutine_handle<promise_type> handle) noexcept
+        : handle{handle}, state{handle.promise().state} {
+    }
+
+  public:
+    async_generator_t(async_generator_t&& rhs) noexcept
+        : handle{std::exchange(rhs.handle, nullptr)}, state{std::move(rhs.state)} {
+    }
+    async_generator_t& operator=(async_generator_t&&) = delete;
+    async_generator_t(const async_generator_t&) = delete;
+    async_generator_t& operator=(const async_generator_t&) = delete;
+
+    ~async_generator_t() noexcept {
+        if (handle == nullptr)
+            return;
+        {
+            std::unique_lock lck{state->mtx};
+            state->canceled = true;
+            state->cv.wait(lck, [s = state.get()]() { return s->running == false; });
+        }
+        handle.destroy();
+    }
+
+    /**
+     * @brief Run the body on the scheduler
+     * @param depth the number of the items to read ahead. at least 1
+     * @return `std::errc::operation_canceled` if the scheduler is stopped
+     */
+    std::errc start(work_scheduler_t& scheduler, size_t depth) noexcept {
+        {
+            std::lock_guard lck{state->mtx};
+            if (state->scheduler)
+                return std::errc::operation_in_progress;
+            state->scheduler = &scheduler;
+            state->depth = depth ? depth : 1;
+            state->running = true;
+        }
+        auto resume = [](void* address) noexcept { coro::coroutine_handle<void>::from_address(address).resume(); };
+        if (auto ec = scheduler.put(work_item_t{resume, handle.address()}); ec != std::errc{}) {
+            std::lock_guard lck{state->mtx};
+            state->running = false;
+            return ec;
+        }
+        return std::errc{};
+    }
+
+    /// @return awaitable for `std::optional<T>`. `std::nullopt` after the last item
+    /// @throws the exception from the body
+    [[nodiscard]] auto next() noexcept {
+        struct awaitable_t final {
+            async_generator_t* owner;
+
+            bool await_ready() const noexcept {
+                std::lock_guard lck{owner->state->mtx};
+                return owner->state->items.empty() == false || owner->state->done;
+            }
+            bool await_suspend(coro::coroutine_handle<void> consumer) noexcept {
+                std::lock_guard lck{owner->state->mtx};
+                if (owner->state->items.empty() == false || owner->state->done)
+                    return false;
+                owner->state->consumer = consumer;
+                return true;
+            }
+            std::optional<T> await_resume() noexcept(false) {
+                return owner->pop();
+            }
+        };
+        return awaitable_t{this};
+    }
+
+  private:
+    /// @brief Take the front item and resume the body if there is a room
+    std::optional<T> pop() noexcept(false) {
+        std::optional<T> item{};
+        bool wake = false;
+        {
+            std::lock_guard lck{state->mtx};
+            if (state->items.empty() == false) {
+                item.emplace(std::move(state->items.front()));
+                state->items.pop_front();
+            } else if (state->error) {
+                std::rethrow_exception(state->error);
+            }
+            if (state->running == false && state->done == false && state->canceled == false &&
+                state->scheduler != nullptr && state->items.size() < state->depth) {
+                state->running = true;
+                wake = true;
+            }
+        }
+        if (wake)
+            resume_on_scheduler(*state->scheduler, handle);
+        return item;
+    }
+};
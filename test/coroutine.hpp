@@ -0,0 +1,12 @@
+#pragma once
+/**
+ * @brief `<coroutine>` for C++20 and `<experimental/coroutine>` for `/await`.
+ *        Use `coro::coroutine_handle`, `coro::suspend_always`, `coro::suspend_never`
+ */
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+namespace coro = std;
+#else
+#include <experimental/coroutine>
+namespace coro = std::experimental;
+#endif
@@ -0,0 +1,139 @@
+#include "deadline_queue.hpp"
+
+#include <algorithm>
+
+namespace {
+
+/// @brief `std::push_heap` makes a max heap. The earliest deadline must be on the top
+template <typename T>
+bool later(const T& lhs, const T& rhs) noexcept {
+    if (lhs.task.deadline != rhs.task.deadline)
+        return lhs.task.deadline > rhs.task.deadline;
+    return lhs.sequence > rhs.sequence;
+}
+
+} // namespace
+
+frame_clock_t::frame_clock_t(uint32_t numerator, uint32_t denominator, deadline_clock_t::duration budget) noexcept
+    : frame_duration{numerator && denominator ? media_duration_t{10'000'000ll * denominator / numerator}
+                                              : media_duration_t{333'333}},
+      budget{budget.count() ? budget : std::chrono::duration_cast<deadline_clock_t::duration>(frame_duration)} {
+}
+
+void frame_clock_t::reset(deadline_clock_t::time_point value) noexcept {
+    origin = value;
+    first_time = media_duration_t{-1};
+}
+
+deadline_clock_t::time_point frame_clock_t::deadline(media_duration_t time, uint64_t index) noexcept {
+    if (time.count() < 0)
+        time = frame_duration * static_cast<int64_t>(index);
+    if (first_time.count() < 0) {
+        if (origin == deadline_clock_t::time_point{})
+            origin = deadline_clock_t::now();
+        first_time = time;
+    }
+    return origin + std::chrono::duration_cast<deadline_clock_t::duration>(time - first_time) + budget;
+}
+
+deadline_queue_t::deadline_queue_t(work_scheduler_t& scheduler, drop_policy_t policy, int32_t priority) noexcept
+    : scheduler{scheduler}, policy{policy}, priority{priority} {
+}
+
+deadline_queue_t::~deadline_queue_t() noexcept {
+    std::unique_lock lck{mtx};
+    cv.wait(lck, [this]() { return tokens == 0; });
+}
+
+std::errc deadline_queue_t::put(const deadline_task_t& task) noexcept {
+    if (task.invoke == nullptr)
+        return std::errc::invalid_argument;
+    uint64_t current = 0;
+    try {
+        std::lock_guard lck{mtx};
+        current = sequence++;
+        heap.emplace_back(entry_t{task, current});
+        std::push_heap(heap.begin(), heap.end(), later<entry_t>);
+        ++tokens;
+        ++counters.submitted;
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    auto ec = scheduler.put(work_item_t{&deadline_queue_t::run, this}, priority);
+    if (ec == std::errc{})
+        return ec;
+    // the token is not in the scheduler. take back the task
+    deadline_task_t orphan{};
+    {
+        std::lock_guard lck{mtx};
+        auto it = std::find_if(heap.begin(), heap.end(), [current](const entry_t& e) { return e.sequence == current; });
+        if (it != heap.end()) {
+            heap.erase(it);
+            std::make_heap(heap.begin(), heap.end(), later<entry_t>);
+            --counters.submitted;
+        } else if (heap.empty() == false) {
+            // the other token took it. then one of the others can't be run by the stopped scheduler
+            std::pop_heap(heap.begin(), heap.end(), later<entry_t>);
+            orphan = heap.back().task;
+            heap.pop_back();
+            ++counters.dropped;
+            ec = std::errc{};
+        }
+        if (--tokens == 0)
+            cv.notify_all();
+    }
+    if (orphan.drop)
+        orphan.drop(orphan.context);
+    return ec;
+}
+
+deadline_stats_t deadline_queue_t::stats() noexcept {
+    std::lock_guard lck{mtx};
+    return counters;
+}
+
+size_t deadline_queue_t::size() noexcept {
+    std::lock_guard lck{mtx};
+    return heap.size();
+}
+
+void deadline_queue_t::run(void* context) noexcept {
+    static_cast<deadline_queue_t*>(context)->run_earliest();
+}
+
+void deadline_queue_t::run_earliest() noexcept {
+    deadline_task_t task{};
+    {
+        std::lock_guard lck{mtx};
+        if (heap.empty() == false) {
+            std::pop_heap(heap.begin(), heap.end(), later<entry_t>);
+            task = heap.back().task;
+            heap.pop_back();
+        }
+    }
+    auto lateness = deadline_clock_t::duration::zero();
+    bool drop = false;
+    if (task.invoke) {
+        lateness = deadline_clock_t::now() - task.deadline;
+        drop = policy.drop_late_non_reference && task.reference == false && lateness > policy.tolerance;
+        if (drop) {
+            if (task.drop)
+                task.drop(task.context);
+        } else {
+            task.invoke(task.context);
+        }
+    }
+    std::lock_guard lck{mtx};
+    if (drop) {
+        ++counters.dropped;
+    } else if (task.invoke) {
+        ++counters.executed;
+        if (lateness > deadline_clock_t::duration::zero()) {
+            ++counters.late;
+            counters.max_lateness = std::max(counters.max_lateness, lateness);
+        }
+    }
+    // `this` may be destroyed after the last token
+    if (--tokens == 0)
+        cv.notify_all();
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "work_scheduler.hpp"
+
+using deadline_clock_t = std::chrono::steady_clock;
+
+/// @brief 100ns unit of `IMFSample::GetSampleTime` and `MFSampleExtension_DecodeTimestamp`
+using media_duration_t = std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>;
+
+/**
+ * @brief Maps the timestamps of a stream to the wall clock.
+ *        The first frame's deadline is `origin + budget` and the others follow by their distance from it
+ * @note  For the decoder input, use the decode timestamp or the decoding order. Presentation timestamps are not
+ *        monotonic with B frames, and the decoder must receive the inputs in the decoding order
+ */
+class frame_clock_t final {
+    deadline_clock_t::time_point origin{};
+    media_duration_t first_time{-1};
+    media_duration_t frame_duration;
+    deadline_clock_t::duration budget;
+
+  public:
+    /// @param numerator, denominator frame rate like `MF_MT_FRAME_RATE`. 0 for 30 fps
+    /// @param budget time allowed for a frame after its timestamp. 0 for one frame duration
+    frame_clock_t(uint32_t numerator, uint32_t denominator, deadline_clock_t::duration budget = {}) noexcept;
+
+    /// @brief Start the clock. The first `deadline` does it if this is not used
+    void reset(deadline_clock_t::time_point origin) noexcept;
+
+    /// @param time timestamp of the frame. Negative if unknown, then `index` * frame duration is used
+    /// @param index count of the frames before this one
+    [[nodiscard]] deadline_clock_t::time_point deadline(media_duration_t time, uint64_t index) noexcept;
+
+    [[nodiscard]] media_duration_t duration() const noexcept {
+        return frame_duration;
+    }
+};
+
+/// @brief What to do with the frame which missed its deadline
+struct drop_policy_t final {
+    /// @brief Non-reference frames can be dropped without breaking the following frames
+    bool drop_late_non_reference = true;
+    /// @brief Lateness allowed before the drop
+    deadline_clock_t::duration tolerance{};
+};
+
+struct deadline_task_t final {
+    void (*invoke)(void* context) noexcept = nullptr;
+    void (*drop)(void* context) noexcept = nullptr; // optional. release the resources of the dropped frame
+    void* context = nullptr;
+    deadline_clock_t::time_point deadline{};
+    bool reference = true; // other frames depend on this frame. never dropped
+};
+
+struct deadline_stats_t final {
+    uint64_t submitted = 0;
+    uint64_t executed = 0;
+    uint64_t dropped = 0;
+    uint64_t late = 0; // executed after the deadline
+    deadline_clock_t::duration max_lateness{};
+};
+
+/**
+ * @brief Earliest-deadline-first dispatch on the `work_scheduler_t`.
+ *        Each `put` gives the scheduler a token, and the worker which runs the token takes the earliest task.
+ *        So the tasks wait in the deadline order while the workers are busy.
+ * @note  Under the overload, the late non-reference frames are dropped before they are invoked.
+ *        Put this in front of the expensive stage so the latency doesn't grow
+ * @see   IMFRealTimeClientEx, MFPutWorkItemEx2
+ */
+class deadline_queue_t final {
+    struct entry_t final {
+        deadline_task_t task{};
+        uint64_t sequence = 0; // FIFO for the same deadline
+    };
+
+    work_scheduler_t& scheduler;
+    drop_policy_t policy;
+    int32_t priority;
+    std::mutex mtx{};
+    std::condition_variable cv{};
+    std::vector<entry_t> heap{};
+    uint64_t sequence = 0;
+    uint32_t tokens = 0; // tokens in the scheduler. they point to this
+    deadline_stats_t counters{};
+
+  public:
+    /// @param priority priority of the tokens in the `work_scheduler_t`
+    deadline_queue_t(work_scheduler_t& scheduler, drop_policy_t policy, int32_t priority = 0) noexcept;
+    /// @brief Wait for the tokens in the scheduler
+    ~deadline_queue_t() noexcept;
+    deadline_queue_t(const deadline_queue_t&) = delete;
+    deadline_queue_t(deadline_queue_t&&) = delete;
+    deadline_queue_t& operator=(const deadline_queue_t&) = delete;
+    deadline_queue_t& operator=(deadline_queue_t&&) = delete;
+
+    /// @return `std::errc::operation_canceled` if the scheduler is stopped
+    std::errc put(const deadline_task_t& task) noexcept;
+
+    [[nodiscard]] deadline_stats_t stats() noexcept;
+    /// @brief Number of the tasks waiting for the worker
+    [[nodiscard]] size_t size() noexcept;
+
+  private:
+    static void run(void* context) noexcept;
+    void run_earliest() noexcept;
+};
@@ -0,0 +1,133 @@
+#include "event_trace.hpp"
+
+#include <exception>
+#include <iterator>
+#include <new>
+
+namespace {
+
+/// @brief Gives the ring back when the thread exits
+struct ring_owner_t final {
+    trace_ring_t* ring = nullptr;
+    bool attached = false;
+
+    ~ring_owner_t() noexcept {
+        if (ring)
+            event_tracer_t::instance().detach(ring);
+    }
+};
+
+thread_local ring_owner_t ring_owner{};
+
+} // namespace
+
+event_tracer_t& event_tracer_t::instance() noexcept {
+    // never destroyed. the thread-local owners may run after the static destructors
+    static event_tracer_t* tracer = new event_tracer_t{};
+    return *tracer;
+}
+
+trace_ring_t* event_tracer_t::attach() noexcept {
+    // the rings of the exited threads. their records are still drained in order
+    const uint32_t size = ring_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < size; ++i) {
+        trace_ring_t* ring = rings[i].load(std::memory_order_acquire);
+        bool expected = false;
+        // acquire: `cached_head` of the previous owner
+        if (ring->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return ring;
+    }
+    std::lock_guard lck{mtx};
+    const uint32_t index = ring_count.load(std::memory_order_relaxed);
+    if (index == max_rings)
+        return nullptr;
+    trace_ring_t* ring = new (std::nothrow) trace_ring_t{};
+    if (ring == nullptr)
+        return nullptr;
+    ring->owned.store(true, std::memory_order_relaxed);
+    rings[index].store(ring, std::memory_order_release);
+    ring_count.store(index + 1, std::memory_order_release);
+    return ring;
+}
+
+void event_tracer_t::detach(trace_ring_t* ring) noexcept {
+    ring->owned.store(false, std::memory_order_release);
+}
+
+void event_tracer_t::dump(std::FILE* stream) noexcept {
+    fmt::memory_buffer line{};
+    const uint32_t size = ring_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < size; ++i) {
+        const trace_ring_t* ring = rings[i].load(std::memory_order_acquire);
+        ring->peek([stream, i, &line](const trace_record_t& record) {
+            line.clear();
+            format_trace_record(i, record, line);
+            std::fwrite(line.data(), 1, line.size(), stream);
+            std::fputc('\n', stream);
+        });
+    }
+    std::fflush(stream);
+}
+
+uint64_t event_tracer_t::dropped() const noexcept {
+    uint64_t count = 0;
+    const uint32_t size = ring_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < size; ++i)
+        count += rings[i].load(std::memory_order_acquire)->dropped();
+    return count;
+}
+
+trace_ring_t* current_trace_ring() noexcept {
+    if (ring_owner.attached == false) {
+        ring_owner.attached = true;
+        ring_owner.ring = event_tracer_t::instance().attach();
+    }
+    return ring_owner.ring;
+}
+
+void format_trace_record(uint32_t ring, const trace_record_t& record, fmt::memory_buffer& output) noexcept {
+    using namespace std::chrono;
+    const auto time = duration_cast<microseconds>(steady_clock::duration{record.time});
+    int64_t args[4]{record.args[0], record.args[1], record.args[2], record.args[3]};
+    try {
+        fmt::format_to(std::back_inserter(output), "{:>12} [{}] {}: ", time.count(), ring, record.event->name);
+        fmt::vformat_to(std::back_inserter(output), record.event->format,
+                        fmt::make_format_args(args[0], args[1], args[2], args[3]));
+    } catch (const std::exception&) {
+        // fmt::format_error for the wrong format. the line has the name at least
+    }
+}
+
+trace_drain_t::trace_drain_t(std::chrono::milliseconds interval,
+                             std::function<void(std::string_view)> sink) noexcept(false)
+    : sink{std::move(sink)}, interval{interval} {
+    worker = std::thread{&trace_drain_t::run, this};
+}
+
+trace_drain_t::~trace_drain_t() noexcept {
+    {
+        std::lock_guard lck{mtx};
+        stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+    flush();
+}
+
+size_t trace_drain_t::flush() noexcept {
+    fmt::memory_buffer line{};
+    return event_tracer_t::instance().drain([this, &line](uint32_t ring, const trace_record_t& record) {
+        line.clear();
+        format_trace_record(ring, record, line);
+        sink({line.data(), line.size()});
+    });
+}
+
+void trace_drain_t::run() noexcept {
+    std::unique_lock lck{mtx};
+    while (cv.wait_for(lck, interval, [this]() { return stopping; }) == false) {
+        lck.unlock();
+        flush();
+        lck.lock();
+    }
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fmt/format.h>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include "sample_ring.hpp"
+
+/**
+ * @brief Static description of the event. The address is the event id, so define it with the static storage
+ * @code
+ * constexpr trace_event_t stream_changed{"mf_transform_node_t", "stream changed. buffer size {}"};
+ * trace_event(stream_changed, info.output_info.cbSize);
+ * @endcode
+ */
+struct trace_event_t final {
+    const char* name;
+    const char* format; // fmt with the integer arguments. Used only when the record is drained
+};
+
+struct trace_record_t final {
+    const trace_event_t* event = nullptr;
+    int64_t time = 0; // ticks of `std::chrono::steady_clock`
+    int64_t args[4]{};
+};
+
+/**
+ * @brief SPSC ring of one thread. The owner thread pushes and the drain pops.
+ *        The new records are dropped when the ring is full, so the owner never waits
+ */
+class trace_ring_t final {
+  public:
+    static constexpr uint32_t capacity = 1024; // power of 2
+
+  private:
+    alignas(cache_line_size) std::atomic<uint64_t> head{0}; // next position to pop. written by the drain
+    alignas(cache_line_size) std::atomic<uint64_t> tail{0}; // next position to push. written by the owner
+    uint64_t cached_head = 0;                               // the owner's copy of `head`
+    std::atomic<uint64_t> dropped_count{0};                 // written by the owner
+    std::atomic<bool> owned{false};                         // a thread is pushing. @see event_tracer_t::attach
+    trace_record_t records[capacity]{};
+
+    friend class event_tracer_t;
+
+  public:
+    /// @return false if the ring is full
+    bool push(const trace_record_t& record) noexcept {
+        const uint64_t position = tail.load(std::memory_order_relaxed);
+        if (position - cached_head == capacity) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (position - cached_head == capacity) {
+                dropped_count.store(dropped_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        records[position % capacity] = record;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Pop every record. Only one thread can consume at once
+    template <typename Fn>
+    size_t consume(Fn&& fn) noexcept {
+        const uint64_t first = head.load(std::memory_order_relaxed);
+        const uint64_t last = tail.load(std::memory_order_acquire);
+        for (uint64_t position = first; position != last; ++position)
+            fn(records[position % capacity]);
+        head.store(last, std::memory_order_release);
+        return static_cast<size_t>(last - first);
+    }
+
+    /// @brief Read the records without popping. They may be overwritten while reading if the drain is running
+    template <typename Fn>
+    void peek(Fn&& fn) const noexcept {
+        const uint64_t last = tail.load(std::memory_order_acquire);
+        for (uint64_t position = head.load(std::memory_order_acquire); position != last; ++position)
+            fn(records[position % capacity]);
+    }
+
+    [[nodiscard]] uint64_t dropped() const noexcept {
+        return dropped_count.load(std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief Process-wide owner of the `trace_ring_t`s. Each thread gets its ring on the first `trace_event`,
+ *        and the ring is reused by the other thread after the owner exits.
+ *        The tracer and the rings are never freed, so the threads can trace until the process exits
+ */
+class event_tracer_t final {
+  public:
+    static constexpr uint32_t max_rings = 256;
+
+  private:
+    std::mutex mtx{}; // for `drain` and the new ring
+    std::atomic<trace_ring_t*> rings[max_rings]{};
+    std::atomic<uint32_t> ring_count{0};
+
+  private:
+    event_tracer_t() noexcept = default;
+
+  public:
+    event_tracer_t(const event_tracer_t&) = delete;
+    event_tracer_t(event_tracer_t&&) = delete;
+    event_tracer_t& operator=(const event_tracer_t&) = delete;
+    event_tracer_t& operator=(event_tracer_t&&) = delete;
+
+    static event_tracer_t& instance() noexcept;
+
+    /// @brief The ring for the calling thread
+    /// @return nullptr if there are `max_rings` threads or the allocation failed. The events are not recorded
+    trace_ring_t* attach() noexcept;
+    /// @brief The ring can be reused after the records are drained
+    void detach(trace_ring_t* ring) noexcept;
+
+    /**
+     * @brief Pop the records of every ring
+     * @param fn `void(uint32_t ring, const trace_record_t&)`. Must not throw
+     * @return the number of the records
+     */
+    template <typename Fn>
+    size_t drain(Fn&& fn) noexcept {
+        std::lock_guard lck{mtx};
+        size_t count = 0;
+        const uint32_t size = ring_count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < size; ++i) {
+            trace_ring_t* ring = rings[i].load(std::memory_order_acquire);
+            count += ring->consume([&fn, i](const trace_record_t& record) { fn(i, record); });
+        }
+        return count;
+    }
+
+    /**
+     * @brief Write the records which are not drained yet, without locking. The other threads may be recording.
+     *        Formats with fmt and writes to `FILE*`, so it is not for a signal or crash handler
+     */
+    void dump(std::FILE* stream) noexcept;
+
+    /// @brief Sum of the records which were dropped because their ring was full
+    [[nodiscard]] uint64_t dropped() const noexcept;
+};
+
+/// @brief The ring of the calling thread. nullptr if the thread can't have one
+trace_ring_t* current_trace_ring() noexcept;
+
+/**
+ * @brief Record the event with up to 4 integers. No format, no lock, no allocation after the first call of the
+ *        thread. The arguments are formatted later by `trace_drain_t` or `event_tracer_t::dump`
+ */
+template <typename... Args>
+void trace_event(const trace_event_t& event, Args... args) noexcept {
+    static_assert(sizeof...(Args) <= 4, "trace_record_t has 4 arguments");
+    const trace_record_t record{&event, std::chrono::steady_clock::now().time_since_epoch().count(),
+                                {static_cast<int64_t>(args)...}};
+    if (trace_ring_t* ring = current_trace_ring())
+        ring->push(record);
+}
+
+/// @brief Append "time(us) [ring] name: message" to the buffer
+void format_trace_record(uint32_t ring, const trace_record_t& record, fmt::memory_buffer& output) noexcept;
+
+/**
+ * @brief Background thread which drains `event_tracer_t` periodically and passes the formatted lines to the sink.
+ *        Forward them to `spdlog` for the usual log
+ * @note  The sink must not throw
+ */
+class trace_drain_t final {
+    std::function<void(std::string_view)> sink;
+    const std::chrono::milliseconds interval;
+    std::mutex mtx{};
+    std::condition_variable cv{};
+    bool stopping = false;
+    std::thread worker{};
+
+  public:
+    /// @throws std::system_error if the thread can't start
+    trace_drain_t(std::chrono::milliseconds interval, std::function<void(std::string_view)> sink) noexcept(false);
+    /// @brief Stop the thread and drain the rest
+    ~trace_drain_t() noexcept;
+    trace_drain_t(const trace_drain_t&) = delete;
+    trace_drain_t(trace_drain_t&&) = delete;
+    trace_drain_t& operator=(const trace_drain_t&) = delete;
+    trace_drain_t& operator=(trace_drain_t&&) = delete;
+
+    /// @brief Drain on the caller's thread now
+    /// @return the number of the records
+    size_t flush() noexcept;
+
+  private:
+    void run() noexcept;
+};
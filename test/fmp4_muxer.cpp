@@ -0,0 +1,486 @@
+#include "fmp4_muxer.hpp"
+#include "h264_parser.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/// @brief Serialize ISO BMFF boxes. The size of the box is patched when the box ends
+class box_writer_t final {
+    std::vector<uint8_t>& buf;
+    std::array<size_t, 12> stack{};
+    size_t depth = 0;
+
+  public:
+    explicit box_writer_t(std::vector<uint8_t>& buf) noexcept : buf{buf} {
+    }
+
+    void u8(uint32_t v) {
+        buf.push_back(static_cast<uint8_t>(v));
+    }
+    void u16(uint32_t v) {
+        u8(v >> 8);
+        u8(v);
+    }
+    void u24(uint32_t v) {
+        u8(v >> 16);
+        u16(v);
+    }
+    void u32(uint32_t v) {
+        u16(v >> 16);
+        u16(v);
+    }
+    void u64(uint64_t v) {
+        u32(static_cast<uint32_t>(v >> 32));
+        u32(static_cast<uint32_t>(v));
+    }
+    void zeros(size_t count) {
+        buf.insert(buf.end(), count, 0);
+    }
+    void bytes(gsl::span<const uint8_t> data) {
+        buf.insert(buf.end(), data.begin(), data.end());
+    }
+    void fourcc(const char* type) {
+        buf.insert(buf.end(), type, type + 4);
+    }
+    /// @brief unity matrix of `mvhd`, `tkhd`
+    void matrix() {
+        constexpr uint32_t values[9]{0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+        for (uint32_t v : values)
+            u32(v);
+    }
+
+    void begin(const char* type) {
+        stack[depth++] = buf.size();
+        u32(0);
+        fourcc(type);
+    }
+    void begin(const char* type, uint8_t version, uint32_t flags) {
+        begin(type);
+        u8(version);
+        u24(flags);
+    }
+    void end() noexcept {
+        const size_t offset = stack[--depth];
+        const auto size = static_cast<uint32_t>(buf.size() - offset);
+        buf[offset + 0] = static_cast<uint8_t>(size >> 24);
+        buf[offset + 1] = static_cast<uint8_t>(size >> 16);
+        buf[offset + 2] = static_cast<uint8_t>(size >> 8);
+        buf[offset + 3] = static_cast<uint8_t>(size);
+    }
+};
+
+/// @brief Make `avcC` with 4 byte NAL unit length from Annex B SPS/PPS
+/// @see ISO/IEC 14496-15 5.2.4.1 AVCDecoderConfigurationRecord
+std::errc make_avcc(gsl::span<const uint8_t> stream, std::vector<uint8_t>& avcc) {
+    std::vector<gsl::span<const uint8_t>> sps_list{}, pps_list{};
+    for (auto nal = next_annexb_nal(stream); nal.empty() == false; nal = next_annexb_nal(stream)) {
+        if (nal.size() > UINT16_MAX)
+            return std::errc::invalid_argument;
+        if (get_nal_type(nal) == h264_nal_type_t::sps)
+            sps_list.emplace_back(nal);
+        else if (get_nal_type(nal) == h264_nal_type_t::pps)
+            pps_list.emplace_back(nal);
+    }
+    if (sps_list.empty() || pps_list.empty() || sps_list.size() > 31 || pps_list.size() > 255 ||
+        sps_list[0].size() < 4)
+        return std::errc::invalid_argument;
+    avcc.clear();
+    avcc.push_back(1);                // configurationVersion
+    avcc.push_back(sps_list[0][1]);   // AVCProfileIndication
+    avcc.push_back(sps_list[0][2]);   // profile_compatibility
+    avcc.push_back(sps_list[0][3]);   // AVCLevelIndication
+    avcc.push_back(0xFC | 3);         // lengthSizeMinusOne
+    avcc.push_back(0xE0 | static_cast<uint8_t>(sps_list.size()));
+    for (auto nal : sps_list) {
+        avcc.push_back(static_cast<uint8_t>(nal.size() >> 8));
+        avcc.push_back(static_cast<uint8_t>(nal.size()));
+        avcc.insert(avcc.end(), nal.begin(), nal.end());
+    }
+    avcc.push_back(static_cast<uint8_t>(pps_list.size()));
+    for (auto nal : pps_list) {
+        avcc.push_back(static_cast<uint8_t>(nal.size() >> 8));
+        avcc.push_back(static_cast<uint8_t>(nal.size()));
+        avcc.insert(avcc.end(), nal.begin(), nal.end());
+    }
+    return std::errc{};
+}
+
+/// @brief The first SPS in the `avcC`
+gsl::span<const uint8_t> find_avcc_sps(gsl::span<const uint8_t> avcc) noexcept {
+    if (avcc.size() < 8 || (avcc[5] & 0x1F) == 0)
+        return {};
+    const size_t length = (static_cast<size_t>(avcc[6]) << 8) | avcc[7];
+    if (avcc.size() - 8 < length)
+        return {};
+    return avcc.subspan(8, length);
+}
+
+/// @see ISO/IEC 14496-12 8.8.3.1 sample_flags
+constexpr uint32_t sync_sample_flags = 0x02000000;     // sample_depends_on = 2
+constexpr uint32_t non_sync_sample_flags = 0x01010000; // sample_depends_on = 1, sample_is_non_sync_sample = 1
+
+} // namespace
+
+fmp4_fd_output_t::fmp4_fd_output_t(int fd) noexcept : fd{fd} {
+}
+
+std::errc fmp4_fd_output_t::write(gsl::span<const io_slice_t> slices) noexcept {
+#if defined(_WIN32)
+    for (const io_slice_t& slice : slices) {
+        auto ptr = static_cast<const char*>(slice.data);
+        size_t remain = slice.size;
+        while (remain) {
+            const int written = _write(fd, ptr, static_cast<unsigned int>(std::min<size_t>(remain, INT_MAX)));
+            if (written < 0)
+                return static_cast<std::errc>(errno);
+            ptr += written;
+            remain -= written;
+        }
+    }
+    return std::errc{};
+#else
+    constexpr size_t batch = 64; // smaller than IOV_MAX
+    iovec vectors[batch]{};
+    size_t index = 0, offset = 0; // `offset` is for the partially written `slices[index]`
+    while (index < slices.size()) {
+        int count = 0;
+        for (size_t i = index; i < slices.size() && count < static_cast<int>(batch); ++i, ++count) {
+            const size_t skip = (i == index) ? offset : 0;
+            vectors[count].iov_base = const_cast<uint8_t*>(static_cast<const uint8_t*>(slices[i].data) + skip);
+            vectors[count].iov_len = slices[i].size - skip;
+        }
+        const ssize_t written = ::writev(fd, vectors, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return static_cast<std::errc>(errno);
+        }
+        auto remain = static_cast<size_t>(written);
+        while (index < slices.size() && remain >= slices[index].size - offset) {
+            remain -= slices[index].size - offset;
+            ++index;
+            offset = 0;
+        }
+        offset += remain;
+    }
+    return std::errc{};
+#endif
+}
+
+fmp4_muxer_t::fmp4_muxer_t(fmp4_output_t& output, fmp4_muxer_config_t config) noexcept(false)
+    : output{output}, config{std::move(config)} {
+    // reserve everything here. `prefixes` must not be reallocated since `slices` point them
+    entries.reserve(this->config.max_samples);
+    slices.reserve(this->config.max_slices + 1);
+    prefixes.reserve(this->config.max_slices * 4);
+    header.reserve(256 + 16 * this->config.max_samples);
+}
+
+std::errc fmp4_muxer_t::write_header() noexcept {
+    if (config.max_samples == 0 || config.max_slices == 0 || config.timescale == 0)
+        return std::errc::invalid_argument;
+    const uint32_t length_size = config.length_size ? config.length_size : 4;
+    if (length_size != 1 && length_size != 2 && length_size != 4)
+        return std::errc::invalid_argument;
+    try {
+        gsl::span<const uint8_t> sequence_header{config.sequence_header};
+        if (sequence_header.size() > 5 && sequence_header[0] == 1) {
+            avcc.assign(sequence_header.begin(), sequence_header.end());
+        } else if (auto ec = make_avcc(sequence_header, avcc); ec != std::errc{}) {
+            return ec;
+        }
+        avcc[4] = static_cast<uint8_t>(0xFC | (length_size - 1));
+        if (config.width == 0 || config.height == 0) {
+            h264_sps_t sps{};
+            if (auto ec = parse_sps(find_avcc_sps(avcc), sps); ec != std::errc{})
+                return ec;
+            config.width = sps.width;
+            config.height = sps.height;
+        }
+
+        std::vector<uint8_t> init{};
+        box_writer_t w{init};
+        w.begin("ftyp");
+        w.fourcc("iso6"); // major_brand
+        w.u32(0);         // minor_version
+        w.fourcc("iso6");
+        w.fourcc("cmfc");
+        w.fourcc("avc1");
+        w.end();
+        w.begin("moov");
+        {
+            w.begin("mvhd", 0, 0);
+            w.u32(0); // creation_time
+            w.u32(0); // modification_time
+            w.u32(config.timescale);
+            w.u32(0);          // duration. unknown for the fragments
+            w.u32(0x00010000); // rate
+            w.u16(0x0100);     // volume
+            w.zeros(10);
+            w.matrix();
+            w.zeros(24); // pre_defined
+            w.u32(2);    // next_track_ID
+            w.end();
+            w.begin("trak");
+            {
+                w.begin("tkhd", 0, 0x3); // track_enabled | track_in_movie
+                w.u32(0);
+                w.u32(0);
+                w.u32(1); // track_ID
+                w.u32(0);
+                w.u32(0); // duration
+                w.zeros(8);
+                w.u16(0); // layer
+                w.u16(0); // alternate_group
+                w.u16(0); // volume
+                w.u16(0);
+                w.matrix();
+                w.u32(config.width << 16);
+                w.u32(config.height << 16);
+                w.end();
+                w.begin("mdia");
+                {
+                    w.begin("mdhd", 0, 0);
+                    w.u32(0);
+                    w.u32(0);
+                    w.u32(config.timescale);
+                    w.u32(0);
+                    w.u16(0x55C4); // 'und'
+                    w.u16(0);
+                    w.end();
+                    w.begin("hdlr", 0, 0);
+                    w.u32(0);
+                    w.fourcc("vide");
+                    w.zeros(12);
+                    w.bytes({reinterpret_cast<const uint8_t*>("VideoHandler"), 13});
+                    w.end();
+                    w.begin("minf");
+                    {
+                        w.begin("vmhd", 0, 1);
+                        w.zeros(8); // graphicsmode, opcolor
+                        w.end();
+                        w.begin("dinf");
+                        w.begin("dref", 0, 0);
+                        w.u32(1);
+                        w.begin("url ", 0, 1); // self-contained
+                        w.end();
+                        w.end();
+                        w.end();
+                        w.begin("stbl");
+                        {
+                            w.begin("stsd", 0, 0);
+                            w.u32(1);
+                            w.begin("avc1");
+                            w.zeros(6);
+                            w.u16(1); // data_reference_index
+                            w.zeros(16);
+                            w.u16(config.width);
+                            w.u16(config.height);
+                            w.u32(0x00480000); // horizresolution
+                            w.u32(0x00480000); // vertresolution
+                            w.u32(0);
+                            w.u16(1); // frame_count
+                            w.zeros(32);
+                            w.u16(0x0018); // depth
+                            w.u16(0xFFFF); // pre_defined
+                            w.begin("avcC");
+                            w.bytes(avcc);
+                            w.end();
+                            w.end();
+                            w.end();
+                            for (const char* type : {"stts", "stsc", "stco"}) {
+                                w.begin(type, 0, 0);
+                                w.u32(0);
+                                w.end();
+                            }
+                            w.begin("stsz", 0, 0);
+                            w.u32(0);
+                            w.u32(0);
+                            w.end();
+                        }
+                        w.end();
+                    }
+                    w.end();
+                }
+                w.end();
+            }
+            w.end();
+            w.begin("mvex");
+            w.begin("trex", 0, 0);
+            w.u32(1); // track_ID
+            w.u32(1); // default_sample_description_index
+            w.u32(0);
+            w.u32(0);
+            w.u32(0);
+            w.end();
+            w.end();
+        }
+        w.end();
+        io_slice_t slice{init.data(), init.size()};
+        if (auto ec = output.write({&slice, 1}); ec != std::errc{})
+            return ec;
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    header_written = true;
+    return std::errc{};
+}
+
+std::errc fmp4_muxer_t::append(const fmp4_sample_t& sample) noexcept {
+    if (header_written == false)
+        if (auto ec = write_header(); ec != std::errc{})
+            return ec;
+    // count the NAL units to write. AUD and filler data are not stored in MP4 samples
+    auto is_stored = [](gsl::span<const uint8_t> nal) {
+        const auto type = get_nal_type(nal);
+        return type != h264_nal_type_t::aud && type != h264_nal_type_t::filler;
+    };
+    size_t num_slices = 1;
+    uint64_t num_bytes = sample.data.size();
+    if (config.length_size == 0) {
+        num_slices = num_bytes = 0;
+        auto stream = sample.data;
+        for (auto nal = next_annexb_nal(stream); nal.empty() == false; nal = next_annexb_nal(stream)) {
+            if (is_stored(nal) == false)
+                continue;
+            num_slices += 2;
+            num_bytes += 4 + nal.size();
+        }
+        if (num_slices == 0)
+            return std::errc::invalid_argument;
+    }
+    if (num_slices > config.max_slices || num_bytes > config.max_bytes || num_bytes > UINT32_MAX)
+        return std::errc::value_too_large;
+
+    if (entries.empty() == false) {
+        const int64_t elapsed = sample.decode_time - time_offset - entries.front().decode_time;
+        const bool long_enough = sample.sync && elapsed >= static_cast<int64_t>(config.fragment_duration);
+        const bool full = entries.size() == config.max_samples || slices.size() - 1 + num_slices > config.max_slices ||
+                          fragment_bytes + num_bytes > config.max_bytes;
+        if (long_enough || full)
+            if (auto ec = write_fragment(sample.decode_time - time_offset); ec != std::errc{})
+                return ec;
+    }
+    if (slices.empty())
+        slices.emplace_back(); // for the header
+    if (config.length_size) {
+        slices.emplace_back(io_slice_t{sample.data.data(), sample.data.size()});
+    } else {
+        auto stream = sample.data;
+        for (auto nal = next_annexb_nal(stream); nal.empty() == false; nal = next_annexb_nal(stream)) {
+            if (is_stored(nal) == false)
+                continue;
+            const auto length = static_cast<uint32_t>(nal.size());
+            const uint8_t prefix[4]{static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+                                    static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+            const size_t offset = prefixes.size();
+            prefixes.insert(prefixes.end(), prefix, prefix + 4); // within the reserved capacity
+            slices.emplace_back(io_slice_t{prefixes.data() + offset, 4});
+            slices.emplace_back(io_slice_t{nal.data(), nal.size()});
+        }
+    }
+    // the timeline starts from 0. the first decode time can be negative when the stream has B frames
+    if (time_offset == unknown_time)
+        time_offset = std::min<int64_t>(sample.decode_time, 0);
+    entry_t entry{};
+    entry.size = static_cast<uint32_t>(num_bytes);
+    entry.decode_time = sample.decode_time - time_offset;
+    entry.presentation_time = sample.presentation_time - time_offset;
+    entry.sync = sample.sync;
+    entry.owner = sample.owner;
+    entries.emplace_back(std::move(entry));
+    fragment_bytes += num_bytes;
+    return std::errc{};
+}
+
+std::errc fmp4_muxer_t::flush() noexcept {
+    return write_fragment(unknown_time);
+}
+
+std::errc fmp4_muxer_t::finalize() noexcept {
+    if (header_written == false)
+        if (auto ec = write_header(); ec != std::errc{})
+            return ec;
+    if (auto ec = flush(); ec != std::errc{})
+        return ec;
+    return output.flush();
+}
+
+std::errc fmp4_muxer_t::write_fragment(int64_t next_decode_time) noexcept {
+    if (entries.empty())
+        return std::errc{};
+    const size_t count = entries.size();
+    header.clear(); // capacity is reserved for `max_samples`
+    try {
+        box_writer_t w{header};
+        w.begin("moof");
+        w.begin("mfhd", 0, 0);
+        w.u32(sequence_number + 1);
+        w.end();
+        w.begin("traf");
+        w.begin("tfhd", 0, 0x020000); // default-base-is-moof
+        w.u32(1);                     // track_ID
+        w.end();
+        w.begin("tfdt", 1, 0);
+        w.u64(static_cast<uint64_t>(entries.front().decode_time));
+        w.end();
+        // data-offset, sample-duration, sample-size, sample-flags, sample-composition-time-offset
+        w.begin("trun", 1, 0x000F01);
+        w.u32(static_cast<uint32_t>(count));
+        const size_t data_offset_position = header.size();
+        w.u32(0); // data_offset. patched below
+        for (size_t i = 0; i < count; ++i) {
+            const entry_t& entry = entries[i];
+            int64_t duration = last_duration;
+            if (i + 1 < count)
+                duration = entries[i + 1].decode_time - entry.decode_time;
+            else if (next_decode_time != unknown_time)
+                duration = next_decode_time - entry.decode_time;
+            duration = std::clamp<int64_t>(duration, 0, UINT32_MAX);
+            last_duration = duration;
+            w.u32(static_cast<uint32_t>(duration));
+            w.u32(entry.size);
+            w.u32(entry.sync ? sync_sample_flags : non_sync_sample_flags);
+            const int64_t offset = std::clamp<int64_t>(entry.presentation_time - entry.decode_time, INT32_MIN, INT32_MAX);
+            w.u32(static_cast<uint32_t>(static_cast<int32_t>(offset)));
+        }
+        w.end(); // trun
+        w.end(); // traf
+        w.end(); // moof
+        const auto moof_size = static_cast<uint32_t>(header.size());
+        const bool large = fragment_bytes + 8 > UINT32_MAX;
+        const uint32_t data_offset = moof_size + (large ? 16 : 8);
+        for (int i = 0; i < 4; ++i)
+            header[data_offset_position + i] = static_cast<uint8_t>(data_offset >> (24 - 8 * i));
+        if (large) {
+            w.u32(1);
+            w.fourcc("mdat");
+            w.u64(fragment_bytes + 16);
+        } else {
+            w.u32(static_cast<uint32_t>(fragment_bytes + 8));
+            w.fourcc("mdat");
+        }
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    slices[0] = io_slice_t{header.data(), header.size()};
+    const auto ec = output.write(slices);
+    // release the samples even if the write failed. the fragment can't be written again
+    entries.clear();
+    slices.clear();
+    prefixes.clear();
+    fragment_bytes = 0;
+    ++sequence_number;
+    return ec;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <climits>
+#include <cstdint>
+#include <gsl/gsl>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+/// @brief Non-owning memory region for vectored write. Same role with POSIX `iovec`
+struct io_slice_t final {
+    const void* data = nullptr;
+    size_t size = 0;
+};
+
+/// @brief Destination of `fmp4_muxer_t`. Implementations must write all slices in the given order
+struct fmp4_output_t {
+    virtual ~fmp4_output_t() = default;
+
+    virtual std::errc write(gsl::span<const io_slice_t> slices) noexcept = 0;
+    virtual std::errc flush() noexcept {
+        return std::errc{};
+    }
+};
+
+/// @brief Write to a file descriptor. Works with pipes, so the fragments can go to `stdout`
+/// @note The descriptor is not closed by this type
+class fmp4_fd_output_t final : public fmp4_output_t {
+    int fd;
+
+  public:
+    explicit fmp4_fd_output_t(int fd) noexcept;
+
+    std::errc write(gsl::span<const io_slice_t> slices) noexcept override;
+};
+
+struct fmp4_muxer_config_t final {
+    uint32_t timescale = 90000; // unit of `fmp4_sample_t`'s timestamps
+    uint32_t width = 0;         // 0 to use the SPS
+    uint32_t height = 0;        // 0 to use the SPS
+    /// @brief AVCDecoderConfigurationRecord(`avcC`) or Annex B SPS/PPS like `MF_MT_MPEG_SEQUENCE_HEADER`
+    std::vector<uint8_t> sequence_header{};
+    /// @brief 0 if the samples are Annex B byte stream. Or the size of NAL unit length prefix
+    uint32_t length_size = 0;
+    /// @brief Fragment is closed at the next sync sample after this duration (in `timescale`)
+    uint64_t fragment_duration = 90000;
+    /// @brief Bounds of a fragment. The fragment is closed early when one of them is reached
+    size_t max_samples = 256;
+    size_t max_slices = 4096;
+    uint64_t max_bytes = 64 << 20;
+};
+
+/// @brief Encoded access unit. Timestamps are in `fmp4_muxer_config_t::timescale`
+struct fmp4_sample_t final {
+    gsl::span<const uint8_t> data{};
+    int64_t decode_time = 0;
+    int64_t presentation_time = 0;
+    bool sync = false;
+    /// @brief Keeps `data` alive until the fragment is written. The muxer doesn't copy the sample data
+    std::shared_ptr<const void> owner{};
+};
+
+/**
+ * @brief Streaming fragmented MP4(CMAF) writer for single H.264 track.
+ *        Writes `ftyp`/`moov` once and then `moof`/`mdat` pairs as the fragments are closed.
+ *        Memory use is bounded by `max_samples`/`max_slices`/`max_bytes`. The sample data is written with vectored
+ *        write, and Annex B start codes are replaced with length prefixes without copying the NAL units.
+ * @see ISO/IEC 14496-12 8.8 Movie Fragments
+ * @see ISO/IEC 23000-19 (CMAF)
+ */
+class fmp4_muxer_t final {
+    static constexpr int64_t unknown_time = INT64_MIN;
+
+    struct entry_t final {
+        uint32_t size = 0;
+        int64_t decode_time = 0;
+        int64_t presentation_time = 0;
+        bool sync = false;
+        std::shared_ptr<const void> owner{};
+    };
+
+    fmp4_output_t& output;
+    fmp4_muxer_config_t config;
+    std::vector<uint8_t> avcc{};
+    std::vector<entry_t> entries{};
+    std::vector<io_slice_t> slices{};      // slices[0] is reserved for `moof` and `mdat` header
+    std::vector<uint8_t> prefixes{};       // 4 byte length prefix for each NAL unit of Annex B samples
+    std::vector<uint8_t> header{};         // `moof` and `mdat` header
+    uint64_t fragment_bytes = 0;
+    uint32_t sequence_number = 0;
+    int64_t last_duration = 0;
+    int64_t time_offset = unknown_time;
+    bool header_written = false;
+
+  public:
+    /// @throws std::bad_alloc
+    fmp4_muxer_t(fmp4_output_t& output, fmp4_muxer_config_t config) noexcept(false);
+
+    /// @brief Write the initialization segment(`ftyp` + `moov`)
+    std::errc write_header() noexcept;
+    /// @brief Append the access unit to the current fragment. The previous fragment is written if needed
+    /// @note samples must be appended in decoding order
+    std::errc append(const fmp4_sample_t& sample) noexcept;
+    /// @brief Write the current fragment
+    std::errc flush() noexcept;
+    /// @brief Write the remaining samples and flush the output. For the drain of the pipeline
+    std::errc finalize() noexcept;
+
+    [[nodiscard]] uint32_t fragment_count() const noexcept {
+        return sequence_number;
+    }
+
+  private:
+    std::errc write_fragment(int64_t next_decode_time) noexcept;
+};
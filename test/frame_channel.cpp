@@ -0,0 +1,407 @@
+#include "frame_channel.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint32_t channel_magic = 0x4843464D; // "MFCH"
+constexpr uint32_t channel_version = 1;
+constexpr uint32_t max_slot_count = 1024;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the atomics in the shared memory must be address-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the atomics in the shared memory must be address-free");
+
+struct ring_header_t final {
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+};
+
+/// @brief Start of the shared memory. Followed by the 2 ring entries, the descriptors, and the slots
+struct channel_header_t final {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t slot_size;
+    uint64_t data_offset; // the first slot
+    std::atomic<uint32_t> closed;
+    ring_header_t ready; // producer -> consumer
+    ring_header_t free;  // consumer -> producer
+};
+
+#if defined(_WIN32)
+const native_handle_t invalid_handle = nullptr;
+#else
+constexpr native_handle_t invalid_handle = -1;
+#endif
+
+size_t get_page_size() noexcept {
+#if defined(_WIN32)
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+size_t metadata_size(uint32_t count) noexcept {
+    return sizeof(channel_header_t) + 2 * sizeof(std::atomic<uint32_t>) * count + sizeof(frame_descriptor_t) * count;
+}
+
+channel_header_t* header_of(uint8_t* base) noexcept {
+    return reinterpret_cast<channel_header_t*>(base);
+}
+
+std::atomic<uint32_t>* ready_entries(uint8_t* base) noexcept {
+    return reinterpret_cast<std::atomic<uint32_t>*>(base + sizeof(channel_header_t));
+}
+
+std::atomic<uint32_t>* free_entries(uint8_t* base, uint32_t count) noexcept {
+    return ready_entries(base) + count;
+}
+
+uint8_t* descriptors(uint8_t* base, uint32_t count) noexcept {
+    return reinterpret_cast<uint8_t*>(free_entries(base, count) + count);
+}
+
+#if defined(_WIN32)
+std::errc create_memory(size_t size, native_handle_t& handle, uint8_t*& base) noexcept {
+    handle = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(uint64_t{size} >> 32),
+                                static_cast<DWORD>(size), nullptr);
+    if (handle == nullptr)
+        return std::errc::not_enough_memory;
+    base = static_cast<uint8_t*>(MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size));
+    if (base == nullptr) {
+        CloseHandle(handle);
+        handle = nullptr;
+        return std::errc::not_enough_memory;
+    }
+    return std::errc{};
+}
+
+std::errc map_memory(native_handle_t handle, uint8_t*& base, size_t& size) noexcept {
+    base = static_cast<uint8_t*>(MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (base == nullptr)
+        return std::errc::invalid_argument;
+    // the pagefile-backed section can't shrink. the view size is the section size rounded up to the page
+    MEMORY_BASIC_INFORMATION info{};
+    if (VirtualQuery(base, &info, sizeof(info)) == 0) {
+        UnmapViewOfFile(base);
+        base = nullptr;
+        return std::errc::invalid_argument;
+    }
+    size = info.RegionSize;
+    return std::errc{};
+}
+
+void unmap_memory(native_handle_t handle, uint8_t* base, size_t) noexcept {
+    if (base)
+        UnmapViewOfFile(base);
+    if (handle)
+        CloseHandle(handle);
+}
+#else
+int create_file() noexcept {
+#if defined(__linux__)
+    return memfd_create("frame_channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    static std::atomic<uint32_t> sequence{0};
+    char name[64]{};
+    std::snprintf(name, sizeof(name), "/frame_channel-%d-%u", static_cast<int>(getpid()), sequence++);
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+        shm_unlink(name);
+    return fd;
+#endif
+}
+
+std::errc create_memory(size_t size, native_handle_t& handle, uint8_t*& base) noexcept {
+    const int fd = create_file();
+    if (fd < 0)
+        return static_cast<std::errc>(errno);
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        const auto ec = static_cast<std::errc>(errno);
+        ::close(fd);
+        return ec;
+    }
+#if defined(__linux__)
+    // the consumer requires these. the size is fixed for both sides
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        const auto ec = static_cast<std::errc>(errno);
+        ::close(fd);
+        return ec;
+    }
+#endif
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        const auto ec = static_cast<std::errc>(errno);
+        ::close(fd);
+        return ec;
+    }
+    handle = fd;
+    base = static_cast<uint8_t*>(ptr);
+    return std::errc{};
+}
+
+std::errc map_memory(native_handle_t handle, uint8_t*& base, size_t& size) noexcept {
+    struct stat status {};
+    if (fstat(handle, &status) < 0)
+        return static_cast<std::errc>(errno);
+#if defined(__linux__)
+    const int seals = fcntl(handle, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0)
+        return std::errc::protocol_error; // the peer could shrink the file under our mapping
+#endif
+    if (status.st_size <= 0)
+        return std::errc::protocol_error;
+    size = static_cast<size_t>(status.st_size);
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+    if (ptr == MAP_FAILED)
+        return static_cast<std::errc>(errno);
+    base = static_cast<uint8_t*>(ptr);
+    return std::errc{};
+}
+
+void unmap_memory(native_handle_t handle, uint8_t* base, size_t size) noexcept {
+    if (base)
+        munmap(base, size);
+    if (handle >= 0)
+        ::close(handle);
+}
+#endif
+
+} // namespace
+
+frame_channel_t::frame_channel_t() noexcept : handle{invalid_handle} {
+}
+
+frame_channel_t::~frame_channel_t() noexcept {
+    close();
+}
+
+void frame_channel_t::close() noexcept {
+    unmap_memory(handle, base, length);
+    handle = invalid_handle;
+    base = nullptr;
+    length = 0;
+    slot_count = 0;
+    slot_size = 0;
+    data_offset = 0;
+    ready_index = 0;
+    free_index = 0;
+}
+
+std::errc frame_channel_t::create(const frame_channel_config_t& config) noexcept {
+    close();
+    if (config.slot_count == 0 || config.slot_count > max_slot_count || config.slot_size == 0)
+        return std::errc::invalid_argument;
+    const size_t page = get_page_size();
+    const size_t size = (config.slot_size + page - 1) / page * page;
+    if (size > UINT32_MAX) // `frame_descriptor_t::size`
+        return std::errc::value_too_large;
+    const size_t offset = (metadata_size(config.slot_count) + page - 1) / page * page;
+    if (size > (SIZE_MAX - offset) / config.slot_count)
+        return std::errc::value_too_large;
+    const size_t total = offset + size * config.slot_count;
+    if (auto ec = create_memory(total, handle, base); ec != std::errc{})
+        return ec;
+    length = total;
+    slot_count = config.slot_count;
+    slot_size = size;
+    data_offset = offset;
+
+    auto* header = new (base) channel_header_t{};
+    header->magic = channel_magic;
+    header->version = channel_version;
+    header->slot_count = slot_count;
+    header->slot_size = slot_size;
+    header->data_offset = data_offset;
+    std::atomic<uint32_t>* entries = free_entries(base, slot_count);
+    for (uint32_t i = 0; i < slot_count; ++i)
+        entries[i].store(i, std::memory_order_relaxed);
+    header->free.head.store(slot_count, std::memory_order_release);
+    return std::errc{};
+}
+
+std::errc frame_channel_t::open(native_handle_t value) noexcept {
+    close();
+    handle = value;
+    if (auto ec = map_memory(handle, base, length); ec != std::errc{}) {
+        close();
+        return ec;
+    }
+    // copy and validate the header once. the producer may change it later
+    channel_header_t* header = header_of(base);
+    if (length < sizeof(channel_header_t) || header->magic != channel_magic || header->version != channel_version) {
+        close();
+        return std::errc::protocol_error;
+    }
+    const uint32_t count = header->slot_count;
+    const uint64_t size = header->slot_size;
+    const uint64_t offset = header->data_offset;
+    if (count == 0 || count > max_slot_count || size == 0 || size > UINT32_MAX || offset < metadata_size(count) ||
+        offset % 64 != 0 || offset > length || size * count > length - offset) {
+        close();
+        return std::errc::protocol_error;
+    }
+    slot_count = count;
+    slot_size = static_cast<size_t>(size);
+    data_offset = static_cast<size_t>(offset);
+    ready_index = header->ready.tail.load(std::memory_order_acquire);
+    free_index = header->free.head.load(std::memory_order_acquire);
+    return std::errc{};
+}
+
+std::errc frame_channel_t::acquire(uint32_t& slot, gsl::span<uint8_t>& memory) noexcept {
+    if (base == nullptr)
+        return std::errc::bad_file_descriptor;
+    channel_header_t* header = header_of(base);
+    const uint64_t head = header->free.head.load(std::memory_order_acquire);
+    if (head == free_index)
+        return std::errc::resource_unavailable_try_again;
+    if (head - free_index > slot_count)
+        return std::errc::protocol_error;
+    const uint32_t index = free_entries(base, slot_count)[free_index % slot_count].load(std::memory_order_relaxed);
+    if (index >= slot_count)
+        return std::errc::protocol_error;
+    header->free.tail.store(++free_index, std::memory_order_release);
+    slot = index;
+    memory = gsl::span<uint8_t>{base + data_offset + slot_size * index, slot_size};
+    return std::errc{};
+}
+
+std::errc frame_channel_t::publish(const frame_descriptor_t& frame) noexcept {
+    if (base == nullptr)
+        return std::errc::bad_file_descriptor;
+    if (frame.slot >= slot_count || frame.size > slot_size)
+        return std::errc::invalid_argument;
+    channel_header_t* header = header_of(base);
+    const uint64_t tail = header->ready.tail.load(std::memory_order_acquire);
+    if (ready_index - tail >= slot_count)
+        return std::errc::resource_unavailable_try_again;
+    std::memcpy(descriptors(base, slot_count) + sizeof(frame_descriptor_t) * frame.slot, &frame, sizeof(frame));
+    ready_entries(base)[ready_index % slot_count].store(frame.slot, std::memory_order_relaxed);
+    header->ready.head.store(++ready_index, std::memory_order_release);
+    return std::errc{};
+}
+
+void frame_channel_t::shutdown() noexcept {
+    if (base)
+        header_of(base)->closed.store(1, std::memory_order_release);
+}
+
+std::errc frame_channel_t::receive(frame_descriptor_t& frame, gsl::span<const uint8_t>& memory) noexcept {
+    if (base == nullptr)
+        return std::errc::bad_file_descriptor;
+    channel_header_t* header = header_of(base);
+    // `closed` before `head`. the last `publish` is visible if the shutdown is
+    const bool closed = header->closed.load(std::memory_order_acquire);
+    const uint64_t head = header->ready.head.load(std::memory_order_acquire);
+    if (head == ready_index)
+        return closed ? std::errc::no_message_available : std::errc::resource_unavailable_try_again;
+    if (head - ready_index > slot_count)
+        return std::errc::protocol_error;
+    const uint32_t index = ready_entries(base)[ready_index % slot_count].load(std::memory_order_relaxed);
+    if (index >= slot_count)
+        return std::errc::protocol_error;
+    frame_descriptor_t copy{};
+    std::memcpy(&copy, descriptors(base, slot_count) + sizeof(frame_descriptor_t) * index, sizeof(copy));
+    if (copy.slot != index || copy.size > slot_size)
+        return std::errc::protocol_error;
+    header->ready.tail.store(++ready_index, std::memory_order_release);
+    frame = copy;
+    memory = gsl::span<const uint8_t>{base + data_offset + slot_size * index, copy.size};
+    return std::errc{};
+}
+
+std::errc frame_channel_t::release(uint32_t slot) noexcept {
+    if (base == nullptr)
+        return std::errc::bad_file_descriptor;
+    if (slot >= slot_count)
+        return std::errc::invalid_argument;
+    channel_header_t* header = header_of(base);
+    const uint64_t tail = header->free.tail.load(std::memory_order_acquire);
+    if (free_index - tail >= slot_count)
+        return std::errc::protocol_error; // more slots than the channel has
+    free_entries(base, slot_count)[free_index % slot_count].store(slot, std::memory_order_relaxed);
+    header->free.head.store(++free_index, std::memory_order_release);
+    return std::errc{};
+}
+
+#if defined(_WIN32)
+std::errc duplicate_handle(native_handle_t handle, uint32_t process_id, native_handle_t& output) noexcept {
+    HANDLE process = OpenProcess(PROCESS_DUP_HANDLE, FALSE, process_id);
+    if (process == nullptr)
+        return std::errc::no_such_process;
+    auto on_return = gsl::finally([process]() { CloseHandle(process); });
+    if (DuplicateHandle(GetCurrentProcess(), handle, process, &output, 0, FALSE, DUPLICATE_SAME_ACCESS) == FALSE)
+        return std::errc::permission_denied;
+    return std::errc{};
+}
+#else
+std::errc send_handle(int socket, native_handle_t handle) noexcept {
+    char payload = 'F';
+    iovec vector{&payload, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &handle, sizeof(int));
+    while (sendmsg(socket, &message, 0) < 0)
+        if (errno != EINTR)
+            return static_cast<std::errc>(errno);
+    return std::errc{};
+}
+
+std::errc receive_handle(int socket, native_handle_t& handle) noexcept {
+    char payload = 0;
+    iovec vector{&payload, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+#if defined(MSG_CMSG_CLOEXEC)
+    const int flags = MSG_CMSG_CLOEXEC;
+#else
+    const int flags = 0;
+#endif
+    ssize_t received = 0;
+    while ((received = recvmsg(socket, &message, flags)) < 0)
+        if (errno != EINTR)
+            return static_cast<std::errc>(errno);
+    if (received == 0)
+        return std::errc::no_message_available;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+        return std::errc::protocol_error;
+    std::memcpy(&handle, CMSG_DATA(cmsg), sizeof(int));
+    if (message.msg_flags & MSG_CTRUNC) {
+        ::close(handle);
+        return std::errc::protocol_error;
+    }
+    return std::errc{};
+}
+#endif
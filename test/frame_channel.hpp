@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <gsl/gsl>
+#include <system_error>
+
+#include "planar_frame.hpp"
+
+#if defined(_WIN32)
+using native_handle_t = void*; // HANDLE of the file mapping
+#else
+using native_handle_t = int; // memfd
+#endif
+
+struct frame_channel_config_t final {
+    uint32_t slot_count = 8;
+    size_t slot_size = 0; // bytes of the largest frame. rounded up to the page
+};
+
+/// @brief Frame in the slot. The consumer must check the fields before use, because the producer may be untrusted
+struct frame_descriptor_t final {
+    uint32_t slot = 0;
+    uint32_t size = 0; // bytes in the slot
+    int64_t time = 0;  // 100ns unit like `IMFSample::GetSampleTime`
+    int64_t duration = 0;
+    pixel_format_t format = pixel_format_t::unknown;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t flags = 0;
+};
+
+/**
+ * @brief Frame slots in the shared memory between 2 processes, like `MF_SA_D3D11_SHARED` for the CPU memory.
+ *        The producer writes a frame in a free slot and publishes the slot index. The consumer reads the frame
+ *        in place and gives the slot back. Both directions are the lock-free SPSC rings in the same memory,
+ *        so the frames are never copied and no system call is made per frame.
+ *
+ * @note  The consumer doesn't trust the memory. The header and every index from the rings are validated,
+ *        and the own side's ring index is kept in the process. The producer can still change the pixels
+ *        while the consumer reads them
+ * @note  On Linux the memfd is sealed against the resize, so the peer can't raise `SIGBUS` by shrinking it
+ * @see   send_handle, receive_handle, duplicate_handle
+ */
+class frame_channel_t final {
+    native_handle_t handle;
+    uint8_t* base = nullptr;
+    size_t length = 0;
+    // validated copies of the header
+    uint32_t slot_count = 0;
+    size_t slot_size = 0;
+    size_t data_offset = 0;
+    // the own side's ring indices
+    uint64_t ready_index = 0; // head for the producer, tail for the consumer
+    uint64_t free_index = 0;  // tail for the producer, head for the consumer
+
+  public:
+    frame_channel_t() noexcept;
+    ~frame_channel_t() noexcept;
+    frame_channel_t(const frame_channel_t&) = delete;
+    frame_channel_t(frame_channel_t&&) = delete;
+    frame_channel_t& operator=(const frame_channel_t&) = delete;
+    frame_channel_t& operator=(frame_channel_t&&) = delete;
+
+    /// @brief Producer. Create the shared memory and put every slot in the free ring
+    std::errc create(const frame_channel_config_t& config) noexcept;
+    /**
+     * @brief Consumer. Map the memory of the producer. The handle is owned by the channel after this
+     * @return `std::errc::protocol_error` if the header doesn't match the memory
+     */
+    std::errc open(native_handle_t handle) noexcept;
+    void close() noexcept;
+
+    [[nodiscard]] native_handle_t native_handle() const noexcept {
+        return handle;
+    }
+    [[nodiscard]] size_t capacity() const noexcept {
+        return slot_size;
+    }
+
+    /// @brief Producer. Take a free slot to write
+    /// @return `std::errc::resource_unavailable_try_again` if the consumer holds every slot
+    std::errc acquire(uint32_t& slot, gsl::span<uint8_t>& memory) noexcept;
+    /// @brief Producer. The slot goes to the consumer
+    std::errc publish(const frame_descriptor_t& frame) noexcept;
+    /// @brief Producer. The consumer drains the ring and sees the end
+    void shutdown() noexcept;
+
+    /**
+     * @brief Consumer. The memory is valid until `release`
+     * @return `std::errc::resource_unavailable_try_again` if the ring is empty.
+     *         `std::errc::no_message_available` after `shutdown`. `std::errc::protocol_error` for the invalid frame
+     */
+    std::errc receive(frame_descriptor_t& frame, gsl::span<const uint8_t>& memory) noexcept;
+    /// @brief Consumer. The slot goes back to the producer
+    std::errc release(uint32_t slot) noexcept;
+};
+
+#if defined(_WIN32)
+/**
+ * @brief Duplicate the handle into the other process. Send the value with any IPC
+ * @see   DuplicateHandle
+ */
+std::errc duplicate_handle(native_handle_t handle, uint32_t process_id, native_handle_t& output) noexcept;
+#else
+/// @brief Send the fd with `SCM_RIGHTS` over the unix domain socket
+std::errc send_handle(int socket, native_handle_t handle) noexcept;
+/// @return `std::errc::no_message_available` if the peer closed the socket
+std::errc receive_handle(int socket, native_handle_t& handle) noexcept;
+#endif
@@ -0,0 +1,277 @@
+#include "frame_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <utility>
+
+struct frame_block_t final {
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+    std::atomic<uint32_t> references{0};
+    frame_pool_t::state_t* owner = nullptr;
+    uint32_t size_class = 0;
+};
+
+struct frame_pool_t::state_t final {
+    struct class_t final {
+        std::mutex mtx{};
+        std::vector<frame_block_t*> free_list{}; // reserved for `max_count`
+        uint32_t count = 0;                      // allocated blocks of the class
+        bool closed = false;                     // the pool is destroyed
+    };
+
+    frame_pool_config_t config;
+    size_class_table_t table;
+    std::unique_ptr<class_t[]> classes;
+    std::unique_ptr<page_arena_t> arena;
+    std::atomic<uint32_t> references{1}; // the pool and the buffers in use
+    std::atomic<uint64_t> acquired{0};
+    std::atomic<uint64_t> allocated{0};
+    std::atomic<uint64_t> exhausted{0};
+
+  public:
+    explicit state_t(const frame_pool_config_t& config) noexcept(false)
+        : config{config}, table{config.min_size, config.max_size, config.alignment},
+          classes{std::make_unique<class_t[]>(table.size())} {
+        if (config.arena_size)
+            arena = std::make_unique<page_arena_t>(config.arena_size, config.huge_pages, true);
+        for (size_t i = 0; i < table.size(); ++i)
+            classes[i].free_list.reserve(std::max(config.max_count, 1u));
+    }
+
+    /// @note `cls.mtx` must be locked
+    /// @return `std::errc::resource_unavailable_try_again` for `max_count` or the budget
+    std::errc allocate(uint32_t index, frame_block_t*& output) noexcept {
+        class_t& cls = classes[index];
+        if (cls.count >= std::max(config.max_count, 1u))
+            return std::errc::resource_unavailable_try_again;
+        const size_t capacity = table.capacity(index);
+        if (config.budget)
+            if (auto ec = config.budget->try_reserve(capacity); ec != std::errc{})
+                return std::errc::resource_unavailable_try_again;
+        try {
+            auto block = std::make_unique<frame_block_t>();
+            if (arena)
+                block->data = static_cast<uint8_t*>(arena->allocate(capacity, config.alignment));
+            if (block->data == nullptr)
+                block->data = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t{config.alignment}));
+            block->capacity = capacity;
+            block->owner = this;
+            block->size_class = index;
+            ++cls.count;
+            ++allocated;
+            output = block.release();
+            return std::errc{};
+        } catch (const std::bad_alloc&) {
+            if (config.budget)
+                config.budget->release(capacity);
+            return std::errc::not_enough_memory;
+        }
+    }
+
+    void destroy(frame_block_t* block) noexcept {
+        // the arena's memory is released with the state
+        if (arena == nullptr || arena->contains(block->data) == false)
+            ::operator delete(block->data, std::align_val_t{config.alignment});
+        if (config.budget)
+            config.budget->release(block->capacity);
+        delete block;
+    }
+
+    void release_reference() noexcept {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    void recycle(frame_block_t* block) noexcept {
+        class_t& cls = classes[block->size_class];
+        {
+            std::lock_guard lck{cls.mtx};
+            if (cls.closed == false) {
+                cls.free_list.emplace_back(block);
+                block = nullptr;
+            } else {
+                --cls.count;
+            }
+        }
+        if (block)
+            destroy(block);
+        release_reference();
+    }
+};
+
+size_class_table_t::size_class_table_t(size_t min_size, size_t max_size, size_t alignment) noexcept(false) {
+    alignment = std::max<size_t>(alignment, 1);
+    size_t base = std::max<size_t>(min_size, alignment);
+    while (true) {
+        for (size_t step = 0; step < 4; ++step) {
+            size_t capacity = base + base / 4 * step;
+            capacity = (capacity + alignment - 1) / alignment * alignment;
+            if (capacities.empty() == false && capacity <= capacities.back())
+                continue;
+            capacities.emplace_back(capacity);
+            if (capacity >= max_size)
+                return;
+        }
+        base *= 2;
+    }
+}
+
+size_t size_class_table_t::find(size_t size) const noexcept {
+    return static_cast<size_t>(std::lower_bound(capacities.begin(), capacities.end(), size) - capacities.begin());
+}
+
+frame_buffer_t::frame_buffer_t(frame_block_t* block) noexcept : block{block} {
+}
+
+frame_buffer_t::~frame_buffer_t() noexcept {
+    reset();
+}
+
+frame_buffer_t::frame_buffer_t(const frame_buffer_t& rhs) noexcept : block{rhs.block} {
+    if (block)
+        block->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+frame_buffer_t::frame_buffer_t(frame_buffer_t&& rhs) noexcept : block{std::exchange(rhs.block, nullptr)} {
+}
+
+frame_buffer_t& frame_buffer_t::operator=(const frame_buffer_t& rhs) noexcept {
+    if (this != &rhs) {
+        if (rhs.block)
+            rhs.block->references.fetch_add(1, std::memory_order_relaxed);
+        reset();
+        block = rhs.block;
+    }
+    return *this;
+}
+
+frame_buffer_t& frame_buffer_t::operator=(frame_buffer_t&& rhs) noexcept {
+    if (this != &rhs) {
+        reset();
+        block = std::exchange(rhs.block, nullptr);
+    }
+    return *this;
+}
+
+void frame_buffer_t::reset() noexcept {
+    frame_block_t* current = std::exchange(block, nullptr);
+    if (current && current->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        current->owner->recycle(current);
+}
+
+uint8_t* frame_buffer_t::data() const noexcept {
+    return block ? block->data : nullptr;
+}
+
+size_t frame_buffer_t::capacity() const noexcept {
+    return block ? block->capacity : 0;
+}
+
+uint32_t frame_buffer_t::use_count() const noexcept {
+    return block ? block->references.load(std::memory_order_relaxed) : 0;
+}
+
+frame_pool_t::frame_pool_t(const frame_pool_config_t& config) noexcept(false) : state{new state_t{config}} {
+}
+
+frame_pool_t::~frame_pool_t() noexcept {
+    for (size_t i = 0; i < state->table.size(); ++i) {
+        state_t::class_t& cls = state->classes[i];
+        std::lock_guard lck{cls.mtx};
+        cls.closed = true;
+        for (frame_block_t* block : cls.free_list)
+            state->destroy(block);
+        cls.count -= static_cast<uint32_t>(cls.free_list.size());
+        cls.free_list.clear();
+    }
+    // the buffers in use keep the state
+    state->release_reference();
+}
+
+std::errc frame_pool_t::acquire(size_t size, frame_buffer_t& buffer) noexcept {
+    const size_t index = state->table.find(size);
+    if (index == state->table.size())
+        return std::errc::value_too_large;
+    state_t::class_t& cls = state->classes[index];
+    frame_block_t* block = nullptr;
+    std::errc ec{};
+    {
+        std::lock_guard lck{cls.mtx};
+        if (cls.count == 0) {
+            // warm up the class like `InitializeSampleAllocatorEx`
+            for (uint32_t i = 0; i < state->config.min_count; ++i) {
+                frame_block_t* spare = nullptr;
+                if (ec = state->allocate(static_cast<uint32_t>(index), spare); ec != std::errc{})
+                    break;
+                cls.free_list.emplace_back(spare);
+            }
+        }
+        if (cls.free_list.empty() == false) {
+            block = cls.free_list.back();
+            cls.free_list.pop_back();
+        } else if (ec == std::errc{}) {
+            // the failed warm-up is not retried. the budget counts the call once
+            ec = state->allocate(static_cast<uint32_t>(index), block);
+        }
+    }
+    if (block == nullptr) {
+        ++state->exhausted;
+        return ec;
+    }
+    block->references.store(1, std::memory_order_relaxed);
+    state->references.fetch_add(1, std::memory_order_relaxed);
+    ++state->acquired;
+    buffer = frame_buffer_t{block};
+    return std::errc{};
+}
+
+std::errc frame_pool_t::prepare(size_t size) noexcept {
+    const size_t index = state->table.find(size);
+    if (index == state->table.size())
+        return std::errc::value_too_large;
+    state_t::class_t& cls = state->classes[index];
+    std::lock_guard lck{cls.mtx};
+    while (cls.count < state->config.min_count) {
+        frame_block_t* block = nullptr;
+        if (auto ec = state->allocate(static_cast<uint32_t>(index), block); ec != std::errc{})
+            return cls.count < state->config.max_count ? ec : std::errc{};
+        cls.free_list.emplace_back(block);
+    }
+    return std::errc{};
+}
+
+size_t frame_pool_t::trim() noexcept {
+    size_t freed = 0;
+    for (size_t i = 0; i < state->table.size(); ++i) {
+        state_t::class_t& cls = state->classes[i];
+        std::lock_guard lck{cls.mtx};
+        // the arena can't take back the memory. keep its buffers
+        auto heap = std::partition(cls.free_list.begin(), cls.free_list.end(), [this](frame_block_t* block) {
+            return state->arena && state->arena->contains(block->data);
+        });
+        for (auto it = heap; it != cls.free_list.end(); ++it) {
+            freed += (*it)->capacity;
+            state->destroy(*it);
+        }
+        cls.count -= static_cast<uint32_t>(cls.free_list.end() - heap);
+        cls.free_list.erase(heap, cls.free_list.end());
+    }
+    return freed;
+}
+
+frame_pool_stats_t frame_pool_t::stats() const noexcept {
+    frame_pool_stats_t result{};
+    result.acquired = state->acquired;
+    result.allocated = state->allocated;
+    result.exhausted = state->exhausted;
+    result.outstanding = state->references.load(std::memory_order_relaxed) - 1;
+    result.arena_used = state->arena ? state->arena->size() : 0;
+    return result;
+}
+
+page_kind_t frame_pool_t::page_kind() const noexcept {
+    return state->arena ? state->arena->kind() : page_kind_t::normal;
+}
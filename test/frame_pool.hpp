@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "memory_budget.hpp"
+#include "page_arena.hpp"
+
+struct frame_pool_config_t final {
+    size_t min_size = 4 << 10;  // capacity of the smallest class
+    size_t max_size = 64 << 20; // the larger requests are rejected
+    /// @brief Buffers allocated at once when a class is used first. Same role with the `cInitialSamples` of
+    ///        `IMFVideoSampleAllocatorEx::InitializeSampleAllocatorEx`
+    uint32_t min_count = 2;
+    /// @brief Limit of the buffers of each class. Same role with the `cMaximumSamples`
+    uint32_t max_count = 8;
+    size_t alignment = 64;
+    /// @brief If not 0, the buffers are carved from a `page_arena_t` of this size. It is pre-faulted when the pool
+    ///        is created. When the arena is full, the buffers come from the heap
+    size_t arena_size = 0;
+    bool huge_pages = true; // of the arena
+    /// @brief If not null, each new buffer is charged to it. Over the budget, `acquire` fails like `max_count`
+    ///        instead of allocating. The budget must outlive the pool and its buffers
+    memory_budget_t* budget = nullptr;
+};
+
+/// @brief Capacities of the size classes. 4 classes in each power of 2, so the waste is under 25%
+class size_class_table_t final {
+    std::vector<size_t> capacities{};
+
+  public:
+    /// @throws std::bad_alloc
+    size_class_table_t(size_t min_size, size_t max_size, size_t alignment) noexcept(false);
+
+    /// @return index of the smallest class for the size. `size()` if it is too large
+    [[nodiscard]] size_t find(size_t size) const noexcept;
+    [[nodiscard]] size_t capacity(size_t index) const noexcept {
+        return capacities[index];
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return capacities.size();
+    }
+};
+
+struct frame_block_t;
+
+/**
+ * @brief Reference to the buffer of `frame_pool_t`. The buffer goes back to the pool when the last reference drops
+ * @note  Copy is cheap(an atomic increment). The buffer is not cleared when it is recycled
+ */
+class frame_buffer_t final {
+    frame_block_t* block = nullptr;
+
+  public:
+    frame_buffer_t() noexcept = default;
+    explicit frame_buffer_t(frame_block_t* block) noexcept;
+    ~frame_buffer_t() noexcept;
+    frame_buffer_t(const frame_buffer_t& rhs) noexcept;
+    frame_buffer_t(frame_buffer_t&& rhs) noexcept;
+    frame_buffer_t& operator=(const frame_buffer_t& rhs) noexcept;
+    frame_buffer_t& operator=(frame_buffer_t&& rhs) noexcept;
+
+    void reset() noexcept;
+
+    [[nodiscard]] uint8_t* data() const noexcept;
+    [[nodiscard]] size_t capacity() const noexcept;
+    [[nodiscard]] uint32_t use_count() const noexcept;
+    explicit operator bool() const noexcept {
+        return block != nullptr;
+    }
+};
+
+struct frame_pool_stats_t final {
+    uint64_t acquired = 0;
+    uint64_t allocated = 0; // buffers allocated (heap or arena)
+    uint64_t exhausted = 0; // `acquire` failed with `max_count` or the budget
+    uint32_t outstanding = 0;
+    size_t arena_used = 0; // bytes of the arena
+};
+
+/**
+ * @brief Recycling buffers in the size classes, for the frames of `mf_transform_info_t::output_info.cbSize`.
+ *        After the warm-up, `acquire` pops a buffer from the class's free list without the allocation.
+ * @note  The buffers may outlive the pool. The pool's memory is released after the last buffer
+ * @see   mf_sample_pool_t
+ */
+class frame_pool_t final {
+  public:
+    struct state_t;
+
+  private:
+    state_t* state = nullptr;
+
+  public:
+    /// @throws std::bad_alloc if the arena can't be mapped
+    explicit frame_pool_t(const frame_pool_config_t& config) noexcept(false);
+    ~frame_pool_t() noexcept;
+    frame_pool_t(const frame_pool_t&) = delete;
+    frame_pool_t(frame_pool_t&&) = delete;
+    frame_pool_t& operator=(const frame_pool_t&) = delete;
+    frame_pool_t& operator=(frame_pool_t&&) = delete;
+
+    /**
+     * @return `std::errc::resource_unavailable_try_again` if the class has `max_count` buffers in use
+     *         or the budget is used up. `std::errc::value_too_large` if `size` is over `max_size`
+     */
+    std::errc acquire(size_t size, frame_buffer_t& buffer) noexcept;
+    /// @brief Allocate `min_count` buffers of the class before the streaming
+    std::errc prepare(size_t size) noexcept;
+    /// @brief Free the idle buffers, so their bytes go back to the budget. The arena's buffers are kept
+    /// @return the freed bytes
+    size_t trim() noexcept;
+
+    [[nodiscard]] frame_pool_stats_t stats() const noexcept;
+    /// @return `page_kind_t::normal` if the pool doesn't have the arena
+    [[nodiscard]] page_kind_t page_kind() const noexcept;
+};
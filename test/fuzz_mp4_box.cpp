@@ -0,0 +1,41 @@
+/**
+ * @brief libFuzzer target for `mp4_box_t` and `probe_mp4`
+ * @code
+ * cmake -S . -B build -DBUILD_FUZZING=ON
+ * build/fuzz_mp4_box build/fuzz_mp4_box_corpus -max_total_time=600
+ * @endcode
+ * @see https://llvm.org/docs/LibFuzzer.html
+ * @see https://docs.microsoft.com/en-us/cpp/build/reference/fsanitize
+ */
+#include "media_probe.hpp"
+#include "mp4_box.hpp"
+
+namespace {
+
+constexpr uint32_t max_depth = 32;
+
+/// @brief Touch every box which can be reached from the root
+void walk(const mp4_box_t& box, uint32_t depth) noexcept {
+    mp4_box_cursor_t cursor{};
+    if (box.children(cursor) != std::errc{}) {
+        box_reader_t reader = box.reader();
+        while (reader.valid)
+            reader.u32();
+        return;
+    }
+    if (depth == max_depth)
+        return;
+    mp4_box_t child{};
+    while (cursor.next(child) == std::errc{})
+        walk(child, depth + 1);
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    const gsl::span<const uint8_t> file{data, size};
+    walk(mp4_box_t{file}, 0);
+    media_probe_t probe{};
+    probe_mp4(file, probe);
+    return 0;
+}
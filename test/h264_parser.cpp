@@ -0,0 +1,769 @@
+#include "h264_parser.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/// @brief Exp-Golomb bit reader over RBSP. Emulation prevention bytes (0x000003) are skipped while reading
+/// @see ITU-T H.264 7.4.1 NAL unit semantics
+/// @see ITU-T H.264 9.1 Parsing process for Exp-Golomb codes
+class rbsp_reader_t final {
+    const uint8_t* ptr;
+    const uint8_t* const end;
+    uint32_t zeros = 0; // consecutive zero bytes
+    uint8_t current = 0;
+    uint32_t remain = 0; // bits left in `current`
+    bool overrun = false;
+
+  public:
+    explicit rbsp_reader_t(gsl::span<const uint8_t> rbsp) noexcept : ptr{rbsp.data()}, end{rbsp.data() + rbsp.size()} {
+    }
+
+    [[nodiscard]] bool failed() const noexcept {
+        return overrun;
+    }
+
+    uint32_t u(uint32_t n) noexcept {
+        uint32_t value = 0;
+        while (n--) {
+            if (remain == 0 && fetch() == false)
+                return 0;
+            --remain;
+            value = (value << 1) | ((current >> remain) & 1u);
+        }
+        return value;
+    }
+    bool flag() noexcept {
+        return u(1) != 0;
+    }
+    uint32_t ue() noexcept {
+        uint32_t leading = 0;
+        while (u(1) == 0) {
+            if (overrun || ++leading > 31) {
+                overrun = true;
+                return 0;
+            }
+        }
+        return ((1u << leading) - 1) + u(leading);
+    }
+    int32_t se() noexcept {
+        const uint32_t k = ue();
+        const int64_t magnitude = (static_cast<int64_t>(k) + 1) / 2;
+        return static_cast<int32_t>((k & 1) ? magnitude : -magnitude);
+    }
+    /// @brief Read `ue(v)` and fail if the value is larger than `limit`
+    uint32_t ue(uint32_t limit) noexcept {
+        const uint32_t value = ue();
+        if (value > limit)
+            overrun = true;
+        return value;
+    }
+
+  private:
+    bool fetch() noexcept {
+        if (ptr == end) {
+            overrun = true;
+            return false;
+        }
+        uint8_t byte = *ptr++;
+        if (zeros >= 2 && byte == 0x03) {
+            if (ptr == end) {
+                overrun = true;
+                return false;
+            }
+            byte = *ptr++;
+            zeros = 0;
+        }
+        zeros = (byte == 0) ? zeros + 1 : 0;
+        current = byte;
+        remain = 8;
+        return true;
+    }
+};
+
+/// @see ITU-T H.264 7.3.2.1.1.1 Scaling list syntax
+void skip_scaling_list(rbsp_reader_t& reader, uint32_t size) noexcept {
+    int32_t last_scale = 8, next_scale = 8;
+    for (uint32_t j = 0; j < size && reader.failed() == false; ++j) {
+        if (next_scale != 0) {
+            const int32_t delta_scale = reader.se();
+            next_scale = (last_scale + delta_scale + 256) % 256;
+        }
+        last_scale = (next_scale == 0) ? last_scale : next_scale;
+    }
+}
+
+/// @see ITU-T H.264 E.1.2 HRD parameters syntax
+void skip_hrd_parameters(rbsp_reader_t& reader) noexcept {
+    const uint32_t cpb_cnt = reader.ue(31) + 1;
+    reader.u(4); // bit_rate_scale
+    reader.u(4); // cpb_size_scale
+    for (uint32_t i = 0; i < cpb_cnt && reader.failed() == false; ++i) {
+        reader.ue(); // bit_rate_value_minus1
+        reader.ue(); // cpb_size_value_minus1
+        reader.u(1); // cbr_flag
+    }
+    reader.u(5); // initial_cpb_removal_delay_length_minus1
+    reader.u(5); // cpb_removal_delay_length_minus1
+    reader.u(5); // dpb_output_delay_length_minus1
+    reader.u(5); // time_offset_length
+}
+
+/// @see ITU-T H.264 E.1.1 VUI parameters syntax
+void parse_vui(rbsp_reader_t& reader, h264_sps_t& sps) noexcept {
+    if (reader.flag()) { // aspect_ratio_info_present_flag
+        constexpr uint32_t extended_sar = 255;
+        if (reader.u(8) == extended_sar) {
+            reader.u(16); // sar_width
+            reader.u(16); // sar_height
+        }
+    }
+    if (reader.flag())   // overscan_info_present_flag
+        reader.u(1);     // overscan_appropriate_flag
+    if (reader.flag()) { // video_signal_type_present_flag
+        reader.u(3);     // video_format
+        reader.u(1);     // video_full_range_flag
+        if (reader.flag())
+            reader.u(24); // colour_primaries, transfer_characteristics, matrix_coefficients
+    }
+    if (reader.flag()) { // chroma_loc_info_present_flag
+        reader.ue();
+        reader.ue();
+    }
+    sps.timing_info_present_flag = reader.flag();
+    if (sps.timing_info_present_flag) {
+        sps.num_units_in_tick = reader.u(32);
+        sps.time_scale = reader.u(32);
+        sps.fixed_frame_rate_flag = reader.flag();
+    }
+    const bool nal_hrd_parameters_present_flag = reader.flag();
+    if (nal_hrd_parameters_present_flag)
+        skip_hrd_parameters(reader);
+    const bool vcl_hrd_parameters_present_flag = reader.flag();
+    if (vcl_hrd_parameters_present_flag)
+        skip_hrd_parameters(reader);
+    if (nal_hrd_parameters_present_flag || vcl_hrd_parameters_present_flag)
+        reader.u(1); // low_delay_hrd_flag
+    reader.u(1);     // pic_struct_present_flag
+    sps.bitstream_restriction_flag = reader.flag();
+    if (sps.bitstream_restriction_flag) {
+        reader.u(1); // motion_vectors_over_pic_boundaries_flag
+        reader.ue(); // max_bytes_per_pic_denom
+        reader.ue(); // max_bits_per_mb_denom
+        reader.ue(); // log2_max_mv_length_horizontal
+        reader.ue(); // log2_max_mv_length_vertical
+        sps.max_num_reorder_frames = reader.ue(16);
+        sps.max_dec_frame_buffering = reader.ue(16);
+    }
+}
+
+bool has_chroma_format(uint8_t profile_idc) noexcept {
+    switch (profile_idc) {
+    case 100:
+    case 110:
+    case 122:
+    case 244:
+    case 44:
+    case 83:
+    case 86:
+    case 118:
+    case 128:
+    case 138:
+    case 139:
+    case 134:
+    case 135:
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint32_t chroma_array_type(const h264_sps_t& sps) noexcept {
+    return sps.separate_colour_plane_flag ? 0 : sps.chroma_format_idc;
+}
+
+/// @see ITU-T H.264 7.3.3.1 Reference picture list modification syntax
+void skip_ref_pic_list_modification(rbsp_reader_t& reader) noexcept {
+    if (reader.flag() == false) // ref_pic_list_modification_flag_lX
+        return;
+    // each modification refers a reference index. 33 is enough for both frame and field
+    for (uint32_t i = 0; i < 33 && reader.failed() == false; ++i) {
+        const uint32_t modification_of_pic_nums_idc = reader.ue(5);
+        if (modification_of_pic_nums_idc == 3)
+            return;
+        reader.ue(); // abs_diff_pic_num_minus1 or long_term_pic_num
+    }
+}
+
+/// @see ITU-T H.264 7.3.3.2 Prediction weight table syntax
+void skip_pred_weight_table(rbsp_reader_t& reader, const h264_sps_t& sps, uint32_t num_ref_idx_l0_active,
+                            uint32_t num_ref_idx_l1_active, bool bipred) noexcept {
+    const bool chroma = chroma_array_type(sps) != 0;
+    reader.ue(); // luma_log2_weight_denom
+    if (chroma)
+        reader.ue(); // chroma_log2_weight_denom
+    auto skip_weights = [&reader, chroma](uint32_t count) {
+        for (uint32_t i = 0; i < count && reader.failed() == false; ++i) {
+            if (reader.flag()) { // luma_weight_lX_flag
+                reader.se();
+                reader.se();
+            }
+            if (chroma && reader.flag()) { // chroma_weight_lX_flag
+                for (int j = 0; j < 2; ++j) {
+                    reader.se();
+                    reader.se();
+                }
+            }
+        }
+    };
+    skip_weights(num_ref_idx_l0_active);
+    if (bipred)
+        skip_weights(num_ref_idx_l1_active);
+}
+
+/// @see ITU-T H.264 7.3.3.3 Decoded reference picture marking syntax
+/// @return true if `memory_management_control_operation` 5 is found
+bool parse_dec_ref_pic_marking(rbsp_reader_t& reader, bool idr) noexcept {
+    if (idr) {
+        reader.u(1); // no_output_of_prior_pics_flag
+        reader.u(1); // long_term_reference_flag
+        return false;
+    }
+    if (reader.flag() == false) // adaptive_ref_pic_marking_mode_flag
+        return false;
+    bool found = false;
+    // operations are bounded by the number of reference frames (and long term frame indices)
+    for (uint32_t i = 0; i < 66 && reader.failed() == false; ++i) {
+        const uint32_t mmco = reader.ue(6);
+        if (mmco == 0)
+            break;
+        if (mmco == 1 || mmco == 3)
+            reader.ue(); // difference_of_pic_nums_minus1
+        if (mmco == 2)
+            reader.ue(); // long_term_pic_num
+        if (mmco == 3 || mmco == 6)
+            reader.ue(); // long_term_frame_idx
+        if (mmco == 4)
+            reader.ue(); // max_long_term_frame_idx_plus1
+        if (mmco == 5)
+            found = true;
+    }
+    return found;
+}
+
+/// @see ITU-T H.264 Table A-1 MaxDpbMbs
+uint32_t get_max_dpb_mbs(const h264_sps_t& sps) noexcept {
+    const bool constraint_set3 = sps.constraint_flags & 0x10;
+    switch (sps.level_idc) {
+    case 9: // level 1b
+    case 10:
+        return 396;
+    case 11:
+        // level 1b of Baseline, Main, Extended profile
+        if (constraint_set3 && (sps.profile_idc == 66 || sps.profile_idc == 77 || sps.profile_idc == 88))
+            return 396;
+        return 900;
+    case 12:
+    case 13:
+    case 20:
+        return 2376;
+    case 21:
+        return 4752;
+    case 22:
+    case 30:
+        return 8100;
+    case 31:
+        return 18000;
+    case 32:
+        return 20480;
+    case 40:
+    case 41:
+        return 32768;
+    case 42:
+        return 34816;
+    case 50:
+        return 110400;
+    case 51:
+    case 52:
+        return 184320;
+    default: // level 6+ or unknown
+        return 696320;
+    }
+}
+
+uint32_t read_u16be(const uint8_t* ptr) noexcept {
+    return (static_cast<uint32_t>(ptr[0]) << 8) | ptr[1];
+}
+
+} // namespace
+
+uint32_t h264_sps_t::max_dpb_frames() const noexcept {
+    const uint32_t frame_height_in_mbs = (frame_mbs_only_flag ? 1 : 2) * pic_height_in_map_units;
+    const uint32_t frame_size_in_mbs = pic_width_in_mbs * frame_height_in_mbs;
+    if (frame_size_in_mbs == 0)
+        return 16;
+    return std::min<uint32_t>(get_max_dpb_mbs(*this) / frame_size_in_mbs, 16);
+}
+
+uint32_t h264_sps_t::reorder_depth() const noexcept {
+    if (bitstream_restriction_flag)
+        return max_num_reorder_frames;
+    // Intra profiles don't have inter prediction
+    const bool constraint_set3 = constraint_flags & 0x10;
+    switch (profile_idc) {
+    case 44:
+    case 86:
+    case 100:
+    case 110:
+    case 122:
+    case 244:
+        if (constraint_set3)
+            return 0;
+        break;
+    default:
+        break;
+    }
+    // PicOrderCnt follows frame_num. Output order is same with decoding order
+    if (pic_order_cnt_type == 2)
+        return 0;
+    return max_dpb_frames();
+}
+
+gsl::span<const uint8_t> next_annexb_nal(gsl::span<const uint8_t>& stream) noexcept {
+    const uint8_t* const end = stream.data() + stream.size();
+    // position of the next `00 00 01`. `end` if not found
+    auto find_start_code = [end](const uint8_t* ptr) -> const uint8_t* {
+        for (ptr += 2; ptr < end;) {
+            const auto* one = static_cast<const uint8_t*>(std::memchr(ptr, 0x01, end - ptr));
+            if (one == nullptr)
+                return end;
+            if (one[-1] == 0 && one[-2] == 0)
+                return one - 2;
+            ptr = one + 1;
+        }
+        return end;
+    };
+    const uint8_t* start = stream.data();
+    while (end - start >= 3) {
+        const uint8_t* code = find_start_code(start);
+        if (code == end)
+            break;
+        const uint8_t* nal_begin = code + 3;
+        const uint8_t* next = find_start_code(nal_begin - 2);
+        const uint8_t* nal_end = next;
+        // trailing_zero_8bits and the first byte of 4 byte start code
+        while (nal_end > nal_begin && nal_end[-1] == 0)
+            --nal_end;
+        stream = gsl::span<const uint8_t>{next, static_cast<size_t>(end - next)};
+        if (nal_end > nal_begin)
+            return {nal_begin, static_cast<size_t>(nal_end - nal_begin)};
+        start = next;
+    }
+    stream = gsl::span<const uint8_t>{end, size_t{0}};
+    return {};
+}
+
+gsl::span<const uint8_t> next_avcc_nal(gsl::span<const uint8_t>& stream, uint32_t length_size) noexcept {
+    if (length_size == 0 || length_size > 4 || stream.size() < length_size) {
+        stream = stream.subspan(stream.size());
+        return {};
+    }
+    size_t length = 0;
+    for (uint32_t i = 0; i < length_size; ++i)
+        length = (length << 8) | stream[i];
+    if (length > stream.size() - length_size) {
+        stream = stream.subspan(stream.size());
+        return {};
+    }
+    auto nal = stream.subspan(length_size, length);
+    stream = stream.subspan(length_size + length);
+    return nal;
+}
+
+h264_nal_type_t get_nal_type(gsl::span<const uint8_t> nal) noexcept {
+    if (nal.empty())
+        return h264_nal_type_t::unspecified;
+    return static_cast<h264_nal_type_t>(nal[0] & 0x1F);
+}
+
+std::errc parse_sps(gsl::span<const uint8_t> nal, h264_sps_t& sps) noexcept {
+    if (get_nal_type(nal) != h264_nal_type_t::sps)
+        return std::errc::invalid_argument;
+    rbsp_reader_t reader{nal.subspan(1)};
+    sps = h264_sps_t{};
+    sps.profile_idc = static_cast<uint8_t>(reader.u(8));
+    sps.constraint_flags = static_cast<uint8_t>(reader.u(8));
+    sps.level_idc = static_cast<uint8_t>(reader.u(8));
+    sps.seq_parameter_set_id = reader.ue(31);
+    if (has_chroma_format(sps.profile_idc)) {
+        sps.chroma_format_idc = reader.ue(3);
+        if (sps.chroma_format_idc == 3)
+            sps.separate_colour_plane_flag = reader.flag();
+        reader.ue(6); // bit_depth_luma_minus8
+        reader.ue(6); // bit_depth_chroma_minus8
+        reader.u(1);  // qpprime_y_zero_transform_bypass_flag
+        if (reader.flag()) { // seq_scaling_matrix_present_flag
+            const uint32_t count = (sps.chroma_format_idc != 3) ? 8 : 12;
+            for (uint32_t i = 0; i < count; ++i)
+                if (reader.flag()) // seq_scaling_list_present_flag
+                    skip_scaling_list(reader, i < 6 ? 16 : 64);
+        }
+    }
+    sps.log2_max_frame_num = reader.ue(12) + 4;
+    sps.pic_order_cnt_type = reader.ue(2);
+    if (sps.pic_order_cnt_type == 0) {
+        sps.log2_max_pic_order_cnt_lsb = reader.ue(12) + 4;
+    } else if (sps.pic_order_cnt_type == 1) {
+        sps.delta_pic_order_always_zero_flag = reader.flag();
+        sps.offset_for_non_ref_pic = reader.se();
+        sps.offset_for_top_to_bottom_field = reader.se();
+        sps.num_ref_frames_in_pic_order_cnt_cycle = reader.ue(255);
+        for (uint32_t i = 0; i < sps.num_ref_frames_in_pic_order_cnt_cycle && reader.failed() == false; ++i)
+            sps.offset_for_ref_frame[i] = reader.se();
+    }
+    sps.max_num_ref_frames = reader.ue(16);
+    reader.u(1); // gaps_in_frame_num_value_allowed_flag
+    sps.pic_width_in_mbs = reader.ue(1023) + 1;
+    sps.pic_height_in_map_units = reader.ue(1023) + 1;
+    sps.frame_mbs_only_flag = reader.flag();
+    if (sps.frame_mbs_only_flag == false)
+        reader.u(1); // mb_adaptive_frame_field_flag
+    reader.u(1);     // direct_8x8_inference_flag
+    uint32_t crop[4]{}; // left, right, top, bottom
+    if (reader.flag()) {
+        for (uint32_t& offset : crop)
+            offset = reader.ue();
+    }
+    sps.vui_parameters_present_flag = reader.flag();
+    if (sps.vui_parameters_present_flag)
+        parse_vui(reader, sps);
+    if (reader.failed())
+        return std::errc::invalid_argument;
+
+    // 7.4.2.1.1 frame_crop_*_offset
+    const uint32_t chroma = chroma_array_type(sps);
+    const uint32_t sub_width_c = (chroma == 3) ? 1 : 2;
+    const uint32_t sub_height_c = (chroma == 1) ? 2 : 1;
+    const uint32_t crop_unit_x = (chroma == 0) ? 1 : sub_width_c;
+    const uint32_t crop_unit_y = ((chroma == 0) ? 1 : sub_height_c) * (sps.frame_mbs_only_flag ? 1 : 2);
+    const uint64_t width = sps.pic_width_in_mbs * 16ull;
+    const uint64_t height = sps.pic_height_in_map_units * 16ull * (sps.frame_mbs_only_flag ? 1 : 2);
+    const uint64_t crop_x = crop_unit_x * (static_cast<uint64_t>(crop[0]) + crop[1]);
+    const uint64_t crop_y = crop_unit_y * (static_cast<uint64_t>(crop[2]) + crop[3]);
+    if (crop_x >= width || crop_y >= height)
+        return std::errc::invalid_argument;
+    sps.width = static_cast<uint32_t>(width - crop_x);
+    sps.height = static_cast<uint32_t>(height - crop_y);
+    return std::errc{};
+}
+
+std::errc parse_pps(gsl::span<const uint8_t> nal, h264_pps_t& pps) noexcept {
+    if (get_nal_type(nal) != h264_nal_type_t::pps)
+        return std::errc::invalid_argument;
+    rbsp_reader_t reader{nal.subspan(1)};
+    pps = h264_pps_t{};
+    pps.pic_parameter_set_id = reader.ue(255);
+    pps.seq_parameter_set_id = reader.ue(31);
+    pps.entropy_coding_mode_flag = reader.flag();
+    pps.bottom_field_pic_order_in_frame_present_flag = reader.flag();
+    pps.num_slice_groups = reader.ue(7) + 1;
+    if (pps.num_slice_groups > 1) {
+        const uint32_t slice_group_map_type = reader.ue(6);
+        if (slice_group_map_type == 0) {
+            for (uint32_t i = 0; i < pps.num_slice_groups; ++i)
+                reader.ue(); // run_length_minus1
+        } else if (slice_group_map_type == 2) {
+            for (uint32_t i = 0; i + 1 < pps.num_slice_groups; ++i) {
+                reader.ue(); // top_left
+                reader.ue(); // bottom_right
+            }
+        } else if (slice_group_map_type >= 3 && slice_group_map_type <= 5) {
+            reader.u(1); // slice_group_change_direction_flag
+            reader.ue(); // slice_group_change_rate_minus1
+        } else if (slice_group_map_type == 6) {
+            const uint32_t pic_size_in_map_units = reader.ue() + 1;
+            uint32_t bits = 0; // Ceil(Log2(num_slice_groups_minus1 + 1))
+            while ((1u << bits) < pps.num_slice_groups)
+                ++bits;
+            for (uint32_t i = 0; i < pic_size_in_map_units && reader.failed() == false; ++i)
+                reader.u(bits); // slice_group_id
+        }
+    }
+    pps.num_ref_idx_l0_default_active = reader.ue(31) + 1;
+    pps.num_ref_idx_l1_default_active = reader.ue(31) + 1;
+    pps.weighted_pred_flag = reader.flag();
+    pps.weighted_bipred_idc = reader.u(2);
+    reader.se(); // pic_init_qp_minus26
+    reader.se(); // pic_init_qs_minus26
+    reader.se(); // chroma_qp_index_offset
+    reader.u(1); // deblocking_filter_control_present_flag
+    reader.u(1); // constrained_intra_pred_flag
+    pps.redundant_pic_cnt_present_flag = reader.flag();
+    if (reader.failed())
+        return std::errc::invalid_argument;
+    return std::errc{};
+}
+
+std::errc parse_slice_header(gsl::span<const uint8_t> nal, const h264_sps_t& sps, const h264_pps_t& pps,
+                             h264_slice_header_t& slice) noexcept {
+    const auto nal_type = get_nal_type(nal);
+    if (nal_type != h264_nal_type_t::slice && nal_type != h264_nal_type_t::idr)
+        return std::errc::invalid_argument;
+    rbsp_reader_t reader{nal.subspan(1)};
+    slice = h264_slice_header_t{};
+    slice.nal_unit_type = nal_type;
+    slice.nal_ref_idc = (nal[0] >> 5) & 0x3;
+    slice.first_mb_in_slice = reader.ue();
+    slice.slice_type = static_cast<h264_slice_type_t>(reader.ue(9) % 5);
+    slice.pic_parameter_set_id = reader.ue(255);
+    if (sps.separate_colour_plane_flag)
+        reader.u(2); // colour_plane_id
+    slice.frame_num = reader.u(sps.log2_max_frame_num);
+    if (sps.frame_mbs_only_flag == false) {
+        slice.field_pic_flag = reader.flag();
+        if (slice.field_pic_flag)
+            slice.bottom_field_flag = reader.flag();
+    }
+    if (slice.idr())
+        slice.idr_pic_id = reader.ue(65535);
+    const bool bottom_present = pps.bottom_field_pic_order_in_frame_present_flag && !slice.field_pic_flag;
+    if (sps.pic_order_cnt_type == 0) {
+        slice.pic_order_cnt_lsb = reader.u(sps.log2_max_pic_order_cnt_lsb);
+        if (bottom_present)
+            slice.delta_pic_order_cnt_bottom = reader.se();
+    }
+    if (sps.pic_order_cnt_type == 1 && sps.delta_pic_order_always_zero_flag == false) {
+        slice.delta_pic_order_cnt[0] = reader.se();
+        if (bottom_present)
+            slice.delta_pic_order_cnt[1] = reader.se();
+    }
+    if (pps.redundant_pic_cnt_present_flag)
+        reader.ue(); // redundant_pic_cnt
+
+    const auto type = slice.slice_type;
+    const bool bipred = type == h264_slice_type_t::B;
+    const bool inter = type == h264_slice_type_t::P || type == h264_slice_type_t::SP || bipred;
+    if (bipred)
+        reader.u(1); // direct_spatial_mv_pred_flag
+    uint32_t num_ref_idx_l0_active = pps.num_ref_idx_l0_default_active;
+    uint32_t num_ref_idx_l1_active = pps.num_ref_idx_l1_default_active;
+    if (inter && reader.flag()) { // num_ref_idx_active_override_flag
+        num_ref_idx_l0_active = reader.ue(31) + 1;
+        if (bipred)
+            num_ref_idx_l1_active = reader.ue(31) + 1;
+    }
+    if (inter) {
+        skip_ref_pic_list_modification(reader);
+        if (bipred)
+            skip_ref_pic_list_modification(reader);
+    }
+    if ((pps.weighted_pred_flag && (type == h264_slice_type_t::P || type == h264_slice_type_t::SP)) ||
+        (pps.weighted_bipred_idc == 1 && bipred))
+        skip_pred_weight_table(reader, sps, num_ref_idx_l0_active, num_ref_idx_l1_active, bipred);
+    if (slice.reference())
+        slice.memory_management_control_operation_5 = parse_dec_ref_pic_marking(reader, slice.idr());
+    if (reader.failed())
+        return std::errc::invalid_argument;
+    return std::errc{};
+}
+
+std::errc h264_stream_analyzer_t::feed(gsl::span<const uint8_t> nal, h264_picture_t& picture) noexcept {
+    switch (get_nal_type(nal)) {
+    case h264_nal_type_t::sps: {
+        h264_sps_t sps{};
+        if (auto ec = parse_sps(nal, sps); ec != std::errc{})
+            return ec;
+        const auto id = sps.seq_parameter_set_id;
+        sps_list[id] = sps;
+        sps_mask |= 1u << id;
+        if (active_sps == nullptr)
+            active_sps = &sps_list[id];
+        return std::errc::resource_unavailable_try_again;
+    }
+    case h264_nal_type_t::pps: {
+        h264_pps_t pps{};
+        if (auto ec = parse_pps(nal, pps); ec != std::errc{})
+            return ec;
+        const auto id = pps.pic_parameter_set_id;
+        pps_list[id] = pps;
+        pps_mask[id / 64] |= uint64_t{1} << (id % 64);
+        return std::errc::resource_unavailable_try_again;
+    }
+    case h264_nal_type_t::slice:
+    case h264_nal_type_t::idr:
+        break;
+    default:
+        return std::errc::resource_unavailable_try_again;
+    }
+    // peek the pic_parameter_set_id. it's the 3rd syntax element
+    uint32_t pps_id = 0;
+    {
+        rbsp_reader_t reader{nal.subspan(1)};
+        reader.ue();
+        reader.ue();
+        pps_id = reader.ue(255);
+        if (reader.failed())
+            return std::errc::invalid_argument;
+    }
+    if ((pps_mask[pps_id / 64] & (uint64_t{1} << (pps_id % 64))) == 0)
+        return std::errc::protocol_error;
+    const h264_pps_t& pps = pps_list[pps_id];
+    if ((sps_mask & (1u << pps.seq_parameter_set_id)) == 0)
+        return std::errc::protocol_error;
+    const h264_sps_t& sps = sps_list[pps.seq_parameter_set_id];
+
+    h264_slice_header_t slice{};
+    if (auto ec = parse_slice_header(nal, sps, pps, slice); ec != std::errc{})
+        return ec;
+    // @todo detect the first VCL NAL unit with 7.4.1.2.4 for arbitrary slice order
+    if (slice.first_mb_in_slice != 0)
+        return std::errc::resource_unavailable_try_again;
+    active_sps = &sps;
+
+    if (slice.idr())
+        ++epoch;
+    picture.poc = compute_poc(sps, slice);
+    picture.slice_type = slice.slice_type;
+    picture.idr = slice.idr();
+    picture.reference = slice.reference();
+    picture.frame_num = slice.frame_num;
+    picture.epoch = epoch;
+    observe(picture.output_order());
+    if (slice.memory_management_control_operation_5) {
+        // 8.2.1: the picture is treated as POC 0 and starts a new sequence of POC
+        ++epoch;
+        picture.epoch = epoch;
+        picture.poc = 0;
+    }
+    return std::errc{};
+}
+
+int32_t h264_stream_analyzer_t::compute_poc(const h264_sps_t& sps, const h264_slice_header_t& slice) noexcept {
+    const bool mmco5 = slice.memory_management_control_operation_5;
+    const bool bottom_field = slice.field_pic_flag && slice.bottom_field_flag;
+    int32_t top = 0, bottom = 0;
+    if (sps.pic_order_cnt_type == 0) {
+        // 8.2.1.1
+        if (slice.idr()) {
+            prev_poc_msb = 0;
+            prev_poc_lsb = 0;
+        }
+        const int32_t max_lsb = 1 << sps.log2_max_pic_order_cnt_lsb;
+        const int32_t lsb = static_cast<int32_t>(slice.pic_order_cnt_lsb);
+        const int32_t prev_lsb = static_cast<int32_t>(prev_poc_lsb);
+        int32_t msb = prev_poc_msb;
+        if (lsb < prev_lsb && (prev_lsb - lsb) >= max_lsb / 2)
+            msb = prev_poc_msb + max_lsb;
+        else if (lsb > prev_lsb && (lsb - prev_lsb) > max_lsb / 2)
+            msb = prev_poc_msb - max_lsb;
+        top = msb + lsb;
+        bottom = slice.field_pic_flag ? top : top + slice.delta_pic_order_cnt_bottom;
+        if (slice.reference()) {
+            if (mmco5) {
+                // tempPicOrderCnt is subtracted. The top field of the frame becomes the reference
+                const int32_t temp = slice.field_pic_flag ? top : std::min(top, bottom);
+                prev_poc_msb = 0;
+                prev_poc_lsb = bottom_field ? 0 : static_cast<uint32_t>(top - temp);
+            } else {
+                prev_poc_msb = msb;
+                prev_poc_lsb = slice.pic_order_cnt_lsb;
+            }
+        }
+    } else {
+        // 8.2.1.2, 8.2.1.3
+        const int32_t max_frame_num = 1 << sps.log2_max_frame_num;
+        int32_t frame_num_offset = 0;
+        if (slice.idr() == false) {
+            const int32_t prev_offset = prev_mmco5 ? 0 : prev_frame_num_offset;
+            frame_num_offset = (prev_frame_num > slice.frame_num) ? prev_offset + max_frame_num : prev_offset;
+        }
+        const int32_t frame_num = static_cast<int32_t>(slice.frame_num);
+        if (sps.pic_order_cnt_type == 1) {
+            const int32_t cycle = static_cast<int32_t>(sps.num_ref_frames_in_pic_order_cnt_cycle);
+            int32_t abs_frame_num = (cycle != 0) ? frame_num_offset + frame_num : 0;
+            if (slice.reference() == false && abs_frame_num > 0)
+                abs_frame_num -= 1;
+            int32_t expected = 0;
+            if (abs_frame_num > 0) {
+                int32_t expected_delta = 0;
+                for (int32_t i = 0; i < cycle; ++i)
+                    expected_delta += sps.offset_for_ref_frame[i];
+                const int32_t cycle_count = (abs_frame_num - 1) / cycle;
+                const int32_t frame_num_in_cycle = (abs_frame_num - 1) % cycle;
+                expected = cycle_count * expected_delta;
+                for (int32_t i = 0; i <= frame_num_in_cycle; ++i)
+                    expected += sps.offset_for_ref_frame[i];
+            }
+            if (slice.reference() == false)
+                expected += sps.offset_for_non_ref_pic;
+            if (slice.field_pic_flag == false) {
+                top = expected + slice.delta_pic_order_cnt[0];
+                bottom = top + sps.offset_for_top_to_bottom_field + slice.delta_pic_order_cnt[1];
+            } else if (bottom_field) {
+                top = bottom = expected + sps.offset_for_top_to_bottom_field + slice.delta_pic_order_cnt[0];
+            } else {
+                top = bottom = expected + slice.delta_pic_order_cnt[0];
+            }
+        } else {
+            int32_t temp = 0;
+            if (slice.idr() == false)
+                temp = 2 * (frame_num_offset + frame_num) - (slice.reference() ? 0 : 1);
+            top = bottom = temp;
+        }
+        prev_frame_num_offset = frame_num_offset;
+        prev_frame_num = mmco5 ? 0 : slice.frame_num;
+    }
+    prev_mmco5 = mmco5;
+    if (slice.field_pic_flag)
+        return bottom_field ? bottom : top;
+    return std::min(top, bottom);
+}
+
+void h264_stream_analyzer_t::observe(int64_t order) noexcept {
+    // count the pictures which were decoded earlier but will be displayed later
+    uint32_t count = 0;
+    const size_t length = std::min(history_count, history.size());
+    for (size_t i = 0; i < length; ++i)
+        if (history[i] > order)
+            ++count;
+    observed_depth = std::max(observed_depth, count);
+    history[history_count++ % history.size()] = order;
+}
+
+uint32_t h264_stream_analyzer_t::reorder_depth() const noexcept {
+    if (active_sps == nullptr)
+        return UINT32_MAX;
+    return active_sps->reorder_depth();
+}
+
+std::errc h264_stream_analyzer_t::feed_sequence_header(gsl::span<const uint8_t> header) noexcept {
+    h264_picture_t picture{};
+    if (header.size() >= 7 && header[0] == 1) {
+        // ISO/IEC 14496-15 5.2.4.1 AVCDecoderConfigurationRecord
+        size_t offset = 5;
+        for (uint32_t set = 0; set < 2; ++set) {
+            if (offset >= header.size())
+                return std::errc::invalid_argument;
+            const uint32_t count = (set == 0) ? (header[offset] & 0x1F) : header[offset];
+            ++offset;
+            for (uint32_t i = 0; i < count; ++i) {
+                if (header.size() - offset < 2)
+                    return std::errc::invalid_argument;
+                const size_t length = read_u16be(header.data() + offset);
+                offset += 2;
+                if (header.size() - offset < length)
+                    return std::errc::invalid_argument;
+                if (auto ec = feed(header.subspan(offset, length), picture);
+                    ec != std::errc::resource_unavailable_try_again)
+                    return ec == std::errc{} ? std::errc::invalid_argument : ec;
+                offset += length;
+            }
+        }
+        return std::errc{};
+    }
+    for (auto nal = next_annexb_nal(header); nal.empty() == false; nal = next_annexb_nal(header))
+        if (auto ec = feed(nal, picture); ec != std::errc::resource_unavailable_try_again && ec != std::errc{})
+            return ec;
+    return active_sps ? std::errc{} : std::errc::invalid_argument;
+}
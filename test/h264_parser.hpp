@@ -0,0 +1,262 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <gsl/gsl>
+#include <system_error>
+#include <utility>
+
+/// @see ITU-T H.264 Table 7-1
+enum class h264_nal_type_t : uint8_t {
+    unspecified = 0,
+    slice = 1,
+    slice_dpa = 2,
+    slice_dpb = 3,
+    slice_dpc = 4,
+    idr = 5,
+    sei = 6,
+    sps = 7,
+    pps = 8,
+    aud = 9,
+    end_of_sequence = 10,
+    end_of_stream = 11,
+    filler = 12,
+    sps_ext = 13,
+    prefix = 14,
+    subset_sps = 15,
+};
+
+/// @see ITU-T H.264 Table 7-6. `slice_type` 5~9 are folded into 0~4
+enum class h264_slice_type_t : uint8_t {
+    P = 0,
+    B = 1,
+    I = 2,
+    SP = 3,
+    SI = 4,
+};
+
+/// @see ITU-T H.264 7.3.2.1.1 Sequence parameter set data syntax
+/// @see ITU-T H.264 E.1.1 VUI parameters syntax
+struct h264_sps_t final {
+    uint8_t profile_idc = 0;
+    uint8_t constraint_flags = 0; // constraint_set0_flag is the MSB
+    uint8_t level_idc = 0;
+    uint32_t seq_parameter_set_id = 0;
+    uint32_t chroma_format_idc = 1;
+    bool separate_colour_plane_flag = false;
+    uint32_t log2_max_frame_num = 4;
+    uint32_t pic_order_cnt_type = 0;
+    uint32_t log2_max_pic_order_cnt_lsb = 4;
+    bool delta_pic_order_always_zero_flag = false;
+    int32_t offset_for_non_ref_pic = 0;
+    int32_t offset_for_top_to_bottom_field = 0;
+    uint32_t num_ref_frames_in_pic_order_cnt_cycle = 0;
+    std::array<int32_t, 255> offset_for_ref_frame{};
+    uint32_t max_num_ref_frames = 0;
+    uint32_t pic_width_in_mbs = 0;
+    uint32_t pic_height_in_map_units = 0;
+    bool frame_mbs_only_flag = true;
+    uint32_t width = 0;  // after frame cropping
+    uint32_t height = 0; // after frame cropping
+
+    bool vui_parameters_present_flag = false;
+    bool timing_info_present_flag = false;
+    uint32_t num_units_in_tick = 0;
+    uint32_t time_scale = 0;
+    bool fixed_frame_rate_flag = false;
+    bool bitstream_restriction_flag = false;
+    uint32_t max_num_reorder_frames = 0;
+    uint32_t max_dec_frame_buffering = 0;
+
+  public:
+    /// @brief `MaxDpbFrames` from the level limits
+    /// @see ITU-T H.264 Table A-1
+    [[nodiscard]] uint32_t max_dpb_frames() const noexcept;
+
+    /// @brief `max_num_reorder_frames` of the VUI, or the value inferred when it is absent
+    /// @see ITU-T H.264 E.2.1 max_num_reorder_frames
+    [[nodiscard]] uint32_t reorder_depth() const noexcept;
+};
+
+/// @see ITU-T H.264 7.3.2.2 Picture parameter set RBSP syntax
+/// @note Fields after `redundant_pic_cnt_present_flag` are not used by the slice header and skipped
+struct h264_pps_t final {
+    uint32_t pic_parameter_set_id = 0;
+    uint32_t seq_parameter_set_id = 0;
+    bool entropy_coding_mode_flag = false;
+    bool bottom_field_pic_order_in_frame_present_flag = false;
+    uint32_t num_slice_groups = 1;
+    uint32_t num_ref_idx_l0_default_active = 1;
+    uint32_t num_ref_idx_l1_default_active = 1;
+    bool weighted_pred_flag = false;
+    uint32_t weighted_bipred_idc = 0;
+    bool redundant_pic_cnt_present_flag = false;
+};
+
+/// @brief Slice header fields up to `dec_ref_pic_marking`. Enough to locate the picture in output order
+/// @see ITU-T H.264 7.3.3 Slice header syntax
+struct h264_slice_header_t final {
+    h264_nal_type_t nal_unit_type = h264_nal_type_t::unspecified;
+    uint8_t nal_ref_idc = 0;
+    uint32_t first_mb_in_slice = 0;
+    h264_slice_type_t slice_type = h264_slice_type_t::P;
+    uint32_t pic_parameter_set_id = 0;
+    uint32_t frame_num = 0;
+    bool field_pic_flag = false;
+    bool bottom_field_flag = false;
+    uint32_t idr_pic_id = 0;
+    uint32_t pic_order_cnt_lsb = 0;
+    int32_t delta_pic_order_cnt_bottom = 0;
+    int32_t delta_pic_order_cnt[2]{};
+    bool memory_management_control_operation_5 = false;
+
+  public:
+    [[nodiscard]] bool idr() const noexcept {
+        return nal_unit_type == h264_nal_type_t::idr;
+    }
+    [[nodiscard]] bool reference() const noexcept {
+        return nal_ref_idc != 0;
+    }
+};
+
+/**
+ * @brief Advance `stream` to the next NAL unit of Annex B byte stream
+ * @return NAL unit without the start code. Empty if there is no more NAL unit
+ * @see ITU-T H.264 B.2 Byte stream NAL unit decoding process
+ */
+gsl::span<const uint8_t> next_annexb_nal(gsl::span<const uint8_t>& stream) noexcept;
+
+/**
+ * @brief Advance `stream` to the next NAL unit of length-prefixed (`avcC`) sample
+ * @param length_size `lengthSizeMinusOne + 1` of AVCDecoderConfigurationRecord
+ * @return NAL unit without the length prefix. Empty if there is no more NAL unit or the length is broken
+ */
+gsl::span<const uint8_t> next_avcc_nal(gsl::span<const uint8_t>& stream, uint32_t length_size) noexcept;
+
+[[nodiscard]] h264_nal_type_t get_nal_type(gsl::span<const uint8_t> nal) noexcept;
+
+/// @note The parsers skip emulation prevention bytes while reading. They don't allocate.
+std::errc parse_sps(gsl::span<const uint8_t> nal, h264_sps_t& sps) noexcept;
+std::errc parse_pps(gsl::span<const uint8_t> nal, h264_pps_t& pps) noexcept;
+std::errc parse_slice_header(gsl::span<const uint8_t> nal, const h264_sps_t& sps, const h264_pps_t& pps,
+                             h264_slice_header_t& slice) noexcept;
+
+/// @brief Decoded picture in decoding order
+struct h264_picture_t final {
+    h264_slice_type_t slice_type = h264_slice_type_t::P; // `slice_type` of the first slice
+    bool idr = false;
+    bool reference = false;
+    uint32_t frame_num = 0;
+    uint32_t epoch = 0; // incremented on IDR and MMCO 5. POC is comparable only in the same epoch
+    int32_t poc = 0;    // PicOrderCnt(CurrPic)
+
+  public:
+    /// @brief Key to sort the pictures in output order
+    [[nodiscard]] int64_t output_order() const noexcept {
+        return (static_cast<int64_t>(epoch) << 32) + poc;
+    }
+};
+
+/**
+ * @brief Tracks parameter sets and slice headers to report frame type, POC and the reorder depth of a stream
+ * @see ITU-T H.264 8.2.1 Decoding process for picture order count
+ */
+class h264_stream_analyzer_t final {
+    std::array<h264_sps_t, 32> sps_list{};
+    std::array<h264_pps_t, 256> pps_list{};
+    uint32_t sps_mask = 0;
+    std::array<uint64_t, 4> pps_mask{};
+    const h264_sps_t* active_sps = nullptr;
+
+    // state of 8.2.1
+    int32_t prev_poc_msb = 0;
+    uint32_t prev_poc_lsb = 0;
+    uint32_t prev_frame_num = 0;
+    int32_t prev_frame_num_offset = 0;
+    bool prev_mmco5 = false;
+    uint32_t epoch = 0;
+
+    // decoding order history for the observed reorder depth
+    std::array<int64_t, 16> history{};
+    size_t history_count = 0;
+    uint32_t observed_depth = 0;
+
+  public:
+    /// @brief Consume a NAL unit. Returns `std::errc{}` and fills `picture` when `nal` starts a new picture
+    /// @return `std::errc::resource_unavailable_try_again` if `nal` doesn't start a picture
+    std::errc feed(gsl::span<const uint8_t> nal, h264_picture_t& picture) noexcept;
+
+    /// @brief Consume `avcC` (AVCDecoderConfigurationRecord) or Annex B sequence header
+    /// @see `MF_MT_MPEG_SEQUENCE_HEADER`
+    std::errc feed_sequence_header(gsl::span<const uint8_t> header) noexcept;
+
+    [[nodiscard]] const h264_sps_t* sps() const noexcept {
+        return active_sps;
+    }
+    /// @brief The reorder depth the stream declares. 0 means decoding order == output order
+    /// @return `UINT32_MAX` if no SPS is known yet
+    [[nodiscard]] uint32_t reorder_depth() const noexcept;
+    /// @brief The largest number of pictures which preceded another in decoding order but follow it in output order
+    [[nodiscard]] uint32_t observed_reorder_depth() const noexcept {
+        return observed_depth;
+    }
+
+  private:
+    int32_t compute_poc(const h264_sps_t& sps, const h264_slice_header_t& slice) noexcept;
+    void observe(int64_t order) noexcept;
+};
+
+/**
+ * @brief Holds decoded frames until they are displayable.
+ *        With depth 0 every frame is released as soon as it is pushed.
+ * @note The capacity is fixed by `depth`. Nothing is allocated after the construction
+ */
+template <typename T, size_t N = 17>
+class h264_reorder_queue_t final {
+    std::array<std::pair<int64_t, T>, N> items{};
+    size_t count = 0;
+    size_t depth;
+
+  public:
+    explicit h264_reorder_queue_t(size_t depth) noexcept : depth{depth < N ? depth : N - 1} {
+    }
+
+    [[nodiscard]] size_t capacity() const noexcept {
+        return depth;
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return count;
+    }
+    [[nodiscard]] bool empty() const noexcept {
+        return count == 0;
+    }
+
+    /// @brief Keep the frame sorted by the output order
+    /// @return false if the queue is full. `pop` must be used after each `push`
+    bool push(const h264_picture_t& picture, T item) noexcept {
+        if (count == N)
+            return false;
+        const int64_t order = picture.output_order();
+        size_t i = count++;
+        for (; i > 0 && items[i - 1].first < order; --i)
+            items[i] = std::move(items[i - 1]);
+        items[i] = std::make_pair(order, std::move(item));
+        return true;
+    }
+
+    /// @brief Take the frame which can be displayed now
+    /// @return false if the queue has to wait for more frames
+    bool pop(T& item) noexcept {
+        if (count <= depth)
+            return false;
+        item = std::move(items[--count].second);
+        return true;
+    }
+
+    /// @brief Take the remaining frames in output order. For the end of stream
+    bool drain(T& item) noexcept {
+        if (count == 0)
+            return false;
+        item = std::move(items[--count].second);
+        return true;
+    }
+};
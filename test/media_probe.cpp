@@ -0,0 +1,503 @@
+#include "media_probe.hpp"
+#include "mp4_box.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t max_sample_count = 1 << 24;
+constexpr uint32_t cache_magic = make_fourcc("MPIX");
+constexpr uint32_t cache_version = 1;
+
+std::errc to_errc(const std::error_code& ec) noexcept {
+    return static_cast<std::errc>(ec.default_error_condition().value());
+}
+
+std::string to_key(const fs::path& path) noexcept(false) {
+    const auto text = path.generic_u8string();
+    return std::string{reinterpret_cast<const char*>(text.data()), text.size()};
+}
+
+/// @brief Make the sample index from the sample table boxes
+/// @see ISO/IEC 14496-12 8.5 Sample Tables
+std::errc make_sample_index(const mp4_box_t& stbl, uint64_t file_size, std::vector<media_sample_index_t>& samples,
+                            uint64_t& duration) noexcept(false) {
+    mp4_box_t stsz{}, stts{}, stsc{}, chunk{}, ctts{}, stss{};
+    const bool large_offset = stbl.find(make_fourcc("stco"), chunk) != std::errc{};
+    if (stbl.find(make_fourcc("stsz"), stsz) != std::errc{} || stbl.find(make_fourcc("stts"), stts) != std::errc{} ||
+        stbl.find(make_fourcc("stsc"), stsc) != std::errc{} ||
+        (large_offset && stbl.find(make_fourcc("co64"), chunk) != std::errc{}))
+        return std::errc::protocol_error;
+
+    box_reader_t sizes = stsz.reader();
+    sizes.skip(4);
+    const uint32_t uniform_size = sizes.u32();
+    const uint32_t count = sizes.u32();
+    if (sizes.valid == false)
+        return std::errc::protocol_error;
+    if (count > max_sample_count)
+        return std::errc::value_too_large;
+    // `count` is not trusted. the samples must fit in the file before the allocation
+    if (uniform_size ? count > file_size / uniform_size : sizes.size() / 4 < count)
+        return std::errc::protocol_error;
+    samples.resize(count);
+    for (media_sample_index_t& sample : samples)
+        sample.size = uniform_size ? uniform_size : sizes.u32();
+
+    size_t index = 0;
+    box_reader_t times = stts.reader();
+    times.skip(4);
+    int64_t decode_time = 0;
+    for (uint32_t n = times.u32(); n && times.valid && index < count; --n) {
+        const uint32_t repeat = times.u32();
+        const uint32_t delta = times.u32();
+        for (uint32_t i = 0; i < repeat && index < count; ++i, ++index) {
+            samples[index].decode_time = decode_time;
+            decode_time += delta;
+        }
+    }
+    if (index < count)
+        return std::errc::protocol_error;
+    duration = static_cast<uint64_t>(decode_time);
+
+    if (stbl.find(make_fourcc("ctts"), ctts) == std::errc{}) {
+        box_reader_t offsets = ctts.reader();
+        offsets.skip(4);
+        index = 0;
+        for (uint32_t n = offsets.u32(); n && offsets.valid && index < count; --n) {
+            const uint32_t repeat = offsets.u32();
+            // version 0 is unsigned, but the writers put negative offsets in practice
+            const auto offset = static_cast<int32_t>(offsets.u32());
+            for (uint32_t i = 0; i < repeat && index < count; ++i, ++index)
+                samples[index].composition_offset = offset;
+        }
+    }
+    if (stbl.find(make_fourcc("stss"), stss) == std::errc{}) {
+        box_reader_t numbers = stss.reader();
+        numbers.skip(4);
+        for (uint32_t n = numbers.u32(); n && numbers.valid; --n)
+            if (const uint32_t number = numbers.u32(); number >= 1 && number <= count)
+                samples[number - 1].sync = true;
+    } else {
+        for (media_sample_index_t& sample : samples)
+            sample.sync = true; // every sample is a sync sample
+    }
+
+    box_reader_t offsets = chunk.reader();
+    offsets.skip(4);
+    const uint32_t chunk_count = offsets.u32();
+    if (offsets.valid == false || offsets.size() / (large_offset ? 8 : 4) < chunk_count)
+        return std::errc::protocol_error;
+    box_reader_t table = stsc.reader();
+    table.skip(4);
+    uint32_t entry_count = table.u32();
+    auto next_entry = [&table, &entry_count](uint32_t& first_chunk, uint32_t& samples_per_chunk) {
+        if (entry_count == 0)
+            return false;
+        --entry_count;
+        first_chunk = table.u32();
+        samples_per_chunk = table.u32();
+        table.skip(4); // sample_description_index
+        return table.valid;
+    };
+    uint32_t first_chunk = 0, samples_per_chunk = 0, next_first_chunk = 0, next_samples_per_chunk = 0;
+    if (next_entry(first_chunk, samples_per_chunk) == false || first_chunk != 1)
+        return std::errc::protocol_error;
+    bool has_next = next_entry(next_first_chunk, next_samples_per_chunk);
+    index = 0;
+    for (uint32_t c = 1; c <= chunk_count && index < count; ++c) {
+        if (has_next && c == next_first_chunk) {
+            samples_per_chunk = next_samples_per_chunk;
+            has_next = next_entry(next_first_chunk, next_samples_per_chunk);
+        }
+        uint64_t offset = large_offset ? offsets.u64() : offsets.u32();
+        for (uint32_t i = 0; i < samples_per_chunk && index < count; ++i, ++index) {
+            // the chunk offset is not trusted. the sample must be in the file
+            if (offset > file_size || samples[index].size > file_size - offset)
+                return std::errc::protocol_error;
+            samples[index].offset = offset;
+            offset += samples[index].size;
+        }
+    }
+    if (index < count)
+        return std::errc::protocol_error;
+    return std::errc{};
+}
+
+/// @brief Description and sample index of the first video track
+std::errc parse_moov(const mp4_box_t& moov, uint64_t file_size, media_probe_t& probe) noexcept(false) {
+    mp4_box_cursor_t cursor{};
+    if (auto ec = moov.children(cursor); ec != std::errc{})
+        return ec;
+    mp4_box_t trak{};
+    while (cursor.next(trak) == std::errc{}) {
+        mp4_box_t mdia{}, mdhd{}, hdlr{}, stbl{}, stsd{}, entry{}, pasp{};
+        if (trak.type() != make_fourcc("trak") || trak.find(make_fourcc("mdia"), mdia) != std::errc{} ||
+            mdia.find(make_fourcc("mdhd"), mdhd) != std::errc{} ||
+            mdia.find(make_fourcc("hdlr"), hdlr) != std::errc{} ||
+            mdia.find({make_fourcc("minf"), make_fourcc("stbl")}, stbl) != std::errc{} ||
+            stbl.find(make_fourcc("stsd"), stsd) != std::errc{})
+            continue;
+        box_reader_t handler = hdlr.reader();
+        handler.skip(8); // version, flags, pre_defined
+        if (handler.u32() != make_fourcc("vide"))
+            continue;
+
+        media_description_t& desc = probe.description;
+        box_reader_t media = mdhd.reader();
+        const uint32_t version = media.u32() >> 24;
+        media.skip(version == 1 ? 16 : 8); // creation_time, modification_time
+        desc.timescale = media.u32();
+        desc.duration = version == 1 ? media.u64() : media.u32();
+        if (media.valid == false || desc.timescale == 0)
+            return std::errc::protocol_error;
+
+        mp4_box_cursor_t entries{};
+        if (stsd.children(entries) != std::errc{} || entries.next(entry) != std::errc{})
+            return std::errc::protocol_error;
+        // VisualSampleEntry: 24 bytes and then width, height
+        box_reader_t visual = entry.reader();
+        visual.skip(24);
+        desc.codec = entry.type();
+        desc.width = visual.u16();
+        desc.height = visual.u16();
+        if (visual.valid == false)
+            return std::errc::protocol_error;
+        if (entry.find(make_fourcc("pasp"), pasp) == std::errc{}) {
+            box_reader_t spacing = pasp.reader();
+            const uint32_t h = spacing.u32();
+            const uint32_t v = spacing.u32();
+            if (spacing.valid && h && v) {
+                desc.aspect_numerator = h;
+                desc.aspect_denominator = v;
+            }
+        }
+        uint64_t duration = 0;
+        if (auto ec = make_sample_index(stbl, file_size, probe.samples, duration); ec != std::errc{})
+            return ec;
+        desc.sample_count = static_cast<uint32_t>(probe.samples.size());
+        if (desc.duration == 0)
+            desc.duration = duration;
+        return std::errc{};
+    }
+    return std::errc::not_supported;
+}
+
+std::errc parse_file(const fs::path& path, media_probe_t& probe) noexcept {
+    mapped_file_t file{};
+    if (auto ec = file.open(path); ec != std::errc{})
+        return ec;
+    return probe_mp4(file.bytes(), probe);
+}
+
+std::errc get_file_status(const fs::path& path, uint64_t& file_size, int64_t& modified_time) noexcept {
+    std::error_code ec{};
+    file_size = fs::file_size(path, ec);
+    if (ec)
+        return to_errc(ec);
+    const auto time = fs::last_write_time(path, ec);
+    if (ec)
+        return to_errc(ec);
+    modified_time = static_cast<int64_t>(time.time_since_epoch().count());
+    return std::errc{};
+}
+
+uint64_t zigzag(int64_t value) noexcept {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) noexcept {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/// @brief LEB128 writer for the cache file
+class varint_writer_t final {
+    std::vector<uint8_t>& buf;
+
+  public:
+    explicit varint_writer_t(std::vector<uint8_t>& buf) noexcept : buf{buf} {
+    }
+
+    void u64(uint64_t value) {
+        while (value >= 0x80) {
+            buf.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buf.push_back(static_cast<uint8_t>(value));
+    }
+    void i64(int64_t value) {
+        u64(zigzag(value));
+    }
+    void str(const std::string& text) {
+        u64(text.size());
+        buf.insert(buf.end(), text.begin(), text.end());
+    }
+};
+
+/// @brief LEB128 reader for the cache file. Reading after the end returns 0 and leaves `valid` false
+class varint_reader_t final {
+    gsl::span<const uint8_t> remain;
+
+  public:
+    bool valid = true;
+
+  public:
+    explicit varint_reader_t(gsl::span<const uint8_t> bytes) noexcept : remain{bytes} {
+    }
+
+    uint64_t u64() noexcept {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if (remain.empty())
+                break;
+            const uint8_t byte = remain[0];
+            remain = remain.subspan(1);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        valid = false;
+        return 0;
+    }
+    uint32_t u32() noexcept {
+        const uint64_t value = u64();
+        if (value > UINT32_MAX)
+            valid = false;
+        return static_cast<uint32_t>(value);
+    }
+    int64_t i64() noexcept {
+        return unzigzag(u64());
+    }
+    std::string str() noexcept(false) {
+        const uint64_t length = u64();
+        if (valid == false || length > remain.size()) {
+            valid = false;
+            return {};
+        }
+        std::string text{reinterpret_cast<const char*>(remain.data()), static_cast<size_t>(length)};
+        remain = remain.subspan(static_cast<size_t>(length));
+        return text;
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return remain.size();
+    }
+};
+
+} // namespace
+
+double media_description_t::fps() const noexcept {
+    if (timescale == 0 || duration == 0)
+        return 0;
+    return static_cast<double>(sample_count) * timescale / static_cast<double>(duration);
+}
+
+std::errc probe_mp4(gsl::span<const uint8_t> file, media_probe_t& probe) noexcept {
+    probe.description = media_description_t{};
+    probe.samples.clear();
+    mp4_box_t moov{};
+    if (auto ec = mp4_box_t{file}.find(make_fourcc("moov"), moov); ec != std::errc{})
+        return ec == std::errc::no_message_available ? std::errc::not_supported : ec;
+    try {
+        return parse_moov(moov, file.size(), probe);
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+}
+
+std::errc probe_mp4(const fs::path& path, media_probe_t& probe) noexcept {
+    if (auto ec = get_file_status(path, probe.file_size, probe.modified_time); ec != std::errc{})
+        return ec;
+    try {
+        probe.path = to_key(path);
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    return parse_file(path, probe);
+}
+
+std::errc media_index_cache_t::load(const fs::path& path) noexcept {
+    entries.clear();
+    try {
+        std::ifstream stream{path, std::ios::binary};
+        if (stream.is_open() == false)
+            return std::errc::no_such_file_or_directory;
+        const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+        varint_reader_t reader{bytes};
+        if (reader.u32() != cache_magic || reader.u32() != cache_version)
+            return std::errc::protocol_error;
+        // every count is checked with the remaining bytes before the allocation
+        for (uint64_t n = reader.u64(); n && reader.valid; --n) {
+            media_probe_t probe{};
+            probe.path = reader.str();
+            probe.file_size = reader.u64();
+            probe.modified_time = reader.i64();
+            media_description_t& desc = probe.description;
+            desc.codec = reader.u32();
+            desc.width = reader.u32();
+            desc.height = reader.u32();
+            desc.aspect_numerator = reader.u32();
+            desc.aspect_denominator = reader.u32();
+            desc.timescale = reader.u32();
+            desc.duration = reader.u64();
+            desc.sample_count = reader.u32();
+            const uint64_t count = reader.u64();
+            if (reader.valid == false || count > reader.size() / 4) {
+                entries.clear();
+                return std::errc::protocol_error;
+            }
+            probe.samples.resize(static_cast<size_t>(count));
+            uint64_t end = 0;
+            int64_t decode_time = 0;
+            for (media_sample_index_t& sample : probe.samples) {
+                const uint64_t size_sync = reader.u64();
+                sample.size = static_cast<uint32_t>(size_sync >> 1);
+                sample.sync = size_sync & 1;
+                sample.offset = end + reader.i64();
+                sample.decode_time = decode_time += reader.i64();
+                sample.composition_offset = static_cast<int32_t>(reader.i64());
+                end = sample.offset + sample.size;
+            }
+            if (reader.valid == false) {
+                entries.clear();
+                return std::errc::protocol_error;
+            }
+            std::string key = probe.path;
+            entries.insert_or_assign(std::move(key), std::move(probe));
+        }
+        if (reader.valid == false) {
+            entries.clear();
+            return std::errc::protocol_error;
+        }
+        return std::errc{};
+    } catch (const std::bad_alloc&) {
+        entries.clear();
+        return std::errc::not_enough_memory;
+    }
+}
+
+std::errc media_index_cache_t::save(const fs::path& path) const noexcept {
+    try {
+        std::vector<uint8_t> bytes{};
+        varint_writer_t writer{bytes};
+        writer.u64(cache_magic);
+        writer.u64(cache_version);
+        writer.u64(entries.size());
+        for (const auto& [key, probe] : entries) {
+            writer.str(probe.path);
+            writer.u64(probe.file_size);
+            writer.i64(probe.modified_time);
+            const media_description_t& desc = probe.description;
+            writer.u64(desc.codec);
+            writer.u64(desc.width);
+            writer.u64(desc.height);
+            writer.u64(desc.aspect_numerator);
+            writer.u64(desc.aspect_denominator);
+            writer.u64(desc.timescale);
+            writer.u64(desc.duration);
+            writer.u64(desc.sample_count);
+            writer.u64(probe.samples.size());
+            // samples are mostly contiguous and evenly spaced, so the deltas are small
+            uint64_t end = 0;
+            int64_t decode_time = 0;
+            for (const media_sample_index_t& sample : probe.samples) {
+                writer.u64((static_cast<uint64_t>(sample.size) << 1) | (sample.sync ? 1 : 0));
+                writer.i64(static_cast<int64_t>(sample.offset - end));
+                writer.i64(sample.decode_time - decode_time);
+                writer.i64(sample.composition_offset);
+                end = sample.offset + sample.size;
+                decode_time = sample.decode_time;
+            }
+        }
+        fs::path temp = path;
+        temp += ".tmp";
+        {
+            std::ofstream stream{temp, std::ios::binary | std::ios::trunc};
+            if (stream.is_open() == false)
+                return std::errc::permission_denied;
+            if (!stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())))
+                return std::errc::io_error;
+        }
+        std::error_code ec{};
+        fs::rename(temp, path, ec);
+        return ec ? to_errc(ec) : std::errc{};
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+}
+
+const media_probe_t* media_index_cache_t::find(const std::string& path, uint64_t file_size,
+                                               int64_t modified_time) const noexcept {
+    const auto it = entries.find(path);
+    if (it == entries.end())
+        return nullptr;
+    const media_probe_t& probe = it->second;
+    if (probe.file_size != file_size || probe.modified_time != modified_time)
+        return nullptr;
+    return &probe;
+}
+
+void media_index_cache_t::update(media_probe_t probe) noexcept(false) {
+    std::string key = probe.path;
+    entries.insert_or_assign(std::move(key), std::move(probe));
+}
+
+std::errc probe_files(gsl::span<const fs::path> paths, media_index_cache_t& cache,
+                      std::vector<media_probe_result_t>& results, uint32_t concurrency) noexcept {
+    try {
+        results.clear();
+        results.resize(paths.size());
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    // the cache is read-only while the workers are running
+    std::atomic<size_t> next{0};
+    auto work = [paths, &cache, &results, &next]() noexcept {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            media_probe_result_t& result = results[i];
+            media_probe_t& probe = result.probe;
+            if (result.status = get_file_status(paths[i], probe.file_size, probe.modified_time);
+                result.status != std::errc{})
+                continue;
+            try {
+                probe.path = to_key(paths[i]);
+                if (const media_probe_t* cached = cache.find(probe.path, probe.file_size, probe.modified_time)) {
+                    probe = *cached;
+                    result.cached = true;
+                    continue;
+                }
+            } catch (const std::bad_alloc&) {
+                result.status = std::errc::not_enough_memory;
+                continue;
+            }
+            result.status = parse_file(paths[i], probe);
+        }
+    };
+    if (concurrency == 0)
+        concurrency = std::max(std::thread::hardware_concurrency(), 1u);
+    const size_t count = std::min<size_t>(concurrency, paths.size());
+    std::vector<std::thread> workers{};
+    try {
+        workers.reserve(count);
+        for (size_t i = 1; i < count; ++i)
+            workers.emplace_back(work);
+    } catch (const std::exception&) {
+        // continue with the threads already created
+    }
+    work();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    try {
+        for (const media_probe_result_t& result : results)
+            if (result.status == std::errc{} && result.cached == false)
+                cache.update(result.probe);
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    return std::errc{};
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <gsl/gsl>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+/// @brief The video stream information which `print` shows for `IMFMediaType`
+struct media_description_t final {
+    uint32_t codec = 0; // type of the sample entry. `avc1` for H.264
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t aspect_numerator = 1; // `pasp`. Same with `MF_MT_PIXEL_ASPECT_RATIO`
+    uint32_t aspect_denominator = 1;
+    uint32_t timescale = 0;
+    uint64_t duration = 0; // in `timescale`
+    uint32_t sample_count = 0;
+
+  public:
+    /// @brief Average frame rate. 0 if unknown
+    [[nodiscard]] double fps() const noexcept;
+};
+
+/// @brief Location and timing of the sample in the file
+struct media_sample_index_t final {
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    int64_t decode_time = 0; // in `media_description_t::timescale`
+    int32_t composition_offset = 0;
+    bool sync = false;
+};
+
+struct media_probe_t final {
+    std::string path{}; // UTF-8, generic format
+    uint64_t file_size = 0;
+    int64_t modified_time = 0; // tick count of `std::filesystem::file_time_type`
+    media_description_t description{};
+    std::vector<media_sample_index_t> samples{};
+};
+
+/**
+ * @brief Parse the `moov` of the MP4 file for the first video track, without Media Foundation.
+ *        The file is memory-mapped and only the boxes on the path are parsed
+ * @return `std::errc::not_supported` if there is no video track
+ */
+std::errc probe_mp4(const std::filesystem::path& path, media_probe_t& probe) noexcept;
+
+/// @brief Parse the MP4 file in the memory. `path`, `file_size`, `modified_time` are not changed
+std::errc probe_mp4(gsl::span<const uint8_t> file, media_probe_t& probe) noexcept;
+
+/**
+ * @brief Probe results keyed by the path. Valid while the size and modified time of the file are same.
+ *        The file format is varint based and the sample indexes are delta-encoded
+ */
+class media_index_cache_t final {
+    std::unordered_map<std::string, media_probe_t> entries{};
+
+  public:
+    /// @brief Replace the entries with the cache file. The entries are cleared if the file is broken
+    std::errc load(const std::filesystem::path& path) noexcept;
+    /// @brief Write to a temporary file and rename it, so the cache file is never half-written
+    std::errc save(const std::filesystem::path& path) const noexcept;
+
+    /// @return nullptr if the entry is missing or stale
+    [[nodiscard]] const media_probe_t* find(const std::string& path, uint64_t file_size,
+                                            int64_t modified_time) const noexcept;
+    /// @throws std::bad_alloc
+    void update(media_probe_t probe) noexcept(false);
+
+    [[nodiscard]] size_t size() const noexcept {
+        return entries.size();
+    }
+};
+
+struct media_probe_result_t final {
+    std::errc status{};
+    bool cached = false; // `probe` came from the cache. The file was not opened
+    media_probe_t probe{};
+};
+
+/**
+ * @brief Probe the files in parallel. The unchanged files are served from the cache
+ *        and the cache is updated with the newly parsed files
+ * @param results    same order with `paths`
+ * @param concurrency the number of worker threads. 0 for `std::thread::hardware_concurrency`
+ */
+std::errc probe_files(gsl::span<const std::filesystem::path> paths, media_index_cache_t& cache,
+                      std::vector<media_probe_result_t>& results, uint32_t concurrency = 0) noexcept;
@@ -0,0 +1,201 @@
+#pragma once
+#include <cstdint>
+#include <system_error>
+#include <utility>
+
+#include "stage_graph.hpp"
+
+/// @see https://docs.microsoft.com/en-us/windows/win32/medfound/basic-mft-processing-model
+enum class transform_state_t : uint8_t {
+    idle = 0,  // the types can be changed. nothing is allocated for the streaming
+    ready,     // `MFT_MESSAGE_NOTIFY_BEGIN_STREAMING`. waiting for the start of a stream
+    streaming, // `MFT_MESSAGE_NOTIFY_START_OF_STREAM`. accepts the inputs
+    ended,     // `MFT_MESSAGE_NOTIFY_END_OF_STREAM`. no more input
+    draining,  // `MFT_MESSAGE_COMMAND_DRAIN`. the leftovers are collected with `process_output`
+};
+
+/**
+ * @brief Portable transform with the processing model of `IMFTransform`.
+ *        The public functions check the state and reject the illegal transition with
+ *        `std::errc::operation_not_permitted`, so the implementation only provides the `on_*` kernels.
+ *
+ * | function          | from                        | to        |
+ * |-------------------|-----------------------------|-----------|
+ * | `begin_streaming` | idle                        | ready     |
+ * | `start_of_stream` | idle, ready                 | streaming |
+ * | `end_of_stream`   | streaming                   | ended     |
+ * | `drain`           | streaming, ended            | draining  |
+ * | `process_output`  | draining (the last output)  | ready     |
+ * | `flush`           | streaming, ended, draining  | streaming |
+ * | `end_streaming`   | ready, streaming            | idle      |
+ *
+ * @note  `start_of_stream` in the idle state implies `begin_streaming`, like the MFT which allocates lazily.
+ *        A failed kernel leaves the state unchanged
+ * @see   IMFTransform::ProcessMessage, IMFTransform::ProcessInput, IMFTransform::ProcessOutput
+ */
+template <typename T>
+class media_transform_t {
+    transform_state_t current = transform_state_t::idle;
+
+  public:
+    virtual ~media_transform_t() noexcept = default;
+
+    [[nodiscard]] transform_state_t state() const noexcept {
+        return current;
+    }
+
+    std::errc begin_streaming() noexcept {
+        if (current != transform_state_t::idle)
+            return std::errc::operation_not_permitted;
+        return move_to(on_begin_streaming(), transform_state_t::ready);
+    }
+    std::errc start_of_stream() noexcept {
+        if (current == transform_state_t::idle)
+            if (auto ec = begin_streaming(); ec != std::errc{})
+                return ec;
+        if (current != transform_state_t::ready)
+            return std::errc::operation_not_permitted;
+        return move_to(on_start_of_stream(), transform_state_t::streaming);
+    }
+
+    /**
+     * @param input taken only when the result is `std::errc{}`
+     * @return `std::errc::resource_unavailable_try_again` if the outputs must be collected first.
+     *         Same with `MF_E_NOTACCEPTING`
+     */
+    std::errc process_input(T& input) noexcept {
+        if (current != transform_state_t::streaming)
+            return std::errc::operation_not_permitted;
+        return on_input(input);
+    }
+
+    /**
+     * @return `std::errc::resource_unavailable_try_again` if more input is required. Same with
+     *         `MF_E_TRANSFORM_NEED_MORE_INPUT`. While draining, `std::errc::no_message_available` after the last
+     *         output and the state becomes `ready`
+     */
+    std::errc process_output(T& output) noexcept {
+        switch (current) {
+        case transform_state_t::streaming:
+        case transform_state_t::ended:
+            return on_output(output);
+        case transform_state_t::draining:
+            if (auto ec = on_output(output); ec != std::errc::resource_unavailable_try_again)
+                return ec;
+            current = transform_state_t::ready;
+            return std::errc::no_message_available;
+        default:
+            return std::errc::operation_not_permitted;
+        }
+    }
+
+    std::errc end_of_stream() noexcept {
+        if (current != transform_state_t::streaming)
+            return std::errc::operation_not_permitted;
+        return move_to(on_end_of_stream(), transform_state_t::ended);
+    }
+    std::errc drain() noexcept {
+        if (current != transform_state_t::streaming && current != transform_state_t::ended)
+            return std::errc::operation_not_permitted;
+        return move_to(on_drain(), transform_state_t::draining);
+    }
+    /// @brief Discard the inputs and the outputs. The stream continues, like the seek
+    std::errc flush() noexcept {
+        switch (current) {
+        case transform_state_t::ready:
+            return std::errc{};
+        case transform_state_t::streaming:
+        case transform_state_t::ended:
+        case transform_state_t::draining:
+            return move_to(on_flush(), transform_state_t::streaming);
+        default:
+            return std::errc::operation_not_permitted;
+        }
+    }
+    /// @brief Release the resources for the streaming. Pending data must be drained or flushed before this
+    std::errc end_streaming() noexcept {
+        if (current != transform_state_t::ready && current != transform_state_t::streaming)
+            return std::errc::operation_not_permitted;
+        return move_to(on_end_streaming(), transform_state_t::idle);
+    }
+
+  protected:
+    virtual std::errc on_begin_streaming() noexcept {
+        return std::errc{};
+    }
+    virtual std::errc on_start_of_stream() noexcept {
+        return std::errc{};
+    }
+    virtual std::errc on_input(T& input) noexcept = 0;
+    /// @return `std::errc::resource_unavailable_try_again` if there is no output now
+    virtual std::errc on_output(T& output) noexcept = 0;
+    virtual std::errc on_end_of_stream() noexcept {
+        return std::errc{};
+    }
+    virtual std::errc on_drain() noexcept {
+        return std::errc{};
+    }
+    virtual std::errc on_flush() noexcept = 0;
+    virtual std::errc on_end_streaming() noexcept {
+        return std::errc{};
+    }
+
+  private:
+    std::errc move_to(std::errc ec, transform_state_t next) noexcept {
+        if (ec == std::errc{})
+            current = next;
+        return ec;
+    }
+};
+
+/**
+ * @brief `stage_node_t` for any `media_transform_t`. The native kernels and the `IMFTransform` adapter
+ *        run in the `stage_graph_t` in the same way
+ */
+template <typename T>
+class transform_node_t final : public stage_node_t<T> {
+    media_transform_t<T>& transform;
+
+  public:
+    explicit transform_node_t(media_transform_t<T>& transform) noexcept : transform{transform} {
+    }
+
+    std::errc start() noexcept override {
+        return transform.start_of_stream();
+    }
+    std::errc process(T input, stage_emitter_t<T>& output) noexcept override {
+        auto ec = transform.process_input(input);
+        if (ec == std::errc::resource_unavailable_try_again) {
+            // the outputs must be collected before the next input
+            if (ec = pull(output); ec != std::errc{})
+                return ec;
+            ec = transform.process_input(input);
+        }
+        if (ec != std::errc{})
+            return ec;
+        return pull(output);
+    }
+    std::errc drain(stage_emitter_t<T>& output) noexcept override {
+        if (auto ec = transform.end_of_stream(); ec != std::errc{})
+            return ec;
+        if (auto ec = transform.drain(); ec != std::errc{})
+            return ec;
+        auto ec = pull(output);
+        return ec == std::errc::no_message_available ? std::errc{} : ec;
+    }
+
+  private:
+    /// @return `std::errc::no_message_available` when the drain is complete
+    std::errc pull(stage_emitter_t<T>& output) noexcept {
+        while (true) {
+            T item{};
+            auto ec = transform.process_output(item);
+            if (ec == std::errc::resource_unavailable_try_again)
+                return std::errc{};
+            if (ec != std::errc{})
+                return ec;
+            if (ec = output.emit(std::move(item)); ec != std::errc{})
+                return ec;
+        }
+    }
+};
@@ -0,0 +1,312 @@
+#include "media_type.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+/// @brief Order of the attributes. The key breaks the tie of the hash, so the same set has the same order
+bool key_less(const media_attribute_t& lhs, uint64_t hash, const media_guid_t& key) noexcept {
+    if (lhs.hash != hash)
+        return lhs.hash < hash;
+    return std::memcmp(&lhs.key, &key, sizeof(media_guid_t)) < 0;
+}
+
+uint64_t pack(uint32_t high, uint32_t low) noexcept {
+    return (uint64_t{high} << 32) | low;
+}
+
+/// @return zero if the key is not one of `media_field_t`
+media_field_t find_field(const media_guid_t& key) noexcept {
+    if (key == mf_mt_major_type)
+        return media_field_t::major_type;
+    if (key == mf_mt_subtype)
+        return media_field_t::subtype;
+    if (key == mf_mt_frame_size)
+        return media_field_t::frame_size;
+    if (key == mf_mt_frame_rate)
+        return media_field_t::frame_rate;
+    if (key == mf_mt_pixel_aspect_ratio)
+        return media_field_t::pixel_aspect_ratio;
+    if (key == mf_mt_default_stride)
+        return media_field_t::default_stride;
+    if (key == mf_mt_interlace_mode)
+        return media_field_t::interlace_mode;
+    return media_field_t{};
+}
+
+bool unpack(bool has, uint64_t value, uint32_t& high, uint32_t& low) noexcept {
+    if (has == false)
+        return false;
+    high = static_cast<uint32_t>(value >> 32);
+    low = static_cast<uint32_t>(value);
+    return true;
+}
+
+} // namespace
+
+bool media_attribute_t::operator==(const media_attribute_t& rhs) const noexcept {
+    if (hash != rhs.hash || kind != rhs.kind || key != rhs.key)
+        return false;
+    switch (kind) {
+    case media_attribute_kind_t::uint32:
+        return value.u32 == rhs.value.u32;
+    case media_attribute_kind_t::uint64:
+        return value.u64 == rhs.value.u64;
+    case media_attribute_kind_t::real:
+        return value.real == rhs.value.real;
+    case media_attribute_kind_t::guid:
+        return value.guid == rhs.value.guid;
+    default:
+        break;
+    }
+    if (bytes == rhs.bytes)
+        return true;
+    auto lhs_data = data();
+    auto rhs_data = rhs.data();
+    return lhs_data.size() == rhs_data.size() && std::equal(lhs_data.begin(), lhs_data.end(), rhs_data.begin());
+}
+
+gsl::span<const uint8_t> media_attribute_t::data() const noexcept {
+    if (bytes == nullptr)
+        return {};
+    return {bytes->data(), bytes->size()};
+}
+
+std::u16string_view media_attribute_t::text() const noexcept {
+    if (kind != media_attribute_kind_t::string || bytes == nullptr)
+        return {};
+    return {reinterpret_cast<const char16_t*>(bytes->data()), bytes->size() / sizeof(char16_t)};
+}
+
+bool media_type_t::operator==(const media_type_t& rhs) const noexcept {
+    if (fields != rhs.fields)
+        return false;
+    if (has(media_field_t::major_type) && major != rhs.major)
+        return false;
+    if (has(media_field_t::subtype) && sub != rhs.sub)
+        return false;
+    if (has(media_field_t::frame_size) && size != rhs.size)
+        return false;
+    if (has(media_field_t::frame_rate) && rate != rhs.rate)
+        return false;
+    if (has(media_field_t::pixel_aspect_ratio) && aspect != rhs.aspect)
+        return false;
+    if (has(media_field_t::default_stride) && stride != rhs.stride)
+        return false;
+    if (has(media_field_t::interlace_mode) && interlace != rhs.interlace)
+        return false;
+    return others == rhs.others;
+}
+
+bool media_type_t::contains(const media_type_t& partial) const noexcept {
+    if ((fields & partial.fields) != partial.fields)
+        return false;
+    if (partial.has(media_field_t::major_type) && major != partial.major)
+        return false;
+    if (partial.has(media_field_t::subtype) && sub != partial.sub)
+        return false;
+    if (partial.has(media_field_t::frame_size) && size != partial.size)
+        return false;
+    if (partial.has(media_field_t::frame_rate) && rate != partial.rate)
+        return false;
+    if (partial.has(media_field_t::pixel_aspect_ratio) && aspect != partial.aspect)
+        return false;
+    if (partial.has(media_field_t::default_stride) && stride != partial.stride)
+        return false;
+    if (partial.has(media_field_t::interlace_mode) && interlace != partial.interlace)
+        return false;
+    // both are sorted. merge them
+    auto it = others.begin();
+    for (const media_attribute_t& required : partial.others) {
+        while (it != others.end() && key_less(*it, required.hash, required.key))
+            ++it;
+        if (it == others.end() || *it != required)
+            return false;
+        ++it;
+    }
+    return true;
+}
+
+void media_type_t::clear() noexcept {
+    fields = 0;
+    others.clear();
+}
+
+media_guid_t media_type_t::major_type() const noexcept {
+    return has(media_field_t::major_type) ? major : media_guid_t{};
+}
+
+media_guid_t media_type_t::subtype() const noexcept {
+    return has(media_field_t::subtype) ? sub : media_guid_t{};
+}
+
+bool media_type_t::frame_size(uint32_t& width, uint32_t& height) const noexcept {
+    return unpack(has(media_field_t::frame_size), size, width, height);
+}
+
+bool media_type_t::frame_rate(uint32_t& numerator, uint32_t& denominator) const noexcept {
+    return unpack(has(media_field_t::frame_rate), rate, numerator, denominator);
+}
+
+bool media_type_t::pixel_aspect_ratio(uint32_t& numerator, uint32_t& denominator) const noexcept {
+    return unpack(has(media_field_t::pixel_aspect_ratio), aspect, numerator, denominator);
+}
+
+bool media_type_t::default_stride(int32_t& value) const noexcept {
+    if (has(media_field_t::default_stride) == false)
+        return false;
+    value = stride;
+    return true;
+}
+
+bool media_type_t::interlace_mode(uint32_t& value) const noexcept {
+    if (has(media_field_t::interlace_mode) == false)
+        return false;
+    value = interlace;
+    return true;
+}
+
+pixel_format_t media_type_t::pixel_format() const noexcept {
+    if (has(media_field_t::subtype) == false || sub != make_video_subtype(sub.data1))
+        return pixel_format_t::unknown;
+    return static_cast<pixel_format_t>(sub.data1);
+}
+
+void media_type_t::set_major_type(const media_guid_t& value) noexcept {
+    major = value;
+    fields |= static_cast<uint32_t>(media_field_t::major_type);
+}
+
+void media_type_t::set_subtype(const media_guid_t& value) noexcept {
+    sub = value;
+    fields |= static_cast<uint32_t>(media_field_t::subtype);
+}
+
+void media_type_t::set_frame_size(uint32_t width, uint32_t height) noexcept {
+    size = pack(width, height);
+    fields |= static_cast<uint32_t>(media_field_t::frame_size);
+}
+
+void media_type_t::set_frame_rate(uint32_t numerator, uint32_t denominator) noexcept {
+    rate = pack(numerator, denominator);
+    fields |= static_cast<uint32_t>(media_field_t::frame_rate);
+}
+
+void media_type_t::set_pixel_aspect_ratio(uint32_t numerator, uint32_t denominator) noexcept {
+    aspect = pack(numerator, denominator);
+    fields |= static_cast<uint32_t>(media_field_t::pixel_aspect_ratio);
+}
+
+void media_type_t::set_default_stride(int32_t value) noexcept {
+    stride = value;
+    fields |= static_cast<uint32_t>(media_field_t::default_stride);
+}
+
+void media_type_t::set_interlace_mode(uint32_t value) noexcept {
+    interlace = value;
+    fields |= static_cast<uint32_t>(media_field_t::interlace_mode);
+}
+
+const media_attribute_t* media_type_t::find(const media_guid_t& key) const noexcept {
+    const uint64_t hash = hash_guid(key);
+    for (const media_attribute_t& attribute : others) {
+        if (attribute.hash < hash)
+            continue;
+        if (attribute.hash > hash)
+            break;
+        if (attribute.key == key)
+            return &attribute;
+    }
+    return nullptr;
+}
+
+media_attribute_t& media_type_t::emplace(const media_guid_t& key, media_attribute_kind_t kind) noexcept(false) {
+    if (find_field(key) != media_field_t{})
+        throw std::invalid_argument{"the kind doesn't match the field"};
+    const uint64_t hash = hash_guid(key);
+    auto it = std::lower_bound(others.begin(), others.end(), key, [hash](const media_attribute_t& lhs, auto& rhs) {
+        return key_less(lhs, hash, rhs);
+    });
+    if (it == others.end() || it->key != key) {
+        it = others.emplace(it);
+        it->hash = hash;
+        it->key = key;
+    }
+    it->kind = kind;
+    it->bytes.reset();
+    return *it;
+}
+
+void media_type_t::set_uint32(const media_guid_t& key, uint32_t value) noexcept(false) {
+    switch (find_field(key)) {
+    case media_field_t::default_stride:
+        return set_default_stride(static_cast<int32_t>(value));
+    case media_field_t::interlace_mode:
+        return set_interlace_mode(value);
+    default:
+        emplace(key, media_attribute_kind_t::uint32).value.u32 = value;
+    }
+}
+
+void media_type_t::set_uint64(const media_guid_t& key, uint64_t value) noexcept(false) {
+    const auto high = static_cast<uint32_t>(value >> 32);
+    const auto low = static_cast<uint32_t>(value);
+    switch (find_field(key)) {
+    case media_field_t::frame_size:
+        return set_frame_size(high, low);
+    case media_field_t::frame_rate:
+        return set_frame_rate(high, low);
+    case media_field_t::pixel_aspect_ratio:
+        return set_pixel_aspect_ratio(high, low);
+    default:
+        emplace(key, media_attribute_kind_t::uint64).value.u64 = value;
+    }
+}
+
+void media_type_t::set_double(const media_guid_t& key, double value) noexcept(false) {
+    emplace(key, media_attribute_kind_t::real).value.real = value;
+}
+
+void media_type_t::set_guid(const media_guid_t& key, const media_guid_t& value) noexcept(false) {
+    switch (find_field(key)) {
+    case media_field_t::major_type:
+        return set_major_type(value);
+    case media_field_t::subtype:
+        return set_subtype(value);
+    default:
+        emplace(key, media_attribute_kind_t::guid).value.guid = value;
+    }
+}
+
+void media_type_t::set_string(const media_guid_t& key, std::u16string_view value) noexcept(false) {
+    const auto* first = reinterpret_cast<const uint8_t*>(value.data());
+    auto bytes = std::make_shared<const std::vector<uint8_t>>(first, first + value.size() * sizeof(char16_t));
+    emplace(key, media_attribute_kind_t::string).bytes = std::move(bytes);
+}
+
+void media_type_t::set_blob(const media_guid_t& key, gsl::span<const uint8_t> value) noexcept(false) {
+    auto bytes = std::make_shared<const std::vector<uint8_t>>(value.begin(), value.end());
+    emplace(key, media_attribute_kind_t::blob).bytes = std::move(bytes);
+}
+
+bool media_type_t::erase(const media_guid_t& key) noexcept {
+    if (const media_field_t field = find_field(key); field != media_field_t{}) {
+        const bool found = has(field);
+        reset(field);
+        return found;
+    }
+    const media_attribute_t* attribute = find(key);
+    if (attribute == nullptr)
+        return false;
+    others.erase(others.begin() + (attribute - others.data()));
+    return true;
+}
+
+std::errc make_frame_layout(const media_type_t& type, uint32_t alignment, frame_layout_t& layout) noexcept {
+    uint32_t width = 0, height = 0;
+    if (type.frame_size(width, height) == false)
+        return std::errc::invalid_argument;
+    return make_frame_layout(type.pixel_format(), width, height, alignment, layout);
+}
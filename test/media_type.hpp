@@ -0,0 +1,196 @@
+#pragma once
+#include <cstdint>
+#include <gsl/gsl>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "planar_frame.hpp"
+
+/// @brief 128-bit key in the memory layout of `GUID`. The attribute keys and the subtypes
+struct media_guid_t final {
+    uint32_t data1;
+    uint16_t data2;
+    uint16_t data3;
+    uint8_t data4[8];
+};
+
+constexpr bool operator==(const media_guid_t& lhs, const media_guid_t& rhs) noexcept {
+    if (lhs.data1 != rhs.data1 || lhs.data2 != rhs.data2 || lhs.data3 != rhs.data3)
+        return false;
+    for (int i = 0; i < 8; ++i)
+        if (lhs.data4[i] != rhs.data4[i])
+            return false;
+    return true;
+}
+constexpr bool operator!=(const media_guid_t& lhs, const media_guid_t& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+/// @brief Mix of the 128 bits. The attributes keep it, so the most of the key comparisons are one integer
+constexpr uint64_t hash_guid(const media_guid_t& key) noexcept {
+    uint64_t low = key.data1 | (uint64_t{key.data2} << 32) | (uint64_t{key.data3} << 48);
+    uint64_t high = 0;
+    for (int i = 0; i < 8; ++i)
+        high |= uint64_t{key.data4[i]} << (8 * i);
+    uint64_t h = (low ^ (high * 0x9E3779B97F4A7C15)) * 0xD6E8FEB86659FD93;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93;
+    return h ^ (h >> 32);
+}
+
+/// @brief The subtype of `MFVideoFormat_Base` with the FourCC or `D3DFORMAT` like `DEFINE_MEDIATYPE_GUID`
+constexpr media_guid_t make_video_subtype(uint32_t data1) noexcept {
+    return {data1, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+}
+
+/// @brief The keys of `media_field_t`. `media_type_t` keeps them in the inline fields
+/// @see mfapi.h
+constexpr media_guid_t mf_mt_major_type{0x48eba18e, 0xf8c9, 0x4687, {0xbf, 0x11, 0x0a, 0x74, 0xc9, 0xf9, 0x6a, 0x8f}};
+constexpr media_guid_t mf_mt_subtype{0xf7e34c9a, 0x42e8, 0x4714, {0xb7, 0x4b, 0xcb, 0x29, 0xd7, 0x2c, 0x35, 0xe5}};
+constexpr media_guid_t mf_mt_frame_size{0x1652c33d, 0xd6b2, 0x4012, {0xb8, 0x34, 0x72, 0x03, 0x08, 0x49, 0xa3, 0x7d}};
+constexpr media_guid_t mf_mt_frame_rate{0xc459a2e8, 0x3d2c, 0x4e44, {0xb1, 0x32, 0xfe, 0xe5, 0x15, 0x6c, 0x7b, 0xb0}};
+constexpr media_guid_t mf_mt_pixel_aspect_ratio{0xc6376a1e, 0x8d0a, 0x4027,
+                                                {0xbe, 0x45, 0x6d, 0x9a, 0x0a, 0xd3, 0x9b, 0xb6}};
+constexpr media_guid_t mf_mt_default_stride{0x644b4e48, 0x1e02, 0x4516,
+                                            {0xb0, 0xeb, 0xc0, 0x1c, 0xa9, 0xd4, 0x9a, 0xc6}};
+constexpr media_guid_t mf_mt_interlace_mode{0xe2724bb8, 0xe676, 0x4806,
+                                            {0xb4, 0xb2, 0xa8, 0xd6, 0xef, 0xb4, 0x4c, 0xcd}};
+
+/// @see MF_ATTRIBUTE_TYPE
+enum class media_attribute_kind_t : uint8_t {
+    uint32,
+    uint64,
+    real, // MF_ATTRIBUTE_DOUBLE
+    guid,
+    string, // UTF-16 code units without the null terminator
+    blob,
+};
+
+/// @note `IUnknown` can't be the value
+struct media_attribute_t final {
+    uint64_t hash = 0; // `hash_guid(key)`
+    media_guid_t key{};
+    media_attribute_kind_t kind = media_attribute_kind_t::uint32;
+    union {
+        uint32_t u32;
+        uint64_t u64;
+        double real;
+        media_guid_t guid;
+    } value{};
+    std::shared_ptr<const std::vector<uint8_t>> bytes{}; // `string` and `blob`. The copies share it
+
+  public:
+    [[nodiscard]] bool operator==(const media_attribute_t& rhs) const noexcept;
+    [[nodiscard]] bool operator!=(const media_attribute_t& rhs) const noexcept {
+        return !(*this == rhs);
+    }
+    [[nodiscard]] gsl::span<const uint8_t> data() const noexcept;
+    [[nodiscard]] std::u16string_view text() const noexcept;
+};
+
+/// @brief The attributes which are stored inline in `media_type_t`, without the hash and the kind
+enum class media_field_t : uint32_t {
+    major_type = 1 << 0,         // MF_MT_MAJOR_TYPE
+    subtype = 1 << 1,            // MF_MT_SUBTYPE
+    frame_size = 1 << 2,         // MF_MT_FRAME_SIZE
+    frame_rate = 1 << 3,         // MF_MT_FRAME_RATE
+    pixel_aspect_ratio = 1 << 4, // MF_MT_PIXEL_ASPECT_RATIO
+    default_stride = 1 << 5,     // MF_MT_DEFAULT_STRIDE
+    interlace_mode = 1 << 6,     // MF_MT_INTERLACE_MODE
+};
+
+/**
+ * @brief Value type of `IMFMediaType`. The common keys are the inline fields and the others are in a flat vector
+ *        sorted by the key's hash. Reading a field is a branch and comparing 2 types is mostly the integer
+ *        comparisons, so the format negotiation and the per-sample type checks don't call the COM methods.
+ *        The copy is one allocation for the vector. The `string`/`blob` values are shared, not copied
+ * @note  The common keys are never in `attributes`. The setters with the keys like `mf_mt_subtype` write the
+ *        inline fields, so the types from the accessors and from the setters are equal
+ * @see   get_media_type, make_media_type
+ */
+class media_type_t final {
+    uint32_t fields = 0; // bits of `media_field_t`
+    media_guid_t major{};
+    media_guid_t sub{};
+    uint64_t size = 0;   // width in the high 32 bits like `MFSetAttributeSize`
+    uint64_t rate = 0;   // numerator in the high 32 bits like `MFSetAttributeRatio`
+    uint64_t aspect = 0; // same with `rate`
+    int32_t stride = 0;
+    uint32_t interlace = 0;
+    std::vector<media_attribute_t> others{};
+
+  public:
+    [[nodiscard]] bool operator==(const media_type_t& rhs) const noexcept;
+    [[nodiscard]] bool operator!=(const media_type_t& rhs) const noexcept {
+        return !(*this == rhs);
+    }
+    /**
+     * @brief Every field and attribute of `partial` is in this type with the same value.
+     *        Use it for the negotiation with the partial types from `GetOutputAvailableType`
+     */
+    [[nodiscard]] bool contains(const media_type_t& partial) const noexcept;
+
+    [[nodiscard]] bool has(media_field_t field) const noexcept {
+        return fields & static_cast<uint32_t>(field);
+    }
+    void reset(media_field_t field) noexcept {
+        fields &= ~static_cast<uint32_t>(field);
+    }
+    /// @brief Remove every field and attribute
+    void clear() noexcept;
+
+    /// @note The getters return false(or zero) if the field is not set
+    [[nodiscard]] media_guid_t major_type() const noexcept;
+    [[nodiscard]] media_guid_t subtype() const noexcept;
+    bool frame_size(uint32_t& width, uint32_t& height) const noexcept;
+    bool frame_rate(uint32_t& numerator, uint32_t& denominator) const noexcept;
+    bool pixel_aspect_ratio(uint32_t& numerator, uint32_t& denominator) const noexcept;
+    bool default_stride(int32_t& value) const noexcept;
+    bool interlace_mode(uint32_t& value) const noexcept;
+    /// @return `pixel_format_t::unknown` if the subtype is not the one of `MFVideoFormat_Base`
+    [[nodiscard]] pixel_format_t pixel_format() const noexcept;
+
+    void set_major_type(const media_guid_t& value) noexcept;
+    void set_subtype(const media_guid_t& value) noexcept;
+    void set_frame_size(uint32_t width, uint32_t height) noexcept;
+    void set_frame_rate(uint32_t numerator, uint32_t denominator) noexcept;
+    void set_pixel_aspect_ratio(uint32_t numerator, uint32_t denominator) noexcept;
+    void set_default_stride(int32_t value) noexcept;
+    void set_interlace_mode(uint32_t value) noexcept;
+
+    /// @return nullptr if the key is missing or one of `media_field_t`
+    [[nodiscard]] const media_attribute_t* find(const media_guid_t& key) const noexcept;
+    /**
+     * @brief Insert or replace the attribute of the key. The keys of `media_field_t` set the inline field
+     * @throws std::bad_alloc
+     * @throws std::invalid_argument if the key is one of `media_field_t` and the kind doesn't match.
+     *         For example, `set_uint32(mf_mt_subtype, ...)`
+     */
+    void set_uint32(const media_guid_t& key, uint32_t value) noexcept(false);
+    void set_uint64(const media_guid_t& key, uint64_t value) noexcept(false);
+    void set_double(const media_guid_t& key, double value) noexcept(false);
+    void set_guid(const media_guid_t& key, const media_guid_t& value) noexcept(false);
+    void set_string(const media_guid_t& key, std::u16string_view value) noexcept(false);
+    void set_blob(const media_guid_t& key, gsl::span<const uint8_t> value) noexcept(false);
+    /// @brief The keys of `media_field_t` reset the inline field
+    /// @return false if the key is missing
+    bool erase(const media_guid_t& key) noexcept;
+
+    /// @brief The attributes except the inline fields, in the order of the hash
+    [[nodiscard]] gsl::span<const media_attribute_t> attributes() const noexcept {
+        return {others.data(), others.size()};
+    }
+
+  private:
+    /// @throws std::bad_alloc, std::invalid_argument
+    media_attribute_t& emplace(const media_guid_t& key, media_attribute_kind_t kind) noexcept(false);
+};
+
+/**
+ * @brief `make_frame_layout` with the subtype and the frame size of the type
+ * @return `std::errc::invalid_argument` if the frame size is missing.
+ *         `std::errc::not_supported` if the subtype is not `pixel_format_t`
+ */
+std::errc make_frame_layout(const media_type_t& type, uint32_t alignment, frame_layout_t& layout) noexcept;
@@ -0,0 +1,98 @@
+#include "memory_budget.hpp"
+
+#include <algorithm>
+
+memory_budget_t::memory_budget_t(size_t limit, memory_budget_t* parent) noexcept : parent{parent}, limit{limit} {
+}
+
+memory_budget_t* memory_budget_t::charge(size_t bytes) noexcept {
+    size_t current = live.load(std::memory_order_relaxed);
+    do {
+        if (limit - current < bytes)
+            return this;
+    } while (live.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed) == false);
+    if (parent) {
+        if (memory_budget_t* level = parent->charge(bytes)) {
+            discharge(bytes); // roll back. the peak is not touched
+            return level;
+        }
+    }
+    size_t value = peak.load(std::memory_order_relaxed);
+    while (value < current + bytes &&
+           peak.compare_exchange_weak(value, current + bytes, std::memory_order_relaxed) == false)
+        continue;
+    return nullptr;
+}
+
+void memory_budget_t::discharge(size_t bytes) noexcept {
+    // seq_cst with `waiters`, so one of the release and the waiter sees the other
+    live.fetch_sub(bytes);
+    if (waiters.load() == 0)
+        return;
+    std::lock_guard lck{mtx};
+    cv.notify_all();
+}
+
+bool memory_budget_t::fits(size_t bytes) const noexcept {
+    for (const memory_budget_t* level = this; level; level = level->parent)
+        if (bytes > level->limit)
+            return false;
+    return true;
+}
+
+std::errc memory_budget_t::try_reserve(size_t bytes) noexcept {
+    if (fits(bytes) == false)
+        return std::errc::value_too_large;
+    if (memory_budget_t* level = charge(bytes)) {
+        ++level->rejected;
+        return std::errc::resource_unavailable_try_again;
+    }
+    return std::errc{};
+}
+
+std::errc memory_budget_t::reserve(size_t bytes, std::chrono::steady_clock::duration timeout) noexcept {
+    if (fits(bytes) == false)
+        return std::errc::value_too_large;
+    const auto until = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        memory_budget_t* level = charge(bytes);
+        if (level == nullptr)
+            return std::errc{};
+        std::unique_lock lck{level->mtx};
+        ++level->waiters;
+        // check again after the registration. the release after this point will notify
+        const bool full = level->limit - level->live.load() < bytes;
+        const bool expired = full && level->cv.wait_until(lck, until) == std::cv_status::timeout;
+        --level->waiters;
+        lck.unlock(); // `charge` may lock the lower levels for the rollback
+        if (expired == false)
+            continue;
+        // the retries are not counted. only the reservation which failed at last
+        if (memory_budget_t* last = charge(bytes)) {
+            ++last->rejected;
+            return std::errc::timed_out;
+        }
+        return std::errc{};
+    }
+}
+
+void memory_budget_t::release(size_t bytes) noexcept {
+    for (memory_budget_t* level = this; level; level = level->parent)
+        level->discharge(bytes);
+}
+
+memory_usage_t memory_budget_t::usage() const noexcept {
+    memory_usage_t result{};
+    result.live = live.load(std::memory_order_relaxed);
+    result.peak = peak.load(std::memory_order_relaxed);
+    result.limit = limit;
+    result.rejected = rejected.load(std::memory_order_relaxed);
+    return result;
+}
+
+size_t memory_budget_t::available() const noexcept {
+    size_t result = SIZE_MAX;
+    for (const memory_budget_t* level = this; level; level = level->parent)
+        result = std::min(result, level->limit - std::min(level->limit, level->live.load(std::memory_order_relaxed)));
+    return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+
+struct memory_usage_t final {
+    size_t live = 0;
+    size_t peak = 0;
+    size_t limit = 0;
+    uint64_t rejected = 0; // `try_reserve`/`reserve` calls which failed on this level. the retries are not counted
+};
+
+/**
+ * @brief Limit of the bytes which the pools can hold. The budgets make a tree like process -> pipeline -> stage.
+ *        A reservation is charged to every level up to the root, and fails if any level goes over its limit.
+ *        The leaf budgets with `SIZE_MAX` work as the per-stage accounts with the live/peak bytes.
+ * @note  The parent must outlive the children. The pools charged to the budget must be released before it
+ * @see   frame_pool_config_t::budget
+ */
+class memory_budget_t final {
+    memory_budget_t* const parent;
+    const size_t limit;
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> peak{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint32_t> waiters{0};
+    std::mutex mtx{};
+    std::condition_variable cv{};
+
+  public:
+    explicit memory_budget_t(size_t limit, memory_budget_t* parent = nullptr) noexcept;
+    memory_budget_t(const memory_budget_t&) = delete;
+    memory_budget_t(memory_budget_t&&) = delete;
+    memory_budget_t& operator=(const memory_budget_t&) = delete;
+    memory_budget_t& operator=(memory_budget_t&&) = delete;
+
+    /// @return `std::errc::resource_unavailable_try_again` if some level is over the limit.
+    ///         `std::errc::value_too_large` if the bytes can never fit
+    std::errc try_reserve(size_t bytes) noexcept;
+    /**
+     * @brief Wait until the other users release enough bytes. This is the backpressure for the producers
+     * @return `std::errc::timed_out`. `std::errc::value_too_large` if the bytes can never fit
+     */
+    std::errc reserve(size_t bytes, std::chrono::steady_clock::duration timeout) noexcept;
+    /// @note the bytes must be reserved by this budget
+    void release(size_t bytes) noexcept;
+
+    [[nodiscard]] memory_usage_t usage() const noexcept;
+    /// @brief Bytes which can be reserved now, considering the parents
+    [[nodiscard]] size_t available() const noexcept;
+
+  private:
+    /// @return the level which is over the limit. `nullptr` if the reservation is done
+    memory_budget_t* charge(size_t bytes) noexcept;
+    /// @return false if some level's limit is smaller than the bytes
+    [[nodiscard]] bool fits(size_t bytes) const noexcept;
+    void discharge(size_t bytes) noexcept;
+};
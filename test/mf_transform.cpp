@@ -1,13 +1,20 @@
 #include "mf_transform.hpp"
+#include "event_trace.hpp"
+#include "h264_parser.hpp"
 
+#include <algorithm>
 #include <codecapi.h>
+#include <cstring>
 #include <d3d11_4.h>
 #include <d3d9.h>
 #include <dxva2api.h>
 #include <evr.h>
 #include <mediaobj.h>
+#include <memory>
 #include <mmdeviceapi.h>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <vector>
 #include <wmcodecdsp.h>
 
 winrt::com_ptr<IMFMediaType> make_video_type(const GUID& subtype) noexcept(false) {
@@ -44,7 +51,7 @@ bool mf_transform_info_t::output_provide_sample() const noexcept {
     return flag0 || flag1;
 }
 
-h264_decoder_t::h264_decoder_t(const GUID& clsid) noexcept(false) {
+h264_decoder_t::h264_decoder_t(const GUID& clsid, DWORD queue) noexcept(false) {
     winrt::com_ptr<IUnknown> unknown{};
     if (auto hr = CoCreateInstance(clsid, nullptr, CLSCTX_ALL, IID_PPV_ARGS(unknown.put())); FAILED(hr))
         winrt::throw_hresult(hr);
@@ -52,7 +59,7 @@ h264_decoder_t::h264_decoder_t(const GUID& clsid) noexcept(false) {
         winrt::throw_hresult(hr);
     configure_acceleration(transform.get());
     winrt::check_hresult(unknown->QueryInterface(realtime.put()));
-    winrt::check_hresult(realtime->SetWorkQueue(MFASYNC_CALLBACK_QUEUE_STANDARD));
+    winrt::check_hresult(realtime->SetWorkQueue(queue));
 }
 
 h264_decoder_t::h264_decoder_t() noexcept(false) : h264_decoder_t{CLSID_CMSH264DecoderMFT} {
@@ -65,6 +72,28 @@ bool h264_decoder_t::support(IMFMediaType* source_type) const noexcept {
     return IsEqualGUID(subtype, MFVideoFormat_H264);
 }
 
+HRESULT h264_decoder_t::configure_reorder(IMFMediaType* source_type) noexcept {
+    UINT32 blob_size = 0;
+    if (auto hr = source_type->GetBlobSize(MF_MT_MPEG_SEQUENCE_HEADER, &blob_size); FAILED(hr))
+        return hr;
+    try {
+        std::vector<uint8_t> blob(blob_size);
+        if (auto hr = source_type->GetBlob(MF_MT_MPEG_SEQUENCE_HEADER, blob.data(), blob_size, &blob_size); FAILED(hr))
+            return hr;
+        auto analyzer = std::make_unique<h264_stream_analyzer_t>(); // parameter set tables are large for the stack
+        if (auto ec = analyzer->feed_sequence_header({blob.data(), blob_size}); ec != std::errc{})
+            return MF_E_INVALIDMEDIATYPE;
+        reorder_depth = analyzer->reorder_depth();
+    } catch (const std::bad_alloc&) {
+        return E_OUTOFMEMORY;
+    }
+    winrt::com_ptr<IMFAttributes> attrs{};
+    if (auto hr = transform->GetAttributes(attrs.put()); FAILED(hr))
+        return hr;
+    spdlog::debug("{}: reorder depth {}", "h264_decoder_t", reorder_depth);
+    return attrs->SetUINT32(CODECAPI_AVLowLatencyMode, reorder_depth == 0);
+}
+
 void h264_decoder_t::configure_acceleration(IMFTransform* transform) {
     winrt::com_ptr<IMFAttributes> attrs{};
     if (auto hr = transform->GetAttributes(attrs.put()); FAILED(hr))
@@ -77,7 +106,7 @@ void h264_decoder_t::configure_acceleration(IMFTransform* transform) {
         spdlog::error("{}: {:#08x}", "CODECAPI_AVDecNumWorkerThreads", hr);
 }
 
-color_converter_t::color_converter_t(const GUID& clsid) noexcept(false) {
+color_converter_t::color_converter_t(const GUID& clsid, DWORD queue) noexcept(false) {
     winrt::com_ptr<IUnknown> unknown{};
     if (auto hr = CoCreateInstance(clsid, nullptr, CLSCTX_ALL, IID_PPV_ARGS(unknown.put())); FAILED(hr))
         winrt::throw_hresult(hr);
@@ -86,13 +115,13 @@ color_converter_t::color_converter_t(const GUID& clsid) noexcept(false) {
     winrt::check_hresult(transform->QueryInterface(props.put()));
     winrt::check_hresult(transform->QueryInterface(media_object.put()));
     winrt::check_hresult(unknown->QueryInterface(realtime.put()));
-    winrt::check_hresult(realtime->SetWorkQueue(MFASYNC_CALLBACK_QUEUE_STANDARD));
+    winrt::check_hresult(realtime->SetWorkQueue(queue));
 }
 
 color_converter_t::color_converter_t() noexcept(false) : color_converter_t{CLSID_CColorConvertDMO} {
 }
 
-sample_cropper_t::sample_cropper_t() noexcept(false) {
+sample_cropper_t::sample_cropper_t(DWORD queue) noexcept(false) {
     winrt::com_ptr<IUnknown> unknown{};
     if (auto hr = CoCreateInstance(CLSID_CResizerDMO, nullptr, CLSCTX_ALL, IID_PPV_ARGS(unknown.put())); FAILED(hr))
         winrt::throw_hresult(hr);
@@ -100,7 +129,7 @@ sample_cropper_t::sample_cropper_t() noexcept(false) {
         winrt::throw_hresult(hr);
     winrt::check_hresult(transform->QueryInterface(props0.put()));
     winrt::check_hresult(unknown->QueryInterface(realtime.put()));
-    winrt::check_hresult(realtime->SetWorkQueue(MFASYNC_CALLBACK_QUEUE_STANDARD));
+    winrt::check_hresult(realtime->SetWorkQueue(queue));
 }
 
 HRESULT sample_cropper_t::crop(IMFMediaType* type, const RECT& region) noexcept {
@@ -129,7 +158,7 @@ HRESULT sample_cropper_t::get_crop_region(RECT& src, RECT& dst) const noexcept {
                                      &dst.left, &dst.top, &dst.right, &dst.bottom);
 }
 
-sample_processor_t::sample_processor_t() noexcept(false) {
+sample_processor_t::sample_processor_t(DWORD queue) noexcept(false) {
     winrt::com_ptr<IUnknown> unknown{};
     if (auto hr = CoCreateInstance(CLSID_VideoProcessorMFT, nullptr, CLSCTX_ALL, IID_PPV_ARGS(unknown.put()));
         FAILED(hr))
@@ -138,7 +167,7 @@ sample_processor_t::sample_processor_t() noexcept(false) {
         winrt::throw_hresult(hr);
     winrt::check_hresult(transform->QueryInterface(control.put()));
     winrt::check_hresult(transform->QueryInterface(realtime.put()));
-    winrt::check_hresult(realtime->SetWorkQueueEx(MFASYNC_CALLBACK_QUEUE_STANDARD, -1));
+    winrt::check_hresult(realtime->SetWorkQueueEx(queue, -1));
 }
 
 HRESULT sample_processor_t::set_type(IMFMediaType* input, IMFMediaType* output) noexcept {
@@ -186,3 +215,632 @@ HRESULT sample_processor_t::set_mirror_rotation(MF_VIDEO_PROCESSOR_MIRROR mirror
         return hr;
     return control->SetRotation(MF_VIDEO_PROCESSOR_ROTATION::ROTATION_NORMAL);
 }
+
+HRESULT get_frame_layout(IMFMediaType* type, uint32_t alignment, frame_layout_t& layout) noexcept {
+    GUID subtype{};
+    if (auto hr = type->GetGUID(MF_MT_SUBTYPE, &subtype); FAILED(hr))
+        return hr;
+    UINT32 width = 0, height = 0;
+    if (auto hr = MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &width, &height); FAILED(hr))
+        return hr;
+    // the FourCC subtypes share the rest of `MFVideoFormat_Base`
+    GUID base = subtype;
+    base.Data1 = 0;
+    if (base != MFVideoFormat_Base)
+        return MF_E_INVALIDMEDIATYPE;
+    switch (make_frame_layout(static_cast<pixel_format_t>(subtype.Data1), width, height, alignment, layout)) {
+    case std::errc{}:
+        return S_OK;
+    case std::errc::not_supported:
+        return MF_E_INVALIDMEDIATYPE;
+    case std::errc::value_too_large:
+        return MF_E_OUT_OF_RANGE;
+    default:
+        return E_INVALIDARG;
+    }
+}
+
+static_assert(sizeof(media_guid_t) == sizeof(GUID));
+
+media_guid_t to_media_guid(const GUID& guid) noexcept {
+    media_guid_t output{};
+    std::memcpy(&output, &guid, sizeof(GUID));
+    return output;
+}
+
+GUID to_guid(const media_guid_t& guid) noexcept {
+    GUID output{};
+    std::memcpy(&output, &guid, sizeof(GUID));
+    return output;
+}
+
+namespace {
+
+/// @throws std::bad_alloc, std::invalid_argument
+void set_media_attribute(media_type_t& output, const GUID& key, const PROPVARIANT& value) noexcept(false) {
+    const media_guid_t attribute = to_media_guid(key);
+    switch (value.vt) {
+    case VT_UI4:
+        return output.set_uint32(attribute, value.ulVal);
+    case VT_UI8:
+        return output.set_uint64(attribute, value.uhVal.QuadPart);
+    case VT_R8:
+        return output.set_double(attribute, value.dblVal);
+    case VT_CLSID:
+        return output.set_guid(attribute, to_media_guid(*value.puuid));
+    case VT_LPWSTR:
+        return output.set_string(attribute, reinterpret_cast<const char16_t*>(value.pwszVal));
+    case VT_VECTOR | VT_UI1:
+        return output.set_blob(attribute, {value.caub.pElems, value.caub.cElems});
+    default:
+        return; // VT_UNKNOWN
+    }
+}
+
+HRESULT set_attribute(IMFMediaType* type, const media_attribute_t& attribute) noexcept {
+    const GUID key = to_guid(attribute.key);
+    switch (attribute.kind) {
+    case media_attribute_kind_t::uint32:
+        return type->SetUINT32(key, attribute.value.u32);
+    case media_attribute_kind_t::uint64:
+        return type->SetUINT64(key, attribute.value.u64);
+    case media_attribute_kind_t::real:
+        return type->SetDouble(key, attribute.value.real);
+    case media_attribute_kind_t::guid:
+        return type->SetGUID(key, to_guid(attribute.value.guid));
+    case media_attribute_kind_t::string: {
+        std::u16string_view text = attribute.text();
+        std::wstring value{text.begin(), text.end()}; // null-terminated
+        return type->SetString(key, value.c_str());
+    }
+    case media_attribute_kind_t::blob: {
+        gsl::span<const uint8_t> data = attribute.data();
+        return type->SetBlob(key, data.data(), static_cast<UINT32>(data.size()));
+    }
+    default:
+        return E_INVALIDARG;
+    }
+}
+
+} // namespace
+
+HRESULT get_media_type(IMFMediaType* type, media_type_t& output) noexcept {
+    output.clear();
+    UINT32 count = 0;
+    if (auto hr = type->LockStore(); FAILED(hr))
+        return hr;
+    auto on_return = gsl::finally([type]() { type->UnlockStore(); });
+    if (auto hr = type->GetCount(&count); FAILED(hr))
+        return hr;
+    for (UINT32 i = 0; i < count; ++i) {
+        GUID key{};
+        PROPVARIANT value{};
+        PropVariantInit(&value);
+        if (auto hr = type->GetItemByIndex(i, &key, &value); FAILED(hr))
+            return hr;
+        auto on_item = gsl::finally([&value]() { PropVariantClear(&value); });
+        try {
+            set_media_attribute(output, key, value); // the common keys go to the inline fields
+        } catch (const std::bad_alloc&) {
+            return E_OUTOFMEMORY;
+        } catch (const std::invalid_argument&) {
+            return MF_E_INVALIDMEDIATYPE; // for example, `MF_MT_FRAME_SIZE` which is not `VT_UI8`
+        }
+    }
+    return S_OK;
+}
+
+HRESULT make_media_type(const media_type_t& input, IMFMediaType** type) noexcept {
+    if (type == nullptr)
+        return E_POINTER;
+    winrt::com_ptr<IMFMediaType> output{};
+    if (auto hr = MFCreateMediaType(output.put()); FAILED(hr))
+        return hr;
+    uint32_t high = 0, low = 0;
+    int32_t stride = 0;
+    HRESULT hr = S_OK;
+    if (SUCCEEDED(hr) && input.has(media_field_t::major_type))
+        hr = output->SetGUID(MF_MT_MAJOR_TYPE, to_guid(input.major_type()));
+    if (SUCCEEDED(hr) && input.has(media_field_t::subtype))
+        hr = output->SetGUID(MF_MT_SUBTYPE, to_guid(input.subtype()));
+    if (SUCCEEDED(hr) && input.frame_size(high, low))
+        hr = MFSetAttributeSize(output.get(), MF_MT_FRAME_SIZE, high, low);
+    if (SUCCEEDED(hr) && input.frame_rate(high, low))
+        hr = MFSetAttributeRatio(output.get(), MF_MT_FRAME_RATE, high, low);
+    if (SUCCEEDED(hr) && input.pixel_aspect_ratio(high, low))
+        hr = MFSetAttributeRatio(output.get(), MF_MT_PIXEL_ASPECT_RATIO, high, low);
+    if (SUCCEEDED(hr) && input.default_stride(stride))
+        hr = output->SetUINT32(MF_MT_DEFAULT_STRIDE, static_cast<UINT32>(stride));
+    if (SUCCEEDED(hr) && input.interlace_mode(low))
+        hr = output->SetUINT32(MF_MT_INTERLACE_MODE, low);
+    for (const media_attribute_t& attribute : input.attributes())
+        if (SUCCEEDED(hr))
+            hr = set_attribute(output.get(), attribute);
+    if (FAILED(hr))
+        return hr;
+    *type = output.detach();
+    return S_OK;
+}
+
+namespace {
+
+constexpr trace_event_t not_accepting_event{"mf_transform_node_t", "MF_E_NOTACCEPTING"};
+constexpr trace_event_t stream_change_event{"mf_transform_node_t", "stream changed. buffer size {}"};
+constexpr trace_event_t adapter_stream_change_event{"mf_transform_adapter_t", "stream changed. buffer size {}"};
+
+std::errc to_errc(HRESULT hr) noexcept {
+    switch (hr) {
+    case E_OUTOFMEMORY:
+        return std::errc::not_enough_memory;
+    case MF_E_INVALIDMEDIATYPE:
+    case MF_E_TRANSFORM_TYPE_NOT_SET:
+        return std::errc::invalid_argument;
+    case MF_E_SAMPLEALLOCATOR_EMPTY:
+        return std::errc::resource_unavailable_try_again;
+    default:
+        return std::errc::io_error;
+    }
+}
+
+/// @brief Keep the `HRESULT` for the caller and log the failed function
+std::errc fail(HRESULT hr, const char* fname, HRESULT& last_error) noexcept {
+    last_error = hr;
+    spdlog::error("{}: {:#08x}", fname, static_cast<uint32_t>(hr));
+    return to_errc(hr);
+}
+
+/// @brief `mf_transform_node_t::pull` stopped because the downstream is canceled. This is not a failure
+const HRESULT emit_canceled = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+
+/// @brief `fail` for the result of `mf_transform_node_t::pull`
+std::errc fail_pull(HRESULT hr, HRESULT& last_error) noexcept {
+    if (hr == emit_canceled)
+        return std::errc::operation_canceled;
+    return fail(hr, "ProcessOutput", last_error);
+}
+
+/**
+ * @brief Allocate the output sample unless the transform provides it
+ * @param timeout wait for the recycled sample of the pool
+ */
+HRESULT make_transform_output(const mf_transform_info_t& info, mf_sample_pool_t* pool,
+                              winrt::com_ptr<IMFSample>& sample,
+                              std::chrono::steady_clock::duration timeout = {}) noexcept {
+    if (info.output_provide_sample())
+        return S_OK;
+    if (pool)
+        return pool->acquire(info.output_info.cbSize, sample.put(), timeout);
+    if (auto hr = MFCreateSample(sample.put()); FAILED(hr))
+        return hr;
+    winrt::com_ptr<IMFMediaBuffer> buffer{};
+    const DWORD alignment = info.output_info.cbAlignment ? info.output_info.cbAlignment - 1 : 0;
+    if (auto hr = MFCreateAlignedMemoryBuffer(info.output_info.cbSize, alignment, buffer.put()); FAILED(hr))
+        return hr;
+    return sample->AddBuffer(buffer.get());
+}
+
+/**
+ * @brief One `ProcessOutput` of the first output stream. The events are released
+ * @param sample the output buffer. If null, the transform allocates it and the sample holds the result
+ */
+HRESULT process_output(IMFTransform* transform, const mf_transform_info_t& info,
+                       winrt::com_ptr<IMFSample>& sample) noexcept {
+    MFT_OUTPUT_DATA_BUFFER buffer{};
+    buffer.dwStreamID = info.output_stream_ids[0];
+    buffer.pSample = sample.get();
+    DWORD status = 0;
+    const auto hr = transform->ProcessOutput(0, 1, &buffer, &status);
+    if (buffer.pEvents)
+        buffer.pEvents->Release();
+    if (hr == S_OK && sample == nullptr)
+        sample.attach(buffer.pSample); // the transform allocated the sample
+    return hr;
+}
+
+/// @brief `GetOutputCurrentType` of the first output stream
+HRESULT get_output_type(IMFTransform* transform, const mf_transform_info_t& info, media_type_t& output) noexcept {
+    winrt::com_ptr<IMFMediaType> current{};
+    if (auto hr = transform->GetOutputCurrentType(info.output_stream_ids[0], current.put()); FAILED(hr))
+        return hr;
+    return get_media_type(current.get(), output);
+}
+
+/**
+ * @brief For `MF_E_TRANSFORM_STREAM_CHANGE`. Select the available type with the same subtype
+ * @param output_type the current output type. It is replaced with the selected one
+ */
+HRESULT renegotiate_transform(IMFTransform* transform, mf_transform_info_t& info, media_type_t& output_type) noexcept {
+    const DWORD ostream = info.output_stream_ids[0];
+    media_type_t candidate{};
+    for (DWORD index = 0;; ++index) {
+        winrt::com_ptr<IMFMediaType> available{};
+        if (auto hr = transform->GetOutputAvailableType(ostream, index, available.put()); FAILED(hr))
+            return hr; // MF_E_NO_MORE_TYPES if no type matches
+        if (FAILED(get_media_type(available.get(), candidate)) || candidate.subtype() != output_type.subtype())
+            continue;
+        if (auto hr = transform->SetOutputType(ostream, available.get(), 0); FAILED(hr))
+            return hr;
+        break;
+    }
+    output_type = std::move(candidate);
+    // the buffer size may be changed with the type
+    return transform->GetOutputStreamInfo(ostream, &info.output_info);
+}
+
+} // namespace
+
+mf_transform_node_t::mf_transform_node_t(winrt::com_ptr<IMFTransform> transform,
+                                         winrt::com_ptr<IMFSample> output_sample) noexcept
+    : transform{std::move(transform)}, output_sample{std::move(output_sample)} {
+}
+
+mf_transform_node_t::mf_transform_node_t(winrt::com_ptr<IMFTransform> transform,
+                                         winrt::com_ptr<mf_sample_pool_t> pool) noexcept
+    : transform{std::move(transform)}, pool{std::move(pool)} {
+}
+
+std::errc mf_transform_node_t::start() noexcept {
+    try {
+        info.from(transform.get());
+    } catch (const winrt::hresult_error& ex) {
+        return fail(ex.code(), "GetOutputStreamInfo", last_error);
+    }
+    if (auto hr = get_output_type(transform.get(), info, output_type); FAILED(hr))
+        return fail(hr, "GetOutputCurrentType", last_error);
+    if (auto hr = transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL); FAILED(hr))
+        return fail(hr, "MFT_MESSAGE_NOTIFY_START_OF_STREAM", last_error);
+    if (auto hr = transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL); FAILED(hr))
+        return fail(hr, "MFT_MESSAGE_NOTIFY_BEGIN_STREAMING", last_error);
+    return std::errc{};
+}
+
+std::errc mf_transform_node_t::process(winrt::com_ptr<IMFSample> input, emitter_t& output) noexcept {
+    const DWORD istream = info.input_stream_ids[0];
+    auto hr = transform->ProcessInput(istream, input.get(), 0);
+    if (hr == MF_E_NOTACCEPTING) {
+        trace_event(not_accepting_event);
+        // the outputs must be collected before the next input
+        if (hr = pull(output); FAILED(hr))
+            return fail_pull(hr, last_error);
+        hr = transform->ProcessInput(istream, input.get(), 0);
+    }
+    if (FAILED(hr))
+        return fail(hr, "ProcessInput", last_error);
+    if (hr = pull(output); FAILED(hr))
+        return fail_pull(hr, last_error);
+    return std::errc{};
+}
+
+std::errc mf_transform_node_t::drain(emitter_t& output) noexcept {
+    if (auto hr = transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, NULL); FAILED(hr))
+        return fail(hr, "MFT_MESSAGE_NOTIFY_END_OF_STREAM", last_error);
+    if (auto hr = transform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL); FAILED(hr))
+        return fail(hr, "MFT_MESSAGE_COMMAND_DRAIN", last_error);
+    if (auto hr = pull(output); FAILED(hr))
+        return fail_pull(hr, last_error);
+    return std::errc{};
+}
+
+HRESULT mf_transform_node_t::make_output_sample(winrt::com_ptr<IMFSample>& sample) noexcept {
+    if (output_sample) {
+        sample = output_sample;
+        return S_OK;
+    }
+    return make_transform_output(info, pool.get(), sample, acquire_timeout);
+}
+
+HRESULT mf_transform_node_t::pull(emitter_t& output) noexcept {
+    while (true) {
+        winrt::com_ptr<IMFSample> sample{};
+        if (auto hr = make_output_sample(sample); FAILED(hr))
+            return hr;
+        switch (auto hr = process_output(transform.get(), info, sample)) {
+        case S_OK:
+            if (output.emit(std::move(sample)) != std::errc{})
+                return emit_canceled;
+            continue;
+        case MF_E_TRANSFORM_NEED_MORE_INPUT:
+            return S_OK;
+        case MF_E_TRANSFORM_STREAM_CHANGE:
+            if (auto result = renegotiate(); FAILED(result))
+                return result;
+            continue;
+        default:
+            return hr;
+        }
+    }
+}
+
+HRESULT mf_transform_node_t::renegotiate() noexcept {
+    ++stream_change_count;
+    if (auto hr = renegotiate_transform(transform.get(), info, output_type); FAILED(hr))
+        return hr;
+    trace_event(stream_change_event, info.output_info.cbSize);
+    return S_OK;
+}
+
+mf_transform_adapter_t::mf_transform_adapter_t(winrt::com_ptr<IMFTransform> transform,
+                                               winrt::com_ptr<mf_sample_pool_t> pool) noexcept
+    : transform{std::move(transform)}, pool{std::move(pool)} {
+}
+
+std::errc mf_transform_adapter_t::send(MFT_MESSAGE_TYPE message, const char* fname) noexcept {
+    if (auto hr = transform->ProcessMessage(message, NULL); FAILED(hr))
+        return fail(hr, fname, last_error);
+    return std::errc{};
+}
+
+std::errc mf_transform_adapter_t::on_begin_streaming() noexcept {
+    try {
+        info.from(transform.get());
+    } catch (const winrt::hresult_error& ex) {
+        return fail(ex.code(), "GetOutputStreamInfo", last_error);
+    }
+    if (auto hr = get_output_type(transform.get(), info, output_type); FAILED(hr))
+        return fail(hr, "GetOutputCurrentType", last_error);
+    return send(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, "MFT_MESSAGE_NOTIFY_BEGIN_STREAMING");
+}
+
+std::errc mf_transform_adapter_t::on_start_of_stream() noexcept {
+    return send(MFT_MESSAGE_NOTIFY_START_OF_STREAM, "MFT_MESSAGE_NOTIFY_START_OF_STREAM");
+}
+
+std::errc mf_transform_adapter_t::on_input(sample_t& input) noexcept {
+    switch (auto hr = transform->ProcessInput(info.input_stream_ids[0], input.get(), 0)) {
+    case S_OK:
+        input = nullptr; // the transform holds the reference if it needs
+        return std::errc{};
+    case MF_E_NOTACCEPTING:
+        return std::errc::resource_unavailable_try_again;
+    default:
+        return fail(hr, "ProcessInput", last_error);
+    }
+}
+
+std::errc mf_transform_adapter_t::on_output(sample_t& output) noexcept {
+    while (true) {
+        sample_t sample{};
+        if (auto hr = make_transform_output(info, pool.get(), sample); FAILED(hr))
+            return fail(hr, "make_transform_output", last_error);
+        switch (auto hr = process_output(transform.get(), info, sample)) {
+        case S_OK:
+            output = std::move(sample);
+            return std::errc{};
+        case MF_E_TRANSFORM_NEED_MORE_INPUT:
+            return std::errc::resource_unavailable_try_again;
+        case MF_E_TRANSFORM_STREAM_CHANGE:
+            ++stream_change_count;
+            if (auto result = renegotiate_transform(transform.get(), info, output_type); FAILED(result))
+                return fail(result, "SetOutputType", last_error);
+            trace_event(adapter_stream_change_event, info.output_info.cbSize);
+            continue;
+        default:
+            return fail(hr, "ProcessOutput", last_error);
+        }
+    }
+}
+
+std::errc mf_transform_adapter_t::on_end_of_stream() noexcept {
+    return send(MFT_MESSAGE_NOTIFY_END_OF_STREAM, "MFT_MESSAGE_NOTIFY_END_OF_STREAM");
+}
+
+std::errc mf_transform_adapter_t::on_drain() noexcept {
+    return send(MFT_MESSAGE_COMMAND_DRAIN, "MFT_MESSAGE_COMMAND_DRAIN");
+}
+
+std::errc mf_transform_adapter_t::on_flush() noexcept {
+    return send(MFT_MESSAGE_COMMAND_FLUSH, "MFT_MESSAGE_COMMAND_FLUSH");
+}
+
+std::errc mf_transform_adapter_t::on_end_streaming() noexcept {
+    return send(MFT_MESSAGE_NOTIFY_END_STREAMING, "MFT_MESSAGE_NOTIFY_END_STREAMING");
+}
+
+namespace {
+
+/// @brief Size class of the pool's sample. `Invoke` finds the class even if the buffer is removed
+/// {5C3F8E51-7A2D-4B1E-9F60-2D8C4A7B13E9}
+const GUID sample_class_key = {0x5c3f8e51, 0x7a2d, 0x4b1e, {0x9f, 0x60, 0x2d, 0x8c, 0x4a, 0x7b, 0x13, 0xe9}};
+
+} // namespace
+
+mf_sample_pool_t::mf_sample_pool_t(const frame_pool_config_t& config) noexcept(false)
+    : config{config}, table{config.min_size, config.max_size, config.alignment},
+      classes{std::make_unique<class_t[]>(table.size())} {
+    for (size_t i = 0; i < table.size(); ++i)
+        classes[i].free_list.reserve(std::max(config.max_count, 1u));
+}
+
+winrt::com_ptr<mf_sample_pool_t> mf_sample_pool_t::make(const frame_pool_config_t& config) noexcept(false) {
+    winrt::com_ptr<mf_sample_pool_t> pool{};
+    pool.attach(new mf_sample_pool_t{config});
+    return pool;
+}
+
+mf_sample_pool_t::~mf_sample_pool_t() noexcept {
+    // the samples in use keep the pool. every sample is in the free lists now
+    if (config.budget)
+        for (size_t i = 0; i < table.size(); ++i)
+            config.budget->release(table.capacity(i) * classes[i].count);
+}
+
+HRESULT mf_sample_pool_t::create(size_t index, winrt::com_ptr<IMFSample>& sample) noexcept {
+    const size_t capacity = table.capacity(index);
+    if (config.budget && config.budget->try_reserve(capacity) != std::errc{})
+        return MF_E_SAMPLEALLOCATOR_EMPTY;
+    winrt::com_ptr<IMFTrackedSample> tracked{};
+    winrt::com_ptr<IMFMediaBuffer> buffer{};
+    const auto alignment = static_cast<DWORD>(std::max<size_t>(config.alignment, 1) - 1);
+    HRESULT hr = MFCreateTrackedSample(tracked.put());
+    if (SUCCEEDED(hr))
+        hr = tracked->QueryInterface(sample.put());
+    if (SUCCEEDED(hr))
+        hr = MFCreateAlignedMemoryBuffer(static_cast<DWORD>(capacity), alignment, buffer.put());
+    if (SUCCEEDED(hr))
+        hr = sample->AddBuffer(buffer.get());
+    if (FAILED(hr)) {
+        sample = nullptr;
+        if (config.budget)
+            config.budget->release(capacity);
+        return hr;
+    }
+    ++allocated;
+    return S_OK;
+}
+
+HRESULT mf_sample_pool_t::acquire(DWORD size, IMFSample** output) noexcept {
+    if (output == nullptr)
+        return E_POINTER;
+    const size_t index = table.find(size);
+    if (index == table.size())
+        return E_INVALIDARG;
+    class_t& cls = classes[index];
+    winrt::com_ptr<IMFSample> sample{};
+    {
+        std::lock_guard lck{cls.mtx};
+        if (cls.count == 0) {
+            // warm up the class like `InitializeSampleAllocatorEx`
+            for (; cls.count < config.min_count; ++cls.count) {
+                winrt::com_ptr<IMFSample> spare{};
+                if (auto hr = create(index, spare); FAILED(hr)) {
+                    if (cls.count)
+                        break;
+                    if (hr == MF_E_SAMPLEALLOCATOR_EMPTY)
+                        ++exhausted;
+                    return hr;
+                }
+                cls.free_list.emplace_back(std::move(spare));
+            }
+        }
+        if (cls.free_list.empty() == false) {
+            sample = std::move(cls.free_list.back());
+            cls.free_list.pop_back();
+        } else if (cls.count < std::max(config.max_count, 1u)) {
+            if (auto hr = create(index, sample); FAILED(hr)) {
+                if (hr == MF_E_SAMPLEALLOCATOR_EMPTY)
+                    ++exhausted; // over the budget
+                return hr;
+            }
+            ++cls.count;
+        } else {
+            ++exhausted;
+            return MF_E_SAMPLEALLOCATOR_EMPTY;
+        }
+    }
+    winrt::com_ptr<IMFTrackedSample> tracked{};
+    HRESULT hr = sample->QueryInterface(tracked.put());
+    if (SUCCEEDED(hr))
+        hr = sample->SetUINT32(sample_class_key, static_cast<UINT32>(index));
+    // the allocator is cleared after each `Invoke`. set it at last, so the failed sample doesn't hold the pool
+    if (SUCCEEDED(hr))
+        hr = tracked->SetAllocator(this, nullptr);
+    if (FAILED(hr)) {
+        // the class counts the sample. put it back for the next `acquire`
+        std::lock_guard lck{cls.mtx};
+        cls.free_list.emplace_back(std::move(sample)); // reserved for `max_count`
+        return hr;
+    }
+    ++acquired;
+    ++outstanding;
+    *output = sample.detach();
+    return S_OK;
+}
+
+HRESULT mf_sample_pool_t::acquire(DWORD size, IMFSample** output,
+                                  std::chrono::steady_clock::duration timeout) noexcept {
+    const auto until = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        uint64_t count = 0;
+        {
+            std::lock_guard lck{recycle_mtx};
+            count = recycle_count;
+        }
+        if (auto hr = acquire(size, output); hr != MF_E_SAMPLEALLOCATOR_EMPTY)
+            return hr;
+        // the recycle after the `count` wakes this
+        std::unique_lock lck{recycle_mtx};
+        if (recycled.wait_until(lck, until, [this, count]() { return recycle_count != count; }) == false)
+            return MF_E_SAMPLEALLOCATOR_EMPTY;
+    }
+}
+
+frame_pool_stats_t mf_sample_pool_t::stats() const noexcept {
+    frame_pool_stats_t result{};
+    result.acquired = acquired;
+    result.allocated = allocated;
+    result.exhausted = exhausted;
+    result.outstanding = outstanding;
+    return result;
+}
+
+HRESULT mf_sample_pool_t::QueryInterface(REFIID riid, void** ppv) noexcept {
+    if (ppv == nullptr)
+        return E_POINTER;
+    *ppv = nullptr;
+    if (riid == IID_IUnknown || riid == IID_IMFAsyncCallback)
+        *ppv = static_cast<IMFAsyncCallback*>(this);
+    if (*ppv == nullptr)
+        return E_NOINTERFACE;
+    AddRef();
+    return S_OK;
+}
+
+ULONG mf_sample_pool_t::AddRef() noexcept {
+    return ++references;
+}
+
+ULONG mf_sample_pool_t::Release() noexcept {
+    const ULONG count = --references;
+    if (count == 0)
+        delete this;
+    return count;
+}
+
+HRESULT mf_sample_pool_t::GetParameters(DWORD*, DWORD*) noexcept {
+    return E_NOTIMPL;
+}
+
+HRESULT mf_sample_pool_t::Invoke(IMFAsyncResult* result) noexcept {
+    // the sample is not in use anymore, even if it can't be recycled
+    auto on_return = gsl::finally([this]() {
+        --outstanding;
+        {
+            std::lock_guard lck{recycle_mtx};
+            ++recycle_count;
+        }
+        recycled.notify_all();
+    });
+    winrt::com_ptr<IUnknown> unknown{};
+    if (auto hr = result->GetObject(unknown.put()); FAILED(hr))
+        return hr;
+    winrt::com_ptr<IMFSample> sample{};
+    if (auto hr = unknown->QueryInterface(sample.put()); FAILED(hr))
+        return hr;
+    winrt::com_ptr<IMFMediaBuffer> buffer{};
+    const HRESULT buffer_hr = sample->GetBufferByIndex(0, buffer.put());
+    UINT32 index = 0;
+    if (FAILED(sample->GetUINT32(sample_class_key, &index))) {
+        // the downstream removed the attributes. the capacity tells the class
+        DWORD capacity = 0;
+        if (FAILED(buffer_hr) || FAILED(buffer->GetMaxLength(&capacity)))
+            return MF_E_NOT_FOUND;
+        index = static_cast<UINT32>(table.find(capacity));
+    }
+    if (index >= table.size())
+        return E_UNEXPECTED; // not from this pool
+    // the attributes of the previous frame must not leak to the next
+    sample->RemoveAllAttributes();
+    sample->SetSampleFlags(0);
+    class_t& cls = classes[index];
+    std::lock_guard lck{cls.mtx};
+    if (FAILED(buffer_hr)) {
+        // the downstream removed the buffer. drop the sample, so the class can create another
+        --cls.count;
+        if (config.budget)
+            config.budget->release(table.capacity(index));
+        return buffer_hr;
+    }
+    buffer->SetCurrentLength(0);
+    cls.free_list.emplace_back(std::move(sample)); // reserved for `max_count`
+    return S_OK;
+}
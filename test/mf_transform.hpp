@@ -7,6 +7,19 @@
 
 #include <winrt/Windows.Foundation.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.hpp"
+#include "media_transform.hpp"
+#include "media_type.hpp"
+#include "planar_frame.hpp"
+#include "stage_graph.hpp"
+
 struct mf_transform_info_t final {
     DWORD num_input = 0;
     DWORD num_output = 0;
@@ -24,6 +37,27 @@ struct mf_transform_info_t final {
     [[nodiscard]] bool output_provide_sample() const noexcept;
 };
 
+/**
+ * @brief `frame_layout_t` from `MF_MT_SUBTYPE` and `MF_MT_FRAME_SIZE` of the uncompressed video type
+ * @param alignment 1 for the contiguous buffer of `MFCalculateImageSize`
+ * @return `MF_E_INVALIDMEDIATYPE` if the subtype is not one of `pixel_format_t`
+ */
+HRESULT get_frame_layout(IMFMediaType* type, uint32_t alignment, frame_layout_t& layout) noexcept;
+
+/// @brief `media_guid_t` has the same memory layout with `GUID`
+media_guid_t to_media_guid(const GUID& guid) noexcept;
+GUID to_guid(const media_guid_t& guid) noexcept;
+
+/**
+ * @brief Read every attribute of the type. The common keys go to the inline fields of `media_type_t`
+ * @return `MF_E_INVALIDMEDIATYPE` if the common key has the other type. For example, `MF_MT_SUBTYPE` of `VT_UI4`
+ * @note  `IUnknown` attributes are skipped
+ */
+HRESULT get_media_type(IMFMediaType* type, media_type_t& output) noexcept;
+
+/// @brief `MFCreateMediaType` with every field and attribute of the input
+HRESULT make_media_type(const media_type_t& input, IMFMediaType** type) noexcept;
+
 /**
  * @brief `IMFTransform` owner for `MFVideoFormat_H264`
  * @todo Support `MFVideoFormat_H264_ES`, `MFVideoFormat_H264_HDCP`
@@ -33,13 +67,22 @@ struct mf_transform_info_t final {
 struct h264_decoder_t final {
     winrt::com_ptr<IMFTransform> transform{};
     winrt::com_ptr<IMFRealTimeClient> realtime{};
+    uint32_t reorder_depth = UINT32_MAX; // number of frames to hold before the output. @see configure_reorder
 
   public:
-    explicit h264_decoder_t(const GUID& clsid) noexcept(false);
+    /// @param queue work queue for `IMFRealTimeClient`. @see MFAllocateWorkQueueEx
+    explicit h264_decoder_t(const GUID& clsid, DWORD queue = MFASYNC_CALLBACK_QUEUE_STANDARD) noexcept(false);
     h264_decoder_t() noexcept(false);
 
     [[nodiscard]] bool support(IMFMediaType* source_type) const noexcept;
 
+    /**
+     * @brief Find the reorder depth from the SPS in `MF_MT_MPEG_SEQUENCE_HEADER`.
+     *        `CODECAPI_AVLowLatencyMode` is kept only when the stream doesn't reorder frames(all-intra/P-only)
+     * @see h264_stream_analyzer_t
+     */
+    [[nodiscard]] HRESULT configure_reorder(IMFMediaType* source_type) noexcept;
+
   public:
     /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/h-264-video-decoder#transform-attributes
     static void configure_acceleration(IMFTransform* transform);
@@ -55,7 +98,7 @@ struct color_converter_t final {
     winrt::com_ptr<IMFRealTimeClient> realtime{};
 
   public:
-    explicit color_converter_t(const GUID& clsid) noexcept(false);
+    explicit color_converter_t(const GUID& clsid, DWORD queue = MFASYNC_CALLBACK_QUEUE_STANDARD) noexcept(false);
     color_converter_t() noexcept(false);
 };
 
@@ -66,7 +109,7 @@ struct sample_cropper_t final {
     winrt::com_ptr<IMFRealTimeClient> realtime{};
 
   public:
-    sample_cropper_t() noexcept(false);
+    explicit sample_cropper_t(DWORD queue = MFASYNC_CALLBACK_QUEUE_STANDARD) noexcept(false);
 
     [[nodiscard]] HRESULT crop(IMFMediaType* type, const RECT& region) noexcept;
     [[nodiscard]] HRESULT get_crop_region(RECT& src, RECT& dst) const noexcept;
@@ -79,7 +122,7 @@ struct sample_processor_t {
     winrt::com_ptr<IMFRealTimeClientEx> realtime{};
 
   public:
-    sample_processor_t() noexcept(false);
+    explicit sample_processor_t(DWORD queue = MFASYNC_CALLBACK_QUEUE_STANDARD) noexcept(false);
 
     [[nodiscard]] HRESULT set_type(IMFMediaType* input, IMFMediaType* output) noexcept;
     [[nodiscard]] HRESULT set_scale(IMFMediaType* input, uint32_t width, uint32_t height) noexcept;
@@ -88,3 +131,147 @@ struct sample_processor_t {
     [[nodiscard]] HRESULT set_mirror_rotation(MF_VIDEO_PROCESSOR_MIRROR mirror,
                                               MF_VIDEO_PROCESSOR_ROTATION rotation) noexcept;
 };
+
+/**
+ * @brief Recycling `IMFSample`s with a single memory buffer, in the size classes of `size_class_table_t`.
+ *        The samples are `IMFTrackedSample`, so they come back to the pool when the last reference is released.
+ *        After the warm-up, `acquire` doesn't call `MFCreateSample` or `MFCreateAlignedMemoryBuffer`
+ * @note  The samples in use keep the pool alive
+ * @see   frame_pool_t, IMFVideoSampleAllocatorEx
+ * @see   https://docs.microsoft.com/en-us/windows/win32/api/mfidl/nn-mfidl-imftrackedsample
+ */
+class mf_sample_pool_t final : public IMFAsyncCallback {
+    struct class_t final {
+        std::mutex mtx{};
+        std::vector<winrt::com_ptr<IMFSample>> free_list{}; // reserved for `max_count`
+        uint32_t count = 0; // created samples of the class
+    };
+
+    std::atomic<ULONG> references{1};
+    frame_pool_config_t config;
+    size_class_table_t table;
+    std::unique_ptr<class_t[]> classes;
+    std::atomic<uint64_t> acquired{0};
+    std::atomic<uint64_t> allocated{0};
+    std::atomic<uint64_t> exhausted{0};
+    std::atomic<uint32_t> outstanding{0};
+    std::mutex recycle_mtx{};
+    std::condition_variable recycled{};
+    uint64_t recycle_count = 0; // guarded by `recycle_mtx`
+
+  private:
+    explicit mf_sample_pool_t(const frame_pool_config_t& config) noexcept(false);
+    ~mf_sample_pool_t() noexcept;
+
+  public:
+    /// @throws std::bad_alloc
+    static winrt::com_ptr<mf_sample_pool_t> make(const frame_pool_config_t& config) noexcept(false);
+
+    /// @return `MF_E_SAMPLEALLOCATOR_EMPTY` if the class has `max_count` samples in use or the budget is used up.
+    ///         `E_INVALIDARG` if `size` is over `max_size`
+    HRESULT acquire(DWORD size, IMFSample** sample) noexcept;
+    /**
+     * @brief `acquire`, but wait for the recycled sample when the pool is exhausted. This is the backpressure
+     *        for the producer: it stalls until the downstream releases its samples
+     * @return `MF_E_SAMPLEALLOCATOR_EMPTY` if no sample comes back in the timeout
+     */
+    HRESULT acquire(DWORD size, IMFSample** sample, std::chrono::steady_clock::duration timeout) noexcept;
+    [[nodiscard]] frame_pool_stats_t stats() const noexcept;
+
+    HRESULT __stdcall QueryInterface(REFIID riid, void** ppv) noexcept override;
+    ULONG __stdcall AddRef() noexcept override;
+    ULONG __stdcall Release() noexcept override;
+    HRESULT __stdcall GetParameters(DWORD* flags, DWORD* queue) noexcept override;
+    /// @brief The tracked sample is released. Put it back to the free list and wake the waiting `acquire`.
+    ///        The sample without the buffer is dropped and the class can create another
+    HRESULT __stdcall Invoke(IMFAsyncResult* result) noexcept override;
+
+  private:
+    HRESULT create(size_t index, winrt::com_ptr<IMFSample>& sample) noexcept;
+};
+
+/**
+ * @brief `stage_node_t` for the synchronous `IMFTransform`.
+ *        The input/output types must be configured before `start`.
+ *        `MF_E_NOTACCEPTING` is resolved by pulling the pending outputs and
+ *        `MF_E_TRANSFORM_STREAM_CHANGE` by selecting the available type with the same subtype
+ * @see https://docs.microsoft.com/en-us/windows/win32/medfound/basic-mft-processing-model
+ * @see https://docs.microsoft.com/en-us/windows/win32/medfound/handling-stream-changes
+ */
+class mf_transform_node_t final : public stage_node_t<winrt::com_ptr<IMFSample>> {
+    using emitter_t = stage_emitter_t<winrt::com_ptr<IMFSample>>;
+
+    winrt::com_ptr<IMFTransform> transform{};
+    mf_transform_info_t info{};
+    media_type_t output_type{}; // the negotiated type. @see MF_E_TRANSFORM_STREAM_CHANGE
+    winrt::com_ptr<IMFSample> output_sample{};
+    winrt::com_ptr<mf_sample_pool_t> pool{};
+
+  public:
+    HRESULT last_error = S_OK; // the reason of the last failure
+    uint32_t stream_change_count = 0;
+    /// @brief Wait for the recycled sample when the pool is exhausted. Over it, the node fails with
+    ///        `std::errc::resource_unavailable_try_again`
+    std::chrono::steady_clock::duration acquire_timeout = std::chrono::seconds{1};
+
+  public:
+    /// @param output_sample if not null, every output is written to it. The downstream must not hold the sample
+    explicit mf_transform_node_t(winrt::com_ptr<IMFTransform> transform,
+                                 winrt::com_ptr<IMFSample> output_sample = nullptr) noexcept;
+    /// @param pool the outputs are acquired from it and recycled when the downstream releases them.
+    ///             When it is exhausted, the node waits for the downstream like the full queue of `stage_graph_t`
+    mf_transform_node_t(winrt::com_ptr<IMFTransform> transform, winrt::com_ptr<mf_sample_pool_t> pool) noexcept;
+
+    /// @brief `MFT_MESSAGE_NOTIFY_START_OF_STREAM`, `MFT_MESSAGE_NOTIFY_BEGIN_STREAMING`
+    std::errc start() noexcept override;
+    /// @return `std::errc::operation_canceled` if the downstream is canceled. `last_error` is not changed
+    std::errc process(winrt::com_ptr<IMFSample> input, emitter_t& output) noexcept override;
+    /// @brief `MFT_MESSAGE_NOTIFY_END_OF_STREAM`, `MFT_MESSAGE_COMMAND_DRAIN` and the leftovers
+    std::errc drain(emitter_t& output) noexcept override;
+
+  private:
+    /// @brief `ProcessOutput` until `MF_E_TRANSFORM_NEED_MORE_INPUT`
+    /// @return `HRESULT_FROM_WIN32(ERROR_CANCELLED)` if the downstream is canceled
+    HRESULT pull(emitter_t& output) noexcept;
+    HRESULT renegotiate() noexcept;
+    HRESULT make_output_sample(winrt::com_ptr<IMFSample>& sample) noexcept;
+};
+
+/**
+ * @brief `media_transform_t` over the synchronous `IMFTransform`.
+ *        The messages reach the MFT only after the state check.
+ *        The input/output types must be configured before `begin_streaming`
+ * @see   transform_node_t
+ */
+class mf_transform_adapter_t final : public media_transform_t<winrt::com_ptr<IMFSample>> {
+    using sample_t = winrt::com_ptr<IMFSample>;
+
+    winrt::com_ptr<IMFTransform> transform{};
+    mf_transform_info_t info{};
+    media_type_t output_type{}; // the negotiated type. @see MF_E_TRANSFORM_STREAM_CHANGE
+    winrt::com_ptr<mf_sample_pool_t> pool{};
+
+  public:
+    HRESULT last_error = S_OK; // the reason of the last failure
+    uint32_t stream_change_count = 0;
+
+  public:
+    /// @param pool if not null, the outputs are acquired from it
+    explicit mf_transform_adapter_t(winrt::com_ptr<IMFTransform> transform,
+                                    winrt::com_ptr<mf_sample_pool_t> pool = nullptr) noexcept;
+
+  protected:
+    /// @brief Read the stream info and `MFT_MESSAGE_NOTIFY_BEGIN_STREAMING`
+    std::errc on_begin_streaming() noexcept override;
+    std::errc on_start_of_stream() noexcept override;
+    std::errc on_input(sample_t& input) noexcept override;
+    /// @note `MF_E_TRANSFORM_STREAM_CHANGE` is resolved inside
+    std::errc on_output(sample_t& output) noexcept override;
+    std::errc on_end_of_stream() noexcept override;
+    std::errc on_drain() noexcept override;
+    std::errc on_flush() noexcept override;
+    std::errc on_end_streaming() noexcept override;
+
+  private:
+    std::errc send(MFT_MESSAGE_TYPE message, const char* fname) noexcept;
+};
@@ -0,0 +1,245 @@
+#include "mp4_box.hpp"
+
+#include <cerrno>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool box_reader_t::skip(size_t count) noexcept {
+    if (remain.size() < count)
+        return valid = false;
+    remain = remain.subspan(count);
+    return true;
+}
+
+uint16_t box_reader_t::u16() noexcept {
+    if (remain.size() < 2) {
+        valid = false;
+        return 0;
+    }
+    const auto value = static_cast<uint16_t>((remain[0] << 8) | remain[1]);
+    remain = remain.subspan(2);
+    return value;
+}
+
+uint32_t box_reader_t::u32() noexcept {
+    if (remain.size() < 4) {
+        valid = false;
+        return 0;
+    }
+    const uint32_t value = load_be32(remain.data());
+    remain = remain.subspan(4);
+    return value;
+}
+
+uint64_t box_reader_t::u64() noexcept {
+    const uint64_t high = u32();
+    return (high << 32) | u32();
+}
+
+bool next_box(gsl::span<const uint8_t>& remain, box_view_t& box) noexcept {
+    if (remain.size() < 8)
+        return false;
+    uint64_t size = load_be32(remain.data());
+    box.type = load_be32(remain.data() + 4);
+    size_t header = 8;
+    if (size == 1) {
+        if (remain.size() < 16)
+            return false;
+        size = load_be64(remain.data() + 8);
+        header = 16;
+    } else if (size == 0) {
+        size = remain.size(); // to the end of the parent
+    }
+    if (size < header || size > remain.size())
+        return false;
+    box.payload = remain.subspan(header, static_cast<size_t>(size) - header);
+    remain = remain.subspan(static_cast<size_t>(size));
+    return true;
+}
+
+bool next_box(gsl::span<const uint8_t>& remain, uint32_t type, box_view_t& box) noexcept {
+    while (next_box(remain, box))
+        if (box.type == type)
+            return true;
+    return false;
+}
+
+bool find_box(gsl::span<const uint8_t> parent, uint32_t type, box_view_t& box) noexcept {
+    return next_box(parent, type, box);
+}
+
+mapped_file_t::~mapped_file_t() noexcept {
+    close();
+}
+
+#if defined(_WIN32)
+std::errc mapped_file_t::open(const std::filesystem::path& path) noexcept {
+    close();
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return GetLastError() == ERROR_FILE_NOT_FOUND ? std::errc::no_such_file_or_directory
+                                                      : std::errc::permission_denied;
+    auto on_return = gsl::finally([file]() { CloseHandle(file); });
+    LARGE_INTEGER size{};
+    if (GetFileSizeEx(file, &size) == FALSE)
+        return std::errc::io_error;
+    if (static_cast<uint64_t>(size.QuadPart) > SIZE_MAX)
+        return std::errc::file_too_large;
+    if (size.QuadPart == 0)
+        return std::errc{}; // can't map the empty file
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+        return std::errc::not_enough_memory;
+    base = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (base == nullptr) {
+        close();
+        return std::errc::not_enough_memory;
+    }
+    length = static_cast<size_t>(size.QuadPart);
+    return std::errc{};
+}
+
+void mapped_file_t::close() noexcept {
+    if (base)
+        UnmapViewOfFile(base);
+    if (mapping)
+        CloseHandle(mapping);
+    base = nullptr;
+    mapping = nullptr;
+    length = 0;
+}
+#else
+std::errc mapped_file_t::open(const std::filesystem::path& path) noexcept {
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return static_cast<std::errc>(errno);
+    auto on_return = gsl::finally([fd]() { ::close(fd); });
+    struct stat status {};
+    if (fstat(fd, &status) < 0)
+        return static_cast<std::errc>(errno);
+    if (S_ISREG(status.st_mode) == false)
+        return std::errc::invalid_argument;
+    if (status.st_size == 0)
+        return std::errc{}; // can't map the empty file
+    void* ptr = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED)
+        return static_cast<std::errc>(errno);
+    base = static_cast<const uint8_t*>(ptr);
+    length = static_cast<size_t>(status.st_size);
+    return std::errc{};
+}
+
+void mapped_file_t::close() noexcept {
+    if (base)
+        munmap(const_cast<uint8_t*>(base), length);
+    base = nullptr;
+    length = 0;
+}
+#endif
+
+bool get_children_offset(uint32_t type, size_t& offset) noexcept {
+    switch (type) {
+    case 0: // root
+    case make_fourcc("moov"):
+    case make_fourcc("trak"):
+    case make_fourcc("edts"):
+    case make_fourcc("mdia"):
+    case make_fourcc("minf"):
+    case make_fourcc("dinf"):
+    case make_fourcc("stbl"):
+    case make_fourcc("mvex"):
+    case make_fourcc("moof"):
+    case make_fourcc("traf"):
+    case make_fourcc("mfra"):
+    case make_fourcc("udta"):
+    case make_fourcc("sinf"):
+    case make_fourcc("schi"):
+        offset = 0;
+        return true;
+    case make_fourcc("meta"): // FullBox
+        offset = 4;
+        return true;
+    case make_fourcc("stsd"): // FullBox + entry_count
+    case make_fourcc("dref"):
+        offset = 8;
+        return true;
+    case make_fourcc("avc1"): // VisualSampleEntry
+    case make_fourcc("avc3"):
+    case make_fourcc("hvc1"):
+    case make_fourcc("hev1"):
+    case make_fourcc("encv"):
+        offset = 78;
+        return true;
+    case make_fourcc("mp4a"): // AudioSampleEntry
+    case make_fourcc("enca"):
+        offset = 28;
+        return true;
+    default:
+        return false;
+    }
+}
+
+mp4_box_t::mp4_box_t(gsl::span<const uint8_t> file) noexcept : box_payload{file} {
+}
+
+mp4_box_t::mp4_box_t(uint32_t type, uint64_t offset, size_t header_size, gsl::span<const uint8_t> payload) noexcept
+    : box_type{type}, box_offset{offset}, header_size{header_size}, box_payload{payload} {
+}
+
+std::errc mp4_box_t::children(mp4_box_cursor_t& cursor) const noexcept {
+    size_t skip = 0;
+    if (get_children_offset(box_type, skip) == false)
+        return std::errc::not_supported;
+    if (skip > box_payload.size())
+        return std::errc::protocol_error;
+    cursor = mp4_box_cursor_t{box_payload.subspan(skip), box_offset + header_size + skip};
+    return std::errc{};
+}
+
+std::errc mp4_box_t::find(uint32_t type, mp4_box_t& child) const noexcept {
+    mp4_box_cursor_t cursor{};
+    if (auto ec = children(cursor); ec != std::errc{})
+        return ec;
+    while (true) {
+        if (auto ec = cursor.next(child); ec != std::errc{})
+            return ec;
+        if (child.type() == type)
+            return std::errc{};
+    }
+}
+
+std::errc mp4_box_t::find(std::initializer_list<uint32_t> path, mp4_box_t& box) const noexcept {
+    box = *this;
+    for (uint32_t type : path)
+        if (auto ec = mp4_box_t{box}.find(type, box); ec != std::errc{})
+            return ec;
+    return std::errc{};
+}
+
+mp4_box_cursor_t::mp4_box_cursor_t(gsl::span<const uint8_t> boxes, uint64_t offset) noexcept
+    : remain{boxes}, offset{offset} {
+}
+
+std::errc mp4_box_cursor_t::next(mp4_box_t& box) noexcept {
+    if (remain.empty())
+        return std::errc::no_message_available;
+    const uint8_t* header = remain.data();
+    const size_t available = remain.size();
+    box_view_t view{};
+    if (next_box(remain, view) == false) {
+        remain = {}; // stop at the broken box
+        return std::errc::protocol_error;
+    }
+    const auto header_size = static_cast<size_t>(view.payload.data() - header);
+    box = mp4_box_t{view.type, offset, header_size, view.payload};
+    offset += available - remain.size();
+    return std::errc{};
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <gsl/gsl>
+#include <initializer_list>
+#include <system_error>
+
+/// @see ISO/IEC 14496-12 4.2 Object Structure
+constexpr uint32_t make_fourcc(const char (&type)[5]) noexcept {
+    return (static_cast<uint32_t>(type[0]) << 24) | (static_cast<uint32_t>(type[1]) << 16) |
+           (static_cast<uint32_t>(type[2]) << 8) | static_cast<uint32_t>(type[3]);
+}
+
+inline uint32_t load_be32(const uint8_t* ptr) noexcept {
+    return (static_cast<uint32_t>(ptr[0]) << 24) | (static_cast<uint32_t>(ptr[1]) << 16) |
+           (static_cast<uint32_t>(ptr[2]) << 8) | ptr[3];
+}
+
+inline uint64_t load_be64(const uint8_t* ptr) noexcept {
+    return (static_cast<uint64_t>(load_be32(ptr)) << 32) | load_be32(ptr + 4);
+}
+
+/// @brief Sequential reader of the box payload. Reading after the end returns 0 and leaves `valid` false
+class box_reader_t final {
+    gsl::span<const uint8_t> remain;
+
+  public:
+    bool valid = true;
+
+  public:
+    explicit box_reader_t(gsl::span<const uint8_t> payload) noexcept : remain{payload} {
+    }
+
+    bool skip(size_t count) noexcept;
+    uint16_t u16() noexcept;
+    uint32_t u32() noexcept;
+    uint64_t u64() noexcept;
+
+    [[nodiscard]] size_t size() const noexcept {
+        return remain.size();
+    }
+};
+
+/// @brief Box in the memory. `payload` excludes the header(size, type, largesize)
+struct box_view_t final {
+    uint32_t type = 0;
+    gsl::span<const uint8_t> payload{};
+};
+
+/// @brief Take the next box from `remain`. `false` at the end or when the box exceeds `remain`
+bool next_box(gsl::span<const uint8_t>& remain, box_view_t& box) noexcept;
+
+/// @brief Take the next box with the type from `remain`
+bool next_box(gsl::span<const uint8_t>& remain, uint32_t type, box_view_t& box) noexcept;
+
+/// @brief Find the first child box with the type
+bool find_box(gsl::span<const uint8_t> parent, uint32_t type, box_view_t& box) noexcept;
+
+/// @brief Read-only memory mapping of the whole file
+class mapped_file_t final {
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+#if defined(_WIN32)
+    void* mapping = nullptr; // HANDLE of the file mapping object
+#endif
+
+  public:
+    mapped_file_t() noexcept = default;
+    ~mapped_file_t() noexcept;
+    mapped_file_t(const mapped_file_t&) = delete;
+    mapped_file_t(mapped_file_t&&) = delete;
+    mapped_file_t& operator=(const mapped_file_t&) = delete;
+    mapped_file_t& operator=(mapped_file_t&&) = delete;
+
+    std::errc open(const std::filesystem::path& path) noexcept;
+    void close() noexcept;
+
+    [[nodiscard]] gsl::span<const uint8_t> bytes() const noexcept {
+        return {base, length};
+    }
+};
+
+class mp4_box_cursor_t;
+
+/**
+ * @brief Box in the memory(usually `mapped_file_t`). The child boxes are parsed only when they are visited.
+ *        Every box is validated against its parent, so the payload never exceeds the memory.
+ *        No allocation is made by the tree.
+ * @note  Recursive walk must bound the depth. Each level costs only 8 bytes of the input
+ */
+class mp4_box_t final {
+    uint32_t box_type = 0;
+    uint64_t box_offset = 0; // offset of the header from the start of the file
+    size_t header_size = 0;
+    gsl::span<const uint8_t> box_payload{};
+
+  public:
+    mp4_box_t() noexcept = default;
+    /// @brief The root. Top-level boxes are the children of it
+    explicit mp4_box_t(gsl::span<const uint8_t> file) noexcept;
+    mp4_box_t(uint32_t type, uint64_t offset, size_t header_size, gsl::span<const uint8_t> payload) noexcept;
+
+    /// @return 0 for the root
+    [[nodiscard]] uint32_t type() const noexcept {
+        return box_type;
+    }
+    [[nodiscard]] uint64_t offset() const noexcept {
+        return box_offset;
+    }
+    [[nodiscard]] uint64_t size() const noexcept {
+        return header_size + box_payload.size();
+    }
+    [[nodiscard]] gsl::span<const uint8_t> payload() const noexcept {
+        return box_payload;
+    }
+    [[nodiscard]] box_reader_t reader() const noexcept {
+        return box_reader_t{box_payload};
+    }
+
+    /// @return `std::errc::not_supported` if the type is not known as a container
+    std::errc children(mp4_box_cursor_t& cursor) const noexcept;
+    /// @return `std::errc::no_message_available` if there is no such child
+    std::errc find(uint32_t type, mp4_box_t& child) const noexcept;
+    /// @brief Follow the path of the box types. For example, `moov`/`trak`/`mdia`
+    std::errc find(std::initializer_list<uint32_t> path, mp4_box_t& box) const noexcept;
+};
+
+/// @brief Iterate the boxes in the payload of the parent
+class mp4_box_cursor_t final {
+    gsl::span<const uint8_t> remain{};
+    uint64_t offset = 0; // offset of `remain` from the start of the file
+
+  public:
+    mp4_box_cursor_t() noexcept = default;
+    mp4_box_cursor_t(gsl::span<const uint8_t> boxes, uint64_t offset) noexcept;
+
+    /// @return `std::errc::no_message_available` at the end,
+    ///         `std::errc::protocol_error` if the next box exceeds the parent
+    std::errc next(mp4_box_t& box) noexcept;
+};
+
+/// @brief Size of the fields before the child boxes in the payload of the container
+/// @return false if the type is not known as a container
+bool get_children_offset(uint32_t type, size_t& offset) noexcept;
@@ -0,0 +1,122 @@
+#include "page_arena.hpp"
+
+#include <new>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+size_t align_up(size_t value, size_t alignment) noexcept {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/// @brief Write a byte in each page. The reads may map the shared zero page and fault again at the first write
+void touch_pages(uint8_t* base, size_t length, size_t step) noexcept {
+    for (size_t offset = 0; offset < length; offset += step)
+        static_cast<volatile uint8_t*>(base)[offset] = 0;
+}
+
+} // namespace
+
+#if defined(_WIN32)
+page_arena_t::page_arena_t(size_t capacity, bool huge_pages, bool prefault) noexcept(false) {
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    const size_t large_page = GetLargePageMinimum();
+    if (huge_pages && large_page) {
+        // the large pages are always resident. no need to touch them
+        const size_t size = align_up(capacity, large_page);
+        base = static_cast<uint8_t*>(
+            VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+        if (base) {
+            length = size;
+            granularity = large_page;
+            pages = page_kind_t::huge;
+            return;
+        }
+    }
+    const size_t size = align_up(capacity, info.dwPageSize);
+    base = static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (base == nullptr)
+        throw std::bad_alloc{};
+    length = size;
+    granularity = info.dwPageSize;
+    if (prefault)
+        touch_pages(base, length, granularity);
+}
+
+page_arena_t::~page_arena_t() noexcept {
+    VirtualFree(base, 0, MEM_RELEASE);
+}
+#else
+page_arena_t::page_arena_t(size_t capacity, bool huge_pages, bool prefault) noexcept(false) {
+    constexpr size_t huge_page = 2 << 20;
+    const auto normal_page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#if defined(MAP_HUGETLB)
+    if (huge_pages) {
+        // the pages are reserved by `mmap`. `MAP_POPULATE` doesn't fail after that
+        const size_t size = align_up(capacity, huge_page);
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (prefault ? MAP_POPULATE : 0);
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (ptr != MAP_FAILED) {
+            base = static_cast<uint8_t*>(ptr);
+            length = size;
+            granularity = huge_page;
+            pages = page_kind_t::huge;
+            return;
+        }
+    }
+#endif
+    // with the huge page alignment, the transparent huge pages can back the whole range
+    const size_t alignment = huge_pages ? huge_page : normal_page;
+    const size_t size = align_up(capacity, alignment);
+    void* ptr = mmap(nullptr, size + alignment - normal_page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (ptr == MAP_FAILED)
+        throw std::bad_alloc{};
+    auto* start = static_cast<uint8_t*>(ptr);
+    auto* aligned = reinterpret_cast<uint8_t*>(align_up(reinterpret_cast<uintptr_t>(start), alignment));
+    auto* end = start + size + alignment - normal_page;
+    if (aligned != start)
+        munmap(start, static_cast<size_t>(aligned - start));
+    if (aligned + size != end)
+        munmap(aligned + size, static_cast<size_t>(end - aligned - size));
+    base = aligned;
+    length = size;
+    granularity = normal_page;
+#if defined(MADV_HUGEPAGE)
+    if (huge_pages && madvise(base, length, MADV_HUGEPAGE) == 0) {
+        granularity = huge_page;
+        pages = page_kind_t::transparent_huge;
+    }
+#endif
+    if (prefault)
+        touch_pages(base, length, normal_page);
+}
+
+page_arena_t::~page_arena_t() noexcept {
+    munmap(base, length);
+}
+#endif
+
+void* page_arena_t::allocate(size_t size, size_t alignment) noexcept {
+    const auto origin = reinterpret_cast<uintptr_t>(base);
+    size_t current = used.load(std::memory_order_relaxed);
+    while (true) {
+        const size_t offset = align_up(origin + current, alignment) - origin;
+        if (offset > length || length - offset < size)
+            return nullptr;
+        if (used.compare_exchange_weak(current, offset + size, std::memory_order_relaxed))
+            return base + offset;
+    }
+}
+
+bool page_arena_t::contains(const void* ptr) const noexcept {
+    const auto address = reinterpret_cast<uintptr_t>(ptr);
+    const auto origin = reinterpret_cast<uintptr_t>(base);
+    return address >= origin && address - origin < length;
+}
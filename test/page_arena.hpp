@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum class page_kind_t : uint8_t {
+    normal = 0,
+    transparent_huge = 1, // `madvise(MADV_HUGEPAGE)`. The kernel may promote the pages later
+    huge = 2,             // `MAP_HUGETLB` or `MEM_LARGE_PAGES`
+};
+
+/**
+ * @brief Bump allocator over one large mapping. The memory is released only with the arena.
+ *        Tries the huge pages(usually 2MB) first so the large frames need fewer TLB entries,
+ *        then falls back to the normal pages.
+ * @note  `MEM_LARGE_PAGES` requires `SeLockMemoryPrivilege`. `MAP_HUGETLB` requires the reserved pages of
+ *        `/proc/sys/vm/nr_hugepages`. Without them the arena silently uses the normal pages
+ * @see   https://docs.microsoft.com/en-us/windows/win32/memory/large-page-support
+ * @see   https://www.kernel.org/doc/html/latest/admin-guide/mm/hugetlbpage.html
+ */
+class page_arena_t final {
+    uint8_t* base = nullptr;
+    size_t length = 0;
+    std::atomic<size_t> used{0};
+    size_t granularity = 0;
+    page_kind_t pages = page_kind_t::normal;
+
+  public:
+    /**
+     * @param capacity rounded up to the page size
+     * @param huge_pages try the huge pages first
+     * @param prefault touch every page now, so the first frames don't pay the page faults
+     * @throws std::bad_alloc if no mapping is available
+     */
+    page_arena_t(size_t capacity, bool huge_pages, bool prefault) noexcept(false);
+    ~page_arena_t() noexcept;
+    page_arena_t(const page_arena_t&) = delete;
+    page_arena_t(page_arena_t&&) = delete;
+    page_arena_t& operator=(const page_arena_t&) = delete;
+    page_arena_t& operator=(page_arena_t&&) = delete;
+
+    /// @param alignment power of 2
+    /// @return `nullptr` if the arena doesn't have enough space
+    [[nodiscard]] void* allocate(size_t size, size_t alignment) noexcept;
+    [[nodiscard]] bool contains(const void* ptr) const noexcept;
+
+    [[nodiscard]] page_kind_t kind() const noexcept {
+        return pages;
+    }
+    [[nodiscard]] size_t page_size() const noexcept {
+        return granularity;
+    }
+    [[nodiscard]] size_t capacity() const noexcept {
+        return length;
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return used.load(std::memory_order_relaxed);
+    }
+};
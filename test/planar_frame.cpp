@@ -0,0 +1,163 @@
+#include "planar_frame.hpp"
+
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint64_t cache_set_stride = 4096;
+
+struct plane_shape_t final {
+    uint64_t width = 0; // bytes
+    uint32_t samples = 0;
+    uint32_t height = 0;
+    uint32_t row_alignment = 1; // minimum alignment of the stride
+};
+
+uint32_t half(uint32_t value) noexcept {
+    return value / 2 + value % 2;
+}
+
+uint32_t quarter(uint32_t value) noexcept {
+    return value / 4 + (value % 4 != 0);
+}
+
+/// @return the number of the planes. 0 if the format is unknown
+uint32_t describe(pixel_format_t format, uint32_t w, uint32_t h, plane_shape_t (&planes)[3]) noexcept {
+    switch (format) {
+    case pixel_format_t::nv12:
+        planes[0] = {w, w, h};
+        planes[1] = {uint64_t{half(w)} * 2, half(w), half(h)}; // interleaved U/V
+        return 2;
+    case pixel_format_t::p010:
+    case pixel_format_t::p016:
+        planes[0] = {uint64_t{w} * 2, w, h};
+        planes[1] = {uint64_t{half(w)} * 4, half(w), half(h)};
+        return 2;
+    case pixel_format_t::p210:
+    case pixel_format_t::p216:
+        planes[0] = {uint64_t{w} * 2, w, h};
+        planes[1] = {uint64_t{half(w)} * 4, half(w), h};
+        return 2;
+    case pixel_format_t::nv11:
+        planes[0] = {w, w, h};
+        planes[1] = {uint64_t{quarter(w)} * 2, quarter(w), h};
+        return 2;
+    case pixel_format_t::i420:
+    case pixel_format_t::iyuv:
+    case pixel_format_t::yv12: // V plane before U plane
+        planes[0] = {w, w, h};
+        planes[1] = {half(w), half(w), half(h)};
+        planes[2] = planes[1];
+        return 3;
+    case pixel_format_t::yuy2:
+    case pixel_format_t::uyvy:
+    case pixel_format_t::yvyu:
+        planes[0] = {uint64_t{half(w)} * 4, w, h}; // 2 pixels in a macropixel
+        return 1;
+    case pixel_format_t::y210:
+    case pixel_format_t::y216:
+        planes[0] = {uint64_t{half(w)} * 8, w, h};
+        return 1;
+    case pixel_format_t::ayuv:
+    case pixel_format_t::y410:
+    case pixel_format_t::v410:
+    case pixel_format_t::rgb32:
+    case pixel_format_t::argb32:
+        planes[0] = {uint64_t{w} * 4, w, h};
+        return 1;
+    case pixel_format_t::y416:
+        planes[0] = {uint64_t{w} * 8, w, h};
+        return 1;
+    // the rows of DIB are aligned to DWORD. @see MFGetStrideForBitmapInfoHeader
+    case pixel_format_t::rgb24:
+        planes[0] = {uint64_t{w} * 3, w, h, 4};
+        return 1;
+    case pixel_format_t::rgb565:
+    case pixel_format_t::rgb555:
+        planes[0] = {uint64_t{w} * 2, w, h, 4};
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+uint64_t align_up(uint64_t value, uint64_t alignment) noexcept {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+std::errc make_frame_layout(pixel_format_t format, uint32_t width, uint32_t height, uint32_t alignment,
+                            frame_layout_t& layout) noexcept {
+    if (width == 0 || height == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return std::errc::invalid_argument;
+    plane_shape_t shapes[3]{};
+    const uint32_t count = describe(format, width, height, shapes);
+    if (count == 0)
+        return std::errc::not_supported;
+    frame_layout_t result{};
+    result.format = format;
+    result.width = width;
+    result.height = height;
+    result.plane_count = count;
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t row_alignment = alignment > shapes[i].row_alignment ? alignment : shapes[i].row_alignment;
+        uint64_t stride = align_up(shapes[i].width, row_alignment);
+        if (alignment > 1 && stride % cache_set_stride == 0)
+            stride += row_alignment;
+        if (stride > UINT32_MAX)
+            return std::errc::value_too_large;
+        plane_layout_t& plane = result.planes[i];
+        plane.offset = static_cast<size_t>(align_up(offset, alignment));
+        plane.width = static_cast<uint32_t>(shapes[i].width);
+        plane.height = shapes[i].height;
+        plane.stride = static_cast<uint32_t>(stride);
+        plane.samples = shapes[i].samples;
+        offset = plane.offset + stride * plane.height;
+    }
+    if (offset > SIZE_MAX)
+        return std::errc::value_too_large;
+    result.size = static_cast<size_t>(offset);
+    layout = result;
+    return std::errc{};
+}
+
+void planar_frame_t::aligned_delete_t::operator()(uint8_t* ptr) const noexcept {
+    ::operator delete(ptr, std::align_val_t{alignment});
+}
+
+planar_frame_t::planar_frame_t(const frame_layout_t& layout, uint32_t alignment) noexcept(false)
+    : frame_layout{layout} {
+    if (layout.size == 0 || layout.plane_count == 0)
+        throw std::invalid_argument{"empty frame layout"};
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        throw std::invalid_argument{"alignment must be power of 2"};
+    owned = std::unique_ptr<uint8_t[], aligned_delete_t>{
+        static_cast<uint8_t*>(::operator new(layout.size, std::align_val_t{alignment})), aligned_delete_t{alignment}};
+    base = owned.get();
+}
+
+planar_frame_t::planar_frame_t(const frame_layout_t& layout, frame_buffer_t buffer) noexcept(false)
+    : frame_layout{layout}, pooled{std::move(buffer)} {
+    if (layout.size == 0 || layout.plane_count == 0)
+        throw std::invalid_argument{"empty frame layout"};
+    if (pooled.capacity() < layout.size)
+        throw std::invalid_argument{"frame buffer is smaller than the layout"};
+    base = pooled.data();
+}
+
+plane_view_t<uint8_t> planar_frame_t::plane(uint32_t index) noexcept {
+    if (base == nullptr || index >= frame_layout.plane_count)
+        return {};
+    const plane_layout_t& p = frame_layout.planes[index];
+    return plane_view_t<uint8_t>{base + p.offset, p.width, p.height, p.stride};
+}
+
+plane_view_t<const uint8_t> planar_frame_t::plane(uint32_t index) const noexcept {
+    if (base == nullptr || index >= frame_layout.plane_count)
+        return {};
+    const plane_layout_t& p = frame_layout.planes[index];
+    return plane_view_t<const uint8_t>{base + p.offset, p.width, p.height, p.stride};
+}
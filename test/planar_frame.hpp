@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <system_error>
+
+#include "frame_pool.hpp"
+
+/// @brief Little-endian FourCC like `MAKEFOURCC`. The `Data1` of the `MFVideoFormat_*` subtypes
+constexpr uint32_t make_pixel_fourcc(const char (&code)[5]) noexcept {
+    return static_cast<uint32_t>(code[0]) | (static_cast<uint32_t>(code[1]) << 8) |
+           (static_cast<uint32_t>(code[2]) << 16) | (static_cast<uint32_t>(code[3]) << 24);
+}
+
+/// @brief Uncompressed formats with the same value of the `MFVideoFormat_*`'s `Data1`
+/// @see https://docs.microsoft.com/en-us/windows/win32/medfound/video-subtype-guids
+enum class pixel_format_t : uint32_t {
+    unknown = 0,
+    rgb24 = 20, // D3DFMT_R8G8B8
+    argb32 = 21,
+    rgb32 = 22,
+    rgb565 = 23,
+    rgb555 = 24,
+    nv12 = make_pixel_fourcc("NV12"),
+    nv11 = make_pixel_fourcc("NV11"),
+    i420 = make_pixel_fourcc("I420"),
+    iyuv = make_pixel_fourcc("IYUV"),
+    yv12 = make_pixel_fourcc("YV12"),
+    p010 = make_pixel_fourcc("P010"),
+    p016 = make_pixel_fourcc("P016"),
+    p210 = make_pixel_fourcc("P210"),
+    p216 = make_pixel_fourcc("P216"),
+    yuy2 = make_pixel_fourcc("YUY2"),
+    uyvy = make_pixel_fourcc("UYVY"),
+    yvyu = make_pixel_fourcc("YVYU"),
+    ayuv = make_pixel_fourcc("AYUV"),
+    y210 = make_pixel_fourcc("Y210"),
+    y216 = make_pixel_fourcc("Y216"),
+    y410 = make_pixel_fourcc("Y410"),
+    y416 = make_pixel_fourcc("Y416"),
+    v410 = make_pixel_fourcc("v410"),
+};
+
+struct plane_layout_t final {
+    size_t offset = 0;    // from the start of the frame
+    uint32_t width = 0;   // bytes of the pixels in a row
+    uint32_t height = 0;  // rows
+    uint32_t stride = 0;  // bytes between the rows. `width` and the padding
+    uint32_t samples = 0; // pixels(or the chroma samples) in a row
+};
+
+/**
+ * @brief Planes of the frame. The planes are in the memory order. For the chroma planes of 4:2:0, the odd width
+ *        and height are rounded up. The rows are top-down
+ * @see   IMF2DBuffer2::Lock2DSize, MF_MT_DEFAULT_STRIDE
+ */
+struct frame_layout_t final {
+    pixel_format_t format = pixel_format_t::unknown;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t plane_count = 0;
+    plane_layout_t planes[3]{};
+    size_t size = 0; // including the padding of the last row
+};
+
+/**
+ * @param alignment of the strides and the planes. 1 for the contiguous layout of `MFCalculateImageSize`.
+ *        The RGB strides are multiple of 4 bytes regardless of it, like `MFGetStrideForBitmapInfoHeader`.
+ *        If larger than 1, the strides of the multiple of 4096 are padded with one more `alignment`.
+ *        Such strides put the rows in the same cache sets and the vertical filters evict their own lines
+ * @return `std::errc::not_supported` for the unknown format. `std::errc::invalid_argument` for the empty frame
+ *         or the alignment which is not power of 2
+ */
+std::errc make_frame_layout(pixel_format_t format, uint32_t width, uint32_t height, uint32_t alignment,
+                            frame_layout_t& layout) noexcept;
+
+template <typename T>
+struct plane_view_t final {
+    T* data = nullptr;
+    uint32_t width = 0; // bytes
+    uint32_t height = 0;
+    uint32_t stride = 0;
+
+  public:
+    [[nodiscard]] T* row(uint32_t y) const noexcept {
+        return data + static_cast<size_t>(y) * stride;
+    }
+};
+
+/**
+ * @brief Owning frame with the aligned planes. The planes start at the `alignment` and the strides are padded,
+ *        so the SIMD kernels can use the aligned loads over the whole stride without touching outside the frame.
+ * @note  With `frame_buffer_t`, the memory comes from `frame_pool_t` and goes back when the frame is destroyed.
+ *        The pool's `alignment` must be the same or larger
+ */
+class planar_frame_t final {
+    struct aligned_delete_t final {
+        size_t alignment;
+        void operator()(uint8_t* ptr) const noexcept;
+    };
+
+    frame_layout_t frame_layout{};
+    frame_buffer_t pooled{};
+    std::unique_ptr<uint8_t[], aligned_delete_t> owned{};
+    uint8_t* base = nullptr;
+
+  public:
+    planar_frame_t() noexcept = default;
+    /// @throws std::bad_alloc
+    /// @throws std::invalid_argument if the layout is empty
+    explicit planar_frame_t(const frame_layout_t& layout, uint32_t alignment = 64) noexcept(false);
+    /// @throws std::invalid_argument if the buffer is smaller than the layout
+    planar_frame_t(const frame_layout_t& layout, frame_buffer_t buffer) noexcept(false);
+
+    [[nodiscard]] const frame_layout_t& layout() const noexcept {
+        return frame_layout;
+    }
+    [[nodiscard]] uint8_t* data() const noexcept {
+        return base;
+    }
+    [[nodiscard]] plane_view_t<uint8_t> plane(uint32_t index) noexcept;
+    [[nodiscard]] plane_view_t<const uint8_t> plane(uint32_t index) const noexcept;
+};
@@ -0,0 +1,306 @@
+#include "presentation_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr uint64_t top_shift = timer_wheel_t::level_bits * timer_wheel_t::level_count;
+
+uint32_t lowest_bit(uint64_t value) noexcept {
+    uint32_t index = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+} // namespace
+
+timer_wheel_t::timer_wheel_t(uint64_t tick) noexcept : current{tick} {
+}
+
+void timer_wheel_t::link(timer_entry_t*& head, timer_entry_t& entry) noexcept {
+    entry.prev = nullptr;
+    entry.next = head;
+    if (head)
+        head->prev = &entry;
+    head = &entry;
+    entry.linked = true;
+    ++count;
+}
+
+bool timer_wheel_t::insert(timer_entry_t& entry) noexcept {
+    if (entry.expiry <= current)
+        return false;
+    const uint64_t diff = entry.expiry ^ current;
+    uint32_t level = 0;
+    while (level < level_count && (diff >> (level_bits * (level + 1))) != 0)
+        ++level;
+    entry.level = static_cast<uint8_t>(level);
+    if (level == level_count) {
+        entry.slot = 0;
+        link(overflow, entry);
+        return true;
+    }
+    entry.slot = static_cast<uint8_t>((entry.expiry >> (level_bits * level)) & (slot_count - 1));
+    link(slots[level][entry.slot], entry);
+    occupied[level] |= uint64_t{1} << entry.slot;
+    return true;
+}
+
+void timer_wheel_t::remove(timer_entry_t& entry) noexcept {
+    if (entry.linked == false)
+        return;
+    timer_entry_t*& head = entry.level == level_count ? overflow : slots[entry.level][entry.slot];
+    if (entry.prev)
+        entry.prev->next = entry.next;
+    else
+        head = entry.next;
+    if (entry.next)
+        entry.next->prev = entry.prev;
+    if (head == nullptr && entry.level < level_count)
+        occupied[entry.level] &= ~(uint64_t{1} << entry.slot);
+    entry.prev = entry.next = nullptr;
+    entry.linked = false;
+    --count;
+}
+
+void timer_wheel_t::cascade(timer_entry_t* list, timer_entry_t*& expired) noexcept {
+    while (list) {
+        timer_entry_t* entry = list;
+        list = list->next;
+        entry->linked = false;
+        --count;
+        if (insert(*entry))
+            continue;
+        entry->prev = nullptr;
+        entry->next = expired;
+        expired = entry;
+    }
+}
+
+timer_entry_t* timer_wheel_t::advance(uint64_t tick) noexcept {
+    timer_entry_t* expired = nullptr;
+    while (count && current < tick) {
+        current = std::min(next_tick(), tick);
+        if ((current & ((uint64_t{1} << top_shift) - 1)) == 0)
+            cascade(std::exchange(overflow, nullptr), expired);
+        // from the highest level, so the entries can move down through the levels at once
+        for (uint32_t level = level_count - 1; level > 0; --level) {
+            const uint32_t shift = level_bits * level;
+            if ((current & ((uint64_t{1} << shift) - 1)) != 0)
+                continue;
+            const auto slot = static_cast<uint32_t>((current >> shift) & (slot_count - 1));
+            occupied[level] &= ~(uint64_t{1} << slot);
+            cascade(std::exchange(slots[level][slot], nullptr), expired);
+        }
+        const auto slot = static_cast<uint32_t>(current & (slot_count - 1));
+        occupied[0] &= ~(uint64_t{1} << slot);
+        cascade(std::exchange(slots[0][slot], nullptr), expired);
+    }
+    current = std::max(current, tick);
+    return expired;
+}
+
+uint64_t timer_wheel_t::next_tick() const noexcept {
+    uint64_t result = UINT64_MAX;
+    for (uint32_t level = 0; level < level_count; ++level) {
+        const uint32_t shift = level_bits * level;
+        const auto index = static_cast<uint32_t>((current >> shift) & (slot_count - 1));
+        // the linked slots are always after the current one
+        const uint64_t mask = index == slot_count - 1 ? 0 : occupied[level] & (~uint64_t{0} << (index + 1));
+        if (mask == 0)
+            continue;
+        const uint64_t start = ((current >> (shift + level_bits)) << (shift + level_bits)) |
+                               (uint64_t{lowest_bit(mask)} << shift);
+        result = std::min(result, start);
+    }
+    if (overflow)
+        result = std::min(result, ((current >> top_shift) + 1) << top_shift);
+    return result;
+}
+
+presentation_scheduler_t::presentation_scheduler_t(presentation_config_t config) noexcept(false)
+    : config{config}, epoch{deadline_clock_t::now()}, wheel{0} {
+    if (this->config.resolution <= deadline_clock_t::duration::zero())
+        this->config.resolution = std::chrono::microseconds{100};
+    if (this->config.rate <= 0)
+        this->config.rate = 1.0;
+    entries.resize(std::max(this->config.capacity, 1u));
+    for (entry_t& entry : entries)
+        free_list.emplace_back(&entry);
+    batch.reserve(entries.size());
+    playout = std::thread{&presentation_scheduler_t::run, this};
+}
+
+presentation_scheduler_t::~presentation_scheduler_t() noexcept {
+    {
+        std::lock_guard lck{mtx};
+        stopping = true;
+        cv.notify_all();
+    }
+    playout.join();
+    flush();
+}
+
+void presentation_scheduler_t::reset(deadline_clock_t::time_point value, media_duration_t time) noexcept {
+    std::lock_guard lck{mtx};
+    origin = value;
+    base = time;
+    started = true;
+}
+
+deadline_clock_t::time_point presentation_scheduler_t::target_of(media_duration_t time) const noexcept {
+    using scaled_duration_t = std::chrono::duration<double, media_duration_t::period>;
+    return origin + std::chrono::duration_cast<deadline_clock_t::duration>(
+                        scaled_duration_t{static_cast<double>((time - base).count())} / config.rate);
+}
+
+void presentation_scheduler_t::insert(entry_t& entry) noexcept {
+    // the first tick at or after the target. the past frames go to the next tick
+    const auto offset = std::max(entry.target - epoch, deadline_clock_t::duration::zero());
+    const auto tick = static_cast<uint64_t>((offset + config.resolution - deadline_clock_t::duration{1}) /
+                                            config.resolution);
+    entry.expiry = std::max(tick, wheel.now() + 1);
+    wheel.insert(entry);
+}
+
+std::errc presentation_scheduler_t::schedule(const presentation_task_t& task) noexcept {
+    if (task.invoke == nullptr)
+        return std::errc::invalid_argument;
+    std::lock_guard lck{mtx};
+    if (stopping)
+        return std::errc::operation_canceled;
+    if (free_list.empty())
+        return std::errc::resource_unavailable_try_again;
+    if (started == false) {
+        origin = deadline_clock_t::now();
+        base = task.time;
+        started = true;
+    }
+    entry_t& entry = *free_list.back();
+    free_list.pop_back();
+    entry.task = task;
+    entry.target = target_of(task.time);
+    entry.sequence = sequence++;
+    const uint64_t next = wheel.next_tick();
+    insert(entry);
+    if (entry.expiry < next)
+        cv.notify_all(); // the playout thread sleeps until the later tick
+    return std::errc{};
+}
+
+std::errc presentation_scheduler_t::set_rate(double rate) noexcept {
+    if (rate <= 0)
+        return std::errc::invalid_argument;
+    std::lock_guard lck{mtx};
+    if (started) {
+        // continue from the current position with the new speed
+        const auto now = deadline_clock_t::now();
+        base = position(now);
+        origin = now;
+    }
+    config.rate = rate;
+    for (entry_t& entry : entries) {
+        if (entry.linked == false)
+            continue;
+        wheel.remove(entry);
+        entry.target = target_of(entry.task.time);
+        insert(entry);
+    }
+    cv.notify_all();
+    return std::errc{};
+}
+
+void presentation_scheduler_t::flush() noexcept {
+    size_t count = 0;
+    {
+        std::lock_guard lck{mtx};
+        for (entry_t& entry : entries) {
+            if (entry.linked == false)
+                continue;
+            wheel.remove(entry);
+            free_list.emplace_back(&entry); // reserved for the capacity
+            if (entry.task.drop)
+                entry.task.drop(entry.task.context);
+            ++count;
+        }
+        started = false;
+    }
+    if (count)
+        cv.notify_all();
+}
+
+media_duration_t presentation_scheduler_t::position(deadline_clock_t::time_point time) const noexcept {
+    using scaled_duration_t = std::chrono::duration<double, media_duration_t::period>;
+    return base + std::chrono::duration_cast<media_duration_t>(
+                      std::chrono::duration_cast<scaled_duration_t>(time - origin) * config.rate);
+}
+
+media_duration_t presentation_scheduler_t::media_time(deadline_clock_t::time_point time) noexcept {
+    std::lock_guard lck{mtx};
+    return position(time);
+}
+
+jitter_stats_t presentation_scheduler_t::stats() noexcept {
+    std::lock_guard lck{mtx};
+    jitter_stats_t result = counters;
+    if (result.released) {
+        const double mean = sum / result.released;
+        const double variance = std::max(square_sum / result.released - mean * mean, 0.0);
+        result.mean = std::chrono::duration_cast<deadline_clock_t::duration>(std::chrono::nanoseconds{
+            static_cast<int64_t>(mean)});
+        result.deviation = std::chrono::duration_cast<deadline_clock_t::duration>(std::chrono::nanoseconds{
+            static_cast<int64_t>(std::sqrt(variance))});
+    }
+    return result;
+}
+
+size_t presentation_scheduler_t::pending() noexcept {
+    std::lock_guard lck{mtx};
+    return wheel.size();
+}
+
+void presentation_scheduler_t::run() noexcept {
+    std::unique_lock lck{mtx};
+    while (stopping == false) {
+        const auto now = deadline_clock_t::now();
+        const auto tick = static_cast<uint64_t>((now - epoch) / config.resolution);
+        timer_entry_t* expired = wheel.advance(tick);
+        if (expired == nullptr) {
+            const uint64_t next = wheel.next_tick();
+            if (next == UINT64_MAX)
+                cv.wait(lck);
+            else
+                cv.wait_until(lck, epoch + config.resolution * next);
+            continue;
+        }
+        batch.clear();
+        for (; expired; expired = expired->next) {
+            auto entry = static_cast<entry_t*>(expired);
+            batch.emplace_back(release_t{entry->task, entry->target, entry->sequence});
+            free_list.emplace_back(entry);
+        }
+        std::sort(batch.begin(), batch.end(), [](const release_t& lhs, const release_t& rhs) {
+            return lhs.target != rhs.target ? lhs.target < rhs.target : lhs.sequence < rhs.sequence;
+        });
+        lck.unlock();
+        for (release_t& item : batch) {
+            item.jitter = deadline_clock_t::now() - item.target;
+            item.task.invoke(item.task.context);
+        }
+        lck.lock();
+        for (const release_t& item : batch) {
+            const auto jitter = item.jitter;
+            const auto ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(jitter).count());
+            ++counters.released;
+            if (jitter > config.resolution)
+                ++counters.late;
+            counters.max = std::max(counters.max, jitter);
+            sum += ns;
+            square_sum += ns * ns;
+        }
+    }
+}
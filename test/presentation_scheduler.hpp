@@ -0,0 +1,168 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "deadline_queue.hpp"
+
+/// @brief Intrusive node of `timer_wheel_t`. The owner keeps it alive while it is linked
+struct timer_entry_t {
+    uint64_t expiry = 0; // tick
+    timer_entry_t* prev = nullptr;
+    timer_entry_t* next = nullptr;
+    uint8_t level = 0;
+    uint8_t slot = 0;
+    bool linked = false;
+};
+
+/**
+ * @brief Hierarchical timer wheel. 4 levels of 64 slots cover 2^24 ticks, and the farther entries wait in the
+ *        overflow list. Each level's slot is moved to the lower levels when the time reaches it.
+ *        `insert` and `remove` are O(1) and `advance` skips the empty slots with the occupancy masks.
+ * @note  Not thread-safe. The owner must serialize the calls
+ * @see   Varghese and Lauck, "Hashed and Hierarchical Timing Wheels"
+ */
+class timer_wheel_t final {
+  public:
+    static constexpr uint32_t level_bits = 6;
+    static constexpr uint32_t slot_count = 1u << level_bits;
+    static constexpr uint32_t level_count = 4;
+
+  private:
+    timer_entry_t* slots[level_count][slot_count]{};
+    uint64_t occupied[level_count]{}; // bit for each non-empty slot
+    timer_entry_t* overflow = nullptr;
+    uint64_t current = 0;
+    size_t count = 0;
+
+  public:
+    explicit timer_wheel_t(uint64_t tick = 0) noexcept;
+
+    /// @return false if the entry's expiry is not after `now()`. Then it is not linked
+    bool insert(timer_entry_t& entry) noexcept;
+    void remove(timer_entry_t& entry) noexcept;
+    /// @brief Move the time to the tick
+    /// @return expired entries linked with `timer_entry_t::next`. They are unlinked from the wheel
+    timer_entry_t* advance(uint64_t tick) noexcept;
+
+    /// @brief The tick which `advance` must reach for the next expiry or the move between the levels
+    /// @return `UINT64_MAX` if empty
+    [[nodiscard]] uint64_t next_tick() const noexcept;
+    [[nodiscard]] uint64_t now() const noexcept {
+        return current;
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return count;
+    }
+
+  private:
+    void link(timer_entry_t*& head, timer_entry_t& entry) noexcept;
+    /// @brief Re-insert the entries of the list. The expired ones are prepended to `expired`
+    void cascade(timer_entry_t* list, timer_entry_t*& expired) noexcept;
+};
+
+struct presentation_task_t final {
+    void (*invoke)(void* context) noexcept = nullptr;
+    /// @brief Optional. For the flush and the destruction. Called with the scheduler's lock, so it must not use
+    ///        the scheduler
+    void (*drop)(void* context) noexcept = nullptr;
+    void* context = nullptr;
+    media_duration_t time{}; // presentation timestamp like `IMFSample::GetSampleTime`
+};
+
+struct presentation_config_t final {
+    /// @brief Tick of the timer wheel. The frames are released on the tick after their time
+    deadline_clock_t::duration resolution = std::chrono::microseconds{100};
+    /// @brief Speed relative to the timestamps. 2 for double speed
+    double rate = 1.0;
+    /// @brief Number of the pending frames
+    uint32_t capacity = 64;
+};
+
+/// @brief Release time minus the scheduled time of the frames
+struct jitter_stats_t final {
+    uint64_t released = 0;
+    uint64_t late = 0; // released over one tick after the scheduled time
+    deadline_clock_t::duration mean{};
+    deadline_clock_t::duration deviation{}; // standard deviation
+    deadline_clock_t::duration max{};
+};
+
+/**
+ * @brief Releases the frames at their presentation timestamps against `deadline_clock_t`.
+ *        The playout thread sleeps until the next tick of the `timer_wheel_t` which has a frame, so there is no
+ *        busy-spinning. The frames of the same tick are released in the order of their timestamps.
+ *
+ * @note  The first `schedule` after the construction or the `flush` maps its timestamp to the current time.
+ *        Use `reset` to give the mapping explicitly
+ * @note  `invoke` runs on the playout thread. Hand the frame to the output and return quickly.
+ *        The sleep is as accurate as the OS timer. On Windows, raise the resolution with `timeBeginPeriod`
+ *        for the sub-millisecond release
+ * @see   IMFPresentationClock, IMFClockStateSink
+ */
+class presentation_scheduler_t final {
+    struct entry_t final : public timer_entry_t {
+        presentation_task_t task{};
+        deadline_clock_t::time_point target{};
+        uint64_t sequence = 0; // FIFO for the same time
+    };
+    struct release_t final {
+        presentation_task_t task{};
+        deadline_clock_t::time_point target{};
+        uint64_t sequence = 0;
+        deadline_clock_t::duration jitter{};
+    };
+
+    presentation_config_t config;
+    const deadline_clock_t::time_point epoch; // tick 0 of the wheel
+    std::mutex mtx{};
+    std::condition_variable cv{};
+    timer_wheel_t wheel;
+    std::vector<entry_t> entries{};
+    std::vector<entry_t*> free_list{};
+    std::vector<release_t> batch{}; // used by the playout thread. reserved for the capacity
+    deadline_clock_t::time_point origin{};
+    media_duration_t base{}; // timestamp at the `origin`
+    bool started = false;
+    uint64_t sequence = 0;
+    jitter_stats_t counters{};
+    double sum = 0, square_sum = 0; // of the jitter in nanoseconds
+    bool stopping = false;
+    std::thread playout{};
+
+  public:
+    /// @throws std::system_error if the playout thread can't be created
+    explicit presentation_scheduler_t(presentation_config_t config) noexcept(false);
+    /// @brief Stop the playout thread. The pending frames are dropped
+    ~presentation_scheduler_t() noexcept;
+    presentation_scheduler_t(const presentation_scheduler_t&) = delete;
+    presentation_scheduler_t(presentation_scheduler_t&&) = delete;
+    presentation_scheduler_t& operator=(const presentation_scheduler_t&) = delete;
+    presentation_scheduler_t& operator=(presentation_scheduler_t&&) = delete;
+
+    /// @brief Map the timestamp `time` to the wall clock `origin`
+    void reset(deadline_clock_t::time_point origin, media_duration_t time) noexcept;
+    /// @return `std::errc::resource_unavailable_try_again` if `presentation_config_t::capacity` frames are pending
+    std::errc schedule(const presentation_task_t& task) noexcept;
+    /// @brief Change the speed from now. The pending frames are rescheduled
+    /// @return `std::errc::invalid_argument` if the rate is not positive
+    std::errc set_rate(double rate) noexcept;
+    /// @brief Drop the pending frames. The next `schedule` maps its timestamp to the current time
+    void flush() noexcept;
+
+    /// @brief The timestamp at the time. Valid after the first `schedule` or `reset`
+    [[nodiscard]] media_duration_t media_time(deadline_clock_t::time_point time) noexcept;
+    [[nodiscard]] jitter_stats_t stats() noexcept;
+    [[nodiscard]] size_t pending() noexcept;
+
+  private:
+    deadline_clock_t::time_point target_of(media_duration_t time) const noexcept;
+    media_duration_t position(deadline_clock_t::time_point time) const noexcept;
+    void insert(entry_t& entry) noexcept;
+    void run() noexcept;
+};
@@ -0,0 +1,297 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/// @brief Size of the destructive interference. `std::hardware_destructive_interference_size` is not available in GCC 11
+constexpr size_t cache_line_size = 64;
+
+inline void cpu_relax() noexcept {
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/**
+ * @brief Spin for a while, and then block until the condition is satisfied.
+ *        The notifier pays a fence and a load when nobody is waiting
+ */
+class ring_event_t final {
+    std::mutex mtx{};
+    std::condition_variable cv{};
+    std::atomic<uint32_t> waiters{0};
+
+  public:
+    static constexpr uint32_t spin_count = 256;
+
+    template <typename Pred>
+    void wait(Pred ready) noexcept(false) {
+        for (uint32_t i = 0; i < spin_count; ++i) {
+            if (ready())
+                return;
+            cpu_relax();
+        }
+        std::unique_lock lck{mtx};
+        ++waiters;
+        // pairs with the fence in `notify`. either we see the change or the notifier sees the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lck, ready);
+        --waiters;
+    }
+
+    /// @note call after the change is published
+    void notify() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0)
+            return;
+        std::lock_guard lck{mtx};
+        cv.notify_all();
+    }
+};
+
+/**
+ * @brief Bounded single-producer single-consumer ring for the sample handles like `com_ptr<IMFSample>`.
+ *        The indices are on their own cache lines and each side caches the other's index,
+ *        so the shared line is touched only when the ring looks full or empty.
+ *
+ * @note  `try_push`/`try_pop` never block, but wake the other side. `push`/`pop` spin and then wait on `ring_event_t`
+ * @see   https://rigtorp.se/ringbuffer/
+ */
+template <typename T>
+class spsc_ring_t final {
+    static_assert(std::is_nothrow_move_assignable_v<T>);
+    static_assert(std::is_nothrow_default_constructible_v<T>);
+
+    alignas(cache_line_size) std::atomic<size_t> head{0}; // next position to pop. written by the consumer
+    size_t cached_tail = 0;
+    alignas(cache_line_size) std::atomic<size_t> tail{0}; // next position to push. written by the producer
+    size_t cached_head = 0;
+    alignas(cache_line_size) std::atomic<bool> closed{false};
+    size_t mask = 0;
+    std::unique_ptr<T[]> slots{};
+    ring_event_t not_empty{};
+    ring_event_t not_full{};
+
+  public:
+    /// @param capacity rounded up to the power of 2
+    /// @throws std::bad_alloc
+    explicit spsc_ring_t(size_t capacity) noexcept(false) {
+        size_t count = 1;
+        while (count < capacity)
+            count <<= 1;
+        slots = std::make_unique<T[]>(count);
+        mask = count - 1;
+    }
+    spsc_ring_t(const spsc_ring_t&) = delete;
+    spsc_ring_t(spsc_ring_t&&) = delete;
+    spsc_ring_t& operator=(const spsc_ring_t&) = delete;
+    spsc_ring_t& operator=(spsc_ring_t&&) = delete;
+
+    /// @note producer only. `value` is moved only when this returns true
+    bool try_push(T& value) noexcept {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head > mask) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head > mask)
+                return false;
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        not_empty.notify();
+        return true;
+    }
+
+    /// @note consumer only
+    bool try_pop(T& value) noexcept {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail)
+                return false;
+        }
+        value = std::move(slots[h & mask]);
+        slots[h & mask] = T{}; // don't hold the reference in the ring
+        head.store(h + 1, std::memory_order_release);
+        not_full.notify();
+        return true;
+    }
+
+    /// @return `std::errc::operation_canceled` if the ring is closed
+    std::errc push(T value) noexcept(false) {
+        while (closed.load(std::memory_order_acquire) == false) {
+            if (try_push(value))
+                return std::errc{};
+            not_full.wait([this]() { return writable() || closed.load(std::memory_order_acquire); });
+        }
+        return std::errc::operation_canceled;
+    }
+
+    /// @return `std::errc::no_message_available` if the ring is closed and drained
+    std::errc pop(T& value) noexcept(false) {
+        while (true) {
+            if (try_pop(value))
+                return std::errc{};
+            if (closed.load(std::memory_order_acquire))
+                return try_pop(value) ? std::errc{} : std::errc::no_message_available;
+            not_empty.wait([this]() { return readable() || closed.load(std::memory_order_acquire); });
+        }
+    }
+
+    /// @brief The consumer can pop the remaining items. `push` fails after this
+    void close() noexcept {
+        closed.store(true, std::memory_order_release);
+        not_empty.notify();
+        not_full.notify();
+    }
+
+    [[nodiscard]] size_t capacity() const noexcept {
+        return mask + 1;
+    }
+    /// @note approximate while the other side is working
+    [[nodiscard]] size_t size() const noexcept {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+  private:
+    bool readable() const noexcept {
+        return tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed);
+    }
+    bool writable() const noexcept {
+        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) <= mask;
+    }
+};
+
+/**
+ * @brief Bounded multi-producer single-consumer ring. Each slot has a sequence number,
+ *        so the producers claim the slot with one CAS and publish it without the lock.
+ *        The consumer API is same with `spsc_ring_t`
+ *
+ * @see   https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+template <typename T>
+class mpsc_ring_t final {
+    static_assert(std::is_nothrow_move_assignable_v<T>);
+    static_assert(std::is_nothrow_default_constructible_v<T>);
+
+    struct slot_t final {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    alignas(cache_line_size) std::atomic<size_t> head{0}; // written by the consumer
+    alignas(cache_line_size) std::atomic<size_t> tail{0}; // claimed by the producers
+    alignas(cache_line_size) std::atomic<bool> closed{false};
+    size_t mask = 0;
+    std::unique_ptr<slot_t[]> slots{};
+    ring_event_t not_empty{};
+    ring_event_t not_full{};
+
+  public:
+    /// @param capacity rounded up to the power of 2
+    /// @throws std::bad_alloc
+    explicit mpsc_ring_t(size_t capacity) noexcept(false) {
+        size_t count = 1;
+        while (count < capacity)
+            count <<= 1;
+        slots = std::make_unique<slot_t[]>(count);
+        for (size_t i = 0; i < count; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        mask = count - 1;
+    }
+    mpsc_ring_t(const mpsc_ring_t&) = delete;
+    mpsc_ring_t(mpsc_ring_t&&) = delete;
+    mpsc_ring_t& operator=(const mpsc_ring_t&) = delete;
+    mpsc_ring_t& operator=(mpsc_ring_t&&) = delete;
+
+    /// @note any thread. `value` is moved only when this returns true
+    bool try_push(T& value) noexcept {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            slot_t& slot = slots[position & mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    not_empty.notify();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // the consumer didn't release the slot yet
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// @note consumer only
+    bool try_pop(T& value) noexcept {
+        const size_t position = head.load(std::memory_order_relaxed);
+        slot_t& slot = slots[position & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+            return false;
+        value = std::move(slot.value);
+        slot.value = T{};
+        slot.sequence.store(position + mask + 1, std::memory_order_release);
+        head.store(position + 1, std::memory_order_release);
+        not_full.notify();
+        return true;
+    }
+
+    /// @return `std::errc::operation_canceled` if the ring is closed
+    std::errc push(T value) noexcept(false) {
+        while (closed.load(std::memory_order_acquire) == false) {
+            if (try_push(value))
+                return std::errc{};
+            not_full.wait([this]() { return writable() || closed.load(std::memory_order_acquire); });
+        }
+        return std::errc::operation_canceled;
+    }
+
+    /// @return `std::errc::no_message_available` if the ring is closed and drained
+    /// @note the items which are pushed concurrently with `close` may be left in the ring
+    std::errc pop(T& value) noexcept(false) {
+        while (true) {
+            if (try_pop(value))
+                return std::errc{};
+            if (closed.load(std::memory_order_acquire))
+                return try_pop(value) ? std::errc{} : std::errc::no_message_available;
+            not_empty.wait([this]() { return readable() || closed.load(std::memory_order_acquire); });
+        }
+    }
+
+    void close() noexcept {
+        closed.store(true, std::memory_order_release);
+        not_empty.notify();
+        not_full.notify();
+    }
+
+    [[nodiscard]] size_t capacity() const noexcept {
+        return mask + 1;
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+  private:
+    bool readable() const noexcept {
+        const size_t position = head.load(std::memory_order_relaxed);
+        return slots[position & mask].sequence.load(std::memory_order_acquire) == position + 1;
+    }
+    bool writable() const noexcept {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        return slots[position & mask].sequence.load(std::memory_order_acquire) == position;
+    }
+};
@@ -0,0 +1,210 @@
+#include "sample_trace.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "mp4_box.hpp"
+
+namespace {
+
+constexpr uint8_t trace_magic[4]{'M', 'S', 'T', 'R'};
+constexpr uint8_t trace_version = 1;
+
+constexpr uint8_t flag_sync = 1 << 0;
+constexpr uint8_t flag_discontinuity = 1 << 1;
+
+/// @return end of the encoded bytes. At most 10 bytes are written
+uint8_t* put_varint(uint8_t* ptr, uint64_t value) noexcept {
+    while (value >= 0x80) {
+        *ptr++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *ptr++ = static_cast<uint8_t>(value);
+    return ptr;
+}
+
+uint8_t* put_svarint(uint8_t* ptr, int64_t value) noexcept {
+    return put_varint(ptr, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+bool get_varint(gsl::span<const uint8_t> bytes, size_t& offset, uint64_t& value) noexcept {
+    value = 0;
+    for (uint32_t shift = 0; shift < 64 && offset < bytes.size(); shift += 7) {
+        const uint8_t b = bytes[offset++];
+        value |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool get_svarint(gsl::span<const uint8_t> bytes, size_t& offset, int64_t& value) noexcept {
+    uint64_t encoded = 0;
+    if (get_varint(bytes, offset, encoded) == false)
+        return false;
+    value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+    return true;
+}
+
+bool get_varint(gsl::span<const uint8_t> bytes, size_t& offset, uint32_t& value) noexcept {
+    uint64_t encoded = 0;
+    if (get_varint(bytes, offset, encoded) == false || encoded > UINT32_MAX)
+        return false;
+    value = static_cast<uint32_t>(encoded);
+    return true;
+}
+
+} // namespace
+
+sample_trace_writer_t::sample_trace_writer_t(fmp4_output_t& output) noexcept : output{output} {
+}
+
+std::errc sample_trace_writer_t::write_header(const sample_trace_header_t& header) noexcept {
+    if (header_written)
+        return std::errc::operation_not_permitted;
+    uint8_t bytes[64]{};
+    uint8_t* ptr = std::copy(std::begin(trace_magic), std::end(trace_magic), bytes);
+    *ptr++ = trace_version;
+    for (int shift = 24; shift >= 0; shift -= 8)
+        *ptr++ = static_cast<uint8_t>(header.codec >> shift);
+    ptr = put_varint(ptr, header.width);
+    ptr = put_varint(ptr, header.height);
+    ptr = put_varint(ptr, header.frame_rate_numerator);
+    ptr = put_varint(ptr, header.frame_rate_denominator);
+    ptr = put_varint(ptr, header.sequence_header.size());
+    const io_slice_t slices[2]{{bytes, static_cast<size_t>(ptr - bytes)},
+                               {header.sequence_header.data(), header.sequence_header.size()}};
+    if (auto ec = output.write(slices); ec != std::errc{})
+        return ec;
+    header_written = true;
+    return std::errc{};
+}
+
+std::errc sample_trace_writer_t::append(const trace_sample_t& sample) noexcept {
+    if (header_written == false)
+        return std::errc::operation_not_permitted;
+    uint8_t flags = 0;
+    if (sample.sync)
+        flags |= flag_sync;
+    if (sample.discontinuity)
+        flags |= flag_discontinuity;
+    uint8_t* ptr = prefix;
+    *ptr++ = flags;
+    ptr = put_varint(ptr, sample.data.size());
+    ptr = put_svarint(ptr, sample.time - previous_time);
+    ptr = put_svarint(ptr, sample.decode_time - sample.time);
+    ptr = put_varint(ptr, static_cast<uint64_t>(std::max<int64_t>(sample.duration, 0)));
+    const io_slice_t slices[2]{{prefix, static_cast<size_t>(ptr - prefix)}, {sample.data.data(), sample.data.size()}};
+    if (auto ec = output.write(slices); ec != std::errc{})
+        return ec;
+    previous_time = sample.time;
+    ++sample_count;
+    return std::errc{};
+}
+
+std::errc sample_trace_writer_t::flush() noexcept {
+    return output.flush();
+}
+
+sample_trace_reader_t::sample_trace_reader_t(gsl::span<const uint8_t> trace) noexcept : trace{trace} {
+}
+
+std::errc sample_trace_reader_t::read_header(sample_trace_header_t& header) noexcept {
+    if (trace.size() < 9 || std::equal(std::begin(trace_magic), std::end(trace_magic), trace.begin()) == false)
+        return std::errc::protocol_error;
+    if (trace[4] != trace_version)
+        return std::errc::not_supported;
+    header.codec = load_be32(trace.data() + 5);
+    size_t cursor = 9;
+    uint32_t length = 0;
+    if (get_varint(trace, cursor, header.width) == false || get_varint(trace, cursor, header.height) == false ||
+        get_varint(trace, cursor, header.frame_rate_numerator) == false ||
+        get_varint(trace, cursor, header.frame_rate_denominator) == false ||
+        get_varint(trace, cursor, length) == false || trace.size() - cursor < length)
+        return std::errc::protocol_error;
+    try {
+        header.sequence_header.assign(trace.data() + cursor, trace.data() + cursor + length);
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    first = offset = cursor + length;
+    previous_time = 0;
+    return std::errc{};
+}
+
+std::errc sample_trace_reader_t::next(trace_sample_t& sample) noexcept {
+    if (first == 0)
+        return std::errc::operation_not_permitted; // `read_header` is required
+    if (offset == trace.size())
+        return std::errc::no_message_available;
+    size_t cursor = offset;
+    const uint8_t flags = trace[cursor++];
+    uint64_t length = 0, duration = 0;
+    int64_t time_delta = 0, decode_delta = 0;
+    if (get_varint(trace, cursor, length) == false || get_svarint(trace, cursor, time_delta) == false ||
+        get_svarint(trace, cursor, decode_delta) == false || get_varint(trace, cursor, duration) == false ||
+        trace.size() - cursor < length || duration > INT64_MAX)
+        return std::errc::protocol_error;
+    sample.data = trace.subspan(cursor, static_cast<size_t>(length));
+    sample.time = previous_time + time_delta;
+    sample.decode_time = sample.time + decode_delta;
+    sample.duration = static_cast<int64_t>(duration);
+    sample.sync = flags & flag_sync;
+    sample.discontinuity = flags & flag_discontinuity;
+    previous_time = sample.time;
+    offset = cursor + static_cast<size_t>(length);
+    return std::errc{};
+}
+
+void sample_trace_reader_t::rewind() noexcept {
+    offset = first;
+    previous_time = 0;
+}
+
+trace_replayer_t::trace_replayer_t(sample_trace_reader_t& reader, replay_config_t config) noexcept
+    : reader{reader}, config{config} {
+}
+
+std::errc trace_replayer_t::next(trace_sample_t& sample) noexcept {
+    if (pass >= config.loops)
+        return std::errc::no_message_available;
+    auto ec = reader.next(sample);
+    if (ec == std::errc::no_message_available) {
+        if (++pass >= config.loops || counters.samples == 0)
+            return ec;
+        // the next pass starts after the last sample of this pass
+        loop_offset = end_time - first_time;
+        reader.rewind();
+        ec = reader.next(sample);
+    }
+    if (ec != std::errc{})
+        return ec;
+    sample.time += loop_offset;
+    sample.decode_time += loop_offset;
+    end_time = std::max(end_time, sample.decode_time + std::max<int64_t>(sample.duration, 1));
+
+    const auto now = deadline_clock_t::now();
+    if (started == false) {
+        origin = now;
+        first_time = sample.decode_time;
+        end_time = sample.decode_time + std::max<int64_t>(sample.duration, 1);
+        started = true;
+    }
+    last_release = now;
+    if (config.rate > 0) {
+        using scaled_duration_t = std::chrono::duration<double, media_duration_t::period>;
+        last_release = origin + std::chrono::duration_cast<deadline_clock_t::duration>(
+                                    scaled_duration_t{static_cast<double>(sample.decode_time - first_time)} /
+                                    config.rate);
+        if (now < last_release) {
+            std::this_thread::sleep_until(last_release);
+        } else if (auto lateness = now - last_release; lateness > deadline_clock_t::duration::zero()) {
+            ++counters.late;
+            counters.max_lateness = std::max(counters.max_lateness, lateness);
+        }
+    }
+    ++counters.samples;
+    counters.bytes += sample.data.size();
+    counters.elapsed = std::max(now, last_release) - origin;
+    return std::errc{};
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <gsl/gsl>
+#include <system_error>
+#include <vector>
+
+#include "deadline_queue.hpp"
+#include "fmp4_muxer.hpp"
+
+/// @brief Stream description at the start of the trace. Enough to configure the decoder without the source
+struct sample_trace_header_t final {
+    uint32_t codec = 0; // fourcc like `make_fourcc("H264")`
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t frame_rate_numerator = 0;
+    uint32_t frame_rate_denominator = 0;
+    /// @brief `MF_MT_MPEG_SEQUENCE_HEADER` of the source type
+    std::vector<uint8_t> sequence_header{};
+};
+
+/// @brief Compressed sample in the trace. Timestamps are in 100ns unit like `IMFSample`
+struct trace_sample_t final {
+    gsl::span<const uint8_t> data{};
+    int64_t time = 0;        // `IMFSample::GetSampleTime`
+    int64_t decode_time = 0; // `MFSampleExtension_DecodeTimestamp`. same with `time` if unknown
+    int64_t duration = 0;    // `IMFSample::GetSampleDuration`
+    bool sync = false;       // `MFSampleExtension_CleanPoint`
+    bool discontinuity = false;
+};
+
+/**
+ * @brief Records the compressed samples in the reading order.
+ *
+ *  header: "MSTR", version(u8), codec(be32), varint width/height/frame rate, varint size + sequence header
+ *  record: flags(u8), varint size, zigzag varint of time - previous time, zigzag varint of decode_time - time,
+ *          varint duration, payload
+ *
+ * @note  The record header is about 10 bytes, so the trace is close to the size of the elementary stream.
+ *        The payload is written from the caller's memory without the copy
+ * @see   sample_trace_reader_t
+ */
+class sample_trace_writer_t final {
+    fmp4_output_t& output;
+    uint8_t prefix[48]{}; // record header of the current `append`
+    int64_t previous_time = 0;
+    uint64_t sample_count = 0;
+    bool header_written = false;
+
+  public:
+    explicit sample_trace_writer_t(fmp4_output_t& output) noexcept;
+
+    std::errc write_header(const sample_trace_header_t& header) noexcept;
+    /// @return `std::errc::operation_not_permitted` before the `write_header`
+    std::errc append(const trace_sample_t& sample) noexcept;
+    std::errc flush() noexcept;
+
+    [[nodiscard]] uint64_t count() const noexcept {
+        return sample_count;
+    }
+};
+
+/**
+ * @brief Reads the trace in the memory(usually `mapped_file_t`). `trace_sample_t::data` points to the memory
+ * @note  Every record is validated against the remaining bytes. A truncated record is `std::errc::protocol_error`
+ */
+class sample_trace_reader_t final {
+    gsl::span<const uint8_t> trace;
+    size_t first = 0; // offset of the first record
+    size_t offset = 0;
+    int64_t previous_time = 0;
+
+  public:
+    explicit sample_trace_reader_t(gsl::span<const uint8_t> trace) noexcept;
+
+    /// @return `std::errc::protocol_error` if it is not a trace, `std::errc::not_supported` for the unknown version
+    std::errc read_header(sample_trace_header_t& header) noexcept;
+    /// @return `std::errc::no_message_available` at the end of the trace
+    std::errc next(trace_sample_t& sample) noexcept;
+    /// @brief Back to the first record
+    void rewind() noexcept;
+};
+
+struct replay_config_t final {
+    /// @brief Speed relative to the timestamps. 2 for double speed. 0 to replay as fast as possible
+    double rate = 1.0;
+    /// @brief Number of the passes over the trace. The timestamps keep increasing on the next pass
+    uint32_t loops = 1;
+};
+
+struct replay_stats_t final {
+    uint64_t samples = 0;
+    uint64_t bytes = 0;
+    uint64_t late = 0; // released after its scheduled time. the consumer couldn't keep the rate
+    deadline_clock_t::duration max_lateness{};
+    deadline_clock_t::duration elapsed{}; // from the first release to the last
+};
+
+/**
+ * @brief Feeds a pipeline from the trace. The samples are released in the trace order, paced by the decode
+ *        timestamps and the `replay_config_t::rate`. The release time of each sample is the reference point of
+ *        the latency, so the numbers don't depend on the media source or the machine's disk.
+ *
+ * @code
+ * stage_graph_t<trace_sample_t> graph{std::ref(replayer)};
+ * @endcode
+ *
+ * @note  `next` sleeps on the caller's thread. Use it as the source of `stage_graph_t` or a dedicated thread
+ */
+class trace_replayer_t final {
+    sample_trace_reader_t& reader;
+    replay_config_t config;
+    deadline_clock_t::time_point origin{};
+    deadline_clock_t::time_point last_release{};
+    int64_t first_time = 0;
+    int64_t loop_offset = 0; // added to the timestamps of the current pass
+    int64_t end_time = 0;    // the largest `decode_time + duration` of the current pass
+    uint32_t pass = 0;
+    bool started = false;
+    replay_stats_t counters{};
+
+  public:
+    /// @param reader after its `read_header`
+    trace_replayer_t(sample_trace_reader_t& reader, replay_config_t config) noexcept;
+
+    /// @return `std::errc::no_message_available` after the last pass
+    std::errc next(trace_sample_t& sample) noexcept;
+    /// @brief Same with `next`. For `stage_graph_t::source_t`
+    std::errc operator()(trace_sample_t& sample) noexcept {
+        return next(sample);
+    }
+
+    /// @brief Scheduled release time of the last sample from `next`. Subtract it from the completion time
+    ///        for the latency of the pipeline
+    [[nodiscard]] deadline_clock_t::time_point release_time() const noexcept {
+        return last_release;
+    }
+    [[nodiscard]] replay_stats_t stats() const noexcept {
+        return counters;
+    }
+};
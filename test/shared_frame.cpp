@@ -0,0 +1,94 @@
+#include "shared_frame.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <utility>
+
+struct shared_frame_block_t final {
+    std::atomic<uint32_t> references{1};
+    planar_frame_t frame;
+};
+
+shared_frame_t::shared_frame_t(planar_frame_t&& frame) noexcept(false)
+    : block{new shared_frame_block_t{{1}, std::move(frame)}} {
+}
+
+shared_frame_t::~shared_frame_t() noexcept {
+    reset();
+}
+
+shared_frame_t::shared_frame_t(const shared_frame_t& rhs) noexcept : block{rhs.block} {
+    if (block)
+        block->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+shared_frame_t::shared_frame_t(shared_frame_t&& rhs) noexcept : block{std::exchange(rhs.block, nullptr)} {
+}
+
+shared_frame_t& shared_frame_t::operator=(const shared_frame_t& rhs) noexcept {
+    if (this != &rhs) {
+        if (rhs.block)
+            rhs.block->references.fetch_add(1, std::memory_order_relaxed);
+        reset();
+        block = rhs.block;
+    }
+    return *this;
+}
+
+shared_frame_t& shared_frame_t::operator=(shared_frame_t&& rhs) noexcept {
+    if (this != &rhs) {
+        reset();
+        block = std::exchange(rhs.block, nullptr);
+    }
+    return *this;
+}
+
+void shared_frame_t::reset() noexcept {
+    shared_frame_block_t* current = std::exchange(block, nullptr);
+    if (current && current->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete current;
+}
+
+const planar_frame_t* shared_frame_t::get() const noexcept {
+    return block ? &block->frame : nullptr;
+}
+
+uint32_t shared_frame_t::use_count() const noexcept {
+    return block ? block->references.load(std::memory_order_relaxed) : 0;
+}
+
+planar_frame_t* shared_frame_t::writable() noexcept {
+    // acquire: the reads of the released handles happen before the writes of this owner
+    if (block == nullptr || block->references.load(std::memory_order_acquire) != 1)
+        return nullptr;
+    return &block->frame;
+}
+
+std::errc shared_frame_t::make_writable(frame_pool_t* pool) noexcept {
+    if (block == nullptr)
+        return std::errc::invalid_argument;
+    if (writable())
+        return std::errc{};
+    const planar_frame_t& source = block->frame;
+    const frame_layout_t& layout = source.layout();
+    if (layout.size == 0)
+        return std::errc::invalid_argument;
+    try {
+        planar_frame_t copy{};
+        if (pool) {
+            frame_buffer_t buffer{};
+            if (auto ec = pool->acquire(layout.size, buffer); ec != std::errc{})
+                return ec;
+            copy = planar_frame_t{layout, std::move(buffer)};
+        } else {
+            copy = planar_frame_t{layout};
+        }
+        // same layout. the padding goes together in one copy
+        std::memcpy(copy.data(), source.data(), layout.size);
+        *this = shared_frame_t{std::move(copy)};
+        return std::errc{};
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+}
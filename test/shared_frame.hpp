@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <system_error>
+
+#include "frame_pool.hpp"
+#include "planar_frame.hpp"
+
+struct shared_frame_block_t;
+
+/**
+ * @brief Immutable handle of `planar_frame_t` with the atomic reference count.
+ *        Copy is an atomic increment, so the fan-out of a decoded frame doesn't copy the pixels.
+ *        A stage which must modify the frame calls `make_writable`. It copies only when the frame is shared
+ * @see   fanout_node_t
+ */
+class shared_frame_t final {
+    shared_frame_block_t* block = nullptr;
+
+  public:
+    shared_frame_t() noexcept = default;
+    /// @throws std::bad_alloc
+    explicit shared_frame_t(planar_frame_t&& frame) noexcept(false);
+    ~shared_frame_t() noexcept;
+    shared_frame_t(const shared_frame_t& rhs) noexcept;
+    shared_frame_t(shared_frame_t&& rhs) noexcept;
+    shared_frame_t& operator=(const shared_frame_t& rhs) noexcept;
+    shared_frame_t& operator=(shared_frame_t&& rhs) noexcept;
+
+    void reset() noexcept;
+
+    [[nodiscard]] const planar_frame_t* get() const noexcept;
+    const planar_frame_t& operator*() const noexcept {
+        return *get();
+    }
+    const planar_frame_t* operator->() const noexcept {
+        return get();
+    }
+    [[nodiscard]] uint32_t use_count() const noexcept;
+    explicit operator bool() const noexcept {
+        return block != nullptr;
+    }
+
+    /**
+     * @brief Make this handle the only owner of its frame. If the frame is shared, it is copied to a new frame
+     *        and this handle moves to the copy. The other handles keep the original
+     * @param pool if not null, the copy's memory comes from it
+     * @return `std::errc::invalid_argument` for the empty handle or frame. The errors of `frame_pool_t::acquire`
+     */
+    std::errc make_writable(frame_pool_t* pool = nullptr) noexcept;
+    /// @return `nullptr` if the frame is shared. @see make_writable
+    [[nodiscard]] planar_frame_t* writable() noexcept;
+};
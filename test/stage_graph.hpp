@@ -0,0 +1,266 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "sample_ring.hpp"
+
+/// @brief The output side of the stage. `emit` waits for the credit of the downstream queue
+template <typename T>
+class stage_emitter_t {
+  public:
+    virtual ~stage_emitter_t() noexcept = default;
+
+    /// @return `std::errc::operation_canceled` if the downstream is stopped
+    virtual std::errc emit(T item) noexcept = 0;
+};
+
+/**
+ * @brief One stage of the `stage_graph_t`. The functions are called on the stage's thread
+ * @see   MFT_MESSAGE_NOTIFY_START_OF_STREAM, MFT_MESSAGE_COMMAND_DRAIN
+ */
+template <typename T>
+class stage_node_t {
+  public:
+    virtual ~stage_node_t() noexcept = default;
+
+    /// @brief Before the first input
+    virtual std::errc start() noexcept {
+        return std::errc{};
+    }
+    /// @brief Consume the input and emit the outputs which are available now
+    virtual std::errc process(T input, stage_emitter_t<T>& output) noexcept = 0;
+    /// @brief The upstream is finished. Emit the leftovers
+    virtual std::errc drain(stage_emitter_t<T>&) noexcept {
+        return std::errc{};
+    }
+};
+
+struct stage_stats_t final {
+    uint64_t input_count = 0;
+    uint64_t output_count = 0;
+    uint64_t full_count = 0; // `emit` had to wait for the credit
+};
+
+/**
+ * @brief Chain of the stages which run in parallel. source -> node 0 -> node 1 -> ... -> (discard).
+ *        Each node has a bounded input queue and its free slots are the credits of the upstream.
+ *        When the credits are used up, the upstream is blocked in `emit`, so the backpressure
+ *        reaches the source and the number of samples in flight is bounded by the sum of the capacities.
+ *
+ * @note  When a stage fails, the queues are closed and the other stages stop without `drain`
+ */
+template <typename T>
+class stage_graph_t final {
+  public:
+    /// @brief Fill the item. `std::errc::no_message_available` for the end of the stream
+    using source_t = std::function<std::errc(T&)>;
+
+  private:
+    struct stage_t final : public stage_emitter_t<T> {
+        stage_graph_t* graph = nullptr;
+        stage_node_t<T>* node = nullptr; // nullptr for the source
+        std::unique_ptr<spsc_ring_t<T>> input{};
+        spsc_ring_t<T>* output = nullptr; // nullptr for the last stage
+        stage_stats_t stats{};
+        std::errc status{};
+
+      public:
+        std::errc emit(T item) noexcept override {
+            ++stats.output_count;
+            if (output == nullptr)
+                return std::errc{}; // discard
+            if (output->try_push(item))
+                return std::errc{};
+            ++stats.full_count;
+            try {
+                return output->push(std::move(item));
+            } catch (const std::system_error&) {
+                return std::errc::resource_unavailable_try_again;
+            }
+        }
+    };
+
+    source_t source;
+    std::vector<std::unique_ptr<stage_t>> stages{}; // [0] is the source
+    std::atomic<bool> failed{false};
+
+  public:
+    /// @throws std::bad_alloc
+    explicit stage_graph_t(source_t source) noexcept(false) : source{std::move(source)} {
+        stages.emplace_back(std::make_unique<stage_t>());
+        stages[0]->graph = this;
+    }
+    stage_graph_t(const stage_graph_t&) = delete;
+    stage_graph_t(stage_graph_t&&) = delete;
+    stage_graph_t& operator=(const stage_graph_t&) = delete;
+    stage_graph_t& operator=(stage_graph_t&&) = delete;
+
+    /**
+     * @brief Append the node to the chain. The node must live until `run` returns
+     * @param capacity the credits for the upstream
+     * @throws std::bad_alloc
+     */
+    stage_graph_t& then(stage_node_t<T>& node, size_t capacity = 4) noexcept(false) {
+        auto stage = std::make_unique<stage_t>();
+        stage->graph = this;
+        stage->node = &node;
+        stage->input = std::make_unique<spsc_ring_t<T>>(capacity);
+        stages.back()->output = stage->input.get();
+        stages.emplace_back(std::move(stage));
+        return *this;
+    }
+
+    /**
+     * @brief Run every stage on its own thread and wait for them.
+     * @return the first failure. `std::errc::resource_unavailable_try_again` if the thread can't be created
+     * @note   call once
+     */
+    std::errc run() noexcept {
+        std::vector<std::thread> threads{};
+        try {
+            threads.reserve(stages.size());
+            threads.emplace_back(&stage_graph_t::run_source, this, stages[0].get());
+            for (size_t i = 1; i < stages.size(); ++i)
+                threads.emplace_back(&stage_graph_t::run_node, this, stages[i].get());
+        } catch (const std::exception&) {
+            stop();
+            for (auto& t : threads)
+                t.join();
+            return std::errc::resource_unavailable_try_again;
+        }
+        for (auto& t : threads)
+            t.join();
+        for (const auto& stage : stages)
+            if (stage->status != std::errc{})
+                return stage->status;
+        return std::errc{};
+    }
+
+    /// @param index 0 for the source, 1 for the first node
+    [[nodiscard]] const stage_stats_t& stats(size_t index) const noexcept {
+        return stages[index]->stats;
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return stages.size();
+    }
+
+  private:
+    void stop() noexcept {
+        failed = true;
+        for (auto& stage : stages)
+            if (stage->input)
+                stage->input->close();
+    }
+
+    /// @note only the first failure is recorded. the others are `operation_canceled` from the closed queues
+    void fail(stage_t* stage, std::errc ec) noexcept {
+        if (failed.exchange(true) == false)
+            stage->status = ec;
+        stop();
+    }
+
+    void run_source(stage_t* stage) noexcept {
+        while (failed == false) {
+            T item{};
+            if (auto ec = source(item); ec != std::errc{}) {
+                if (ec != std::errc::no_message_available)
+                    fail(stage, ec);
+                break;
+            }
+            ++stage->stats.input_count;
+            if (auto ec = stage->emit(std::move(item)); ec != std::errc{}) {
+                fail(stage, ec);
+                break;
+            }
+        }
+        if (stage->output)
+            stage->output->close();
+    }
+
+    void run_node(stage_t* stage) noexcept {
+        if (auto ec = stage->node->start(); ec != std::errc{})
+            return fail(stage, ec);
+        try {
+            T item{};
+            while (stage->input->pop(item) == std::errc{}) {
+                ++stage->stats.input_count;
+                if (auto ec = stage->node->process(std::move(item), *stage); ec != std::errc{})
+                    return fail(stage, ec);
+                item = T{};
+            }
+        } catch (const std::system_error&) {
+            return fail(stage, std::errc::resource_unavailable_try_again);
+        }
+        if (failed == false)
+            if (auto ec = stage->node->drain(*stage); ec != std::errc{})
+                return fail(stage, ec);
+        if (stage->output)
+            stage->output->close();
+    }
+};
+
+/**
+ * @brief Pass the input downstream and its copy to each branch queue. With the ref-counted `T` like `shared_frame_t`
+ *        or `com_ptr<IMFSample>`, a branch costs a reference instead of the memory copy.
+ *        Each queue is the source of the branch's own `stage_graph_t`. @see source
+ * @note  A slow branch blocks the fan-out when its queue is full, so the backpressure reaches the main graph.
+ *        If the main graph stops without `drain`, `close` must be called to end the branches
+ */
+template <typename T>
+class fanout_node_t final : public stage_node_t<T> {
+    std::vector<std::unique_ptr<spsc_ring_t<T>>> branches{};
+
+  public:
+    /// @param capacity of each branch queue
+    /// @throws std::bad_alloc
+    explicit fanout_node_t(size_t count, size_t capacity = 4) noexcept(false) {
+        for (size_t i = 0; i < count; ++i)
+            branches.emplace_back(std::make_unique<spsc_ring_t<T>>(capacity));
+    }
+    ~fanout_node_t() noexcept {
+        close();
+    }
+
+    std::errc process(T input, stage_emitter_t<T>& output) noexcept override {
+        try {
+            for (auto& branch : branches)
+                if (auto ec = branch->push(input); ec != std::errc{} && ec != std::errc::operation_canceled)
+                    return ec;
+        } catch (const std::system_error&) {
+            return std::errc::resource_unavailable_try_again;
+        }
+        return output.emit(std::move(input));
+    }
+    std::errc drain(stage_emitter_t<T>&) noexcept override {
+        close();
+        return std::errc{};
+    }
+
+    /// @brief The branches pop the remaining items and end
+    void close() noexcept {
+        for (auto& branch : branches)
+            branch->close();
+    }
+
+    /**
+     * @return the source of the branch's graph. It ends after the fan-out is drained or closed
+     * @throws std::out_of_range
+     */
+    typename stage_graph_t<T>::source_t source(size_t index) noexcept(false) {
+        spsc_ring_t<T>* ring = branches.at(index).get();
+        return [ring](T& item) -> std::errc {
+            try {
+                return ring->pop(item);
+            } catch (const std::system_error&) {
+                return std::errc::resource_unavailable_try_again;
+            }
+        };
+    }
+    [[nodiscard]] size_t size() const noexcept {
+        return branches.size();
+    }
+};
@@ -0,0 +1,441 @@
+#include "stream_demux.hpp"
+#include "h264_parser.hpp"
+#include "mp4_box.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <utility>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool is_vcl(uint8_t nal_type) noexcept {
+    return nal_type >= 1 && nal_type <= 5;
+}
+
+/// @brief NAL units which can't follow the VCL NAL units of the same access unit
+/// @see ITU-T H.264 7.4.1.2.3 Order of NAL units and coded pictures and association to access units
+bool starts_access_unit(uint8_t nal_type) noexcept {
+    return (nal_type >= 6 && nal_type <= 9) || (nal_type >= 14 && nal_type <= 18);
+}
+
+/// @see ISO/IEC 14496-12 8.8.3.1 sample_flags
+constexpr uint32_t sample_is_non_sync_sample = 0x00010000;
+
+} // namespace
+
+stream_fd_input_t::stream_fd_input_t(int fd) noexcept : fd{fd} {
+}
+
+std::errc stream_fd_input_t::read(gsl::span<uint8_t> buffer, size_t& count) noexcept {
+    while (true) {
+#if defined(_WIN32)
+        const int result = _read(fd, buffer.data(), static_cast<unsigned int>(std::min<size_t>(buffer.size(), INT_MAX)));
+#else
+        const ssize_t result = ::read(fd, buffer.data(), buffer.size());
+#endif
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            return static_cast<std::errc>(errno);
+        }
+        count = static_cast<size_t>(result);
+        return std::errc{};
+    }
+}
+
+stream_demux_t::stream_demux_t(stream_input_t& input, size_t capacity) noexcept(false)
+    : input{input}, buffer{std::make_unique<uint8_t[]>(capacity)}, capacity{capacity} {
+    entries.reserve(max_fragment_samples);
+}
+
+uint32_t stream_demux_t::length_size() const noexcept {
+    if (stream_format != stream_format_t::fmp4 || config.size() < 5)
+        return 0;
+    return (config[4] & 0b11) + 1;
+}
+
+/// @brief Buffer `count` bytes from `head`. The buffer is compacted when the tail space is not enough
+std::errc stream_demux_t::fill(size_t count) noexcept {
+    if (count > capacity)
+        return std::errc::value_too_large;
+    if (tail - head >= count)
+        return std::errc{};
+    if (capacity - head < count) {
+        std::memmove(buffer.get(), buffer.get() + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+    while (tail - head < count) {
+        if (end_of_stream)
+            return std::errc::no_message_available;
+        size_t length = 0;
+        if (auto ec = input.read({buffer.get() + tail, capacity - tail}, length); ec != std::errc{})
+            return ec;
+        if (length == 0)
+            end_of_stream = true;
+        tail += length;
+    }
+    return std::errc{};
+}
+
+/// @brief Consume `count` bytes. The bytes that are not buffered yet are read and discarded
+std::errc stream_demux_t::skip(uint64_t count) noexcept {
+    const size_t buffered = tail - head;
+    if (count <= buffered) {
+        head += static_cast<size_t>(count);
+        position += count;
+        return std::errc{};
+    }
+    count -= buffered;
+    position += buffered;
+    head = tail = 0;
+    while (count) {
+        if (end_of_stream)
+            return std::errc::no_message_available;
+        size_t length = 0;
+        const auto request = static_cast<size_t>(std::min<uint64_t>(count, capacity));
+        if (auto ec = input.read({buffer.get(), request}, length); ec != std::errc{})
+            return ec;
+        if (length == 0)
+            end_of_stream = true;
+        count -= length;
+        position += length;
+    }
+    return std::errc{};
+}
+
+std::errc stream_demux_t::detect() noexcept {
+    if (auto ec = fill(8); ec != std::errc{}) {
+        if (ec != std::errc::no_message_available || tail - head < 4)
+            return ec;
+    }
+    const uint8_t* ptr = buffer.get() + head;
+    if (ptr[0] == 0 && ptr[1] == 0 && (ptr[2] == 1 || (ptr[2] == 0 && ptr[3] == 1))) {
+        stream_format = stream_format_t::annexb;
+        return std::errc{};
+    }
+    if (tail - head >= 8) {
+        switch (load_be32(ptr + 4)) {
+        case make_fourcc("ftyp"):
+        case make_fourcc("styp"):
+        case make_fourcc("moov"):
+        case make_fourcc("sidx"):
+        case make_fourcc("free"):
+            stream_format = stream_format_t::fmp4;
+            return std::errc{};
+        default:
+            break;
+        }
+    }
+    return std::errc::not_supported;
+}
+
+std::errc stream_demux_t::next(stream_sample_t& sample) noexcept {
+    if (auto ec = skip(std::exchange(emitted, 0)); ec != std::errc{})
+        return ec;
+    if (stream_format == stream_format_t::unknown)
+        if (auto ec = detect(); ec != std::errc{})
+            return ec;
+    if (stream_format == stream_format_t::annexb)
+        return next_annexb(sample);
+    return next_fmp4(sample);
+}
+
+std::errc stream_demux_t::next_annexb(stream_sample_t& sample) noexcept {
+    // search the first NAL unit of the next access unit. `buffer[head]` is the start of the current one
+    size_t boundary = 0;
+    while (boundary == 0) {
+        const uint8_t* base = buffer.get() + head;
+        const size_t length = tail - head;
+        // start code and 2 bytes after it(NAL unit header and the first byte of the slice header)
+        while (scan + 5 <= length) {
+            const auto* one = static_cast<const uint8_t*>(std::memchr(base + scan + 2, 0x01, length - scan - 4));
+            if (one == nullptr) {
+                scan = length - 4;
+                break;
+            }
+            const auto code = static_cast<size_t>(one - base) - 2;
+            if (base[code] != 0 || base[code + 1] != 0) {
+                scan = code + 1;
+                continue;
+            }
+            const uint8_t nal_type = base[code + 3] & 0x1F;
+            if (is_vcl(nal_type)) {
+                // first_mb_in_slice == 0 starts a new primary coded picture
+                if (has_vcl && (base[code + 4] & 0x80))
+                    boundary = code;
+                has_vcl = true;
+            } else if (has_vcl && starts_access_unit(nal_type)) {
+                boundary = code;
+            }
+            scan = code + 3;
+            if (boundary)
+                break;
+        }
+        if (boundary)
+            break;
+        if (auto ec = fill(length + 1); ec != std::errc{}) {
+            if (ec != std::errc::no_message_available)
+                return ec;
+            if (length == 0)
+                return ec;
+            boundary = length; // the last access unit
+        }
+    }
+    gsl::span<const uint8_t> unit{buffer.get() + head, boundary};
+    sample.data = unit;
+    sample.decode_time = sample.presentation_time = frame_count++;
+    sample.sync = false;
+    try {
+        bool sps_found = false;
+        for (auto nal = next_annexb_nal(unit); nal.empty() == false; nal = next_annexb_nal(unit)) {
+            const auto type = get_nal_type(nal);
+            if (type == h264_nal_type_t::idr)
+                sample.sync = true;
+            if (type != h264_nal_type_t::sps && type != h264_nal_type_t::pps)
+                continue;
+            if (type == h264_nal_type_t::sps && sps_found == false) {
+                config.clear();
+                sps_found = true;
+            }
+            const uint8_t start_code[4]{0, 0, 0, 1};
+            config.insert(config.end(), start_code, start_code + 4);
+            config.insert(config.end(), nal.begin(), nal.end());
+        }
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    emitted = boundary;
+    scan = 0;
+    has_vcl = false;
+    return std::errc{};
+}
+
+std::errc stream_demux_t::next_fmp4(stream_sample_t& sample) noexcept {
+    while (true) {
+        if (mdat_end) {
+            // the samples must be in the current `mdat`. the others can't be reached without seek
+            while (entry_index < entries.size()) {
+                const entry_t& entry = entries[entry_index];
+                if (entry.offset >= position && entry.offset + entry.size <= mdat_end)
+                    break;
+                ++entry_index;
+            }
+            if (entry_index < entries.size()) {
+                const entry_t& entry = entries[entry_index++];
+                if (auto ec = skip(entry.offset - position); ec != std::errc{})
+                    return ec;
+                if (auto ec = fill(entry.size); ec != std::errc{})
+                    return ec == std::errc::no_message_available ? std::errc::protocol_error : ec;
+                sample.data = gsl::span<const uint8_t>{buffer.get() + head, entry.size};
+                sample.decode_time = entry.decode_time;
+                sample.presentation_time = entry.presentation_time;
+                sample.sync = entry.sync;
+                emitted = entry.size;
+                return std::errc{};
+            }
+            if (auto ec = skip(mdat_end - position); ec != std::errc{})
+                return ec == std::errc::no_message_available ? std::errc::protocol_error : ec;
+            mdat_end = 0;
+        }
+        if (auto ec = fill(8); ec != std::errc{})
+            return (ec == std::errc::no_message_available && tail == head) ? ec : std::errc::protocol_error;
+        uint64_t size = load_be32(buffer.get() + head);
+        const uint32_t type = load_be32(buffer.get() + head + 4);
+        size_t header = 8;
+        if (size == 1) {
+            if (auto ec = fill(16); ec != std::errc{})
+                return std::errc::protocol_error;
+            size = load_be64(buffer.get() + head + 8);
+            header = 16;
+        } else if (size == 0) {
+            return std::errc::not_supported; // the box extends to the end of the stream
+        }
+        if (size < header)
+            return std::errc::protocol_error;
+        switch (type) {
+        case make_fourcc("moov"):
+        case make_fourcc("moof"): {
+            if (size > capacity)
+                return std::errc::value_too_large;
+            if (auto ec = fill(static_cast<size_t>(size)); ec != std::errc{})
+                return ec == std::errc::no_message_available ? std::errc::protocol_error : ec;
+            gsl::span<const uint8_t> payload{buffer.get() + head + header, static_cast<size_t>(size) - header};
+            const auto ec = type == make_fourcc("moov") ? parse_moov(payload) : parse_moof(payload, position);
+            if (ec != std::errc{})
+                return ec;
+            break;
+        }
+        case make_fourcc("mdat"):
+            if (position > UINT64_MAX - size)
+                return std::errc::protocol_error;
+            mdat_end = position + size;
+            size = header;
+            break;
+        default:
+            break;
+        }
+        if (auto ec = skip(size); ec != std::errc{})
+            return ec == std::errc::no_message_available ? std::errc::protocol_error : ec;
+    }
+}
+
+/// @brief Find the first H.264 video track and its defaults
+std::errc stream_demux_t::parse_moov(gsl::span<const uint8_t> payload) noexcept {
+    box_view_t trak{};
+    auto traks = payload;
+    while (track_id == 0 && next_box(traks, trak)) {
+        if (trak.type != make_fourcc("trak"))
+            continue;
+        box_view_t tkhd{}, mdia{}, mdhd{}, hdlr{}, minf{}, stbl{}, stsd{};
+        if (!find_box(trak.payload, make_fourcc("tkhd"), tkhd) || !find_box(trak.payload, make_fourcc("mdia"), mdia) ||
+            !find_box(mdia.payload, make_fourcc("mdhd"), mdhd) || !find_box(mdia.payload, make_fourcc("hdlr"), hdlr) ||
+            !find_box(mdia.payload, make_fourcc("minf"), minf) || !find_box(minf.payload, make_fourcc("stbl"), stbl) ||
+            !find_box(stbl.payload, make_fourcc("stsd"), stsd))
+            continue;
+        box_reader_t handler{hdlr.payload};
+        handler.skip(8); // version, flags, pre_defined
+        if (handler.u32() != make_fourcc("vide"))
+            continue;
+        // the first sample entry. 78 bytes of VisualSampleEntry and then the child boxes
+        gsl::span<const uint8_t> entries_payload = stsd.payload.size() < 8 ? gsl::span<const uint8_t>{}
+                                                                            : stsd.payload.subspan(8);
+        box_view_t entry{}, avcc{};
+        if (!next_box(entries_payload, entry) || entry.payload.size() < 78)
+            continue;
+        if (entry.type != make_fourcc("avc1") && entry.type != make_fourcc("avc3"))
+            continue;
+        if (!find_box(entry.payload.subspan(78), make_fourcc("avcC"), avcc))
+            continue;
+
+        box_reader_t header{tkhd.payload};
+        const uint32_t tkhd_version = header.u32() >> 24;
+        header.skip(tkhd_version == 1 ? 16 : 8); // creation_time, modification_time
+        const uint32_t id = header.u32();
+        box_reader_t media{mdhd.payload};
+        const uint32_t mdhd_version = media.u32() >> 24;
+        media.skip(mdhd_version == 1 ? 16 : 8);
+        const uint32_t timescale = media.u32();
+        if (!header.valid || !media.valid || id == 0 || timescale == 0)
+            return std::errc::protocol_error;
+        try {
+            config.assign(avcc.payload.begin(), avcc.payload.end());
+        } catch (const std::bad_alloc&) {
+            return std::errc::not_enough_memory;
+        }
+        track_id = id;
+        track_timescale = timescale;
+    }
+    if (track_id == 0)
+        return std::errc::not_supported;
+
+    box_view_t mvex{}, trex{};
+    if (find_box(payload, make_fourcc("mvex"), mvex)) {
+        auto children = mvex.payload;
+        while (next_box(children, make_fourcc("trex"), trex)) {
+            box_reader_t reader{trex.payload};
+            reader.skip(4);
+            if (reader.u32() != track_id)
+                continue;
+            reader.skip(4); // default_sample_description_index
+            default_duration = reader.u32();
+            default_size = reader.u32();
+            default_flags = reader.u32();
+            if (reader.valid == false)
+                return std::errc::protocol_error;
+        }
+    }
+    return std::errc{};
+}
+
+/// @brief Make the sample entries of the track in the fragment
+std::errc stream_demux_t::parse_moof(gsl::span<const uint8_t> payload, uint64_t moof_position) noexcept {
+    if (track_id == 0)
+        return std::errc::protocol_error; // `moov` is required
+    entries.clear();
+    entry_index = 0;
+    box_view_t traf{};
+    while (next_box(payload, make_fourcc("traf"), traf)) {
+        box_view_t tfhd{};
+        if (find_box(traf.payload, make_fourcc("tfhd"), tfhd) == false)
+            return std::errc::protocol_error;
+        box_reader_t header{tfhd.payload};
+        const uint32_t tf_flags = header.u32() & 0xFFFFFF;
+        if (header.u32() != track_id)
+            continue;
+        uint64_t base = moof_position;
+        uint32_t duration = default_duration, size = default_size, flags = default_flags;
+        if (tf_flags & 0x000001)
+            base = header.u64();
+        if (tf_flags & 0x000002)
+            header.skip(4); // sample_description_index
+        if (tf_flags & 0x000008)
+            duration = header.u32();
+        if (tf_flags & 0x000010)
+            size = header.u32();
+        if (tf_flags & 0x000020)
+            flags = header.u32();
+        if (header.valid == false)
+            return std::errc::protocol_error;
+
+        box_view_t tfdt{};
+        if (find_box(traf.payload, make_fourcc("tfdt"), tfdt)) {
+            box_reader_t reader{tfdt.payload};
+            const uint32_t version = reader.u32() >> 24;
+            const uint64_t time = version == 1 ? reader.u64() : reader.u32();
+            if (reader.valid == false || time > INT64_MAX)
+                return std::errc::protocol_error;
+            next_decode_time = static_cast<int64_t>(time);
+        }
+
+        uint64_t data_offset = base;
+        auto children = traf.payload;
+        box_view_t trun{};
+        while (next_box(children, make_fourcc("trun"), trun)) {
+            box_reader_t reader{trun.payload};
+            const uint32_t version_flags = reader.u32();
+            const uint32_t version = version_flags >> 24;
+            const uint32_t tr_flags = version_flags & 0xFFFFFF;
+            const uint32_t count = reader.u32();
+            if (tr_flags & 0x000001)
+                data_offset = base + static_cast<int32_t>(reader.u32());
+            uint32_t first_flags = flags;
+            if (tr_flags & 0x000004)
+                first_flags = reader.u32();
+            if (reader.valid == false)
+                return std::errc::protocol_error;
+            // the entries are bounded. `count` is not trusted
+            if (count > entries.capacity() - entries.size())
+                return std::errc::value_too_large;
+            for (uint32_t i = 0; i < count; ++i) {
+                entry_t entry{};
+                const uint32_t sample_duration = (tr_flags & 0x000100) ? reader.u32() : duration;
+                entry.size = (tr_flags & 0x000200) ? reader.u32() : size;
+                uint32_t sample_flags = (tr_flags & 0x000400) ? reader.u32() : (i == 0 ? first_flags : flags);
+                int64_t composition_offset = 0;
+                if (tr_flags & 0x000800) {
+                    const uint32_t value = reader.u32();
+                    composition_offset = version == 0 ? static_cast<int64_t>(value)
+                                                      : static_cast<int64_t>(static_cast<int32_t>(value));
+                }
+                if (reader.valid == false)
+                    return std::errc::protocol_error;
+                entry.offset = data_offset;
+                entry.decode_time = next_decode_time;
+                entry.presentation_time = next_decode_time + composition_offset;
+                entry.sync = (sample_flags & sample_is_non_sync_sample) == 0;
+                entries.emplace_back(entry); // within the reserved capacity
+                data_offset += entry.size;
+                next_decode_time += sample_duration;
+            }
+        }
+    }
+    return std::errc{};
+}
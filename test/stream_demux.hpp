@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <gsl/gsl>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+/// @brief Source of `stream_demux_t`. Unlike `IMFByteStream`, it is never asked to seek
+struct stream_input_t {
+    virtual ~stream_input_t() = default;
+
+    /// @param count 0 for the end of the stream
+    virtual std::errc read(gsl::span<uint8_t> buffer, size_t& count) noexcept = 0;
+};
+
+/// @brief Read from a file descriptor. Works with pipes, so the stream can come from `stdin`
+/// @note The descriptor is not closed by this type
+class stream_fd_input_t final : public stream_input_t {
+    int fd;
+
+  public:
+    explicit stream_fd_input_t(int fd) noexcept;
+
+    std::errc read(gsl::span<uint8_t> buffer, size_t& count) noexcept override;
+};
+
+enum class stream_format_t : uint8_t {
+    unknown = 0,
+    annexb = 1, // H.264 elementary stream
+    fmp4 = 2,   // fragmented MP4 with H.264 track
+};
+
+/// @brief Encoded access unit from `stream_demux_t`
+struct stream_sample_t final {
+    /// @brief Points the buffer of the demuxer. Valid until the next `stream_demux_t::next`
+    gsl::span<const uint8_t> data{};
+    int64_t decode_time = 0; // in `stream_demux_t::timescale`
+    int64_t presentation_time = 0;
+    bool sync = false;
+};
+
+/**
+ * @brief Demux H.264 access units from non-seekable byte stream.
+ *        The input is read into a fixed size buffer and the samples are returned as soon as their bytes are buffered.
+ *        Boxes other than `moov`/`moof`/`mdat` are skipped without buffering them.
+ *
+ * @note  The buffer is compacted(the unconsumed bytes are moved to the front) instead of wrapping around,
+ *        so each sample is contiguous in memory. A sample(or `moov`/`moof`) larger than the capacity is an error
+ *
+ * @see ITU-T H.264 Annex B Byte stream format
+ * @see ISO/IEC 14496-12 8.8 Movie Fragments
+ */
+class stream_demux_t final {
+  public:
+    static constexpr size_t default_capacity = 8 << 20;
+    static constexpr size_t max_fragment_samples = 16384;
+
+  private:
+    struct entry_t final {
+        uint64_t offset = 0; // stream offset of the sample data
+        uint32_t size = 0;
+        int64_t decode_time = 0;
+        int64_t presentation_time = 0;
+        bool sync = false;
+    };
+
+    stream_input_t& input;
+    std::unique_ptr<uint8_t[]> buffer;
+    const size_t capacity;
+    size_t head = 0;       // the first unconsumed byte
+    size_t tail = 0;       // the end of the buffered bytes
+    uint64_t position = 0; // stream offset of `buffer[head]`
+    size_t emitted = 0;    // size of the last sample. consumed by the next `next`
+    bool end_of_stream = false;
+    stream_format_t stream_format = stream_format_t::unknown;
+    std::vector<uint8_t> config{}; // `avcC` or Annex B SPS/PPS
+    // Annex B
+    size_t scan = 0; // offset from `head` to continue the start code search
+    bool has_vcl = false;
+    int64_t frame_count = 0;
+    // fMP4
+    uint32_t track_id = 0;
+    uint32_t track_timescale = 0;
+    uint32_t default_duration = 0; // from `trex`
+    uint32_t default_size = 0;
+    uint32_t default_flags = 0;
+    std::vector<entry_t> entries{};
+    size_t entry_index = 0;
+    uint64_t mdat_end = 0; // 0 if not in `mdat`
+    int64_t next_decode_time = 0;
+
+  public:
+    /// @throws std::bad_alloc
+    explicit stream_demux_t(stream_input_t& input, size_t capacity = default_capacity) noexcept(false);
+
+    /// @return `std::errc::no_message_available` at the end of the stream
+    std::errc next(stream_sample_t& sample) noexcept;
+
+    /// @note `stream_format_t::unknown` until the first `next`
+    [[nodiscard]] stream_format_t format() const noexcept {
+        return stream_format;
+    }
+    /// @brief 0 for Annex B. The timestamps of the samples are decoding order index in the case
+    [[nodiscard]] uint32_t timescale() const noexcept {
+        return track_timescale;
+    }
+    /// @brief `avcC` for fMP4, the last SPS/PPS with start codes for Annex B
+    [[nodiscard]] gsl::span<const uint8_t> sequence_header() const noexcept {
+        return config;
+    }
+    /// @brief Size of the NAL unit length prefix of the samples. 0 for Annex B
+    [[nodiscard]] uint32_t length_size() const noexcept;
+
+  private:
+    std::errc fill(size_t count) noexcept;
+    std::errc skip(uint64_t count) noexcept;
+    std::errc detect() noexcept;
+    std::errc next_annexb(stream_sample_t& sample) noexcept;
+    std::errc next_fmp4(stream_sample_t& sample) noexcept;
+    std::errc parse_moov(gsl::span<const uint8_t> payload) noexcept;
+    std::errc parse_moof(gsl::span<const uint8_t> payload, uint64_t moof_position) noexcept;
+};
@@ -0,0 +1,260 @@
+#include "stream_executor.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <thread>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fstream>
+#endif
+
+namespace {
+
+void set_numa_node(cpu_topology_t& topology, uint32_t cpu, uint32_t node) noexcept(false) {
+    if (topology.numa_nodes.size() <= cpu)
+        topology.numa_nodes.resize(cpu + 1);
+    topology.numa_nodes[cpu] = node;
+}
+
+#if !defined(_WIN32)
+/// @brief Parse the list like "0-3,8,10-11" of the sysfs
+bool parse_cpu_list(const std::string& text, std::vector<uint32_t>& values) noexcept(false) {
+    size_t offset = 0;
+    while (offset < text.size()) {
+        size_t end = text.find(',', offset);
+        if (end == std::string::npos)
+            end = text.size();
+        const std::string token = text.substr(offset, end - offset);
+        offset = end + 1;
+        if (token.empty())
+            continue;
+        const size_t dash = token.find('-');
+        try {
+            const auto first = static_cast<uint32_t>(std::stoul(token.substr(0, dash)));
+            const auto last =
+                dash == std::string::npos ? first : static_cast<uint32_t>(std::stoul(token.substr(dash + 1)));
+            for (uint32_t value = first; value <= last; ++value)
+                values.emplace_back(value);
+        } catch (const std::logic_error&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_cpu_list(const std::string& path, std::vector<uint32_t>& values) noexcept(false) {
+    std::ifstream stream{path};
+    std::string text{};
+    if (!std::getline(stream, text))
+        return false;
+    return parse_cpu_list(text, values);
+}
+#endif
+
+} // namespace
+
+std::errc get_cpu_topology(cpu_topology_t& topology) noexcept {
+    try {
+        topology.numa_nodes.clear();
+#if defined(_WIN32)
+        DWORD length = 0;
+        GetLogicalProcessorInformationEx(RelationNumaNode, nullptr, &length);
+        std::vector<std::byte> buffer(length);
+        auto* head = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+        if (length && GetLogicalProcessorInformationEx(RelationNumaNode, head, &length)) {
+            for (DWORD offset = 0; offset < length;) {
+                const auto* info =
+                    reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+                const GROUP_AFFINITY& affinity = info->NumaNode.GroupMask;
+                for (uint32_t bit = 0; bit < 64; ++bit)
+                    if (affinity.Mask & (KAFFINITY{1} << bit))
+                        set_numa_node(topology, affinity.Group * 64u + bit, info->NumaNode.NodeNumber);
+                offset += info->Size;
+            }
+        }
+#else
+        std::vector<uint32_t> nodes{};
+        if (read_cpu_list("/sys/devices/system/node/online", nodes)) {
+            for (uint32_t node : nodes) {
+                std::vector<uint32_t> cpus{};
+                if (read_cpu_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpus) == false)
+                    continue;
+                for (uint32_t cpu : cpus)
+                    set_numa_node(topology, cpu, node);
+            }
+        }
+#endif
+        if (topology.numa_nodes.empty())
+            topology.numa_nodes.resize(std::max(std::thread::hardware_concurrency(), 1u));
+        return std::errc{};
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+}
+
+std::vector<std::vector<uint32_t>> make_core_groups(const cpu_topology_t& topology, uint32_t group_size,
+                                                    bool numa_aware) noexcept(false) {
+    if (group_size == 0)
+        group_size = 1;
+    std::map<uint32_t, std::vector<uint32_t>> nodes{}; // node -> processors
+    for (uint32_t cpu = 0; cpu < topology.processor_count(); ++cpu)
+        nodes[numa_aware ? topology.numa_nodes[cpu] : 0].emplace_back(cpu);
+    std::vector<std::vector<uint32_t>> groups{};
+    for (const auto& [node, cpus] : nodes) {
+        for (size_t offset = 0; offset < cpus.size(); offset += group_size) {
+            const size_t count = std::min<size_t>(group_size, cpus.size() - offset);
+            groups.emplace_back(cpus.begin() + offset, cpus.begin() + offset + count);
+        }
+    }
+    return groups;
+}
+
+executor_stream_t::executor_stream_t(stream_executor_t& executor, uint32_t max_in_flight,
+                                     uint32_t group) noexcept(false)
+    : executor{&executor}, tasks(max_in_flight), group{group} {
+    free_tasks.reserve(tasks.size());
+    for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+        it->stream = this;
+        free_tasks.emplace_back(&*it);
+    }
+}
+
+executor_stream_stats_t executor_stream_t::stats() const noexcept {
+    executor_stream_stats_t result{};
+    result.submitted = submitted;
+    result.completed = completed;
+    result.rejected = rejected;
+    result.migrations = migrations;
+    result.group = group;
+    result.in_flight = in_flight;
+    return result;
+}
+
+auto executor_stream_t::acquire() noexcept -> task_t* {
+    std::lock_guard lck{mtx};
+    if (free_tasks.empty())
+        return nullptr;
+    task_t* task = free_tasks.back();
+    free_tasks.pop_back();
+    return task;
+}
+
+void executor_stream_t::release(task_t* task) noexcept {
+    std::lock_guard lck{mtx};
+    free_tasks.emplace_back(task); // never grows over the reserved capacity
+}
+
+stream_executor_t::stream_executor_t(const std::vector<std::vector<uint32_t>>& cpus,
+                                     stream_executor_config_t config) noexcept(false)
+    : config{config} {
+    if (cpus.empty())
+        throw std::system_error{std::make_error_code(std::errc::invalid_argument)};
+    for (const auto& group_cpus : cpus) {
+        auto group = std::make_unique<group_t>();
+        if (config.affinity)
+            group->scheduler = std::make_unique<work_scheduler_t>(gsl::span<const uint32_t>{group_cpus});
+        else
+            group->scheduler = std::make_unique<work_scheduler_t>(static_cast<uint32_t>(group_cpus.size()));
+        groups.emplace_back(std::move(group));
+    }
+}
+
+stream_executor_t::~stream_executor_t() noexcept {
+    // the workers touch the streams and the groups until the last item
+    for (auto& group : groups)
+        group->scheduler.reset();
+}
+
+std::errc stream_executor_t::open(uint32_t max_in_flight, executor_stream_t*& stream) noexcept {
+    if (max_in_flight == 0)
+        return std::errc::invalid_argument;
+    auto less = [](const std::unique_ptr<group_t>& lhs, const std::unique_ptr<group_t>& rhs) {
+        if (lhs->streams != rhs->streams)
+            return lhs->streams < rhs->streams;
+        return lhs->load < rhs->load;
+    };
+    try {
+        std::lock_guard lck{mtx};
+        const auto index = static_cast<uint32_t>(std::min_element(groups.begin(), groups.end(), less) - groups.begin());
+        streams.emplace_back(std::make_unique<executor_stream_t>(*this, max_in_flight, index));
+        ++groups[index]->streams;
+        stream = streams.back().get();
+        return std::errc{};
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+}
+
+std::errc stream_executor_t::close(executor_stream_t* stream) noexcept {
+    if (stream == nullptr || stream->executor != this)
+        return std::errc::invalid_argument;
+    while (stream->in_flight)
+        std::this_thread::yield();
+    std::lock_guard lck{mtx};
+    auto it = std::find_if(streams.begin(), streams.end(), [stream](const auto& s) { return s.get() == stream; });
+    if (it == streams.end())
+        return std::errc::invalid_argument;
+    --groups[stream->group]->streams;
+    streams.erase(it);
+    return std::errc{};
+}
+
+void stream_executor_t::rebalance(executor_stream_t& stream) noexcept {
+    const uint32_t current = stream.group;
+    const uint32_t load = groups[current]->load;
+    if (load < config.rebalance_load)
+        return;
+    uint32_t target = current;
+    for (uint32_t i = 0; i < groups.size(); ++i)
+        if (groups[i]->load < groups[target]->load)
+            target = i;
+    // move only when it's clearly better. the stream loses the warm cache
+    if (target == current || groups[target]->load * 2 > load)
+        return;
+    --groups[current]->streams;
+    ++groups[target]->streams;
+    stream.group = target;
+    ++stream.migrations;
+}
+
+std::errc stream_executor_t::submit(executor_stream_t& stream, work_item_t item, int32_t priority) noexcept {
+    if (item.invoke == nullptr || stream.executor != this)
+        return std::errc::invalid_argument;
+    if (stream.in_flight == 0) // nothing to reorder
+        rebalance(stream);
+    executor_stream_t::task_t* task = stream.acquire();
+    if (task == nullptr) {
+        ++stream.rejected;
+        return std::errc::resource_unavailable_try_again;
+    }
+    task->item = item;
+    task->group = stream.group;
+    group_t& group = *groups[task->group];
+    ++stream.in_flight;
+    ++stream.submitted;
+    ++group.load;
+    if (auto ec = group.scheduler->put(work_item_t{&stream_executor_t::invoke, task}, priority); ec != std::errc{}) {
+        --group.load;
+        --stream.submitted;
+        stream.release(task);
+        --stream.in_flight;
+        return ec;
+    }
+    return std::errc{};
+}
+
+void stream_executor_t::invoke(void* context) noexcept {
+    auto* task = static_cast<executor_stream_t::task_t*>(context);
+    task->item.invoke(task->item.context);
+    task->stream->executor->complete(task);
+}
+
+void stream_executor_t::complete(executor_stream_t::task_t* task) noexcept {
+    executor_stream_t& stream = *task->stream;
+    --groups[task->group]->load;
+    ++stream.completed;
+    stream.release(task);
+    --stream.in_flight; // `close` may destroy the stream after this
+}
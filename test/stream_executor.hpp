@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "work_scheduler.hpp"
+
+struct cpu_topology_t final {
+    std::vector<uint32_t> numa_nodes{}; // NUMA node of each logical processor. the index is the processor number
+
+  public:
+    [[nodiscard]] uint32_t processor_count() const noexcept {
+        return static_cast<uint32_t>(numa_nodes.size());
+    }
+};
+
+/**
+ * @brief Find the NUMA node of the logical processors.
+ *        If the system doesn't tell, all `std::thread::hardware_concurrency` processors are in the node 0
+ * @see GetLogicalProcessorInformationEx
+ * @see /sys/devices/system/node/node*\/cpulist
+ */
+std::errc get_cpu_topology(cpu_topology_t& topology) noexcept;
+
+/**
+ * @brief Split the logical processors into the groups of `group_size`. The last one of a node may be smaller
+ * @param numa_aware if true, a group never spans the NUMA nodes. The memory of a stream stays in one node
+ */
+std::vector<std::vector<uint32_t>> make_core_groups(const cpu_topology_t& topology, uint32_t group_size,
+                                                    bool numa_aware) noexcept(false);
+
+struct stream_executor_config_t final {
+    /// @brief The stream in the group with this many pending items moves to the other group when it's idle
+    uint32_t rebalance_load = 8;
+    /// @brief Bind the workers to the processors of their group
+    bool affinity = true;
+};
+
+struct executor_stream_stats_t final {
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t rejected = 0;   // `submit` over the in-flight limit
+    uint32_t migrations = 0; // moved to the other group
+    uint32_t group = 0;
+    uint32_t in_flight = 0;
+};
+
+class stream_executor_t;
+
+/**
+ * @brief Frames of a stream which are running or waiting in the `stream_executor_t`.
+ *        The slots are allocated when it's opened, so the `submit` doesn't allocate
+ */
+class executor_stream_t final {
+    friend class stream_executor_t;
+
+    struct task_t final {
+        executor_stream_t* stream = nullptr;
+        work_item_t item{};
+        uint32_t group = 0; // where the item was put. the stream may move before it completes
+    };
+
+    stream_executor_t* executor = nullptr;
+    std::vector<task_t> tasks{};
+    std::mutex mtx{};                  // guards `free_tasks`
+    std::vector<task_t*> free_tasks{}; // LIFO. the recent one is likely in the cache
+    std::atomic<uint32_t> group{0};
+    std::atomic<uint32_t> in_flight{0};
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint32_t> migrations{0};
+
+  public:
+    executor_stream_t(stream_executor_t& executor, uint32_t max_in_flight, uint32_t group) noexcept(false);
+    executor_stream_t(const executor_stream_t&) = delete;
+    executor_stream_t(executor_stream_t&&) = delete;
+    executor_stream_t& operator=(const executor_stream_t&) = delete;
+    executor_stream_t& operator=(executor_stream_t&&) = delete;
+
+    [[nodiscard]] uint32_t max_in_flight() const noexcept {
+        return static_cast<uint32_t>(tasks.size());
+    }
+    [[nodiscard]] executor_stream_stats_t stats() const noexcept;
+
+  private:
+    task_t* acquire() noexcept;
+    void release(task_t* task) noexcept;
+};
+
+/**
+ * @brief Runs the frames of the multiple streams. Each core group has its own `work_scheduler_t`,
+ *        and a stream is assigned to one group so its frames stay in the cache of the group's processors.
+ *
+ * @note  The number of the in-flight frames of each stream is bounded. `submit` over the limit is rejected
+ *        and the caller should hold the next frame (the credit of `stage_graph_t` works in the same way).
+ * @note  When a stream stalls, the frames of its group wait behind it. The other streams of the group move to
+ *        the least loaded group when they don't have the in-flight frame, so the move doesn't reorder them.
+ * @note  The frames of a stream run in the submission order only with `max_in_flight` 1. Over 1, they run at
+ *        the same time on the group's workers and may complete out of order
+ * @see   MFAllocateWorkQueueEx, IMFRealTimeClient::SetWorkQueue
+ */
+class stream_executor_t final {
+    friend class executor_stream_t;
+
+    struct group_t final {
+        std::unique_ptr<work_scheduler_t> scheduler{};
+        std::atomic<uint32_t> load{0};    // in-flight items of the group
+        std::atomic<uint32_t> streams{0}; // assigned streams
+    };
+
+    stream_executor_config_t config{};
+    std::vector<std::unique_ptr<group_t>> groups{};
+    std::mutex mtx{}; // guards `streams`
+    std::vector<std::unique_ptr<executor_stream_t>> streams{};
+
+  public:
+    /// @param cpus logical processors of each group. @see make_core_groups
+    /// @throws std::system_error if the workers can't be created
+    stream_executor_t(const std::vector<std::vector<uint32_t>>& cpus, stream_executor_config_t config) noexcept(false);
+    /// @brief Wait for the in-flight items of all streams
+    ~stream_executor_t() noexcept;
+    stream_executor_t(const stream_executor_t&) = delete;
+    stream_executor_t(stream_executor_t&&) = delete;
+    stream_executor_t& operator=(const stream_executor_t&) = delete;
+    stream_executor_t& operator=(stream_executor_t&&) = delete;
+
+    /**
+     * @brief Create a stream in the group with the fewest streams
+     * @param max_in_flight at least 1. 1 for the stream which needs its frames in order
+     * @param stream the pointer is valid until `close`
+     */
+    std::errc open(uint32_t max_in_flight, executor_stream_t*& stream) noexcept;
+    /// @brief Wait for the in-flight items of the stream and destroy it
+    std::errc close(executor_stream_t* stream) noexcept;
+
+    /**
+     * @return `std::errc::resource_unavailable_try_again` if the stream already has `max_in_flight` items.
+     *         `std::errc::operation_canceled` if the group's scheduler is stopped
+     * @note   Only one thread submits the items of a stream at a time
+     */
+    std::errc submit(executor_stream_t& stream, work_item_t item, int32_t priority = 0) noexcept;
+
+    [[nodiscard]] uint32_t group_count() const noexcept {
+        return static_cast<uint32_t>(groups.size());
+    }
+    [[nodiscard]] uint32_t group_load(uint32_t group) const noexcept {
+        return groups[group]->load;
+    }
+
+  private:
+    /// @brief Move the idle stream if its group is overloaded by the others
+    void rebalance(executor_stream_t& stream) noexcept;
+    void complete(executor_stream_t::task_t* task) noexcept;
+    static void invoke(void* context) noexcept;
+};
@@ -1,37 +1,29 @@
+#include <algorithm>
+#include <cstring>
 #include <fmt/format.h>
+#include <iterator>
 #include <mfapi.h>
 #include <mferror.h>
+#include <numeric>
+#include <string>
+#include <string_view>
 #include <system_error>
 
+#include "unicode.hpp"
+
+/// @note UTF-8 regardless of the locale
 std::string w2mb(std::wstring_view in) noexcept(false) {
+    static_assert(sizeof(wchar_t) == sizeof(char16_t));
     std::string out{};
-    out.reserve(MB_CUR_MAX * in.length());
-    mbstate_t state{};
-    for (wchar_t wc : in) {
-        size_t len = 0;
-        char mb[8]{}; // ensure null-terminated for UTF-8 (maximum 4 byte)
-        if (auto ec = wcrtomb_s(&len, mb, wc, &state))
-            throw std::system_error{ec, std::system_category(), "wcrtomb_s"};
-        out += std::string_view{mb, len};
-    }
+    if (auto ec = utf16_to_utf8({reinterpret_cast<const char16_t*>(in.data()), in.size()}, out); ec != std::errc{})
+        throw std::system_error{std::make_error_code(ec), "utf16_to_utf8"};
     return out;
 }
 
 std::wstring mb2w(std::string_view in) noexcept(false) {
     std::wstring out{};
-    out.reserve(in.length());
-    const char* ptr = in.data();
-    const char* const end = in.data() + in.length();
-    mbstate_t state{};
-    wchar_t wc{};
-    while (size_t len = mbrtowc(&wc, ptr, end - ptr, &state)) {
-        if (len == static_cast<size_t>(-1)) // bad encoding
-            throw std::system_error{errno, std::system_category(), "mbrtowc"};
-        if (len == static_cast<size_t>(-2)) // valid but incomplete
-            break;                          // nothing to do more
-        out.push_back(wc);
-        ptr += len; // advance [1...n]
-    }
+    if (auto ec = utf8_to_utf16(in, out); ec != std::errc{})
+        throw std::system_error{std::make_error_code(ec), "utf8_to_utf16"};
     return out;
 }
 
@@ -39,188 +31,349 @@ std::string to_hex_string(HRESULT hr) noexcept {
     return fmt::format("{:#08x}", static_cast<uint32_t>(hr));
 }
 
-std::string to_guid_string(const GUID& guid) noexcept {
-    constexpr auto bufsz = 40;
-    wchar_t buf[bufsz]{};
-    size_t buflen = StringFromGUID2(guid, buf, bufsz);
-    return w2mb({buf + 1, buflen - 3}); // GUID requires 36 characters
-}
+namespace {
+
+struct mf_name_t final {
+    const GUID* guid;
+    std::string_view name;
+};
 
+/// @note The GUIDs are in `mfuuid.lib`, so only their addresses are the constant expressions
 /// @see https://docs.microsoft.com/en-us/windows/win32/wmformat/media-type-identifiers
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/media-type-debugging-code
-std::string to_mf_string(const GUID& guid) noexcept {
-#ifndef IF_EQUAL_RETURN
-#define IF_EQUAL_RETURN(param, val)                                                                                    \
-    if (val == param)                                                                                                  \
-    return #val
-#endif
-    IF_EQUAL_RETURN(guid, MF_MT_MAJOR_TYPE);
-    IF_EQUAL_RETURN(guid, MF_MT_MAJOR_TYPE);
-    IF_EQUAL_RETURN(guid, MF_MT_SUBTYPE);
-    IF_EQUAL_RETURN(guid, MF_MT_ALL_SAMPLES_INDEPENDENT);
-    IF_EQUAL_RETURN(guid, MF_MT_FIXED_SIZE_SAMPLES);
-    IF_EQUAL_RETURN(guid, MF_MT_COMPRESSED);
-    IF_EQUAL_RETURN(guid, MF_MT_SAMPLE_SIZE);
-    IF_EQUAL_RETURN(guid, MF_MT_WRAPPED_TYPE);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_NUM_CHANNELS);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_SAMPLES_PER_SECOND);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_AVG_BYTES_PER_SECOND);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_BLOCK_ALIGNMENT);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_BITS_PER_SAMPLE);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_VALID_BITS_PER_SAMPLE);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_SAMPLES_PER_BLOCK);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_CHANNEL_MASK);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_FOLDDOWN_MATRIX);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_PEAKREF);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_PEAKTARGET);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_AVGREF);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_WMADRC_AVGTARGET);
-    IF_EQUAL_RETURN(guid, MF_MT_AUDIO_PREFER_WAVEFORMATEX);
-    IF_EQUAL_RETURN(guid, MF_MT_AAC_PAYLOAD_TYPE);
-    IF_EQUAL_RETURN(guid, MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION);
-    IF_EQUAL_RETURN(guid, MF_MT_FRAME_SIZE);
-    IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE);
-    IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE_RANGE_MAX);
-    IF_EQUAL_RETURN(guid, MF_MT_FRAME_RATE_RANGE_MIN);
-    IF_EQUAL_RETURN(guid, MF_MT_PIXEL_ASPECT_RATIO);
-    IF_EQUAL_RETURN(guid, MF_MT_DRM_FLAGS);
-    IF_EQUAL_RETURN(guid, MF_MT_PAD_CONTROL_FLAGS);
-    IF_EQUAL_RETURN(guid, MF_MT_SOURCE_CONTENT_HINT);
-    IF_EQUAL_RETURN(guid, MF_MT_VIDEO_CHROMA_SITING);
-    IF_EQUAL_RETURN(guid, MF_MT_INTERLACE_MODE);
-    IF_EQUAL_RETURN(guid, MF_MT_TRANSFER_FUNCTION);
-    IF_EQUAL_RETURN(guid, MF_MT_VIDEO_PRIMARIES);
-    IF_EQUAL_RETURN(guid, MF_MT_CUSTOM_VIDEO_PRIMARIES);
-    IF_EQUAL_RETURN(guid, MF_MT_YUV_MATRIX);
-    IF_EQUAL_RETURN(guid, MF_MT_VIDEO_LIGHTING);
-    IF_EQUAL_RETURN(guid, MF_MT_VIDEO_NOMINAL_RANGE);
-    IF_EQUAL_RETURN(guid, MF_MT_GEOMETRIC_APERTURE);
-    IF_EQUAL_RETURN(guid, MF_MT_MINIMUM_DISPLAY_APERTURE);
-    IF_EQUAL_RETURN(guid, MF_MT_PAN_SCAN_APERTURE);
-    IF_EQUAL_RETURN(guid, MF_MT_PAN_SCAN_ENABLED);
-    IF_EQUAL_RETURN(guid, MF_MT_AVG_BITRATE);
-    IF_EQUAL_RETURN(guid, MF_MT_AVG_BIT_ERROR_RATE);
-    IF_EQUAL_RETURN(guid, MF_MT_MAX_KEYFRAME_SPACING);
-    IF_EQUAL_RETURN(guid, MF_MT_DEFAULT_STRIDE);
-    IF_EQUAL_RETURN(guid, MF_MT_PALETTE);
-    IF_EQUAL_RETURN(guid, MF_MT_USER_DATA);
-    IF_EQUAL_RETURN(guid, MF_MT_AM_FORMAT_TYPE);
-    IF_EQUAL_RETURN(guid, MF_MT_MPEG_START_TIME_CODE);
-    IF_EQUAL_RETURN(guid, MF_MT_MPEG2_PROFILE);
-    IF_EQUAL_RETURN(guid, MF_MT_MPEG2_LEVEL);
-    IF_EQUAL_RETURN(guid, MF_MT_MPEG2_FLAGS);
-    IF_EQUAL_RETURN(guid, MF_MT_MPEG_SEQUENCE_HEADER);
-    IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_SRC_PACK_0);
-    IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_CTRL_PACK_0);
-    IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_SRC_PACK_1);
-    IF_EQUAL_RETURN(guid, MF_MT_DV_AAUX_CTRL_PACK_1);
-    IF_EQUAL_RETURN(guid, MF_MT_DV_VAUX_SRC_PACK);
-    IF_EQUAL_RETURN(guid, MF_MT_DV_VAUX_CTRL_PACK);
-    IF_EQUAL_RETURN(guid, MF_MT_ARBITRARY_HEADER);
-    IF_EQUAL_RETURN(guid, MF_MT_ARBITRARY_FORMAT);
-    IF_EQUAL_RETURN(guid, MF_MT_IMAGE_LOSS_TOLERANT);
-    IF_EQUAL_RETURN(guid, MF_MT_MPEG4_SAMPLE_DESCRIPTION);
-    IF_EQUAL_RETURN(guid, MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY);
-    IF_EQUAL_RETURN(guid, MF_MT_ORIGINAL_4CC);
-    IF_EQUAL_RETURN(guid, MF_MT_ORIGINAL_WAVE_FORMAT_TAG);
+#define MF_NAME(val) mf_name_t{&val, #val}
+constexpr mf_name_t mf_names[]{
+    MF_NAME(MF_MT_MAJOR_TYPE),
+    MF_NAME(MF_MT_SUBTYPE),
+    MF_NAME(MF_MT_ALL_SAMPLES_INDEPENDENT),
+    MF_NAME(MF_MT_FIXED_SIZE_SAMPLES),
+    MF_NAME(MF_MT_COMPRESSED),
+    MF_NAME(MF_MT_SAMPLE_SIZE),
+    MF_NAME(MF_MT_WRAPPED_TYPE),
+    MF_NAME(MF_MT_AUDIO_NUM_CHANNELS),
+    MF_NAME(MF_MT_AUDIO_SAMPLES_PER_SECOND),
+    MF_NAME(MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND),
+    MF_NAME(MF_MT_AUDIO_AVG_BYTES_PER_SECOND),
+    MF_NAME(MF_MT_AUDIO_BLOCK_ALIGNMENT),
+    MF_NAME(MF_MT_AUDIO_BITS_PER_SAMPLE),
+    MF_NAME(MF_MT_AUDIO_VALID_BITS_PER_SAMPLE),
+    MF_NAME(MF_MT_AUDIO_SAMPLES_PER_BLOCK),
+    MF_NAME(MF_MT_AUDIO_CHANNEL_MASK),
+    MF_NAME(MF_MT_AUDIO_FOLDDOWN_MATRIX),
+    MF_NAME(MF_MT_AUDIO_WMADRC_PEAKREF),
+    MF_NAME(MF_MT_AUDIO_WMADRC_PEAKTARGET),
+    MF_NAME(MF_MT_AUDIO_WMADRC_AVGREF),
+    MF_NAME(MF_MT_AUDIO_WMADRC_AVGTARGET),
+    MF_NAME(MF_MT_AUDIO_PREFER_WAVEFORMATEX),
+    MF_NAME(MF_MT_AAC_PAYLOAD_TYPE),
+    MF_NAME(MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION),
+    MF_NAME(MF_MT_FRAME_SIZE),
+    MF_NAME(MF_MT_FRAME_RATE),
+    MF_NAME(MF_MT_FRAME_RATE_RANGE_MAX),
+    MF_NAME(MF_MT_FRAME_RATE_RANGE_MIN),
+    MF_NAME(MF_MT_PIXEL_ASPECT_RATIO),
+    MF_NAME(MF_MT_DRM_FLAGS),
+    MF_NAME(MF_MT_PAD_CONTROL_FLAGS),
+    MF_NAME(MF_MT_SOURCE_CONTENT_HINT),
+    MF_NAME(MF_MT_VIDEO_CHROMA_SITING),
+    MF_NAME(MF_MT_INTERLACE_MODE),
+    MF_NAME(MF_MT_TRANSFER_FUNCTION),
+    MF_NAME(MF_MT_VIDEO_PRIMARIES),
+    MF_NAME(MF_MT_CUSTOM_VIDEO_PRIMARIES),
+    MF_NAME(MF_MT_YUV_MATRIX),
+    MF_NAME(MF_MT_VIDEO_LIGHTING),
+    MF_NAME(MF_MT_VIDEO_NOMINAL_RANGE),
+    MF_NAME(MF_MT_GEOMETRIC_APERTURE),
+    MF_NAME(MF_MT_MINIMUM_DISPLAY_APERTURE),
+    MF_NAME(MF_MT_PAN_SCAN_APERTURE),
+    MF_NAME(MF_MT_PAN_SCAN_ENABLED),
+    MF_NAME(MF_MT_AVG_BITRATE),
+    MF_NAME(MF_MT_AVG_BIT_ERROR_RATE),
+    MF_NAME(MF_MT_MAX_KEYFRAME_SPACING),
+    MF_NAME(MF_MT_DEFAULT_STRIDE),
+    MF_NAME(MF_MT_PALETTE),
+    MF_NAME(MF_MT_USER_DATA),
+    MF_NAME(MF_MT_AM_FORMAT_TYPE),
+    MF_NAME(MF_MT_MPEG_START_TIME_CODE),
+    MF_NAME(MF_MT_MPEG2_PROFILE),
+    MF_NAME(MF_MT_MPEG2_LEVEL),
+    MF_NAME(MF_MT_MPEG2_FLAGS),
+    MF_NAME(MF_MT_MPEG_SEQUENCE_HEADER),
+    MF_NAME(MF_MT_DV_AAUX_SRC_PACK_0),
+    MF_NAME(MF_MT_DV_AAUX_CTRL_PACK_0),
+    MF_NAME(MF_MT_DV_AAUX_SRC_PACK_1),
+    MF_NAME(MF_MT_DV_AAUX_CTRL_PACK_1),
+    MF_NAME(MF_MT_DV_VAUX_SRC_PACK),
+    MF_NAME(MF_MT_DV_VAUX_CTRL_PACK),
+    MF_NAME(MF_MT_ARBITRARY_HEADER),
+    MF_NAME(MF_MT_ARBITRARY_FORMAT),
+    MF_NAME(MF_MT_IMAGE_LOSS_TOLERANT),
+    MF_NAME(MF_MT_MPEG4_SAMPLE_DESCRIPTION),
+    MF_NAME(MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY),
+    MF_NAME(MF_MT_ORIGINAL_4CC),
+    MF_NAME(MF_MT_ORIGINAL_WAVE_FORMAT_TAG),
 
     // MF_MT_MAJOR_TYPE
-    IF_EQUAL_RETURN(guid, MFMediaType_Audio);
-    IF_EQUAL_RETURN(guid, MFMediaType_Video);
-    IF_EQUAL_RETURN(guid, MFMediaType_Protected);
-    IF_EQUAL_RETURN(guid, MFMediaType_SAMI);
-    IF_EQUAL_RETURN(guid, MFMediaType_Script);
-    IF_EQUAL_RETURN(guid, MFMediaType_Image);
-    IF_EQUAL_RETURN(guid, MFMediaType_HTML);
-    IF_EQUAL_RETURN(guid, MFMediaType_Binary);
-    IF_EQUAL_RETURN(guid, MFMediaType_FileTransfer);
+    MF_NAME(MFMediaType_Audio),
+    MF_NAME(MFMediaType_Video),
+    MF_NAME(MFMediaType_Protected),
+    MF_NAME(MFMediaType_SAMI),
+    MF_NAME(MFMediaType_Script),
+    MF_NAME(MFMediaType_Image),
+    MF_NAME(MFMediaType_HTML),
+    MF_NAME(MFMediaType_Binary),
+    MF_NAME(MFMediaType_FileTransfer),
 
     // subtype
-    IF_EQUAL_RETURN(guid, MFVideoFormat_AI44);    // FCC('AI44')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_ARGB32);  // D3DFMT_A8R8G8B8
-    IF_EQUAL_RETURN(guid, MFVideoFormat_AYUV);    // FCC('AYUV')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_DV25);    // FCC('dv25')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_DV50);    // FCC('dv50')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_DVH1);    // FCC('dvh1')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_DVSD);    // FCC('dvsd')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_DVSL);    // FCC('dvsl')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_H264);    // FCC('H264')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_H264_ES); //
-    IF_EQUAL_RETURN(guid, MFVideoFormat_I420);    // FCC('I420')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_IYUV);    // FCC('IYUV')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_M4S2);    // FCC('M4S2')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_MJPG);
-    IF_EQUAL_RETURN(guid, MFVideoFormat_MP43);   // FCC('MP43')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_MP4S);   // FCC('MP4S')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_MP4V);   // FCC('MP4V')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_MPG1);   // FCC('MPG1')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_MSS1);   // FCC('MSS1')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_MSS2);   // FCC('MSS2')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_NV11);   // FCC('NV11')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_NV12);   // FCC('NV12')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_P010);   // FCC('P010')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_P016);   // FCC('P016')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_P210);   // FCC('P210')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_P216);   // FCC('P216')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_RGB24);  // D3DFMT_R8G8B8
-    IF_EQUAL_RETURN(guid, MFVideoFormat_RGB32);  // D3DFMT_X8R8G8B8
-    IF_EQUAL_RETURN(guid, MFVideoFormat_RGB555); // D3DFMT_X1R5G5B5
-    IF_EQUAL_RETURN(guid, MFVideoFormat_RGB565); // D3DFMT_R5G6B5
-    IF_EQUAL_RETURN(guid, MFVideoFormat_RGB8);
-    IF_EQUAL_RETURN(guid, MFVideoFormat_UYVY); // FCC('UYVY')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_v210); // FCC('v210')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_v410); // FCC('v410')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_WMV1); // FCC('WMV1')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_WMV2); // FCC('WMV2')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_WMV3); // FCC('WMV3')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_WVC1); // FCC('WVC1')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_Y210); // FCC('Y210')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_Y216); // FCC('Y216')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_Y410); // FCC('Y410')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_Y416); // FCC('Y416')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_Y41P);
-    IF_EQUAL_RETURN(guid, MFVideoFormat_Y41T);
-    IF_EQUAL_RETURN(guid, MFVideoFormat_YUY2); // FCC('YUY2')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_YV12); // FCC('YV12')
-    IF_EQUAL_RETURN(guid, MFVideoFormat_YVYU);
-
-    IF_EQUAL_RETURN(guid, MFAudioFormat_PCM);              // WAVE_FORMAT_PCM
-    IF_EQUAL_RETURN(guid, MFAudioFormat_Float);            // WAVE_FORMAT_IEEE_FLOAT
-    IF_EQUAL_RETURN(guid, MFAudioFormat_DTS);              // WAVE_FORMAT_DTS
-    IF_EQUAL_RETURN(guid, MFAudioFormat_Dolby_AC3_SPDIF);  // WAVE_FORMAT_DOLBY_AC3_SPDIF
-    IF_EQUAL_RETURN(guid, MFAudioFormat_DRM);              // WAVE_FORMAT_DRM
-    IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudioV8);        // WAVE_FORMAT_WMAUDIO2
-    IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudioV9);        // WAVE_FORMAT_WMAUDIO3
-    IF_EQUAL_RETURN(guid, MFAudioFormat_WMAudio_Lossless); // WAVE_FORMAT_WMAUDIO_LOSSLESS
-    IF_EQUAL_RETURN(guid, MFAudioFormat_WMASPDIF);         // WAVE_FORMAT_WMASPDIF
-    IF_EQUAL_RETURN(guid, MFAudioFormat_MSP1);             // WAVE_FORMAT_WMAVOICE9
-    IF_EQUAL_RETURN(guid, MFAudioFormat_MP3);              // WAVE_FORMAT_MPEGLAYER3
-    IF_EQUAL_RETURN(guid, MFAudioFormat_MPEG);             // WAVE_FORMAT_MPEG
-    IF_EQUAL_RETURN(guid, MFAudioFormat_AAC);              // WAVE_FORMAT_MPEG_HEAAC
-    IF_EQUAL_RETURN(guid, MFAudioFormat_ADTS);             // WAVE_FORMAT_MPEG_ADTS_AAC
-#undef IF_EQUAL_RETURN
-    return to_guid_string(guid);
-
-    // MFVideoFormat_RGB32 // 444 (32 bpp)
-    // MFVideoFormat_ARGB32
-    // MFVideoFormat_RGB24
-    // MFVideoFormat_I420 // 420 (16 bpp)
-    // MFVideoFormat_NV12 // 420 (12 bpp)
-    // MFVideoFormat_UYVY // 422 (12 bpp)
-    // MFVideoFormat_MJPG
-    // MFVideoFormat_AI44 // 4:4:4 Packed P
-    // MFVideoFormat_AYUV // 4:4:4 Packed 8
-    // MFVideoFormat_I420 // 4:2:0 Planar 8
-    // MFVideoFormat_IYUV // 4:2:0 Planar 8
-    // MFVideoFormat_NV11 // 4:1:1 Planar 8
-    // MFVideoFormat_NV12 // 4:2:0 Planar 8
-    // MFVideoFormat_UYVY // 4:2:2 Packed 8
-    // MFVideoFormat_Y41P // 4:1:1 Packed 8
-    // MFVideoFormat_Y41T // 4:1:1 Packed 8
-    // MFVideoFormat_Y42T // 4:2:2 Packed 8
-    // MFVideoFormat_YUY2 // 4:2:2 Packed 8
-    // MFVideoFormat_YVU9 // 8:4:4 Planar 9
-    // MFVideoFormat_YV12 // 4:2:0 Planar 8
-    // MFVideoFormat_YVYU // 4:2:2 Packed 8
+    MF_NAME(MFVideoFormat_AI44),   // FCC('AI44')
+    MF_NAME(MFVideoFormat_ARGB32), // D3DFMT_A8R8G8B8
+    MF_NAME(MFVideoFormat_AYUV),   // FCC('AYUV')
+    MF_NAME(MFVideoFormat_DV25),   // FCC('dv25')
+    MF_NAME(MFVideoFormat_DV50),   // FCC('dv50')
+    MF_NAME(MFVideoFormat_DVH1),   // FCC('dvh1')
+    MF_NAME(MFVideoFormat_DVSD),   // FCC('dvsd')
+    MF_NAME(MFVideoFormat_DVSL),   // FCC('dvsl')
+    MF_NAME(MFVideoFormat_H264),   // FCC('H264')
+    MF_NAME(MFVideoFormat_H264_ES),
+    MF_NAME(MFVideoFormat_I420), // FCC('I420')
+    MF_NAME(MFVideoFormat_IYUV), // FCC('IYUV')
+    MF_NAME(MFVideoFormat_M4S2), // FCC('M4S2')
+    MF_NAME(MFVideoFormat_MJPG),
+    MF_NAME(MFVideoFormat_MP43),   // FCC('MP43')
+    MF_NAME(MFVideoFormat_MP4S),   // FCC('MP4S')
+    MF_NAME(MFVideoFormat_MP4V),   // FCC('MP4V')
+    MF_NAME(MFVideoFormat_MPG1),   // FCC('MPG1')
+    MF_NAME(MFVideoFormat_MSS1),   // FCC('MSS1')
+    MF_NAME(MFVideoFormat_MSS2),   // FCC('MSS2')
+    MF_NAME(MFVideoFormat_NV11),   // FCC('NV11')
+    MF_NAME(MFVideoFormat_NV12),   // FCC('NV12')
+    MF_NAME(MFVideoFormat_P010),   // FCC('P010')
+    MF_NAME(MFVideoFormat_P016),   // FCC('P016')
+    MF_NAME(MFVideoFormat_P210),   // FCC('P210')
+    MF_NAME(MFVideoFormat_P216),   // FCC('P216')
+    MF_NAME(MFVideoFormat_RGB24),  // D3DFMT_R8G8B8
+    MF_NAME(MFVideoFormat_RGB32),  // D3DFMT_X8R8G8B8
+    MF_NAME(MFVideoFormat_RGB555), // D3DFMT_X1R5G5B5
+    MF_NAME(MFVideoFormat_RGB565), // D3DFMT_R5G6B5
+    MF_NAME(MFVideoFormat_RGB8),
+    MF_NAME(MFVideoFormat_UYVY), // FCC('UYVY')
+    MF_NAME(MFVideoFormat_v210), // FCC('v210')
+    MF_NAME(MFVideoFormat_v410), // FCC('v410')
+    MF_NAME(MFVideoFormat_WMV1), // FCC('WMV1')
+    MF_NAME(MFVideoFormat_WMV2), // FCC('WMV2')
+    MF_NAME(MFVideoFormat_WMV3), // FCC('WMV3')
+    MF_NAME(MFVideoFormat_WVC1), // FCC('WVC1')
+    MF_NAME(MFVideoFormat_Y210), // FCC('Y210')
+    MF_NAME(MFVideoFormat_Y216), // FCC('Y216')
+    MF_NAME(MFVideoFormat_Y410), // FCC('Y410')
+    MF_NAME(MFVideoFormat_Y416), // FCC('Y416')
+    MF_NAME(MFVideoFormat_Y41P),
+    MF_NAME(MFVideoFormat_Y41T),
+    MF_NAME(MFVideoFormat_YUY2), // FCC('YUY2')
+    MF_NAME(MFVideoFormat_YV12), // FCC('YV12')
+    MF_NAME(MFVideoFormat_YVYU),
+
+    MF_NAME(MFAudioFormat_PCM),              // WAVE_FORMAT_PCM
+    MF_NAME(MFAudioFormat_Float),            // WAVE_FORMAT_IEEE_FLOAT
+    MF_NAME(MFAudioFormat_DTS),              // WAVE_FORMAT_DTS
+    MF_NAME(MFAudioFormat_Dolby_AC3_SPDIF),  // WAVE_FORMAT_DOLBY_AC3_SPDIF
+    MF_NAME(MFAudioFormat_DRM),              // WAVE_FORMAT_DRM
+    MF_NAME(MFAudioFormat_WMAudioV8),        // WAVE_FORMAT_WMAUDIO2
+    MF_NAME(MFAudioFormat_WMAudioV9),        // WAVE_FORMAT_WMAUDIO3
+    MF_NAME(MFAudioFormat_WMAudio_Lossless), // WAVE_FORMAT_WMAUDIO_LOSSLESS
+    MF_NAME(MFAudioFormat_WMASPDIF),         // WAVE_FORMAT_WMASPDIF
+    MF_NAME(MFAudioFormat_MSP1),             // WAVE_FORMAT_WMAVOICE9
+    MF_NAME(MFAudioFormat_MP3),              // WAVE_FORMAT_MPEGLAYER3
+    MF_NAME(MFAudioFormat_MPEG),             // WAVE_FORMAT_MPEG
+    MF_NAME(MFAudioFormat_AAC),              // WAVE_FORMAT_MPEG_HEAAC
+    MF_NAME(MFAudioFormat_ADTS),             // WAVE_FORMAT_MPEG_ADTS_AAC
+};
+#undef MF_NAME
+
+// MFVideoFormat_RGB32 // 444 (32 bpp)
+// MFVideoFormat_ARGB32
+// MFVideoFormat_RGB24
+// MFVideoFormat_I420 // 420 (16 bpp)
+// MFVideoFormat_NV12 // 420 (12 bpp)
+// MFVideoFormat_UYVY // 422 (12 bpp)
+// MFVideoFormat_MJPG
+// MFVideoFormat_AI44 // 4:4:4 Packed P
+// MFVideoFormat_AYUV // 4:4:4 Packed 8
+// MFVideoFormat_I420 // 4:2:0 Planar 8
+// MFVideoFormat_IYUV // 4:2:0 Planar 8
+// MFVideoFormat_NV11 // 4:1:1 Planar 8
+// MFVideoFormat_NV12 // 4:2:0 Planar 8
+// MFVideoFormat_UYVY // 4:2:2 Packed 8
+// MFVideoFormat_Y41P // 4:1:1 Packed 8
+// MFVideoFormat_Y41T // 4:1:1 Packed 8
+// MFVideoFormat_Y42T // 4:2:2 Packed 8
+// MFVideoFormat_YUY2 // 4:2:2 Packed 8
+// MFVideoFormat_YVU9 // 8:4:4 Planar 9
+// MFVideoFormat_YV12 // 4:2:0 Planar 8
+// MFVideoFormat_YVYU // 4:2:2 Packed 8
+
+uint64_t mix(uint64_t value) noexcept {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EB;
+    return value ^ (value >> 31);
+}
+
+uint64_t hash_guid(const GUID& guid, uint64_t seed) noexcept {
+    uint64_t words[2]{};
+    std::memcpy(words, &guid, sizeof(GUID));
+    return mix(words[0] ^ mix(words[1] ^ seed));
+}
+
+/**
+ * @brief Perfect hash of `mf_names` by hash and displace. The keys are grouped in the buckets, and each bucket has
+ *        the seed which puts all of its keys in the empty slots. The lookup is 2 hashes and 1 GUID comparison
+ *        instead of the comparison with every name
+ * @note  The table is built on the first use, because the GUID values are not known at compile time
+ */
+class mf_name_table_t final {
+    static constexpr size_t slot_count = 512; // power of 2
+    static constexpr size_t bucket_count = 64;
+    static_assert(std::size(mf_names) * 2 <= slot_count);
+    static_assert(std::size(mf_names) < INT16_MAX);
+
+    uint16_t seeds[bucket_count]{};
+    int16_t slots[slot_count]{}; // index of `mf_names`. -1 if empty
+    bool perfect = true;         // every bucket is placed
+
+  public:
+    mf_name_table_t() noexcept {
+        std::fill(std::begin(slots), std::end(slots), -1);
+        uint8_t sizes[bucket_count]{};
+        for (const mf_name_t& entry : mf_names)
+            ++sizes[hash_guid(*entry.guid, 0) % bucket_count];
+        // the larger buckets are harder to place. place them first
+        uint8_t order[bucket_count]{};
+        std::iota(std::begin(order), std::end(order), 0);
+        std::stable_sort(std::begin(order), std::end(order), [&sizes](uint8_t lhs, uint8_t rhs) {
+            return sizes[lhs] > sizes[rhs];
+        });
+        for (uint8_t bucket : order)
+            if (sizes[bucket] && place(bucket) == false)
+                perfect = false;
+    }
+
+    [[nodiscard]] const mf_name_t* find(const GUID& guid) const noexcept {
+        if (perfect == false) {
+            // the names of the failed bucket must be found anyway
+            auto it = std::find_if(std::begin(mf_names), std::end(mf_names),
+                                   [&guid](const mf_name_t& entry) { return *entry.guid == guid; });
+            return it == std::end(mf_names) ? nullptr : it;
+        }
+        const uint16_t seed = seeds[hash_guid(guid, 0) % bucket_count];
+        const int16_t index = slots[hash_guid(guid, seed) % slot_count];
+        if (index < 0 || *mf_names[index].guid != guid)
+            return nullptr;
+        return &mf_names[index];
+    }
+
+    /// @return false if some bucket couldn't be placed. `find` is the linear search then
+    [[nodiscard]] bool is_perfect() const noexcept {
+        return perfect;
+    }
+
+  private:
+    /// @return false if the bucket is larger than 16 keys or no seed puts it in the empty slots
+    bool place(uint8_t bucket) noexcept {
+        int16_t keys[16]{};
+        size_t count = 0;
+        for (int16_t i = 0; i < static_cast<int16_t>(std::size(mf_names)); ++i) {
+            const GUID& guid = *mf_names[i].guid;
+            if (hash_guid(guid, 0) % bucket_count != bucket)
+                continue;
+            // some names are the aliases of the other
+            if (std::any_of(keys, keys + count, [&guid](int16_t key) { return *mf_names[key].guid == guid; }))
+                continue;
+            if (count == std::size(keys))
+                return false;
+            keys[count++] = i;
+        }
+        size_t positions[16]{};
+        for (uint16_t seed = 1; seed < UINT16_MAX; ++seed) {
+            size_t placed = 0;
+            for (; placed < count; ++placed) {
+                const size_t position = hash_guid(*mf_names[keys[placed]].guid, seed) % slot_count;
+                if (slots[position] >= 0 || std::find(positions, positions + placed, position) != positions + placed)
+                    break;
+                positions[placed] = position;
+            }
+            if (placed < count)
+                continue;
+            for (size_t i = 0; i < count; ++i)
+                slots[positions[i]] = keys[i];
+            seeds[bucket] = seed;
+            return true;
+        }
+        return false;
+    }
+};
+
+const mf_name_table_t& get_mf_name_table() noexcept {
+    static const mf_name_table_t table{};
+    return table;
+}
+
+constexpr char hex_digits[] = "0123456789ABCDEF";
+
+char* format_hex(char* output, uint64_t value, int digits) noexcept {
+    for (int i = digits - 1; i >= 0; --i, value >>= 4)
+        output[i] = hex_digits[value & 0xF];
+    return output + digits;
+}
+
+} // namespace
+
+std::string_view format_guid(const GUID& guid, char (&buf)[40]) noexcept {
+    // same with `StringFromGUID2` without the braces
+    char* it = format_hex(buf, guid.Data1, 8);
+    *it++ = '-';
+    it = format_hex(it, guid.Data2, 4);
+    *it++ = '-';
+    it = format_hex(it, guid.Data3, 4);
+    *it++ = '-';
+    for (int i = 0; i < 8; ++i) {
+        if (i == 2)
+            *it++ = '-';
+        it = format_hex(it, guid.Data4[i], 2);
+    }
+    return {buf, static_cast<size_t>(it - buf)};
+}
+
+std::string to_guid_string(const GUID& guid) noexcept {
+    char buf[40]{};
+    return std::string{format_guid(guid, buf)};
+}
+
+std::string_view find_mf_name(const GUID& guid) noexcept {
+    const mf_name_t* entry = get_mf_name_table().find(guid);
+    return entry ? entry->name : std::string_view{};
+}
+
+bool get_mf_name(size_t index, GUID& guid, std::string_view& name) noexcept {
+    if (index >= std::size(mf_names))
+        return false;
+    guid = *mf_names[index].guid;
+    name = mf_names[index].name;
+    return true;
+}
+
+bool is_mf_name_table_perfect() noexcept {
+    return get_mf_name_table().is_perfect();
+}
+
+std::string_view to_mf_string(const GUID& guid, char (&buf)[40]) noexcept {
+    if (std::string_view name = find_mf_name(guid); name.empty() == false)
+        return name;
+    return format_guid(guid, buf);
+}
+
+std::string to_mf_string(const GUID& guid) noexcept {
+    char buf[40]{};
+    return std::string{to_mf_string(guid, buf)};
 }
@@ -0,0 +1,119 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "async_generator.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/// @brief Coroutine without the result. The caller waits with the `std::future`
+struct detached_task_t final {
+    struct promise_type final {
+        detached_task_t get_return_object() noexcept {
+            return {};
+        }
+        coro::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        coro::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {
+        }
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+struct counter_t final {
+    std::atomic<uint32_t> produced{0};
+    std::atomic<uint32_t> max_ahead{0};
+};
+
+async_generator_t<uint32_t> produce(counter_t& counter, uint32_t count, std::chrono::milliseconds delay) {
+    for (uint32_t i = 0; i < count; ++i) {
+        std::this_thread::sleep_for(delay); // blocking I/O like `IMFSourceReader::ReadSample`
+        ++counter.produced;
+        co_yield i;
+    }
+}
+
+async_generator_t<uint32_t> produce_error() {
+    co_yield 1u;
+    throw std::runtime_error{"read failed"};
+}
+
+detached_task_t consume(async_generator_t<uint32_t>& items, counter_t& counter, std::chrono::milliseconds delay,
+                        std::vector<uint32_t>& outputs, std::promise<void>& done) {
+    while (std::optional<uint32_t> item = co_await items.next()) {
+        outputs.emplace_back(*item);
+        std::this_thread::sleep_for(delay); // transform
+        // the items which were read during the transform
+        const uint32_t ahead = counter.produced - static_cast<uint32_t>(outputs.size());
+        if (ahead > counter.max_ahead)
+            counter.max_ahead = ahead;
+    }
+    done.set_value();
+}
+
+detached_task_t consume_error(async_generator_t<uint32_t>& items, std::promise<uint32_t>& done) {
+    uint32_t count = 0;
+    try {
+        while (co_await items.next())
+            ++count;
+    } catch (const std::runtime_error&) {
+        done.set_value(count);
+        co_return;
+    }
+    done.set_value(UINT32_MAX);
+}
+
+} // namespace
+
+TEST_CASE("Async Generator", "[thread]") {
+    work_scheduler_t scheduler{2};
+    counter_t counter{};
+    std::vector<uint32_t> outputs{};
+    std::promise<void> done{};
+
+    SECTION("read ahead") {
+        auto items = produce(counter, 20, 5ms);
+        REQUIRE(items.start(scheduler, 4) == std::errc{});
+        REQUIRE(items.start(scheduler, 4) == std::errc::operation_in_progress);
+        consume(items, counter, 5ms, outputs, done);
+        REQUIRE(done.get_future().wait_for(10s) == std::future_status::ready);
+
+        REQUIRE(outputs.size() == 20);
+        for (uint32_t i = 0; i < 20; ++i)
+            REQUIRE(outputs[i] == i);
+        REQUIRE(counter.max_ahead <= 4 + 1); // the queue and the one in the producer's hand
+        REQUIRE(counter.max_ahead > 0);      // 0 if the reads and the transforms don't overlap
+    }
+    SECTION("destroy while reading") {
+        {
+            auto items = produce(counter, 1000, 1ms);
+            REQUIRE(items.start(scheduler, 2) == std::errc{});
+            std::this_thread::sleep_for(10ms);
+        }
+        REQUIRE(counter.produced < 1000);
+    }
+    SECTION("not started") {
+        auto items = produce(counter, 10, 0ms);
+        REQUIRE(counter.produced == 0);
+    }
+    SECTION("exception") {
+        auto items = produce_error();
+        REQUIRE(items.start(scheduler, 1) == std::errc{});
+        std::promise<uint32_t> count{};
+        consume_error(items, count);
+        auto future = count.get_future();
+        REQUIRE(future.wait_for(10s) == std::future_status::ready);
+        REQUIRE(future.get() == 1);
+    }
+}
@@ -0,0 +1,140 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include "deadline_queue.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct frame_t final {
+    std::mutex* mtx = nullptr;
+    std::vector<int>* invoked = nullptr;
+    std::vector<int>* dropped = nullptr;
+    int id = 0;
+
+    static void invoke(void* context) noexcept {
+        auto self = static_cast<frame_t*>(context);
+        std::lock_guard lck{*self->mtx};
+        self->invoked->emplace_back(self->id);
+    }
+    static void drop(void* context) noexcept {
+        auto self = static_cast<frame_t*>(context);
+        std::lock_guard lck{*self->mtx};
+        self->dropped->emplace_back(self->id);
+    }
+};
+
+/// @brief Holds the worker until `release`
+struct stall_t final {
+    std::promise<void> started{};
+    std::shared_future<void> release{};
+
+    static void invoke(void* context) noexcept {
+        auto self = static_cast<stall_t*>(context);
+        self->started.set_value();
+        self->release.wait();
+    }
+};
+
+} // namespace
+
+TEST_CASE("Frame Clock", "[thread]") {
+    const auto origin = deadline_clock_t::now();
+    SECTION("frame rate") {
+        frame_clock_t clock{30000, 1001};
+        REQUIRE(clock.duration() == media_duration_t{333'666});
+        REQUIRE(frame_clock_t{0, 0}.duration() == media_duration_t{333'333});
+    }
+    SECTION("timestamp") {
+        frame_clock_t clock{25, 1, 10ms};
+        clock.reset(origin);
+        REQUIRE(clock.deadline(media_duration_t{1'000'000}, 0) == origin + 10ms); // the first frame
+        REQUIRE(clock.deadline(media_duration_t{1'400'000}, 1) == origin + 50ms);
+    }
+    SECTION("index") {
+        frame_clock_t clock{25, 1};
+        clock.reset(origin);
+        REQUIRE(clock.deadline(media_duration_t{-1}, 0) == origin + 40ms); // one frame budget
+        REQUIRE(clock.deadline(media_duration_t{-1}, 3) == origin + 160ms);
+    }
+}
+
+TEST_CASE("Deadline Queue", "[thread]") {
+    work_scheduler_t scheduler{1};
+    std::promise<void> release{};
+    stall_t stall{};
+    stall.release = release.get_future().share();
+
+    std::mutex mtx{};
+    std::vector<int> invoked{};
+    std::vector<int> dropped{};
+    std::vector<frame_t> frames(5);
+    for (int i = 0; i < 5; ++i)
+        frames[i] = frame_t{&mtx, &invoked, &dropped, i};
+
+    SECTION("earliest deadline first") {
+        const auto now = deadline_clock_t::now();
+        {
+            deadline_queue_t queue{scheduler, drop_policy_t{}};
+            REQUIRE(scheduler.put(work_item_t{&stall_t::invoke, &stall}) == std::errc{});
+            stall.started.get_future().wait();
+            const std::chrono::milliseconds offsets[5]{50s, 10s, 40s, 20s, 30s};
+            for (int i = 0; i < 5; ++i) {
+                deadline_task_t task{&frame_t::invoke, &frame_t::drop, &frames[i], now + offsets[i], false};
+                REQUIRE(queue.put(task) == std::errc{});
+            }
+            REQUIRE(queue.size() == 5);
+            release.set_value();
+        }
+        REQUIRE(invoked == std::vector<int>{1, 3, 4, 2, 0});
+        REQUIRE(dropped.empty());
+    }
+    SECTION("drop late non-reference") {
+        const auto now = deadline_clock_t::now();
+        deadline_stats_t stats{};
+        {
+            deadline_queue_t queue{scheduler, drop_policy_t{true, 5ms}};
+            REQUIRE(scheduler.put(work_item_t{&stall_t::invoke, &stall}) == std::errc{});
+            stall.started.get_future().wait();
+            REQUIRE(queue.put(deadline_task_t{&frame_t::invoke, &frame_t::drop, &frames[0], now, true}) == std::errc{});
+            REQUIRE(queue.put(deadline_task_t{&frame_t::invoke, &frame_t::drop, &frames[1], now, false}) ==
+                    std::errc{});
+            REQUIRE(queue.put(deadline_task_t{&frame_t::invoke, &frame_t::drop, &frames[2], now + 10s, false}) ==
+                    std::errc{});
+            std::this_thread::sleep_for(20ms); // the worker is busy over the tolerance
+            release.set_value();
+            // the counters are updated after the invocation
+            do {
+                std::this_thread::yield();
+                stats = queue.stats();
+            } while (stats.dropped + stats.executed < 3);
+        }
+        REQUIRE(invoked == std::vector<int>{0, 2}); // the reference frame is late, but never dropped
+        REQUIRE(dropped == std::vector<int>{1});
+        REQUIRE(stats.submitted == 3);
+        REQUIRE(stats.dropped == 1);
+        REQUIRE(stats.executed == 2);
+        REQUIRE(stats.late >= 1); // the reference frame
+    }
+    SECTION("keep late frames") {
+        const auto now = deadline_clock_t::now();
+        {
+            deadline_queue_t queue{scheduler, drop_policy_t{false, {}}};
+            for (int i = 0; i < 5; ++i)
+                REQUIRE(queue.put(deadline_task_t{&frame_t::invoke, nullptr, &frames[i], now - 1s, false}) ==
+                        std::errc{});
+            release.set_value();
+        }
+        REQUIRE(invoked.size() == 5);
+        REQUIRE(dropped.empty());
+    }
+    SECTION("invalid task") {
+        deadline_queue_t queue{scheduler, drop_policy_t{}};
+        REQUIRE(queue.put(deadline_task_t{}) == std::errc::invalid_argument);
+        release.set_value();
+    }
+}
@@ -0,0 +1,134 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "event_trace.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr trace_event_t test_event{"test", "thread {} sequence {}"};
+constexpr trace_event_t hresult_event{"ProcessOutput", "{:#08x}"};
+
+bool is_test_record(const trace_record_t& record) noexcept {
+    return record.event == &test_event || record.event == &hresult_event;
+}
+
+/// @brief The records of the other tests are logged like `main` does after the session
+void forward_record(uint32_t ring, const trace_record_t& record) {
+    fmt::memory_buffer line{};
+    format_trace_record(ring, record, line);
+    spdlog::debug("{}", std::string_view{line.data(), line.size()});
+}
+
+} // namespace
+
+TEST_CASE("Trace Ring") {
+    auto ring = std::make_unique<trace_ring_t>();
+    trace_record_t record{&test_event, 0, {}};
+    for (uint32_t i = 0; i < trace_ring_t::capacity; ++i) {
+        record.args[1] = i;
+        REQUIRE(ring->push(record));
+    }
+    REQUIRE_FALSE(ring->push(record));
+    REQUIRE(ring->dropped() == 1);
+
+    size_t peeked = 0;
+    ring->peek([&peeked](const trace_record_t&) { ++peeked; });
+    REQUIRE(peeked == trace_ring_t::capacity);
+
+    int64_t expected = 0;
+    REQUIRE(ring->consume([&expected](const trace_record_t& record) {
+        if (record.args[1] == expected)
+            ++expected;
+    }) == trace_ring_t::capacity);
+    REQUIRE(expected == trace_ring_t::capacity);
+    // the space is back
+    REQUIRE(ring->push(record));
+    REQUIRE(ring->consume([](const trace_record_t&) {}) == 1);
+}
+
+TEST_CASE("Event Trace", "[thread]") {
+    event_tracer_t& tracer = event_tracer_t::instance();
+
+    SECTION("format") {
+        trace_event(hresult_event, 0xC00D6D72u); // MF_E_TRANSFORM_NEED_MORE_INPUT
+        trace_event(test_event, 1, 2);
+        std::vector<std::pair<uint32_t, trace_record_t>> records{};
+        tracer.drain([&records](uint32_t ring, const trace_record_t& record) {
+            if (is_test_record(record))
+                records.emplace_back(ring, record);
+            else
+                forward_record(ring, record);
+        });
+        REQUIRE(records.size() == 2);
+        std::vector<std::string> lines{};
+        for (const auto& [ring, record] : records) {
+            fmt::memory_buffer line{};
+            format_trace_record(ring, record, line);
+            lines.emplace_back(line.data(), line.size());
+        }
+        REQUIRE(lines[0].find("ProcessOutput: 0xc00d6d72") != std::string::npos);
+        REQUIRE(lines[1].find("test: thread 1 sequence 2") != std::string::npos);
+    }
+    SECTION("threads") {
+        constexpr uint32_t thread_count = 4;
+        constexpr int64_t count = 20'000;
+        const uint64_t dropped = tracer.dropped();
+        std::atomic<uint32_t> finished{0};
+        std::vector<std::thread> threads{};
+        for (uint32_t t = 0; t < thread_count; ++t)
+            threads.emplace_back([t, &finished]() {
+                for (int64_t i = 0; i < count; ++i)
+                    trace_event(test_event, t, i);
+                ++finished;
+            });
+        // the order in each thread is kept. the records can be dropped when the drain is slow
+        int64_t next[thread_count]{};
+        uint32_t failures = 0;
+        uint64_t received = 0;
+        auto consume = [&](uint32_t ring, const trace_record_t& record) {
+            if (record.event != &test_event)
+                return forward_record(ring, record);
+            const auto thread = static_cast<uint32_t>(record.args[0]);
+            if (thread >= thread_count || record.args[1] < next[thread])
+                ++failures;
+            else
+                next[thread] = record.args[1] + 1;
+            ++received;
+        };
+        while (finished < thread_count)
+            tracer.drain(consume);
+        for (std::thread& thread : threads)
+            thread.join();
+        tracer.drain(consume);
+        REQUIRE(failures == 0);
+        REQUIRE(received > 0);
+        REQUIRE(received + (tracer.dropped() - dropped) == thread_count * count);
+    }
+    SECTION("drain thread") {
+        std::mutex mtx{};
+        std::vector<std::string> lines{};
+        {
+            trace_drain_t drain{1ms, [&mtx, &lines](std::string_view line) {
+                                    if (line.find("test: ") == std::string_view::npos)
+                                        return spdlog::debug("{}", line);
+                                    std::lock_guard lck{mtx};
+                                    lines.emplace_back(line);
+                                }};
+            std::thread{[]() { trace_event(test_event, 7, 8); }}.join();
+        } // the rest is drained
+        REQUIRE(lines.size() == 1);
+        REQUIRE(lines[0].find("test: thread 7 sequence 8") != std::string::npos);
+    }
+}
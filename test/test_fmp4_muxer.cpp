@@ -0,0 +1,163 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include "fmp4_muxer.hpp"
+
+namespace {
+
+struct memory_output_t final : public fmp4_output_t {
+    std::vector<uint8_t> bytes{};
+    std::vector<const void*> pointers{}; // `data` of the written slices
+    size_t flush_count = 0;
+
+  public:
+    std::errc write(gsl::span<const io_slice_t> slices) noexcept override {
+        for (const io_slice_t& slice : slices) {
+            auto ptr = static_cast<const uint8_t*>(slice.data);
+            bytes.insert(bytes.end(), ptr, ptr + slice.size);
+            pointers.emplace_back(slice.data);
+        }
+        return std::errc{};
+    }
+    std::errc flush() noexcept override {
+        ++flush_count;
+        return std::errc{};
+    }
+};
+
+struct box_t final {
+    std::string type{};
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+uint32_t read_u32(const std::vector<uint8_t>& bytes, size_t offset) {
+    return (static_cast<uint32_t>(bytes[offset]) << 24) | (static_cast<uint32_t>(bytes[offset + 1]) << 16) |
+           (static_cast<uint32_t>(bytes[offset + 2]) << 8) | bytes[offset + 3];
+}
+
+std::vector<box_t> list_boxes(const std::vector<uint8_t>& bytes, size_t offset, size_t end) {
+    std::vector<box_t> boxes{};
+    while (offset + 8 <= end) {
+        box_t box{};
+        box.size = read_u32(bytes, offset);
+        box.type.assign(reinterpret_cast<const char*>(bytes.data() + offset + 4), 4);
+        box.offset = offset;
+        REQUIRE(box.size >= 8);
+        REQUIRE(offset + box.size <= end);
+        boxes.emplace_back(box);
+        offset += box.size;
+    }
+    REQUIRE(offset == end);
+    return boxes;
+}
+
+// SPS/PPS of test-sample-0.mp4
+const uint8_t sequence_header[] = {
+    0x00, 0x00, 0x00, 0x01, 0x27, 0x4d, 0x00, 0x1f, 0x97, 0x60, 0x28, 0x02, 0xdd, 0x80, 0xa2, 0x40, 0x00,
+    0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x0f, 0x3a, 0x10, 0x00, 0x78, 0x88, 0x00, 0x01, 0xe2, 0x2d, 0xef,
+    0x7b, 0xe0, 0xed, 0x0e, 0x18, 0x9c, 0x00, 0x00, 0x00, 0x01, 0x28, 0xee, 0xbc, 0x80};
+
+} // namespace
+
+TEST_CASE("fMP4 muxer", "[mp4]") {
+    memory_output_t output{};
+    fmp4_muxer_config_t config{};
+    config.timescale = 30;
+    config.fragment_duration = 3; // 3 frames
+    config.sequence_header.assign(std::begin(sequence_header), std::end(sequence_header));
+
+    // AUD + slice. The slice payloads are fake
+    std::vector<std::vector<uint8_t>> samples{};
+    for (uint8_t i = 0; i < 7; ++i)
+        samples.emplace_back(std::vector<uint8_t>{0x00, 0x00, 0x00, 0x01, 0x09, 0x10, //
+                                                  0x00, 0x00, 0x01, static_cast<uint8_t>(i ? 0x21 : 0x25), 0x88,
+                                                  static_cast<uint8_t>(i + 1)});
+
+    fmp4_muxer_t muxer{output, config};
+    REQUIRE(muxer.write_header() == std::errc{});
+    auto top = list_boxes(output.bytes, 0, output.bytes.size());
+    REQUIRE(top.size() == 2);
+    REQUIRE(top[0].type == "ftyp");
+    REQUIRE(top[1].type == "moov");
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        fmp4_sample_t sample{};
+        sample.data = samples[i];
+        sample.decode_time = static_cast<int64_t>(i);
+        sample.presentation_time = static_cast<int64_t>(i) + 1;
+        sample.sync = (i % 3) == 0;
+        REQUIRE(muxer.append(sample) == std::errc{});
+    }
+    REQUIRE(muxer.fragment_count() == 2); // [0,1,2] [3,4,5]. [6] is pending
+    REQUIRE(muxer.finalize() == std::errc{});
+    REQUIRE(muxer.fragment_count() == 3);
+    REQUIRE(output.flush_count == 1);
+
+    top = list_boxes(output.bytes, 0, output.bytes.size());
+    REQUIRE(top.size() == 8);
+    for (size_t i = 2; i < top.size(); i += 2) {
+        const box_t& moof = top[i];
+        const box_t& mdat = top[i + 1];
+        REQUIRE(moof.type == "moof");
+        REQUIRE(mdat.type == "mdat");
+        auto children = list_boxes(output.bytes, moof.offset + 8, moof.offset + moof.size);
+        REQUIRE(children.size() == 2);
+        REQUIRE(children[0].type == "mfhd");
+        REQUIRE(read_u32(output.bytes, children[0].offset + 12) == i / 2); // sequence_number
+        auto traf = list_boxes(output.bytes, children[1].offset + 8, children[1].offset + children[1].size);
+        REQUIRE(traf.size() == 3);
+        REQUIRE(traf[2].type == "trun");
+        const size_t count = read_u32(output.bytes, traf[2].offset + 12);
+        REQUIRE(count == (i == 6 ? 1 : 3));
+        // data_offset points the payload of `mdat`
+        REQUIRE(moof.offset + read_u32(output.bytes, traf[2].offset + 16) == mdat.offset + 8);
+        // AUD is removed. 4 byte length + 3 byte slice
+        REQUIRE(mdat.size == 8 + count * 7);
+        REQUIRE(read_u32(output.bytes, mdat.offset + 8) == 3);
+        const size_t first_duration = read_u32(output.bytes, traf[2].offset + 20);
+        REQUIRE(first_duration == 1);
+    }
+    SECTION("NAL units are not copied") {
+        bool found = false;
+        for (const void* ptr : output.pointers)
+            found |= (ptr == samples[6].data() + 9);
+        REQUIRE(found);
+    }
+}
+
+TEST_CASE("fMP4 muxer - bounded fragment", "[mp4]") {
+    memory_output_t output{};
+    fmp4_muxer_config_t config{};
+    config.sequence_header.assign(std::begin(sequence_header), std::end(sequence_header));
+    config.max_samples = 2;
+    fmp4_muxer_t muxer{output, config};
+
+    const uint8_t frame[] = {0x00, 0x00, 0x01, 0x21, 0x88, 0x00};
+    for (int64_t i = 0; i < 5; ++i) {
+        fmp4_sample_t sample{};
+        sample.data = frame;
+        sample.decode_time = sample.presentation_time = i * 3000;
+        sample.sync = i == 0;
+        REQUIRE(muxer.append(sample) == std::errc{}); // the header is written by the first `append`
+    }
+    REQUIRE(muxer.fragment_count() == 2);
+
+    SECTION("too large sample") {
+        std::vector<uint8_t> large(config.max_bytes + 1, 0xFF);
+        large[0] = large[1] = 0x00;
+        large[2] = 0x01;
+        large[3] = 0x21;
+        fmp4_sample_t sample{};
+        sample.data = large;
+        REQUIRE(muxer.append(sample) == std::errc::value_too_large);
+    }
+    SECTION("no NAL unit") {
+        const uint8_t garbage[] = {0xFF, 0xFF, 0xFF};
+        fmp4_sample_t sample{};
+        sample.data = garbage;
+        REQUIRE(muxer.append(sample) == std::errc::invalid_argument);
+    }
+}
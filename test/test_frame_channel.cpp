@@ -0,0 +1,192 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "frame_channel.hpp"
+
+namespace {
+
+/// @brief The consumer side of the handle. Another process in the real use
+std::errc share_handle(const frame_channel_t& producer, native_handle_t& handle) {
+#if defined(_WIN32)
+    return duplicate_handle(producer.native_handle(), GetCurrentProcessId(), handle);
+#else
+    int sockets[2]{};
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0)
+        return static_cast<std::errc>(errno);
+    auto on_return = gsl::finally([&sockets]() {
+        close(sockets[0]);
+        close(sockets[1]);
+    });
+    if (auto ec = send_handle(sockets[0], producer.native_handle()); ec != std::errc{})
+        return ec;
+    return receive_handle(sockets[1], handle);
+#endif
+}
+
+/// @brief The slots start at the page after the metadata. Same as the one in frame_channel.cpp
+size_t get_page_size() noexcept {
+#if defined(_WIN32)
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+} // namespace
+
+TEST_CASE("Frame Channel") {
+    frame_layout_t layout{};
+    REQUIRE(make_frame_layout(pixel_format_t::nv12, 640, 360, 64, layout) == std::errc{});
+    frame_channel_t producer{};
+    REQUIRE(producer.create(frame_channel_config_t{4, layout.size}) == std::errc{});
+    REQUIRE(producer.capacity() >= layout.size);
+    native_handle_t handle{};
+    REQUIRE(share_handle(producer, handle) == std::errc{});
+    frame_channel_t consumer{};
+    REQUIRE(consumer.open(handle) == std::errc{});
+    REQUIRE(consumer.capacity() == producer.capacity());
+
+    SECTION("zero copy") {
+        uint32_t slot = 0;
+        gsl::span<uint8_t> memory{};
+        REQUIRE(producer.acquire(slot, memory) == std::errc{});
+        std::memset(memory.data(), 0x7F, layout.size);
+        frame_descriptor_t frame{slot, static_cast<uint32_t>(layout.size), 333'333, 333'333, layout.format, 640, 360};
+        REQUIRE(producer.publish(frame) == std::errc{});
+
+        frame_descriptor_t received{};
+        gsl::span<const uint8_t> view{};
+        REQUIRE(consumer.receive(received, view) == std::errc{});
+        REQUIRE(received.slot == slot);
+        REQUIRE(received.time == 333'333);
+        REQUIRE(received.format == pixel_format_t::nv12);
+        REQUIRE(view.size() == layout.size);
+        REQUIRE(view.data() != memory.data()); // the other mapping of the same memory
+        REQUIRE(view[layout.size - 1] == 0x7F);
+        memory[0] = 1; // not a copy
+        REQUIRE(view[0] == 1);
+        REQUIRE(consumer.receive(received, view) == std::errc::resource_unavailable_try_again);
+        REQUIRE(consumer.release(slot) == std::errc{});
+    }
+    SECTION("slots are bounded") {
+        uint32_t slots[4]{};
+        gsl::span<uint8_t> memory{};
+        for (uint32_t& slot : slots)
+            REQUIRE(producer.acquire(slot, memory) == std::errc{});
+        uint32_t extra = 0;
+        REQUIRE(producer.acquire(extra, memory) == std::errc::resource_unavailable_try_again);
+        REQUIRE(producer.publish(frame_descriptor_t{slots[0], 16}) == std::errc{});
+        frame_descriptor_t received{};
+        gsl::span<const uint8_t> view{};
+        REQUIRE(consumer.receive(received, view) == std::errc{});
+        REQUIRE(consumer.release(received.slot) == std::errc{});
+        REQUIRE(producer.acquire(extra, memory) == std::errc{});
+        REQUIRE(extra == slots[0]);
+        REQUIRE(producer.publish(frame_descriptor_t{7, 16}) == std::errc::invalid_argument);
+        REQUIRE(producer.publish(frame_descriptor_t{0, UINT32_MAX}) == std::errc::invalid_argument);
+    }
+    SECTION("shutdown") {
+        uint32_t slot = 0;
+        gsl::span<uint8_t> memory{};
+        REQUIRE(producer.acquire(slot, memory) == std::errc{});
+        REQUIRE(producer.publish(frame_descriptor_t{slot, 1}) == std::errc{});
+        producer.shutdown();
+        frame_descriptor_t received{};
+        gsl::span<const uint8_t> view{};
+        REQUIRE(consumer.receive(received, view) == std::errc{}); // drained first
+        REQUIRE(consumer.receive(received, view) == std::errc::no_message_available);
+    }
+}
+
+TEST_CASE("Frame Channel - invalid memory") {
+    frame_channel_t producer{};
+    REQUIRE(producer.create(frame_channel_config_t{0, 4096}) == std::errc::invalid_argument);
+    REQUIRE(producer.create(frame_channel_config_t{2, 0}) == std::errc::invalid_argument);
+    REQUIRE(producer.create(frame_channel_config_t{2, 4096}) == std::errc{});
+    native_handle_t handle{};
+    REQUIRE(share_handle(producer, handle) == std::errc{});
+    frame_channel_t consumer{};
+    REQUIRE(consumer.open(handle) == std::errc{});
+
+    // the producer writes the garbage to the header. the metadata of 2 slots is in the first page
+    uint32_t slot = 0;
+    gsl::span<uint8_t> memory{};
+    REQUIRE(producer.acquire(slot, memory) == std::errc{});
+    REQUIRE(producer.publish(frame_descriptor_t{slot, 16}) == std::errc{});
+    uint8_t* const header = memory.data() - producer.capacity() * slot - get_page_size();
+    uint32_t slot_count = 0;
+    std::memcpy(&slot_count, header + 8, sizeof(slot_count));
+    REQUIRE(slot_count == 2);
+    const uint32_t garbage = 0xFFFF;
+    std::memcpy(header + 8, &garbage, sizeof(garbage));
+
+    frame_descriptor_t received{};
+    gsl::span<const uint8_t> view{};
+    REQUIRE(consumer.receive(received, view) == std::errc{}); // the validated copy is used
+    REQUIRE(consumer.release(received.slot) == std::errc{});
+    frame_channel_t late{};
+    REQUIRE(share_handle(producer, handle) == std::errc{});
+    REQUIRE(late.open(handle) == std::errc::protocol_error);
+}
+
+TEST_CASE("Frame Channel - stream", "[thread]") {
+    frame_channel_t producer{};
+    REQUIRE(producer.create(frame_channel_config_t{4, 64 << 10}) == std::errc{});
+    native_handle_t handle{};
+    REQUIRE(share_handle(producer, handle) == std::errc{});
+    frame_channel_t consumer{};
+    REQUIRE(consumer.open(handle) == std::errc{});
+
+    constexpr uint32_t count = 1000;
+    std::atomic<uint32_t> failures{0};
+    std::thread writer{[&producer, &failures]() {
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t slot = 0;
+            gsl::span<uint8_t> memory{};
+            std::errc ec{};
+            while ((ec = producer.acquire(slot, memory)) == std::errc::resource_unavailable_try_again)
+                std::this_thread::yield();
+            if (ec != std::errc{}) {
+                ++failures;
+                break;
+            }
+            std::memset(memory.data(), static_cast<uint8_t>(i), 4096);
+            if (producer.publish(frame_descriptor_t{slot, 4096, i}) != std::errc{})
+                ++failures;
+        }
+        producer.shutdown();
+    }};
+    uint32_t received_count = 0, mismatch = 0;
+    while (true) {
+        frame_descriptor_t frame{};
+        gsl::span<const uint8_t> view{};
+        const std::errc ec = consumer.receive(frame, view);
+        if (ec == std::errc::resource_unavailable_try_again) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (ec != std::errc{})
+            break;
+        if (frame.time != received_count || view[0] != static_cast<uint8_t>(frame.time) || view[4095] != view[0])
+            ++mismatch;
+        ++received_count;
+        REQUIRE(consumer.release(frame.slot) == std::errc{});
+    }
+    writer.join();
+    REQUIRE(failures == 0);
+    REQUIRE(mismatch == 0);
+    REQUIRE(received_count == count);
+}
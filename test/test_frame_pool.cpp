@@ -0,0 +1,122 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "frame_pool.hpp"
+
+TEST_CASE("Size Class") {
+    size_class_table_t table{4096, 8 << 20, 64};
+    REQUIRE(table.capacity(0) == 4096);
+    REQUIRE(table.capacity(1) == 5120);
+    REQUIRE(table.capacity(table.size() - 1) >= (8 << 20));
+    for (size_t i = 1; i < table.size(); ++i) {
+        REQUIRE(table.capacity(i) > table.capacity(i - 1));
+        REQUIRE(table.capacity(i) % 64 == 0);
+    }
+    REQUIRE(table.find(1) == 0);
+    REQUIRE(table.find(4096) == 0);
+    REQUIRE(table.find(4097) == 1);
+    REQUIRE(table.find(9 << 20) == table.size());
+    // NV12 1080p. the waste is under 25%
+    const size_t nv12 = 1920 * 1080 * 3 / 2;
+    const size_t capacity = table.capacity(table.find(nv12));
+    REQUIRE(capacity >= nv12);
+    REQUIRE(capacity < nv12 * 5 / 4);
+}
+
+TEST_CASE("Frame Pool") {
+    frame_pool_config_t config{};
+    config.min_count = 2;
+    config.max_count = 3;
+    frame_pool_t pool{config};
+    const size_t nv12 = 1920 * 1080 * 3 / 2;
+
+    SECTION("recycle") {
+        frame_buffer_t buffer{};
+        REQUIRE(pool.acquire(nv12, buffer) == std::errc{});
+        REQUIRE(buffer.capacity() >= nv12);
+        REQUIRE(reinterpret_cast<uintptr_t>(buffer.data()) % config.alignment == 0);
+        REQUIRE(pool.stats().allocated == 2); // min_count at the first use
+        uint8_t* const ptr = buffer.data();
+        buffer.reset();
+        REQUIRE(pool.stats().outstanding == 0);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(pool.acquire(nv12, buffer) == std::errc{});
+            REQUIRE(buffer.data() == ptr); // LIFO. the warm buffer is reused
+            buffer.reset();
+        }
+        const frame_pool_stats_t stats = pool.stats();
+        REQUIRE(stats.allocated == 2);
+        REQUIRE(stats.acquired == 101);
+    }
+    SECTION("last reference") {
+        frame_buffer_t buffer{};
+        REQUIRE(pool.acquire(1000, buffer) == std::errc{});
+        frame_buffer_t copy = buffer;
+        REQUIRE(buffer.use_count() == 2);
+        frame_buffer_t moved = std::move(buffer);
+        REQUIRE_FALSE(buffer);
+        moved.reset();
+        REQUIRE(pool.stats().outstanding == 1);
+        copy = frame_buffer_t{};
+        REQUIRE(pool.stats().outstanding == 0);
+    }
+    SECTION("max count") {
+        std::vector<frame_buffer_t> buffers(3);
+        for (frame_buffer_t& buffer : buffers)
+            REQUIRE(pool.acquire(nv12, buffer) == std::errc{});
+        frame_buffer_t extra{};
+        REQUIRE(pool.acquire(nv12, extra) == std::errc::resource_unavailable_try_again);
+        REQUIRE(pool.acquire(1000, extra) == std::errc{}); // the other class
+        REQUIRE(pool.stats().exhausted == 1);
+        buffers.pop_back();
+        REQUIRE(pool.acquire(nv12, extra) == std::errc{});
+        REQUIRE(pool.stats().allocated == 3 + 2);
+    }
+    SECTION("too large") {
+        frame_buffer_t buffer{};
+        REQUIRE(pool.acquire(config.max_size * 2, buffer) == std::errc::value_too_large);
+    }
+    SECTION("prepare") {
+        REQUIRE(pool.prepare(nv12) == std::errc{});
+        REQUIRE(pool.stats().allocated == 2);
+        frame_buffer_t buffer{};
+        REQUIRE(pool.acquire(nv12, buffer) == std::errc{});
+        REQUIRE(pool.stats().allocated == 2);
+    }
+}
+
+TEST_CASE("Frame Pool - outlive", "[thread]") {
+    frame_buffer_t buffer{};
+    {
+        frame_pool_t pool{frame_pool_config_t{}};
+        REQUIRE(pool.acquire(4096, buffer) == std::errc{});
+    }
+    buffer.data()[0] = 1; // still valid
+    buffer.reset();
+
+    frame_pool_config_t config{};
+    config.max_count = 4;
+    frame_pool_t pool{config};
+    std::atomic<uint32_t> failures{0};
+    std::vector<std::thread> threads{};
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&pool, &failures]() {
+            for (int i = 0; i < 1000; ++i) {
+                frame_buffer_t item{};
+                if (pool.acquire(64 << 10, item) != std::errc{}) {
+                    ++failures;
+                    continue;
+                }
+                item.data()[0] = static_cast<uint8_t>(i);
+                frame_buffer_t other = item; // released on the other reference
+            }
+        });
+    for (auto& thread : threads)
+        thread.join();
+    REQUIRE(failures == 0);
+    REQUIRE(pool.stats().outstanding == 0);
+    REQUIRE(pool.stats().allocated <= 4);
+}
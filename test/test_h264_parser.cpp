@@ -0,0 +1,141 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "h264_parser.hpp"
+
+// `avcC` and the leading bytes of the first 12 samples in test-sample-0.mp4
+static const uint8_t avcc[] = {0x01, 0x4d, 0x00, 0x1f, 0xff, 0xe1, 0x00, 0x24, 0x27, 0x4d, 0x00, 0x1f, 0x97, 0x60,
+                               0x28, 0x02, 0xdd, 0x80, 0xa2, 0x40, 0x00, 0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x0f,
+                               0x3a, 0x10, 0x00, 0x78, 0x88, 0x00, 0x01, 0xe2, 0x2d, 0xef, 0x7b, 0xe0, 0xed, 0x0e,
+                               0x18, 0x9c, 0x01, 0x00, 0x05, 0x28, 0xee, 0xbc, 0x80, 0x00};
+static const uint8_t slices[12][16] = {
+    {0x25, 0x88, 0x80, 0x40, 0xff, 0xb8, 0xf5, 0xb4, 0xb5, 0xe0, 0x04, 0xa0, 0xae, 0x10, 0x56, 0x41},
+    {0x21, 0x9a, 0x02, 0xc3, 0xff, 0xfb, 0x71, 0x3d, 0x6e, 0x7e, 0xca, 0x34, 0x04, 0xee, 0x4e, 0x0b},
+    {0x01, 0x9e, 0x04, 0x51, 0xff, 0xfc, 0xb0, 0x03, 0xb8, 0x02, 0x64, 0xaa, 0xf6, 0x85, 0x04, 0xa3},
+    {0x01, 0x9e, 0x04, 0x91, 0xff, 0xe9, 0x98, 0xa3, 0x06, 0x4b, 0xaf, 0xcc, 0x20, 0xe4, 0x12, 0x5a},
+    {0x21, 0x9a, 0x05, 0x83, 0xff, 0xe7, 0x51, 0x5f, 0x4e, 0xe3, 0xd6, 0xfd, 0x4c, 0x2e, 0x97, 0x91},
+    {0x01, 0x9e, 0x07, 0x11, 0xff, 0xe8, 0xb2, 0x59, 0x42, 0x8f, 0xe7, 0x27, 0x4e, 0xc1, 0xa2, 0xd4},
+    {0x01, 0x9e, 0x07, 0x51, 0xff, 0xfd, 0x9c, 0xd7, 0x64, 0xf8, 0x04, 0xb3, 0xd4, 0x3c, 0xad, 0x89},
+    {0x21, 0x9a, 0x06, 0x43, 0xff, 0xa8, 0xa5, 0x1b, 0x75, 0x80, 0xa7, 0xb8, 0x22, 0xd6, 0x16, 0xc5},
+    {0x01, 0x9e, 0x09, 0xd1, 0xff, 0xfe, 0x4c, 0x41, 0xd5, 0xb5, 0x0f, 0x32, 0xa0, 0x76, 0xb7, 0x4b},
+    {0x01, 0x9e, 0x08, 0x11, 0xff, 0xfb, 0x36, 0x04, 0xd8, 0x0f, 0x2f, 0x0f, 0x07, 0x82, 0x89, 0x91},
+    {0x21, 0x9a, 0x09, 0x03, 0xff, 0xdd, 0x69, 0x63, 0x93, 0x60, 0x1e, 0xa2, 0x3a, 0xe1, 0xc0, 0xbb},
+    {0x01, 0x9e, 0x0a, 0x91, 0xff, 0xfd, 0x1c, 0xeb, 0xfa, 0x7b, 0x97, 0x3e, 0x09, 0x7d, 0xfd, 0xd3},
+};
+
+TEST_CASE("H.264 NAL unit", "[h264]") {
+    SECTION("Annex B") {
+        const uint8_t stream[] = {0x00, 0x00, 0x00, 0x01, 0x09, 0x10, // 4 byte start code
+                                  0x00, 0x00, 0x01, 0x67, 0x42,       // 3 byte start code
+                                  0x00, 0x00, 0x01,                   // empty
+                                  0x00, 0x00, 0x01, 0x65, 0x00, 0x00, 0x03, 0x01, 0x00, 0x00};
+        gsl::span<const uint8_t> remain{stream};
+        auto nal = next_annexb_nal(remain);
+        REQUIRE(nal.size() == 2);
+        REQUIRE(get_nal_type(nal) == h264_nal_type_t::aud);
+        nal = next_annexb_nal(remain);
+        REQUIRE(nal.size() == 2);
+        REQUIRE(get_nal_type(nal) == h264_nal_type_t::sps);
+        nal = next_annexb_nal(remain);
+        REQUIRE(nal.size() == 5); // emulation prevention byte stays. trailing zero is removed
+        REQUIRE(get_nal_type(nal) == h264_nal_type_t::idr);
+        nal = next_annexb_nal(remain);
+        REQUIRE(nal.empty());
+        REQUIRE(remain.empty());
+    }
+    SECTION("Length prefix") {
+        const uint8_t sample[] = {0x00, 0x00, 0x00, 0x02, 0x09, 0x30, 0x00, 0x00, 0x00, 0x09, 0x06};
+        gsl::span<const uint8_t> remain{sample};
+        auto nal = next_avcc_nal(remain, 4);
+        REQUIRE(get_nal_type(nal) == h264_nal_type_t::aud);
+        nal = next_avcc_nal(remain, 4); // the length is larger than the remaining bytes
+        REQUIRE(nal.empty());
+        REQUIRE(remain.empty());
+    }
+}
+
+TEST_CASE("H.264 Parameter Sets", "[h264]") {
+    h264_stream_analyzer_t analyzer{};
+    REQUIRE(analyzer.reorder_depth() == UINT32_MAX);
+    REQUIRE(analyzer.feed_sequence_header(avcc) == std::errc{});
+
+    const h264_sps_t* sps = analyzer.sps();
+    REQUIRE(sps);
+    REQUIRE(sps->profile_idc == 77); // Main
+    REQUIRE(sps->level_idc == 31);
+    REQUIRE(sps->width == 1280);
+    REQUIRE(sps->height == 720);
+    REQUIRE(sps->pic_order_cnt_type == 0);
+    REQUIRE(sps->vui_parameters_present_flag);
+    REQUIRE(sps->timing_info_present_flag);
+    REQUIRE(sps->max_dpb_frames() == 5);
+    REQUIRE(sps->bitstream_restriction_flag);
+    REQUIRE(sps->max_num_reorder_frames == 1);
+    REQUIRE(analyzer.reorder_depth() == sps->reorder_depth());
+    REQUIRE(analyzer.reorder_depth() == 1);
+
+    SECTION("broken SPS") {
+        const uint8_t nal[] = {0x67, 0x4d, 0x00};
+        h264_sps_t broken{};
+        REQUIRE(parse_sps(nal, broken) == std::errc::invalid_argument);
+    }
+    SECTION("slice without PPS") {
+        h264_stream_analyzer_t empty{};
+        h264_picture_t picture{};
+        REQUIRE(empty.feed(slices[0], picture) == std::errc::protocol_error);
+    }
+}
+
+TEST_CASE("H.264 Slice Header", "[h264]") {
+    h264_stream_analyzer_t analyzer{};
+    REQUIRE(analyzer.feed_sequence_header(avcc) == std::errc{});
+
+    std::vector<h264_picture_t> pictures{};
+    for (const auto& slice : slices) {
+        h264_picture_t picture{};
+        REQUIRE(analyzer.feed(slice, picture) == std::errc{});
+        pictures.emplace_back(picture);
+    }
+    REQUIRE(pictures[0].idr);
+    REQUIRE(pictures[0].slice_type == h264_slice_type_t::I);
+    REQUIRE(pictures[0].poc == 0);
+    // I P B B P B B ...
+    for (size_t i = 1; i < pictures.size(); ++i) {
+        const bool anchor = (i % 3) == 1;
+        CAPTURE(i);
+        REQUIRE(pictures[i].epoch == pictures[0].epoch);
+        REQUIRE(pictures[i].slice_type == (anchor ? h264_slice_type_t::P : h264_slice_type_t::B));
+        REQUIRE(pictures[i].reference == anchor);
+    }
+    // B frames are displayed before the P frame decoded earlier
+    REQUIRE(pictures[2].poc < pictures[1].poc);
+    REQUIRE(pictures[3].poc < pictures[1].poc);
+    REQUIRE(pictures[2].poc < pictures[3].poc);
+    REQUIRE(analyzer.observed_reorder_depth() == 1);
+    REQUIRE(analyzer.observed_reorder_depth() <= analyzer.reorder_depth());
+
+    SECTION("reorder queue") {
+        h264_reorder_queue_t<size_t> queue{analyzer.observed_reorder_depth()};
+        std::vector<int32_t> outputs{};
+        size_t index = 0;
+        for (size_t i = 0; i < pictures.size(); ++i) {
+            REQUIRE(queue.push(pictures[i], i));
+            REQUIRE(queue.size() <= queue.capacity() + 1);
+            while (queue.pop(index))
+                outputs.emplace_back(pictures[index].poc);
+        }
+        while (queue.drain(index))
+            outputs.emplace_back(pictures[index].poc);
+        REQUIRE(outputs.size() == pictures.size());
+        REQUIRE(std::is_sorted(outputs.begin(), outputs.end()));
+    }
+    SECTION("no reorder") {
+        h264_reorder_queue_t<size_t> queue{0};
+        size_t index = 0;
+        REQUIRE(queue.push(pictures[0], 0));
+        REQUIRE(queue.pop(index));
+        REQUIRE(queue.empty());
+    }
+}
@@ -18,6 +18,7 @@
 // https://docs.microsoft.com/en-us/windows/win32/sysinfo/getting-the-system-version
 #include <VersionHelpers.h>
 
+#include "event_trace.hpp"
 #include "winrt/WinRTComponent.h"
 
 namespace fs = std::filesystem;
@@ -93,7 +94,19 @@ int wmain(int argc, wchar_t* argv[], wchar_t* envp[]) {
 
     Catch::Session session{};
     session.applyCommandLine(argc, argv);
-    return session.run();
+    const int result = session.run();
+
+    // the events of the sample loops are formatted after the tests
+    fmt::memory_buffer line{};
+    event_tracer_t& tracer = event_tracer_t::instance();
+    tracer.drain([&line](uint32_t ring, const trace_record_t& record) {
+        line.clear();
+        format_trace_record(ring, record, line);
+        spdlog::debug("{}", std::string_view{line.data(), line.size()});
+    });
+    if (auto dropped = tracer.dropped(); dropped > 0)
+        spdlog::warn("trace: {} events are dropped", dropped);
+    return result;
 }
 
 using std::experimental::coroutine_handle;
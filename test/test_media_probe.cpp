@@ -0,0 +1,115 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "media_probe.hpp"
+#include "mp4_box.hpp"
+
+namespace fs = std::filesystem;
+
+fs::path get_asset_dir() noexcept;
+
+TEST_CASE("MP4 Probe", "[mp4]") {
+    media_probe_t probe{};
+    REQUIRE(probe_mp4(get_asset_dir() / "test-sample-0.mp4", probe) == std::errc{});
+    REQUIRE(probe.file_size == fs::file_size(get_asset_dir() / "test-sample-0.mp4"));
+
+    const media_description_t& desc = probe.description;
+    REQUIRE(desc.codec == make_fourcc("avc1"));
+    REQUIRE(desc.width == 1280);
+    REQUIRE(desc.height == 720);
+    REQUIRE(desc.aspect_numerator == desc.aspect_denominator);
+    REQUIRE(desc.timescale == 30000);
+    REQUIRE(desc.duration == 190119);
+    REQUIRE(desc.sample_count == 64);
+    REQUIRE(desc.fps() == Approx(64.0 * 30000 / 190119));
+
+    REQUIRE(probe.samples.size() == 64);
+    REQUIRE(probe.samples[0].offset == 1672);
+    REQUIRE(probe.samples[0].size == 173158);
+    REQUIRE(probe.samples[1].offset == 1672 + 173158); // same chunk
+    REQUIRE(probe.samples[1].decode_time == 2880);
+    REQUIRE(probe.samples[1].composition_offset == 6240);
+    REQUIRE(probe.samples[2].composition_offset == -3359);
+    REQUIRE(std::count_if(probe.samples.begin(), probe.samples.end(), [](auto& s) { return s.sync; }) == 3);
+    REQUIRE(probe.samples[30].sync);
+
+    SECTION("directory") {
+        REQUIRE(probe_mp4(get_asset_dir(), probe) != std::errc{});
+    }
+    SECTION("chunk offset past the end") {
+        std::ifstream stream{get_asset_dir() / "test-sample-0.mp4", std::ios::binary};
+        std::vector<uint8_t> bytes{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+        const gsl::span<const uint8_t> file{bytes.data(), bytes.size()};
+        mp4_box_t stco{};
+        REQUIRE(mp4_box_t{file}.find({make_fourcc("moov"), make_fourcc("trak"), make_fourcc("mdia"),
+                                      make_fourcc("minf"), make_fourcc("stbl"), make_fourcc("stco")},
+                                     stco) == std::errc{});
+        // version/flags, entry_count and then the first chunk_offset
+        std::fill_n(bytes.begin() + (stco.payload().data() - bytes.data()) + 8, 4, 0xff);
+        REQUIRE(probe_mp4(file, probe) == std::errc::protocol_error);
+    }
+}
+
+TEST_CASE("MP4 Probe - Index Cache", "[mp4]") {
+    const fs::path paths[] = {get_asset_dir() / "test-sample-0.mp4", get_asset_dir() / "not-exist.mp4"};
+    const fs::path cache_path = fs::temp_directory_path() / "media_index_cache.bin";
+
+    media_index_cache_t cache{};
+    std::vector<media_probe_result_t> results{};
+    REQUIRE(probe_files(paths, cache, results, 2) == std::errc{});
+    REQUIRE(results.size() == 2);
+    REQUIRE(results[0].status == std::errc{});
+    REQUIRE_FALSE(results[0].cached);
+    REQUIRE(results[1].status == std::errc::no_such_file_or_directory);
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.save(cache_path) == std::errc{});
+    REQUIRE(fs::file_size(cache_path) < 64 * 12); // 32 bytes of `media_sample_index_t` becomes 8~10 bytes
+
+    media_index_cache_t loaded{};
+    REQUIRE(loaded.load(cache_path) == std::errc{});
+    REQUIRE(loaded.size() == 1);
+    std::vector<media_probe_result_t> rescan{};
+    REQUIRE(probe_files(paths, loaded, rescan) == std::errc{});
+    REQUIRE(rescan[0].status == std::errc{});
+    REQUIRE(rescan[0].cached);
+
+    const media_probe_t& expected = results[0].probe;
+    const media_probe_t& actual = rescan[0].probe;
+    REQUIRE(actual.path == expected.path);
+    REQUIRE(actual.description.codec == expected.description.codec);
+    REQUIRE(actual.description.duration == expected.description.duration);
+    REQUIRE(actual.samples.size() == expected.samples.size());
+    for (size_t i = 0; i < expected.samples.size(); ++i) {
+        CAPTURE(i);
+        REQUIRE(actual.samples[i].offset == expected.samples[i].offset);
+        REQUIRE(actual.samples[i].size == expected.samples[i].size);
+        REQUIRE(actual.samples[i].decode_time == expected.samples[i].decode_time);
+        REQUIRE(actual.samples[i].composition_offset == expected.samples[i].composition_offset);
+        REQUIRE(actual.samples[i].sync == expected.samples[i].sync);
+    }
+
+    SECTION("broken cache") {
+        const auto size = fs::file_size(cache_path);
+        fs::resize_file(cache_path, size - 3);
+        REQUIRE(loaded.load(cache_path) == std::errc::protocol_error);
+        REQUIRE(loaded.size() == 0);
+    }
+    SECTION("truncated cache") {
+        std::ifstream stream{cache_path, std::ios::binary};
+        const std::string bytes{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+        stream.close();
+        // every prefix ends in the middle of the entry. none of them is a valid index
+        for (size_t size = 0; size < bytes.size(); ++size) {
+            CAPTURE(size);
+            std::ofstream output{cache_path, std::ios::binary | std::ios::trunc};
+            output.write(bytes.data(), static_cast<std::streamsize>(size));
+            output.close();
+            REQUIRE(loaded.load(cache_path) == std::errc::protocol_error);
+            REQUIRE(loaded.size() == 0);
+        }
+    }
+    fs::remove(cache_path);
+}
@@ -0,0 +1,162 @@
+#include <catch2/catch.hpp>
+
+#include <deque>
+#include <vector>
+
+#include "media_transform.hpp"
+
+namespace {
+
+/// @brief Holds `depth` inputs before the output, like the decoder with reorder.
+///        Refuses the input while 2 outputs are not collected
+class delay_transform_t final : public media_transform_t<uint32_t> {
+    std::deque<uint32_t> inputs{};
+    std::deque<uint32_t> outputs{};
+    size_t depth;
+
+  public:
+    uint32_t begin_count = 0;
+    uint32_t end_count = 0;
+
+  public:
+    explicit delay_transform_t(size_t depth) noexcept : depth{depth} {
+    }
+
+  protected:
+    std::errc on_begin_streaming() noexcept override {
+        ++begin_count;
+        return std::errc{};
+    }
+    std::errc on_input(uint32_t& input) noexcept override {
+        if (outputs.size() >= 2)
+            return std::errc::resource_unavailable_try_again;
+        inputs.emplace_back(input);
+        if (inputs.size() > depth) {
+            outputs.emplace_back(inputs.front());
+            inputs.pop_front();
+        }
+        return std::errc{};
+    }
+    std::errc on_output(uint32_t& output) noexcept override {
+        if (outputs.empty())
+            return std::errc::resource_unavailable_try_again;
+        output = outputs.front();
+        outputs.pop_front();
+        return std::errc{};
+    }
+    std::errc on_drain() noexcept override {
+        outputs.insert(outputs.end(), inputs.begin(), inputs.end());
+        inputs.clear();
+        return std::errc{};
+    }
+    std::errc on_flush() noexcept override {
+        inputs.clear();
+        outputs.clear();
+        return std::errc{};
+    }
+    std::errc on_end_streaming() noexcept override {
+        ++end_count;
+        return std::errc{};
+    }
+};
+
+class collect_node_t final : public stage_node_t<uint32_t> {
+  public:
+    std::vector<uint32_t> items{};
+
+  public:
+    std::errc process(uint32_t input, stage_emitter_t<uint32_t>& output) noexcept override {
+        items.emplace_back(input);
+        return output.emit(input);
+    }
+};
+
+} // namespace
+
+TEST_CASE("Media Transform - state", "[thread]") {
+    delay_transform_t transform{1};
+    uint32_t item = 0;
+    REQUIRE(transform.state() == transform_state_t::idle);
+
+    SECTION("illegal transition") {
+        REQUIRE(transform.process_input(item) == std::errc::operation_not_permitted);
+        REQUIRE(transform.process_output(item) == std::errc::operation_not_permitted);
+        REQUIRE(transform.end_of_stream() == std::errc::operation_not_permitted);
+        REQUIRE(transform.drain() == std::errc::operation_not_permitted);
+        REQUIRE(transform.flush() == std::errc::operation_not_permitted);
+        REQUIRE(transform.end_streaming() == std::errc::operation_not_permitted);
+        REQUIRE(transform.begin_streaming() == std::errc{});
+        REQUIRE(transform.begin_streaming() == std::errc::operation_not_permitted);
+        REQUIRE(transform.process_input(item) == std::errc::operation_not_permitted);
+        REQUIRE(transform.start_of_stream() == std::errc{});
+        REQUIRE(transform.start_of_stream() == std::errc::operation_not_permitted);
+        REQUIRE(transform.end_of_stream() == std::errc{});
+        REQUIRE(transform.process_input(item) == std::errc::operation_not_permitted);
+        REQUIRE(transform.end_streaming() == std::errc::operation_not_permitted); // drain or flush first
+        REQUIRE(transform.state() == transform_state_t::ended);
+    }
+    SECTION("implicit begin") {
+        REQUIRE(transform.start_of_stream() == std::errc{});
+        REQUIRE(transform.begin_count == 1);
+        REQUIRE(transform.state() == transform_state_t::streaming);
+    }
+    SECTION("not accepting") {
+        REQUIRE(transform.start_of_stream() == std::errc{});
+        for (uint32_t i = 0; i < 3; ++i)
+            REQUIRE(transform.process_input(i) == std::errc{});
+        uint32_t next = 3;
+        REQUIRE(transform.process_input(next) == std::errc::resource_unavailable_try_again);
+        REQUIRE(transform.process_output(item) == std::errc{});
+        REQUIRE(item == 0);
+        REQUIRE(transform.process_input(next) == std::errc{});
+    }
+    SECTION("drain") {
+        REQUIRE(transform.start_of_stream() == std::errc{});
+        for (uint32_t i = 0; i < 2; ++i)
+            REQUIRE(transform.process_input(i) == std::errc{});
+        REQUIRE(transform.end_of_stream() == std::errc{});
+        REQUIRE(transform.drain() == std::errc{});
+        REQUIRE(transform.state() == transform_state_t::draining);
+        std::vector<uint32_t> outputs{};
+        std::errc ec{};
+        while ((ec = transform.process_output(item)) == std::errc{})
+            outputs.emplace_back(item);
+        REQUIRE(ec == std::errc::no_message_available);
+        REQUIRE(outputs == std::vector<uint32_t>{0, 1});
+        REQUIRE(transform.state() == transform_state_t::ready);
+        // the next stream
+        REQUIRE(transform.start_of_stream() == std::errc{});
+        REQUIRE(transform.begin_count == 1);
+    }
+    SECTION("flush") {
+        REQUIRE(transform.start_of_stream() == std::errc{});
+        for (uint32_t i = 0; i < 2; ++i)
+            REQUIRE(transform.process_input(i) == std::errc{});
+        REQUIRE(transform.flush() == std::errc{});
+        REQUIRE(transform.state() == transform_state_t::streaming);
+        REQUIRE(transform.process_output(item) == std::errc::resource_unavailable_try_again);
+        REQUIRE(transform.end_streaming() == std::errc{});
+        REQUIRE(transform.end_count == 1);
+        REQUIRE(transform.state() == transform_state_t::idle);
+    }
+}
+
+TEST_CASE("Media Transform - stage_graph_t", "[thread]") {
+    delay_transform_t transform{3};
+    transform_node_t<uint32_t> node{transform};
+    collect_node_t collect{};
+
+    uint32_t next = 0;
+    stage_graph_t<uint32_t> graph{[&next](uint32_t& item) {
+        if (next == 100)
+            return std::errc::no_message_available;
+        item = next++;
+        return std::errc{};
+    }};
+    graph.then(node, 2).then(collect, 2);
+    REQUIRE(graph.run() == std::errc{});
+    REQUIRE(collect.items.size() == 100);
+    for (uint32_t i = 0; i < 100; ++i)
+        REQUIRE(collect.items[i] == i);
+    REQUIRE(transform.state() == transform_state_t::ready);
+}
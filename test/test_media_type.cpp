@@ -0,0 +1,144 @@
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "media_type.hpp"
+
+namespace {
+
+constexpr media_guid_t video_type{0x73646976, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+// MF_MT_ALL_SAMPLES_INDEPENDENT
+constexpr media_guid_t independent_key{0xc9173739, 0x5e56, 0x461c, {0xb7, 0x13, 0x46, 0xfb, 0x99, 0x5c, 0xb9, 0x5f}};
+// MF_MT_MPEG_SEQUENCE_HEADER
+constexpr media_guid_t sequence_key{0x3c036de7, 0x3ad0, 0x4c9e, {0x92, 0x16, 0xee, 0x6d, 0x6a, 0xc2, 0x1c, 0xb3}};
+constexpr media_guid_t name_key{0x00000001, 0x0002, 0x0003, {4, 5, 6, 7, 8, 9, 10, 11}};
+
+static_assert(hash_guid(independent_key) != hash_guid(sequence_key));
+static_assert(make_video_subtype(make_pixel_fourcc("NV12")).data1 == 0x3231564E);
+
+media_type_t make_nv12_type(uint32_t width, uint32_t height) {
+    media_type_t type{};
+    type.set_major_type(video_type);
+    type.set_subtype(make_video_subtype(make_pixel_fourcc("NV12")));
+    type.set_frame_size(width, height);
+    type.set_frame_rate(30000, 1001);
+    type.set_uint32(independent_key, 1);
+    return type;
+}
+
+} // namespace
+
+TEST_CASE("Media Type") {
+    media_type_t type = make_nv12_type(1920, 1080);
+
+    SECTION("inline fields") {
+        REQUIRE(type.has(media_field_t::subtype));
+        REQUIRE_FALSE(type.has(media_field_t::default_stride));
+        uint32_t width = 0, height = 0;
+        REQUIRE(type.frame_size(width, height));
+        REQUIRE(width == 1920);
+        REQUIRE(height == 1080);
+        int32_t stride = 0;
+        REQUIRE_FALSE(type.default_stride(stride));
+        type.set_default_stride(-1920 * 4); // bottom-up
+        REQUIRE(type.default_stride(stride));
+        REQUIRE(stride == -1920 * 4);
+        REQUIRE(type.pixel_format() == pixel_format_t::nv12);
+        type.reset(media_field_t::frame_size);
+        REQUIRE_FALSE(type.frame_size(width, height));
+        // the inline fields are not in the list
+        REQUIRE(type.attributes().size() == 1);
+    }
+    SECTION("attributes") {
+        const uint8_t header[]{0, 0, 0, 1, 0x67, 0x42};
+        type.set_blob(sequence_key, header);
+        type.set_string(name_key, u"decoder");
+        REQUIRE(type.attributes().size() == 3);
+        for (size_t i = 1; i < type.attributes().size(); ++i)
+            REQUIRE(type.attributes()[i - 1].hash <= type.attributes()[i].hash);
+
+        const media_attribute_t* blob = type.find(sequence_key);
+        REQUIRE(blob);
+        REQUIRE(blob->kind == media_attribute_kind_t::blob);
+        REQUIRE(blob->data().size() == sizeof(header));
+        REQUIRE(std::memcmp(blob->data().data(), header, sizeof(header)) == 0);
+        REQUIRE(type.find(name_key)->text() == u"decoder");
+
+        // replace with the other kind
+        type.set_double(sequence_key, 0.5);
+        REQUIRE(type.attributes().size() == 3);
+        REQUIRE(type.find(sequence_key)->kind == media_attribute_kind_t::real);
+        REQUIRE(type.find(sequence_key)->data().empty());
+
+        REQUIRE(type.erase(name_key));
+        REQUIRE_FALSE(type.erase(name_key));
+        REQUIRE(type.find(name_key) == nullptr);
+        type.clear();
+        REQUIRE(type.attributes().empty());
+        REQUIRE_FALSE(type.has(media_field_t::major_type));
+    }
+    SECTION("common keys") {
+        media_type_t other{};
+        other.set_guid(mf_mt_major_type, video_type);
+        other.set_guid(mf_mt_subtype, make_video_subtype(make_pixel_fourcc("NV12")));
+        other.set_uint64(mf_mt_frame_size, (uint64_t{1920} << 32) | 1080);
+        other.set_uint64(mf_mt_frame_rate, (uint64_t{30000} << 32) | 1001);
+        other.set_uint32(independent_key, 1);
+        REQUIRE(other.attributes().size() == 1);
+        REQUIRE(other.find(mf_mt_subtype) == nullptr);
+        REQUIRE(other == type);
+        REQUIRE(type.contains(other));
+        // the inline field can't have the other kind
+        REQUIRE_THROWS_AS(other.set_uint32(mf_mt_subtype, 1), std::invalid_argument);
+        REQUIRE(other.erase(mf_mt_frame_rate));
+        REQUIRE_FALSE(other.has(media_field_t::frame_rate));
+        REQUIRE_FALSE(other.erase(mf_mt_frame_rate));
+    }
+    SECTION("copy and compare") {
+        const uint8_t header[]{0, 0, 0, 1, 0x67, 0x42};
+        type.set_blob(sequence_key, header);
+        media_type_t copy = type;
+        REQUIRE(copy == type);
+        // the bytes are shared, not copied
+        REQUIRE(copy.find(sequence_key)->bytes == type.find(sequence_key)->bytes);
+
+        // same attributes in the other order
+        media_type_t other = make_nv12_type(1920, 1080);
+        other.reset(media_field_t::frame_rate);
+        other.set_blob(sequence_key, header);
+        REQUIRE(other != type);
+        other.set_frame_rate(30000, 1001);
+        REQUIRE(other == type);
+
+        copy.set_uint32(independent_key, 0);
+        REQUIRE(copy != type);
+        copy.set_uint32(independent_key, 1);
+        copy.set_uint64(independent_key, 1); // same value, the other kind
+        REQUIRE(copy != type);
+    }
+    SECTION("contains") {
+        media_type_t partial{};
+        partial.set_major_type(video_type);
+        partial.set_subtype(make_video_subtype(make_pixel_fourcc("NV12")));
+        REQUIRE(type.contains(partial));
+        REQUIRE_FALSE(partial.contains(type));
+        partial.set_uint32(independent_key, 1);
+        REQUIRE(type.contains(partial));
+        partial.set_uint32(name_key, 1);
+        REQUIRE_FALSE(type.contains(partial));
+        partial.erase(name_key);
+        partial.set_frame_size(1280, 720);
+        REQUIRE_FALSE(type.contains(partial));
+    }
+    SECTION("frame layout") {
+        frame_layout_t layout{};
+        REQUIRE(make_frame_layout(type, 1, layout) == std::errc{});
+        REQUIRE(layout.size == 1920 * 1080 * 3 / 2);
+        type.set_subtype(independent_key);
+        REQUIRE(type.pixel_format() == pixel_format_t::unknown);
+        REQUIRE(make_frame_layout(type, 1, layout) == std::errc::not_supported);
+        type.reset(media_field_t::frame_size);
+        REQUIRE(make_frame_layout(type, 1, layout) == std::errc::invalid_argument);
+    }
+}
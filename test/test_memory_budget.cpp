@@ -0,0 +1,114 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "frame_pool.hpp"
+#include "memory_budget.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Memory Budget") {
+    memory_budget_t process{1000};
+    memory_budget_t pipeline{800, &process};
+    memory_budget_t decoder{SIZE_MAX, &pipeline};
+    memory_budget_t scaler{SIZE_MAX, &pipeline};
+
+    SECTION("charged to the parents") {
+        REQUIRE(decoder.try_reserve(300) == std::errc{});
+        REQUIRE(scaler.try_reserve(200) == std::errc{});
+        REQUIRE(pipeline.usage().live == 500);
+        REQUIRE(process.usage().live == 500);
+        REQUIRE(decoder.available() == 300);
+        decoder.release(300);
+        REQUIRE(decoder.usage().live == 0);
+        REQUIRE(decoder.usage().peak == 300);
+        REQUIRE(process.usage().live == 200);
+        scaler.release(200);
+    }
+    SECTION("rollback") {
+        REQUIRE(decoder.try_reserve(700) == std::errc{});
+        REQUIRE(scaler.try_reserve(200) == std::errc::resource_unavailable_try_again);
+        REQUIRE(scaler.usage().live == 0); // not left in the lower level
+        REQUIRE(pipeline.usage().rejected == 1);
+        REQUIRE(process.try_reserve(300) == std::errc{}); // other pipeline
+        REQUIRE(decoder.try_reserve(1) == std::errc::resource_unavailable_try_again);
+        REQUIRE(process.usage().rejected == 1);
+        REQUIRE(scaler.try_reserve(900) == std::errc::value_too_large);
+        process.release(300);
+        decoder.release(700);
+    }
+    SECTION("backpressure") {
+        REQUIRE(decoder.try_reserve(800) == std::errc{});
+        REQUIRE(scaler.reserve(100, 10ms) == std::errc::timed_out);
+        REQUIRE(pipeline.usage().rejected == 1); // not for each retry
+        std::thread consumer{[&decoder]() {
+            std::this_thread::sleep_for(20ms);
+            decoder.release(400);
+        }};
+        REQUIRE(scaler.reserve(400, 5s) == std::errc{});
+        consumer.join();
+        REQUIRE(pipeline.usage().rejected == 1); // waited, but not failed
+        REQUIRE(pipeline.usage().live == 800);
+        decoder.release(400);
+        scaler.release(400);
+    }
+    REQUIRE(process.usage().live == 0);
+}
+
+TEST_CASE("Memory Budget - frame pool", "[thread]") {
+    memory_budget_t pipeline{1 << 20};
+    memory_budget_t stage{SIZE_MAX, &pipeline};
+    frame_pool_config_t config{};
+    config.min_count = 1;
+    config.max_count = 16;
+    config.budget = &stage;
+    {
+        frame_pool_t pool{config};
+        std::vector<frame_buffer_t> buffers{};
+        frame_buffer_t buffer{};
+        while (pool.acquire(256 << 10, buffer) == std::errc{})
+            buffers.emplace_back(std::move(buffer));
+        // the budget stopped the allocation before `max_count`
+        REQUIRE(buffers.size() == 4);
+        REQUIRE(pool.acquire(256 << 10, buffer) == std::errc::resource_unavailable_try_again);
+        REQUIRE(pool.stats().exhausted == 2);
+        REQUIRE(stage.usage().live == 1 << 20);
+        REQUIRE(pipeline.usage().rejected == 2);
+        // the other class can't grow either until the idle buffers are trimmed
+        REQUIRE(pool.acquire(4096, buffer) == std::errc::resource_unavailable_try_again);
+        REQUIRE(pipeline.usage().rejected == 3); // once for the failed call
+        buffers.pop_back();
+        REQUIRE(pool.trim() == 256 << 10);
+        REQUIRE(pool.acquire(4096, buffer) == std::errc{});
+        REQUIRE(stage.usage().peak == 1 << 20);
+
+        // the producers wait on the budget while the consumer releases
+        buffer.reset();
+        buffers.clear();
+        REQUIRE(pool.trim() > 0);
+        REQUIRE(stage.usage().live == 0);
+        const uint64_t rejected = pipeline.usage().rejected;
+        std::atomic<uint32_t> failures{0};
+        std::vector<std::thread> threads{};
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([&stage, &failures]() {
+                for (int i = 0; i < 100; ++i) {
+                    if (stage.reserve(300 << 10, 5s) != std::errc{}) {
+                        ++failures;
+                        continue;
+                    }
+                    std::this_thread::yield();
+                    stage.release(300 << 10);
+                }
+            });
+        for (auto& thread : threads)
+            thread.join();
+        REQUIRE(failures == 0);
+        REQUIRE(pipeline.usage().rejected == rejected); // the waits are not counted
+        REQUIRE(stage.usage().peak == 1 << 20); // 3 of 300K at most. same with the previous peak
+    }
+    REQUIRE(pipeline.usage().live == 0);
+}
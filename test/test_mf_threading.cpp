@@ -13,6 +13,8 @@
 // clang-format on
 #include <spdlog/spdlog.h>
 
+#include "work_scheduler.hpp"
+
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/work-queues
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/using-work-queues
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/media-foundation-work-queue-and-threading-improvements
@@ -108,3 +110,13 @@ TEST_CASE_METHOD(mf_scheduler_test_case, "Simple work queue") {
     REQUIRE(WaitForSingleObjectEx(invoked, INFINITE, true) == WAIT_OBJECT_0);
     REQUIRE(res->GetStatus() == E_ABORT);
 }
+
+TEST_CASE_METHOD(mf_scheduler_test_case, "Portable work queue") {
+    work_scheduler_t portable{2};
+    winrt::com_ptr<IMFAsyncResult> res{};
+    REQUIRE(MFCreateAsyncResult(nullptr, this, nullptr, res.put()) == S_OK);
+    auto invoke = [](void* context) noexcept { MFInvokeCallback(static_cast<IMFAsyncResult*>(context)); };
+    REQUIRE(portable.put(work_item_t{invoke, res.get()}, 0) == std::errc{});
+    REQUIRE(WaitForSingleObjectEx(invoked, INFINITE, true) == WAIT_OBJECT_0);
+    REQUIRE(res->GetStatus() == E_ABORT);
+}
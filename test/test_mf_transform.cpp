@@ -9,11 +9,28 @@
 #include <windowsx.h>
 
 // clang-format on
+#include <deque>
 #include <experimental/generator>
+#include <fcntl.h>
 #include <filesystem>
+#include <io.h>
+#include <optional>
+#include <share.h>
 #include <spdlog/spdlog.h>
+#include <sys/stat.h>
 
+#include "async_generator.hpp"
+#include "deadline_queue.hpp"
+#include "fmp4_muxer.hpp"
+#include "h264_parser.hpp"
+#include "memory_budget.hpp"
 #include "mf_transform.hpp"
+#include "mp4_box.hpp"
+#include "planar_frame.hpp"
+#include "sample_ring.hpp"
+#include "sample_trace.hpp"
+#include "stage_graph.hpp"
+#include "stream_executor.hpp"
 
 namespace fs = std::filesystem;
 
@@ -26,6 +43,11 @@ void report_error(HRESULT hr, const char* fname) noexcept {
     spdlog::error("{}: {:#08x} {}", fname, static_cast<uint32_t>(ex.code()), winrt::to_string(ex.message()));
 }
 std::string to_mf_string(const GUID& guid) noexcept;
+std::string_view to_mf_string(const GUID& guid, char (&buf)[40]) noexcept;
+std::string_view find_mf_name(const GUID& guid) noexcept;
+bool get_mf_name(size_t index, GUID& guid, std::string_view& name) noexcept;
+bool is_mf_name_table_perfect() noexcept;
+std::string to_guid_string(const GUID& guid) noexcept;
 
 struct video_buffer_test_case {
     com_ptr<ID3D11Device> device{};
@@ -119,24 +141,153 @@ TEST_CASE_METHOD(video_buffer_test_case, "Uncompressed Video Buffer") {
     }
 }
 
+/// @see https://docs.microsoft.com/en-us/windows/win32/medfound/image-stride
+TEST_CASE("frame_layout_t - MFCalculateImageSize") {
+    auto make_type = [](const GUID& subtype) {
+        com_ptr<IMFMediaType> media_type{};
+        REQUIRE(MFCreateMediaType(media_type.put()) == S_OK);
+        REQUIRE(media_type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video) == S_OK);
+        REQUIRE(media_type->SetGUID(MF_MT_SUBTYPE, subtype) == S_OK);
+        REQUIRE(MFSetAttributeSize(media_type.get(), MF_MT_FRAME_SIZE, 1280, 720) == S_OK);
+        return media_type;
+    };
+    const GUID subtypes[]{MFVideoFormat_NV12,  MFVideoFormat_I420,   MFVideoFormat_IYUV,  MFVideoFormat_YV12,
+                          MFVideoFormat_YUY2,  MFVideoFormat_UYVY,   MFVideoFormat_RGB32, MFVideoFormat_ARGB32,
+                          MFVideoFormat_RGB24, MFVideoFormat_RGB565, MFVideoFormat_AYUV};
+    for (const GUID& subtype : subtypes) {
+        com_ptr<IMFMediaType> media_type = make_type(subtype);
+        frame_layout_t layout{};
+        REQUIRE(get_frame_layout(media_type.get(), 1, layout) == S_OK);
+        UINT32 size = 0;
+        REQUIRE(MFCalculateImageSize(subtype, 1280, 720, &size) == S_OK);
+        REQUIRE(layout.size == size);
+        LONG stride = 0;
+        REQUIRE(MFGetStrideForBitmapInfoHeader(subtype.Data1, 1280, &stride) == S_OK);
+        REQUIRE(layout.planes[0].stride == static_cast<uint32_t>(std::abs(stride))); // RGB may be bottom-up
+
+        REQUIRE(get_frame_layout(media_type.get(), 64, layout) == S_OK);
+        planar_frame_t frame{layout};
+        for (uint32_t i = 0; i < layout.plane_count; ++i)
+            REQUIRE(reinterpret_cast<uintptr_t>(frame.plane(i).data) % 64 == 0);
+    }
+    // the odd width. the RGB rows are padded to DWORD
+    const GUID rgb_subtypes[]{MFVideoFormat_RGB32, MFVideoFormat_RGB24, MFVideoFormat_RGB565, MFVideoFormat_RGB555};
+    for (const GUID& subtype : rgb_subtypes) {
+        com_ptr<IMFMediaType> media_type = make_type(subtype);
+        REQUIRE(MFSetAttributeSize(media_type.get(), MF_MT_FRAME_SIZE, 641, 3) == S_OK);
+        frame_layout_t layout{};
+        REQUIRE(get_frame_layout(media_type.get(), 1, layout) == S_OK);
+        UINT32 size = 0;
+        REQUIRE(MFCalculateImageSize(subtype, 641, 3, &size) == S_OK);
+        REQUIRE(layout.size == size);
+        LONG stride = 0;
+        REQUIRE(MFGetStrideForBitmapInfoHeader(subtype.Data1, 641, &stride) == S_OK);
+        REQUIRE(layout.planes[0].stride == static_cast<uint32_t>(std::abs(stride)));
+    }
+    frame_layout_t layout{};
+    REQUIRE(get_frame_layout(make_type(MFVideoFormat_H264).get(), 64, layout) == MF_E_INVALIDMEDIATYPE);
+}
+
+TEST_CASE("media_type_t - IMFMediaType") {
+    com_ptr<IMFMediaType> source{};
+    REQUIRE(MFCreateMediaType(source.put()) == S_OK);
+    REQUIRE(source->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video) == S_OK);
+    REQUIRE(source->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12) == S_OK);
+    REQUIRE(MFSetAttributeSize(source.get(), MF_MT_FRAME_SIZE, 1280, 720) == S_OK);
+    REQUIRE(MFSetAttributeRatio(source.get(), MF_MT_FRAME_RATE, 30000, 1001) == S_OK);
+    REQUIRE(source->SetUINT32(MF_MT_DEFAULT_STRIDE, static_cast<UINT32>(-1280)) == S_OK);
+    REQUIRE(source->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE) == S_OK);
+    const uint8_t header[]{0, 0, 0, 1, 0x67, 0x42};
+    REQUIRE(source->SetBlob(MF_MT_MPEG_SEQUENCE_HEADER, header, sizeof(header)) == S_OK);
+    REQUIRE(source->SetString(MF_MT_MPEG2_PROFILE, L"main") == S_OK); // any key for the string
+    REQUIRE(source->SetDouble(MF_MT_AUDIO_FLOAT_SAMPLES_PER_SECOND, 0.5) == S_OK);
+
+    media_type_t type{};
+    REQUIRE(get_media_type(source.get(), type) == S_OK);
+    REQUIRE(type.pixel_format() == pixel_format_t::nv12);
+    int32_t stride = 0;
+    REQUIRE(type.default_stride(stride));
+    REQUIRE(stride == -1280);
+    REQUIRE(type.attributes().size() == 4);
+
+    com_ptr<IMFMediaType> output{};
+    REQUIRE(make_media_type(type, output.put()) == S_OK);
+    BOOL equal = FALSE;
+    REQUIRE(source->Compare(output.get(), MF_ATTRIBUTES_MATCH_ALL_ITEMS, &equal) == S_OK);
+    REQUIRE(equal);
+
+    media_type_t copy{};
+    REQUIRE(get_media_type(output.get(), copy) == S_OK);
+    REQUIRE(copy == type);
+    // the keys of the inline fields
+    REQUIRE(to_guid(mf_mt_major_type) == MF_MT_MAJOR_TYPE);
+    REQUIRE(to_guid(mf_mt_subtype) == MF_MT_SUBTYPE);
+    REQUIRE(to_guid(mf_mt_frame_size) == MF_MT_FRAME_SIZE);
+    REQUIRE(to_guid(mf_mt_frame_rate) == MF_MT_FRAME_RATE);
+    REQUIRE(to_guid(mf_mt_pixel_aspect_ratio) == MF_MT_PIXEL_ASPECT_RATIO);
+    REQUIRE(to_guid(mf_mt_default_stride) == MF_MT_DEFAULT_STRIDE);
+    REQUIRE(to_guid(mf_mt_interlace_mode) == MF_MT_INTERLACE_MODE);
+    REQUIRE(source->SetUINT32(MF_MT_SUBTYPE, 1) == S_OK);
+    REQUIRE(get_media_type(source.get(), copy) == MF_E_INVALIDMEDIATYPE);
+    frame_layout_t layout{};
+    REQUIRE(make_frame_layout(copy, 1, layout) == std::errc{});
+    UINT32 size = 0;
+    REQUIRE(MFCalculateImageSize(MFVideoFormat_NV12, 1280, 720, &size) == S_OK);
+    REQUIRE(layout.size == size);
+}
+
+TEST_CASE("to_mf_string") {
+    REQUIRE(find_mf_name(MF_MT_MAJOR_TYPE) == "MF_MT_MAJOR_TYPE");
+    REQUIRE(find_mf_name(MFVideoFormat_NV12) == "MFVideoFormat_NV12");
+    REQUIRE(find_mf_name(MFVideoFormat_IYUV) == "MFVideoFormat_IYUV");
+    REQUIRE(find_mf_name(MFAudioFormat_ADTS) == "MFAudioFormat_ADTS");
+    REQUIRE(to_mf_string(MFMediaType_Video) == "MFMediaType_Video");
+
+    // every name in the table. the aliases are found with the first name of the GUID
+    REQUIRE(is_mf_name_table_perfect());
+    GUID guid{}, first{};
+    std::string_view name{}, first_name{};
+    size_t count = 0;
+    for (; get_mf_name(count, guid, name); ++count) {
+        CAPTURE(name);
+        for (size_t i = 0; get_mf_name(i, first, first_name); ++i)
+            if (first == guid)
+                break;
+        REQUIRE(find_mf_name(guid) == first_name);
+    }
+    REQUIRE(count > 100);
+
+    // not in the table. same with `StringFromGUID2` without the braces
+    const GUID unknown = CLSID_CMSH264DecoderMFT;
+    REQUIRE(find_mf_name(unknown).empty());
+    wchar_t expected[40]{};
+    REQUIRE(StringFromGUID2(unknown, expected, 40) == 39);
+    char buf[40]{};
+    std::string_view text = to_mf_string(unknown, buf);
+    REQUIRE(text.size() == 36);
+    REQUIRE(std::equal(text.begin(), text.end(), expected + 1));
+    REQUIRE(to_guid_string(unknown) == text);
+}
+
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/video-subtype-guids
 /// @see https://stackoverflow.com/a/9681384
 void print(IMFMediaType* media_type) noexcept {
+    char buf[40]{};
     GUID major{};
     media_type->GetGUID(MF_MT_MAJOR_TYPE, &major);
     spdlog::info("media_type:");
-    spdlog::info("  {}: {}", "major", to_mf_string(major));
+    spdlog::info("  {}: {}", "major", to_mf_string(major, buf));
 
     if (major == MFMediaType_Audio) {
         GUID subtype{};
         if SUCCEEDED (media_type->GetGUID(MF_MT_SUBTYPE, &subtype))
-            spdlog::info("  {}: {}", "subtype", to_mf_string(subtype));
+            spdlog::info("  {}: {}", "subtype", to_mf_string(subtype, buf));
         return;
     }
     if (major == MFMediaType_Video) {
         GUID subtype{};
         if SUCCEEDED (media_type->GetGUID(MF_MT_SUBTYPE, &subtype))
-            spdlog::info("  {}: {}", "subtype", to_mf_string(subtype));
+            spdlog::info("  {}: {}", "subtype", to_mf_string(subtype, buf));
 
         UINT32 value = FALSE;
         if SUCCEEDED (media_type->GetUINT32(MF_MT_COMPRESSED, &value))
@@ -181,6 +332,7 @@ struct video_reader_test_case {
     com_ptr<IMFMediaType> source_type{};
     com_ptr<IMFSourceReaderEx> reader{}; // expose IMFTransform for each stream
     const DWORD reader_stream = static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM);
+    com_ptr<mf_sample_pool_t> sample_pool = mf_sample_pool_t::make(frame_pool_config_t{4 << 10, 64 << 20, 2, 16});
 
   public:
     video_reader_test_case() {
@@ -298,43 +450,86 @@ struct video_reader_test_case {
         }
     }
 
-    static com_ptr<IMFMediaType> clone(IMFMediaType* input) noexcept(false) {
-        com_ptr<IMFMediaType> output{};
-        if (auto hr = MFCreateMediaType(output.put()); FAILED(hr))
-            winrt::throw_hresult(hr);
-        if (auto hr = input->CopyAllItems(output.get()); FAILED(hr))
-            winrt::throw_hresult(hr);
-        return output;
+    /// @brief `read_samples` on the `work_scheduler_t`. The next samples are read while the consumer works
+    /// @see async_generator_t::start
+    static auto read_samples_async(com_ptr<IMFSourceReaderEx> reader, DWORD stream_index)
+        -> async_generator_t<com_ptr<IMFSample>> {
+        for (com_ptr<IMFSample> sample : read_samples(reader, stream_index))
+            co_yield sample;
     }
 
-    static com_ptr<IMFMediaType> make_video_type(IMFMediaType* input, const GUID& subtype) noexcept {
-        com_ptr<IMFMediaType> output = clone(input);
-        if (auto hr = output->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video); FAILED(hr))
-            winrt::throw_hresult(hr);
-        if (auto hr = output->SetGUID(MF_MT_SUBTYPE, subtype); FAILED(hr))
-            winrt::throw_hresult(hr);
-        UINT32 w = 0, h = 0;
-        MFGetAttributeSize(input, MF_MT_FRAME_SIZE, &w, &h);
-        if (auto hr = MFSetAttributeSize(output.get(), MF_MT_FRAME_SIZE, w, h); FAILED(hr))
+    /// @brief `stage_graph_t::source_t` with `read_samples`. Use with `std::ref`
+    struct reader_source_t final {
+        std::experimental::generator<com_ptr<IMFSample>> samples;
+        std::optional<std::experimental::generator<com_ptr<IMFSample>>::iterator> it{};
+
+      public:
+        std::errc operator()(com_ptr<IMFSample>& sample) {
+            if (it.has_value())
+                ++(*it);
+            else
+                it = samples.begin();
+            if (*it == samples.end())
+                return std::errc::no_message_available;
+            sample = **it;
+            return std::errc{};
+        }
+    };
+
+    /// @brief reader -> transform -> (discard). Returns the stats of the transform stage
+    static stage_stats_t run_transform(com_ptr<IMFSourceReaderEx> reader, DWORD reader_stream,
+                                       mf_transform_node_t& node) {
+        reader_source_t source{read_samples(reader, reader_stream)};
+        stage_graph_t<com_ptr<IMFSample>> graph{std::ref(source)};
+        graph.then(node);
+        if (auto ec = graph.run(); ec != std::errc{}) {
+            report_error(node.last_error, "mf_transform_node_t");
+            FAIL(static_cast<uint32_t>(ec));
+        }
+        return graph.stats(1);
+    }
+
+    /// @brief The input with the other subtype. The frame size and rate are kept
+    static com_ptr<IMFMediaType> make_video_type(IMFMediaType* input, const GUID& subtype) noexcept(false) {
+        media_type_t type{};
+        if (auto hr = get_media_type(input, type); FAILED(hr))
             winrt::throw_hresult(hr);
-        UINT32 num = 0, denom = 1;
-        MFGetAttributeRatio(input, MF_MT_FRAME_RATE, &num, &denom);
-        if (auto hr = MFSetAttributeSize(output.get(), MF_MT_FRAME_RATE, num, denom); FAILED(hr))
+        type.set_major_type(to_media_guid(MFMediaType_Video));
+        type.set_subtype(to_media_guid(subtype));
+        com_ptr<IMFMediaType> output{};
+        if (auto hr = make_media_type(type, output.put()); FAILED(hr))
             winrt::throw_hresult(hr);
         return output;
     }
 
+    /// @brief The sample from `sample_pool`. It goes back to the pool when the last reference is released
     /// @see https://docs.microsoft.com/en-us/windows/win32/api/mfobjects/nn-mfobjects-imfmediabuffer
-    static HRESULT create_single_buffer_sample(IMFSample** output, DWORD bufsz) {
-        if (auto hr = MFCreateSample(output); FAILED(hr))
+    HRESULT create_single_buffer_sample(IMFSample** output, DWORD bufsz) {
+        // GetMaxLength will be the capacity of the size class
+        // GetCurrentLength will be 0
+        return sample_pool->acquire(bufsz, output);
+    }
+
+    /// @brief Copy of the trace's sample. The timestamps and the flags are restored like `read_samples`
+    HRESULT create_trace_sample(const trace_sample_t& item, IMFSample** output) {
+        if (auto hr = create_single_buffer_sample(output, static_cast<DWORD>(item.data.size())); FAILED(hr))
             return hr;
+        IMFSample* sample = *output;
         com_ptr<IMFMediaBuffer> buffer{};
-        if (auto hr = MFCreateMemoryBuffer(bufsz, buffer.put()); FAILED(hr))
+        if (auto hr = sample->GetBufferByIndex(0, buffer.put()); FAILED(hr))
             return hr;
-        // GetMaxLength will be length of the available memory location
-        // GetCurrentLength will be 0
-        IMFSample* sample = *output;
-        return sample->AddBuffer(buffer.get());
+        BYTE* ptr = nullptr;
+        if (auto hr = buffer->Lock(&ptr, nullptr, nullptr); FAILED(hr))
+            return hr;
+        std::memcpy(ptr, item.data.data(), item.data.size());
+        buffer->Unlock();
+        if (auto hr = buffer->SetCurrentLength(static_cast<DWORD>(item.data.size())); FAILED(hr))
+            return hr;
+        sample->SetSampleTime(item.time);
+        sample->SetSampleDuration(item.duration);
+        sample->SetUINT64(MFSampleExtension_DecodeTimestamp, static_cast<UINT64>(item.decode_time));
+        sample->SetUINT32(MFSampleExtension_CleanPoint, item.sync);
+        return sample->SetUINT32(MFSampleExtension_Discontinuity, item.discontinuity);
     }
 };
 
@@ -360,6 +555,135 @@ TEST_CASE_METHOD(video_reader_test_case, "IMFSourceReader - H264", "[codec]") {
     };
 }
 
+TEST_CASE_METHOD(video_reader_test_case, "IMFSourceReader - H264 to fMP4", "[codec][mp4]") {
+    fmp4_muxer_config_t config{};
+    config.timescale = 10'000'000;        // unit 100-nanosecond
+    config.fragment_duration = 5'000'000; // close at each sync sample (every 1 sec)
+    UINT32 blob_size = 0;
+    REQUIRE(source_type->GetBlobSize(MF_MT_MPEG_SEQUENCE_HEADER, &blob_size) == S_OK);
+    config.sequence_header.resize(blob_size);
+    REQUIRE(source_type->GetBlob(MF_MT_MPEG_SEQUENCE_HEADER, config.sequence_header.data(), blob_size, &blob_size) ==
+            S_OK);
+
+    const auto fpath = fs::temp_directory_path() / "test-sample-0-fragmented.mp4";
+    int fd = -1;
+    REQUIRE(_wsopen_s(&fd, fpath.c_str(), _O_CREAT | _O_TRUNC | _O_WRONLY | _O_BINARY, _SH_DENYNO,
+                      _S_IREAD | _S_IWRITE) == 0);
+    auto on_return = gsl::finally([fd]() { _close(fd); });
+    fmp4_fd_output_t output{fd};
+    fmp4_muxer_t muxer{output, config};
+
+    size_t count = 0;
+    for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
+        com_ptr<IMFMediaBuffer> buffer{};
+        REQUIRE(sample->ConvertToContiguousBuffer(buffer.put()) == S_OK);
+        BYTE* ptr = nullptr;
+        DWORD length = 0;
+        REQUIRE(buffer->Lock(&ptr, nullptr, &length) == S_OK);
+        fmp4_sample_t item{};
+        item.data = gsl::span<const uint8_t>{ptr, length};
+        // the muxer doesn't copy. keep the buffer locked until the fragment is written
+        item.owner = std::shared_ptr<const void>{ptr, [buffer](const void*) { buffer->Unlock(); }};
+        REQUIRE(sample->GetSampleTime(&item.presentation_time) == S_OK);
+        item.decode_time = static_cast<int64_t>(
+            MFGetAttributeUINT64(sample.get(), MFSampleExtension_DecodeTimestamp, item.presentation_time));
+        item.sync = MFGetAttributeUINT32(sample.get(), MFSampleExtension_CleanPoint, FALSE);
+        REQUIRE(muxer.append(item) == std::errc{});
+        ++count;
+    }
+    REQUIRE(muxer.finalize() == std::errc{});
+    REQUIRE(count == 64);
+    REQUIRE(muxer.fragment_count() == 3); // sync samples are 1, 31, 61
+}
+
+/// @brief Record the compressed samples once, then replay them into the decoder without the source reader.
+///        The media type is rebuilt from the trace, so the replay doesn't depend on the source
+TEST_CASE_METHOD(video_reader_test_case, "IMFSourceReader - H264 to sample trace", "[codec][thread]") {
+    sample_trace_header_t header{make_fourcc("H264")};
+    REQUIRE(MFGetAttributeSize(source_type.get(), MF_MT_FRAME_SIZE, &header.width, &header.height) == S_OK);
+    MFGetAttributeRatio(source_type.get(), MF_MT_FRAME_RATE, &header.frame_rate_numerator,
+                        &header.frame_rate_denominator);
+    UINT32 blob_size = 0;
+    REQUIRE(source_type->GetBlobSize(MF_MT_MPEG_SEQUENCE_HEADER, &blob_size) == S_OK);
+    header.sequence_header.resize(blob_size);
+    REQUIRE(source_type->GetBlob(MF_MT_MPEG_SEQUENCE_HEADER, header.sequence_header.data(), blob_size, &blob_size) ==
+            S_OK);
+
+    const auto fpath = fs::temp_directory_path() / "test-sample-0.trace";
+    {
+        int fd = -1;
+        REQUIRE(_wsopen_s(&fd, fpath.c_str(), _O_CREAT | _O_TRUNC | _O_WRONLY | _O_BINARY, _SH_DENYNO,
+                          _S_IREAD | _S_IWRITE) == 0);
+        auto on_return = gsl::finally([fd]() { _close(fd); });
+        fmp4_fd_output_t output{fd};
+        sample_trace_writer_t writer{output};
+        REQUIRE(writer.write_header(header) == std::errc{});
+        for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
+            com_ptr<IMFMediaBuffer> buffer{};
+            REQUIRE(sample->ConvertToContiguousBuffer(buffer.put()) == S_OK);
+            BYTE* ptr = nullptr;
+            DWORD length = 0;
+            REQUIRE(buffer->Lock(&ptr, nullptr, &length) == S_OK);
+            auto unlock = gsl::finally([buffer]() { buffer->Unlock(); });
+            trace_sample_t item{gsl::span<const uint8_t>{ptr, length}};
+            REQUIRE(sample->GetSampleTime(&item.time) == S_OK);
+            sample->GetSampleDuration(&item.duration);
+            item.decode_time =
+                static_cast<int64_t>(MFGetAttributeUINT64(sample.get(), MFSampleExtension_DecodeTimestamp, item.time));
+            item.sync = MFGetAttributeUINT32(sample.get(), MFSampleExtension_CleanPoint, FALSE);
+            item.discontinuity = MFGetAttributeUINT32(sample.get(), MFSampleExtension_Discontinuity, FALSE);
+            REQUIRE(writer.append(item) == std::errc{});
+        }
+        REQUIRE(writer.flush() == std::errc{});
+        REQUIRE(writer.count() == 64);
+    }
+
+    mapped_file_t file{};
+    REQUIRE(file.open(fpath) == std::errc{});
+    sample_trace_reader_t trace{file.bytes()};
+    sample_trace_header_t replay_header{};
+    REQUIRE(trace.read_header(replay_header) == std::errc{});
+    REQUIRE(replay_header.sequence_header == header.sequence_header);
+
+    com_ptr<IMFMediaType> input_type{};
+    REQUIRE(MFCreateMediaType(input_type.put()) == S_OK);
+    REQUIRE(input_type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video) == S_OK);
+    REQUIRE(input_type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_H264) == S_OK);
+    REQUIRE(MFSetAttributeSize(input_type.get(), MF_MT_FRAME_SIZE, replay_header.width, replay_header.height) == S_OK);
+    REQUIRE(MFSetAttributeRatio(input_type.get(), MF_MT_FRAME_RATE, replay_header.frame_rate_numerator,
+                                replay_header.frame_rate_denominator) == S_OK);
+    REQUIRE(input_type->SetBlob(MF_MT_MPEG_SEQUENCE_HEADER, replay_header.sequence_header.data(),
+                                static_cast<UINT32>(replay_header.sequence_header.size())) == S_OK);
+
+    h264_decoder_t decoder{};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], input_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> output_type = make_video_type(input_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], output_type.get(), 0) == S_OK);
+
+    // as fast as possible. the second pass starts at the IDR frame with the continued timestamps
+    trace_replayer_t replayer{trace, replay_config_t{0, 2}};
+    mf_transform_node_t decode{decoder.transform};
+    stage_graph_t<com_ptr<IMFSample>> graph{[this, &replayer](com_ptr<IMFSample>& sample) {
+        trace_sample_t item{};
+        if (auto ec = replayer.next(item); ec != std::errc{})
+            return ec;
+        if (auto hr = create_trace_sample(item, sample.put()); FAILED(hr))
+            return std::errc::not_enough_memory;
+        return std::errc{};
+    }};
+    graph.then(decode);
+    REQUIRE(graph.run() == std::errc{});
+    REQUIRE(decode.last_error == S_OK);
+    const replay_stats_t stats = replayer.stats();
+    REQUIRE(stats.samples == 128);
+    REQUIRE(graph.stats(1).input_count == 128);
+    REQUIRE(graph.stats(1).output_count);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(stats.elapsed);
+    spdlog::info("replay: {} samples, {} bytes in {} us", stats.samples, stats.bytes, elapsed.count());
+}
+
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/h-264-video-decoder
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/basic-mft-processing-model
 TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CMSH264DecoderMFT", "[codec]") {
@@ -386,66 +710,10 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CMSH264DecoderMFT"
         REQUIRE(transform->SetOutputType(ostream, output.get(), 0) == MF_E_INVALIDMEDIATYPE);
         // we can't consume the samples because there is no transform
     }
-
-    auto consume_samples = [istream, ostream](com_ptr<IMFSourceReaderEx> reader, DWORD reader_stream, //
-                                              com_ptr<IMFTransform> transform,                        //
-                                              com_ptr<IMFSample> output_sample) {
-        DWORD status = 0;
-        REQUIRE(transform->GetInputStatus(istream, &status) == S_OK);
-        REQUIRE(status == MFT_INPUT_STATUS_ACCEPT_DATA);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL) == S_OK);
-
-        size_t output_count = 0;
-        for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
-            if (auto hr = transform->ProcessInput(istream, sample.get(), 0); FAILED(hr)) {
-                report_error(hr, "ProcessInput");
-                FAIL(static_cast<uint32_t>(hr));
-            }
-
-            MFT_OUTPUT_DATA_BUFFER output{};
-            output.dwStreamID = ostream;
-            output.pSample = output_sample.get();
-            switch (auto hr = transform->ProcessOutput(0, 1, &output, &status); hr) {
-            case S_OK:
-                ++output_count;
-                continue;
-            case MF_E_TRANSFORM_NEED_MORE_INPUT:
-                continue;
-            case MF_E_TRANSFORM_STREAM_CHANGE:
-                spdlog::debug("stream changed: {:#08x}", status);
-                [[fallthrough]];
-            default:
-                report_error(hr, __func__);
-                FAIL(static_cast<uint32_t>(hr));
-            }
-        }
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL) == S_OK);
-        REQUIRE(output_count);
-        output_count = 0;
-        bool output_available = true;
-        while (output_available) {
-            MFT_OUTPUT_DATA_BUFFER output{};
-            output.dwStreamID = ostream;
-            output.pSample = output_sample.get();
-            switch (auto hr = transform->ProcessOutput(0, 1, &output, &status); hr) {
-            case S_OK:
-                ++output_count;
-                continue;
-            case MF_E_TRANSFORM_NEED_MORE_INPUT:
-                output_available = false;
-                continue;
-            case MF_E_TRANSFORM_STREAM_CHANGE:
-                spdlog::debug("stream changed: {:#08x}", status);
-                [[fallthrough]];
-            default:
-                report_error(hr, __func__);
-                FAIL(static_cast<uint32_t>(hr));
-            }
-        }
-        REQUIRE(output_count);
-    };
+    SECTION("Reorder depth") {
+        REQUIRE(decoder.configure_reorder(source_type.get()) == S_OK);
+        REQUIRE(decoder.reorder_depth == 1); // test-sample-0.mp4 uses I/P/B frames
+    }
 
     // for Asynchronous MFT
     // @todo https://docs.microsoft.com/en-us/windows/win32/medfound/basic-mft-processing-model#get-buffer-requirements
@@ -456,7 +724,11 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CMSH264DecoderMFT"
         com_ptr<IMFMediaType> output_type = make_video_type(input.get(), MFVideoFormat_NV12);
         REQUIRE(transform->SetOutputType(ostream, output_type.get(), 0) == S_OK);
 
-        consume_samples(reader, reader_stream, transform, output_sample);
+        DWORD status = 0;
+        REQUIRE(transform->GetInputStatus(istream, &status) == S_OK);
+        REQUIRE(status == MFT_INPUT_STATUS_ACCEPT_DATA);
+        mf_transform_node_t node{transform, output_sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
     SECTION("I420") {
         com_ptr<IMFMediaType> input = source_type;
@@ -464,11 +736,211 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CMSH264DecoderMFT"
         com_ptr<IMFMediaType> output_type = make_video_type(input.get(), MFVideoFormat_I420);
         REQUIRE(transform->SetOutputType(ostream, output_type.get(), 0) == S_OK);
 
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
     // todo: MFVideoFormat_IYUV
 }
 
+/// @brief The decoder works while the next samples are read on the `work_scheduler_t`
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CMSH264DecoderMFT with async_generator_t",
+                 "[codec][thread]") {
+    h264_decoder_t decoder{};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], output_type.get(), 0) == S_OK);
+
+    struct counter_t final : public stage_emitter_t<com_ptr<IMFSample>> {
+        uint32_t count = 0;
+
+      public:
+        std::errc emit(com_ptr<IMFSample>) noexcept override {
+            ++count;
+            return std::errc{};
+        }
+    };
+    auto decode = [](async_generator_t<com_ptr<IMFSample>>& samples, mf_transform_node_t& node,
+                     counter_t& outputs) -> winrt::Windows::Foundation::IAsyncOperation<int32_t> {
+        if (auto ec = node.start(); ec != std::errc{})
+            co_return static_cast<int32_t>(ec);
+        while (std::optional<com_ptr<IMFSample>> sample = co_await samples.next())
+            if (auto ec = node.process(std::move(*sample), outputs); ec != std::errc{})
+                co_return static_cast<int32_t>(ec);
+        co_return static_cast<int32_t>(node.drain(outputs));
+    };
+
+    work_scheduler_t scheduler{2};
+    auto samples = read_samples_async(reader, reader_stream);
+    REQUIRE(samples.start(scheduler, 4) == std::errc{});
+    mf_transform_node_t node{decoder.transform};
+    counter_t outputs{};
+    REQUIRE(decode(samples, node, outputs).get() == 0);
+    REQUIRE(node.last_error == S_OK);
+    REQUIRE(outputs.count);
+}
+
+/// @brief The late non-reference samples are dropped before the decoder. The other frames don't refer them
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CMSH264DecoderMFT with deadline_queue_t",
+                 "[codec][thread]") {
+    h264_decoder_t decoder{};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], output_type.get(), 0) == S_OK);
+
+    auto analyzer = std::make_unique<h264_stream_analyzer_t>(); // parameter set tables are large for the stack
+    {
+        UINT32 blob_size = 0;
+        REQUIRE(source_type->GetBlobSize(MF_MT_MPEG_SEQUENCE_HEADER, &blob_size) == S_OK);
+        std::vector<uint8_t> blob(blob_size);
+        REQUIRE(source_type->GetBlob(MF_MT_MPEG_SEQUENCE_HEADER, blob.data(), blob_size, &blob_size) == S_OK);
+        REQUIRE(analyzer->feed_sequence_header({blob.data(), blob_size}) == std::errc{});
+    }
+    // unknown samples are treated as the reference
+    auto is_reference = [&analyzer](IMFSample* sample) {
+        com_ptr<IMFMediaBuffer> buffer{};
+        if (FAILED(sample->ConvertToContiguousBuffer(buffer.put())))
+            return true;
+        BYTE* ptr = nullptr;
+        DWORD length = 0;
+        if (FAILED(buffer->Lock(&ptr, nullptr, &length)))
+            return true;
+        auto on_return = gsl::finally([buffer]() { buffer->Unlock(); });
+        gsl::span<const uint8_t> stream{ptr, length};
+        h264_picture_t picture{};
+        while (true) {
+            gsl::span<const uint8_t> nal = next_annexb_nal(stream);
+            if (nal.empty())
+                return true;
+            if (analyzer->feed(nal, picture) == std::errc{})
+                return picture.reference;
+        }
+    };
+
+    struct frame_t final : public stage_emitter_t<com_ptr<IMFSample>> {
+        mf_transform_node_t* node = nullptr;
+        com_ptr<IMFSample> input{};
+        bool reference = true;
+        bool dropped = false;
+        bool failed = false;
+
+      public:
+        std::errc emit(com_ptr<IMFSample>) noexcept override {
+            return std::errc{};
+        }
+        static void invoke(void* context) noexcept {
+            auto frame = static_cast<frame_t*>(context);
+            frame->failed = frame->node->process(std::move(frame->input), *frame) != std::errc{};
+        }
+        static void drop(void* context) noexcept {
+            auto frame = static_cast<frame_t*>(context);
+            frame->input = nullptr;
+            frame->dropped = true;
+        }
+    };
+    mf_transform_node_t node{decoder.transform};
+    REQUIRE(node.start() == std::errc{});
+
+    UINT32 num = 0, denom = 1;
+    REQUIRE(MFGetAttributeRatio(source_type.get(), MF_MT_FRAME_RATE, &num, &denom) == S_OK);
+    // tight budget. the samples behind the busy decoder become late
+    frame_clock_t clock{num, denom, std::chrono::milliseconds{1}};
+    work_scheduler_t scheduler{1}; // the decoder takes the inputs one by one
+    std::deque<frame_t> frames{};
+    deadline_stats_t stats{};
+    {
+        deadline_queue_t queue{scheduler, drop_policy_t{}};
+        for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
+            frame_t& frame = frames.emplace_back();
+            frame.node = &node;
+            frame.input = sample;
+            frame.reference = is_reference(sample.get());
+            deadline_task_t task{&frame_t::invoke, &frame_t::drop, &frame};
+            // the deadline follows the decoding order. so EDF keeps the order for the decoder
+            task.deadline = clock.deadline(media_duration_t{-1}, frames.size() - 1);
+            task.reference = frame.reference;
+            REQUIRE(queue.put(task) == std::errc{});
+        }
+        do {
+            std::this_thread::yield();
+            stats = queue.stats();
+        } while (stats.executed + stats.dropped < stats.submitted);
+    }
+    frame_t last{};
+    REQUIRE(node.drain(last) == std::errc{});
+    REQUIRE(node.last_error == S_OK);
+
+    REQUIRE(stats.submitted == frames.size());
+    uint64_t dropped = 0;
+    for (const frame_t& frame : frames) {
+        REQUIRE_FALSE(frame.failed);
+        if (frame.reference)
+            REQUIRE_FALSE(frame.dropped);
+        dropped += frame.dropped;
+    }
+    REQUIRE(stats.dropped == dropped);
+    spdlog::debug("{}: executed {} dropped {} late {}", "deadline_queue_t", stats.executed, stats.dropped, stats.late);
+}
+
+/// @brief The reader runs on its own thread and the decoder consumes from the ring
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CMSH264DecoderMFT with spsc_ring_t", "[codec][thread]") {
+    h264_decoder_t decoder{};
+    com_ptr<IMFTransform> transform = decoder.transform;
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(transform.get()));
+    const DWORD istream = info.input_stream_ids[0];
+    const DWORD ostream = info.output_stream_ids[0];
+    REQUIRE(transform->SetInputType(istream, source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(transform->SetOutputType(ostream, output_type.get(), 0) == S_OK);
+    REQUIRE_NOTHROW(info.from(transform.get()));
+    com_ptr<IMFSample> output_sample{};
+    REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
+
+    spsc_ring_t<com_ptr<IMFSample>> ring{8};
+    size_t input_count = 0;
+    std::thread producer{[&ring, &input_count](com_ptr<IMFSourceReaderEx> reader, DWORD reader_stream) {
+                             winrt::init_apartment(winrt::apartment_type::multi_threaded);
+                             for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
+                                 if (ring.push(std::move(sample)) != std::errc{})
+                                     break;
+                                 ++input_count;
+                             }
+                             ring.close();
+                             winrt::uninit_apartment();
+                         },
+                         reader, reader_stream};
+    auto on_exit = gsl::finally([&ring, &producer]() {
+        ring.close();
+        producer.join();
+    });
+
+    REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL) == S_OK);
+    REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL) == S_OK);
+    size_t output_count = 0;
+    DWORD status = 0;
+    com_ptr<IMFSample> sample{};
+    while (ring.pop(sample) == std::errc{}) {
+        REQUIRE(transform->ProcessInput(istream, sample.get(), 0) == S_OK);
+        sample = nullptr;
+        MFT_OUTPUT_DATA_BUFFER output{};
+        output.dwStreamID = ostream;
+        output.pSample = output_sample.get();
+        const auto hr = transform->ProcessOutput(0, 1, &output, &status);
+        if (hr == S_OK)
+            ++output_count;
+        else if (hr != MF_E_TRANSFORM_NEED_MORE_INPUT)
+            FAIL(static_cast<uint32_t>(hr));
+    }
+    REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, NULL) == S_OK);
+    REQUIRE(transform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL) == S_OK);
+    REQUIRE(output_count);
+    REQUIRE(input_count > output_count); // the rest are in the decoder until drained
+}
+
 /// @see https://docs.microsoft.com/en-us/windows/win32/medfound/basic-mft-processing-model
 TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CColorConvertDMO", "[dsp]") {
     // Valid configuration order can be I->O or O->I.
@@ -479,42 +951,6 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CColorConvertDMO",
 
     const DWORD istream = 0;
     const DWORD ostream = 0;
-    auto consume_samples = [istream, ostream](com_ptr<IMFSourceReaderEx> reader, DWORD reader_stream, //
-                                              com_ptr<IMFTransform> transform,                        //
-                                              com_ptr<IMFSample> output_sample) {
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL) == S_OK);
-        DWORD status = 0;
-        size_t output_count = 0;
-        for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
-            if (auto hr = transform->ProcessInput(istream, sample.get(), 0); FAILED(hr)) {
-                report_error(hr, "ProcessInput");
-                FAIL(static_cast<uint32_t>(hr));
-            }
-            bool output_available = true;
-            while (output_available) {
-                MFT_OUTPUT_DATA_BUFFER output{};
-                output.dwStreamID = ostream;
-                output.pSample = output_sample.get();
-                switch (auto hr = transform->ProcessOutput(0, 1, &output, &status); hr) {
-                case S_OK:
-                    ++output_count;
-                    continue;
-                case MF_E_TRANSFORM_NEED_MORE_INPUT:
-                    output_available = false;
-                    continue;
-                case MF_E_TRANSFORM_STREAM_CHANGE:
-                    [[fallthrough]];
-                default:
-                    report_error(hr, __func__);
-                    FAIL(static_cast<uint32_t>(hr));
-                }
-            }
-        }
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL) == S_OK);
-        REQUIRE(output_count);
-    };
 
     mf_transform_info_t info{};
     SECTION("RGB32 - I420") {
@@ -527,7 +963,8 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CColorConvertDMO",
         REQUIRE_FALSE(info.output_provide_sample());
         com_ptr<IMFSample> output_sample{};
         REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
     SECTION("RGB32 - IYUV") {
         REQUIRE(set_subtype(MFVideoFormat_RGB32) == S_OK);
@@ -539,7 +976,8 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CColorConvertDMO",
         REQUIRE_FALSE(info.output_provide_sample());
         com_ptr<IMFSample> output_sample{};
         REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
     SECTION("NV12 - RGB32") {
         // @todo Try with Texture2D buffer
@@ -553,7 +991,8 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CColorConvertDMO",
         REQUIRE_FALSE(info.output_provide_sample());
         com_ptr<IMFSample> output_sample{};
         REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
     SECTION("I420 - RGB32") {
         // @todo Try with Texture2D buffer
@@ -566,7 +1005,8 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CColorConvertDMO",
         REQUIRE_FALSE(info.output_provide_sample());
         com_ptr<IMFSample> output_sample{};
         REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
     SECTION("I420 - RGB565") {
         // @todo Try with Texture2D buffer
@@ -579,7 +1019,8 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - CLSID_CColorConvertDMO",
         REQUIRE_FALSE(info.output_provide_sample());
         com_ptr<IMFSample> output_sample{};
         REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
 }
 
@@ -601,49 +1042,6 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Resizer DSP", "[ds
         REQUIRE(transform->SetInputType(0, source_type.get(), 0) != S_OK);
     }
 
-    const DWORD istream = 0;
-    const DWORD ostream = 0;
-    auto consume_samples = [istream, ostream](com_ptr<IMFSourceReaderEx> reader, DWORD reader_stream, //
-                                              com_ptr<IMFTransform> transform,                        //
-                                              com_ptr<IMFSample> output_sample) {
-        size_t input_count = 0;
-        size_t output_count = 0;
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL) == S_OK);
-        DWORD status = 0;
-        for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
-            ++input_count;
-            if (auto hr = transform->ProcessInput(istream, sample.get(), 0); FAILED(hr)) {
-                report_error(hr, "ProcessInput");
-                FAIL(static_cast<uint32_t>(hr));
-            }
-            bool output_available = true;
-            while (output_available) {
-                MFT_OUTPUT_DATA_BUFFER output{};
-                output.dwStreamID = ostream;
-                output.pSample = output_sample.get();
-                switch (auto hr = transform->ProcessOutput(0, 1, &output, &status); hr) {
-                case S_OK:
-                    ++output_count;
-                    continue;
-                case MF_E_TRANSFORM_NEED_MORE_INPUT:
-                    output_available = false;
-                    continue;
-                case MF_E_TRANSFORM_STREAM_CHANGE:
-                    [[fallthrough]];
-                default:
-                    report_error(hr, __func__);
-                    FAIL(static_cast<uint32_t>(hr));
-                }
-            }
-        }
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL) == S_OK);
-        // CLSID_CResizerDMO won't have leftover
-        REQUIRE(output_count);
-        REQUIRE(input_count == output_count);
-    };
-
     mf_transform_info_t info{};
     SECTION("RGB32") {
         REQUIRE(set_subtype(MFVideoFormat_RGB32) == S_OK);
@@ -657,7 +1055,10 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Resizer DSP", "[ds
         REQUIRE_FALSE(info.output_provide_sample());
         com_ptr<IMFSample> output_sample{};
         REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        const auto stats = run_transform(reader, reader_stream, node);
+        REQUIRE(stats.output_count);
+        REQUIRE(stats.input_count == stats.output_count); // CLSID_CResizerDMO won't have leftover
     }
     SECTION("I420") {
         REQUIRE(set_subtype(MFVideoFormat_I420) == S_OK);
@@ -671,7 +1072,10 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Resizer DSP", "[ds
         REQUIRE_FALSE(info.output_provide_sample());
         com_ptr<IMFSample> output_sample{};
         REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-        consume_samples(reader, reader_stream, transform, output_sample);
+        mf_transform_node_t node{transform, output_sample};
+        const auto stats = run_transform(reader, reader_stream, node);
+        REQUIRE(stats.output_count);
+        REQUIRE(stats.input_count == stats.output_count); // CLSID_CResizerDMO won't have leftover
     }
 }
 
@@ -691,53 +1095,6 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Processor MFT", "[
         const DWORD ostream = num_output - 1;
     }
 
-    const DWORD istream = 0;
-    const DWORD ostream = 0;
-    auto consume_samples = [istream, ostream](com_ptr<IMFSourceReaderEx> reader, DWORD reader_stream, //
-                                              com_ptr<IMFTransform> transform,                        //
-                                              com_ptr<IMFVideoProcessorControl> control,
-                                              com_ptr<IMFSample> output_sample) {
-        MFARGB color{};
-        REQUIRE(control->SetBorderColor(&color) == S_OK);
-
-        size_t input_count = 0;
-        size_t output_count = 0;
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL) == S_OK);
-        DWORD status = 0;
-        for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
-            ++input_count;
-            if (auto hr = transform->ProcessInput(istream, sample.get(), 0); FAILED(hr)) {
-                report_error(hr, "ProcessInput");
-                FAIL(static_cast<uint32_t>(hr));
-            }
-            bool output_available = true;
-            while (output_available) {
-                MFT_OUTPUT_DATA_BUFFER output{};
-                output.dwStreamID = ostream;
-                output.pSample = output_sample.get();
-                switch (auto hr = transform->ProcessOutput(0, 1, &output, &status); hr) {
-                case S_OK:
-                    ++output_count;
-                    continue;
-                case MF_E_TRANSFORM_NEED_MORE_INPUT:
-                    output_available = false;
-                    continue;
-                case MF_E_TRANSFORM_STREAM_CHANGE:
-                    [[fallthrough]];
-                default:
-                    report_error(hr, __func__);
-                    FAIL(static_cast<uint32_t>(hr));
-                }
-            }
-        }
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL) == S_OK);
-        // CLSID_VideoProcessorMFT won't have leftover
-        REQUIRE(output_count);
-        REQUIRE(input_count == output_count);
-    };
-
     mf_transform_info_t info{};
     SECTION("MIRROR_HORIZONTAL/ROTAION_NORMAL") {
         com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_RGB32);
@@ -752,7 +1109,11 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Processor MFT", "[
         // H mirror, corrects the orientation, letterboxes the output as needed
         REQUIRE(processor.set_mirror_rotation(MF_VIDEO_PROCESSOR_MIRROR::MIRROR_HORIZONTAL,
                                               MF_VIDEO_PROCESSOR_ROTATION::ROTATION_NORMAL) == S_OK);
-        consume_samples(reader, reader_stream, transform, processor.control, output_sample);
+        REQUIRE(processor.set_color(MFARGB{}) == S_OK);
+        mf_transform_node_t node{transform, output_sample};
+        const auto stats = run_transform(reader, reader_stream, node);
+        REQUIRE(stats.output_count);
+        REQUIRE(stats.input_count == stats.output_count); // CLSID_VideoProcessorMFT won't have leftover
     }
     SECTION("MIRROR_VERTICAL/ROTAION_NORMAL") {
         com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_RGB32);
@@ -767,7 +1128,11 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Processor MFT", "[
         // H mirror, corrects the orientation, letterboxes the output as needed
         REQUIRE(processor.set_mirror_rotation(MF_VIDEO_PROCESSOR_MIRROR::MIRROR_VERTICAL,
                                               MF_VIDEO_PROCESSOR_ROTATION::ROTATION_NORMAL) == S_OK);
-        consume_samples(reader, reader_stream, transform, processor.control, output_sample);
+        REQUIRE(processor.set_color(MFARGB{}) == S_OK);
+        mf_transform_node_t node{transform, output_sample};
+        const auto stats = run_transform(reader, reader_stream, node);
+        REQUIRE(stats.output_count);
+        REQUIRE(stats.input_count == stats.output_count); // CLSID_VideoProcessorMFT won't have leftover
     }
     SECTION("Scale") {
         SECTION("With IMFMediaType") {
@@ -779,7 +1144,11 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Processor MFT", "[
             REQUIRE_FALSE(info.output_provide_sample());
             com_ptr<IMFSample> output_sample{};
             REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-            consume_samples(reader, reader_stream, transform, processor.control, output_sample);
+            REQUIRE(processor.set_color(MFARGB{}) == S_OK);
+            mf_transform_node_t node{transform, output_sample};
+            const auto stats = run_transform(reader, reader_stream, node);
+            REQUIRE(stats.output_count);
+            REQUIRE(stats.input_count == stats.output_count); // CLSID_VideoProcessorMFT won't have leftover
         }
         SECTION("With Width/Height") {
             REQUIRE(processor.set_scale(source_type.get(), 720, 720) == S_OK);
@@ -788,11 +1157,249 @@ TEST_CASE_METHOD(video_reader_test_case, "MFTransform - Video Processor MFT", "[
             REQUIRE_FALSE(info.output_provide_sample());
             com_ptr<IMFSample> output_sample{};
             REQUIRE(create_single_buffer_sample(output_sample.put(), info.output_info.cbSize) == S_OK);
-            consume_samples(reader, reader_stream, transform, processor.control, output_sample);
+            REQUIRE(processor.set_color(MFARGB{}) == S_OK);
+            mf_transform_node_t node{transform, output_sample};
+            const auto stats = run_transform(reader, reader_stream, node);
+            REQUIRE(stats.output_count);
+            REQUIRE(stats.input_count == stats.output_count); // CLSID_VideoProcessorMFT won't have leftover
         }
     }
 }
 
+/// @brief reader -> decoder -> scaler -> (discard). Every stage runs on its own thread
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - stage_graph_t", "[codec][dsp][thread]") {
+    h264_decoder_t decoder{};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> nv12 = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], nv12.get(), 0) == S_OK);
+
+    sample_processor_t processor{};
+    com_ptr<IMFMediaType> rgb32 = make_video_type(source_type.get(), MFVideoFormat_RGB32);
+    REQUIRE(MFSetAttributeSize(rgb32.get(), MF_MT_FRAME_SIZE, 640, 360) == S_OK);
+    REQUIRE(processor.set_type(nv12.get(), rgb32.get()) == S_OK);
+
+    mf_transform_node_t decode{decoder.transform};
+    mf_transform_node_t scale{processor.transform};
+    reader_source_t source{read_samples(reader, reader_stream)};
+    stage_graph_t<com_ptr<IMFSample>> graph{std::ref(source)};
+    graph.then(decode, 4).then(scale, 2);
+    REQUIRE(graph.run() == std::errc{});
+    REQUIRE(decode.last_error == S_OK);
+    REQUIRE(scale.last_error == S_OK);
+    REQUIRE(graph.stats(1).input_count == graph.stats(0).output_count);
+    REQUIRE(graph.stats(1).output_count == graph.stats(1).input_count); // drained
+    REQUIRE(graph.stats(2).output_count == graph.stats(2).input_count);
+}
+
+/// @brief The downstream is canceled. It is not a failure of the transform
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - canceled downstream", "[codec]") {
+    h264_decoder_t decoder{};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], output_type.get(), 0) == S_OK);
+
+    struct canceled_emitter_t final : public stage_emitter_t<com_ptr<IMFSample>> {
+        std::errc emit(com_ptr<IMFSample>) noexcept override {
+            return std::errc::operation_canceled;
+        }
+    };
+    canceled_emitter_t output{};
+    mf_transform_node_t node{decoder.transform};
+    REQUIRE(node.start() == std::errc{});
+    std::errc ec{};
+    for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream))
+        if (ec = node.process(sample, output); ec != std::errc{})
+            break;
+    if (ec == std::errc{})
+        ec = node.drain(output);
+    REQUIRE(ec == std::errc::operation_canceled);
+    REQUIRE(node.last_error == S_OK);
+}
+
+/// @brief The decoder through the portable `media_transform_t`. The illegal messages don't reach the MFT
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - mf_transform_adapter_t", "[codec][thread]") {
+    h264_decoder_t decoder{};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], output_type.get(), 0) == S_OK);
+
+    mf_transform_adapter_t adapter{decoder.transform};
+    com_ptr<IMFSample> sample{};
+    REQUIRE(adapter.process_input(sample) == std::errc::operation_not_permitted);
+    REQUIRE(adapter.drain() == std::errc::operation_not_permitted);
+
+    transform_node_t<com_ptr<IMFSample>> node{adapter};
+    reader_source_t source{read_samples(reader, reader_stream)};
+    stage_graph_t<com_ptr<IMFSample>> graph{std::ref(source)};
+    graph.then(node);
+    REQUIRE(graph.run() == std::errc{});
+    REQUIRE(adapter.last_error == S_OK);
+    REQUIRE(graph.stats(1).output_count);
+    REQUIRE(adapter.state() == transform_state_t::ready); // drained
+    REQUIRE(adapter.end_streaming() == std::errc{});
+    REQUIRE(adapter.state() == transform_state_t::idle);
+}
+
+/// @brief The decoder has its own MF work queue and its frames run on a core group of the `stream_executor_t`
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - stream_executor_t", "[codec][thread]") {
+    DWORD queue = 0;
+    REQUIRE(MFAllocateWorkQueueEx(MF_STANDARD_WORKQUEUE, &queue) == S_OK);
+    auto on_return = gsl::finally([queue]() { MFUnlockWorkQueue(queue); });
+
+    h264_decoder_t decoder{CLSID_CMSH264DecoderMFT, queue};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> output_type = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], output_type.get(), 0) == S_OK);
+
+    struct frame_t final : public stage_emitter_t<com_ptr<IMFSample>> {
+        mf_transform_node_t* node = nullptr;
+        com_ptr<IMFSample> input{};
+        std::atomic<uint32_t> output_count{0};
+        std::atomic<uint32_t> failed{0};
+
+      public:
+        std::errc emit(com_ptr<IMFSample>) noexcept override {
+            ++output_count;
+            return std::errc{};
+        }
+        static void invoke(void* context) noexcept {
+            auto frame = static_cast<frame_t*>(context);
+            if (frame->node->process(std::move(frame->input), *frame) != std::errc{})
+                ++frame->failed;
+        }
+    };
+    mf_transform_node_t node{decoder.transform};
+    REQUIRE(node.start() == std::errc{});
+
+    cpu_topology_t topology{};
+    REQUIRE(get_cpu_topology(topology) == std::errc{});
+    stream_executor_t executor{make_core_groups(topology, 2, true), stream_executor_config_t{}};
+    executor_stream_t* stream = nullptr;
+    REQUIRE(executor.open(1, stream) == std::errc{}); // the decoder takes the inputs in order
+
+    frame_t frame{};
+    frame.node = &node;
+    for (com_ptr<IMFSample> sample : read_samples(reader, reader_stream)) {
+        while (stream->stats().in_flight) // the frame is reused
+            std::this_thread::yield();
+        frame.input = sample;
+        REQUIRE(executor.submit(*stream, work_item_t{&frame_t::invoke, &frame}) == std::errc{});
+    }
+    REQUIRE(executor.close(stream) == std::errc{});
+    REQUIRE(node.drain(frame) == std::errc{});
+    REQUIRE(frame.failed == 0);
+    REQUIRE(node.last_error == S_OK);
+    REQUIRE(frame.output_count);
+}
+
+/// @brief The decoder's outputs are recycled. After the warm-up, no sample is created for the frames
+TEST_CASE_METHOD(video_reader_test_case, "MFTransform - mf_sample_pool_t", "[codec][thread]") {
+    h264_decoder_t decoder{};
+    mf_transform_info_t info{};
+    REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+    REQUIRE(decoder.transform->SetInputType(info.input_stream_ids[0], source_type.get(), 0) == S_OK);
+    com_ptr<IMFMediaType> nv12 = make_video_type(source_type.get(), MFVideoFormat_NV12);
+    REQUIRE(decoder.transform->SetOutputType(info.output_stream_ids[0], nv12.get(), 0) == S_OK);
+
+    frame_pool_config_t config{};
+    config.min_count = 4;
+    config.max_count = 8;
+    com_ptr<mf_sample_pool_t> pool = mf_sample_pool_t::make(config);
+    SECTION("acquire and release") {
+        REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+        com_ptr<IMFSample> sample{};
+        REQUIRE(pool->acquire(info.output_info.cbSize, sample.put()) == S_OK);
+        com_ptr<IMFMediaBuffer> buffer{};
+        REQUIRE(sample->GetBufferByIndex(0, buffer.put()) == S_OK);
+        DWORD capacity = 0;
+        REQUIRE(buffer->GetMaxLength(&capacity) == S_OK);
+        REQUIRE(capacity >= info.output_info.cbSize);
+        IMFSample* const ptr = sample.get();
+        buffer = nullptr;
+        sample = nullptr; // back to the pool
+        while (pool->stats().outstanding)
+            std::this_thread::yield();
+        REQUIRE(pool->acquire(info.output_info.cbSize, sample.put()) == S_OK);
+        REQUIRE(sample.get() == ptr);
+        REQUIRE(pool->stats().allocated == 4);
+        com_ptr<IMFSample> oversized{};
+        REQUIRE(pool->acquire(UINT32_MAX, oversized.put()) == E_INVALIDARG);
+    }
+    SECTION("stage_graph_t") {
+        mf_transform_node_t decode{decoder.transform, pool};
+        reader_source_t source{read_samples(reader, reader_stream)};
+        stage_graph_t<com_ptr<IMFSample>> graph{std::ref(source)};
+        graph.then(decode);
+        REQUIRE(graph.run() == std::errc{});
+        REQUIRE(decode.last_error == S_OK);
+        const frame_pool_stats_t stats = pool->stats();
+        REQUIRE(stats.acquired > graph.stats(1).output_count); // the last one for `MF_E_TRANSFORM_NEED_MORE_INPUT`
+        // `Invoke` recycles on the MF work queue, so `exhausted` depends on the timing. the node waits then
+        REQUIRE(stats.allocated <= config.max_count);
+    }
+    SECTION("budget") {
+        REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+        const size_class_table_t table{config.min_size, config.max_size, config.alignment};
+        const size_t capacity = table.capacity(table.find(info.output_info.cbSize));
+        memory_budget_t budget{capacity * 2};
+        config.budget = &budget;
+        com_ptr<mf_sample_pool_t> limited = mf_sample_pool_t::make(config);
+        com_ptr<IMFSample> samples[3]{};
+        REQUIRE(limited->acquire(info.output_info.cbSize, samples[0].put()) == S_OK);
+        REQUIRE(limited->acquire(info.output_info.cbSize, samples[1].put()) == S_OK);
+        REQUIRE(limited->acquire(info.output_info.cbSize, samples[2].put()) == MF_E_SAMPLEALLOCATOR_EMPTY);
+        REQUIRE(limited->stats().allocated == 2); // under `min_count`
+        REQUIRE(budget.usage().live == capacity * 2);
+        for (auto& sample : samples)
+            sample = nullptr;
+        limited = nullptr;
+        while (budget.usage().live) // `Invoke` may run later
+            std::this_thread::yield();
+    }
+    SECTION("budget backpressure") {
+        REQUIRE_NOTHROW(info.from(decoder.transform.get()));
+        const size_class_table_t table{config.min_size, config.max_size, config.alignment};
+        const size_t capacity = table.capacity(table.find(info.output_info.cbSize));
+        memory_budget_t budget{capacity * 2};
+        config.min_count = 1;
+        config.budget = &budget;
+        com_ptr<mf_sample_pool_t> limited = mf_sample_pool_t::make(config);
+        {
+            // holds the sample longer than the decoder takes. the queue and this can't fit in the budget
+            struct slow_node_t final : public stage_node_t<com_ptr<IMFSample>> {
+                std::errc process(com_ptr<IMFSample> input,
+                                  stage_emitter_t<com_ptr<IMFSample>>& output) noexcept override {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+                    return output.emit(std::move(input));
+                }
+            };
+            mf_transform_node_t decode{decoder.transform, limited};
+            slow_node_t consume{};
+            reader_source_t source{read_samples(reader, reader_stream)};
+            stage_graph_t<com_ptr<IMFSample>> graph{std::ref(source)};
+            graph.then(decode).then(consume, 2);
+            REQUIRE(graph.run() == std::errc{}); // stalled, not failed
+            REQUIRE(decode.last_error == S_OK);
+            REQUIRE(graph.stats(2).input_count == graph.stats(1).output_count);
+        }
+        const frame_pool_stats_t stats = limited->stats();
+        REQUIRE(stats.exhausted > 0);
+        REQUIRE(stats.allocated <= 2);
+        REQUIRE(budget.usage().peak <= capacity * 2);
+        limited = nullptr;
+        while (budget.usage().live) // `Invoke` may run later
+            std::this_thread::yield();
+    }
+}
+
 struct rgba32_buffer_test_case : public video_buffer_test_case, public video_reader_test_case {
     com_ptr<ID3D11Texture2D> tex2d{};
     com_ptr<IMFSample> sample{};
@@ -811,43 +1418,6 @@ struct rgba32_buffer_test_case : public video_buffer_test_case, public video_rea
 };
 
 TEST_CASE_METHOD(rgba32_buffer_test_case, "Resize to ID3D11Texture2D(RGBA32)", "[codec]") {
-    auto consume_samples = [](com_ptr<IMFSourceReaderEx> reader, com_ptr<IMFTransform> transform,
-                              const mf_transform_info_t info, com_ptr<IMFSample> output_sample) {
-        const DWORD istream = info.input_stream_ids[0];
-        const DWORD ostream = info.output_stream_ids[0];
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, NULL) == S_OK);
-        DWORD status = 0;
-        size_t output_count = 0;
-        for (com_ptr<IMFSample> sample : read_samples(reader, MF_SOURCE_READER_FIRST_VIDEO_STREAM)) {
-            if (auto hr = transform->ProcessInput(istream, sample.get(), 0); FAILED(hr)) {
-                report_error(hr, "ProcessInput");
-                FAIL(static_cast<uint32_t>(hr));
-            }
-            bool output_available = true;
-            while (output_available) {
-                MFT_OUTPUT_DATA_BUFFER output{};
-                output.dwStreamID = ostream;
-                output.pSample = output_sample.get();
-                switch (auto hr = transform->ProcessOutput(0, 1, &output, &status); hr) {
-                case S_OK:
-                    ++output_count;
-                    continue;
-                case MF_E_TRANSFORM_NEED_MORE_INPUT:
-                    output_available = false;
-                    continue;
-                case MF_E_TRANSFORM_STREAM_CHANGE:
-                    [[fallthrough]];
-                default:
-                    report_error(hr, __func__);
-                    FAIL(static_cast<uint32_t>(hr));
-                }
-            }
-        }
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, NULL) == S_OK);
-        REQUIRE(transform->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, NULL) == S_OK);
-        REQUIRE(output_count);
-    };
 
     REQUIRE(set_subtype(MFVideoFormat_RGB32) == S_OK);
     const RECT src{0, 0, 1280, 720}, dst{0, 0, 256, 256};
@@ -861,7 +1431,8 @@ TEST_CASE_METHOD(rgba32_buffer_test_case, "Resize to ID3D11Texture2D(RGBA32)", "
         REQUIRE_FALSE(info.output_provide_sample());
         REQUIRE(info.output_info.cbSize == static_cast<uint32_t>(dst.right * dst.bottom * 4));
 
-        consume_samples(reader, cropper.transform, info, sample);
+        mf_transform_node_t node{cropper.transform, sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
     SECTION("Downscale") {
         sample_processor_t resizer{};
@@ -872,6 +1443,7 @@ TEST_CASE_METHOD(rgba32_buffer_test_case, "Resize to ID3D11Texture2D(RGBA32)", "
         REQUIRE_FALSE(info.output_provide_sample());
         REQUIRE(info.output_info.cbSize == static_cast<uint32_t>(dst.right * dst.bottom * 4));
 
-        consume_samples(reader, resizer.transform, info, sample);
+        mf_transform_node_t node{resizer.transform, sample};
+        REQUIRE(run_transform(reader, reader_stream, node).output_count);
     }
 }
@@ -0,0 +1,80 @@
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "mp4_box.hpp"
+
+namespace fs = std::filesystem;
+
+fs::path get_asset_dir() noexcept;
+
+TEST_CASE("MP4 Box", "[mp4]") {
+    mapped_file_t file{};
+    REQUIRE(file.open(get_asset_dir() / "test-sample-0.mp4") == std::errc{});
+    REQUIRE(file.bytes().size() == fs::file_size(get_asset_dir() / "test-sample-0.mp4"));
+
+    const mp4_box_t root{file.bytes()};
+    std::vector<uint32_t> types{};
+    mp4_box_cursor_t cursor{};
+    REQUIRE(root.children(cursor) == std::errc{});
+    mp4_box_t box{};
+    std::errc ec{};
+    while ((ec = cursor.next(box)) == std::errc{})
+        types.emplace_back(box.type());
+    REQUIRE(ec == std::errc::no_message_available);
+    REQUIRE(types == std::vector<uint32_t>{make_fourcc("ftyp"), make_fourcc("uuid"), make_fourcc("pdin"),
+                                           make_fourcc("mdat"), make_fourcc("moov")});
+
+    mp4_box_t moov{};
+    REQUIRE(root.find(make_fourcc("moov"), moov) == std::errc{});
+    REQUIRE(moov.offset() == 2553607);
+    REQUIRE(moov.size() == 4366);
+
+    mp4_box_t avcc{};
+    REQUIRE(moov.find({make_fourcc("trak"), make_fourcc("mdia"), make_fourcc("minf"), make_fourcc("stbl"),
+                       make_fourcc("stsd"), make_fourcc("avc1"), make_fourcc("avcC")},
+                      avcc) == std::errc{});
+    REQUIRE(avcc.offset() == 2554082);
+    REQUIRE(avcc.size() == 60);
+    REQUIRE(avcc.payload().data() == file.bytes().data() + 2554082 + 8); // points the mapped memory
+
+    SECTION("no such box") {
+        REQUIRE(root.find(make_fourcc("moof"), box) == std::errc::no_message_available);
+        REQUIRE(avcc.find(make_fourcc("avcC"), box) == std::errc::not_supported); // not a container
+    }
+    SECTION("missing file") {
+        mapped_file_t missing{};
+        REQUIRE(missing.open(get_asset_dir() / "not-exist.mp4") == std::errc::no_such_file_or_directory);
+        REQUIRE(missing.bytes().empty());
+    }
+}
+
+TEST_CASE("MP4 Box - broken input", "[mp4]") {
+    mp4_box_t box{};
+    mp4_box_cursor_t cursor{};
+    SECTION("box exceeds the parent") {
+        const uint8_t bytes[] = {0x00, 0x00, 0x00, 0x10, 'm', 'o', 'o', 'v', 0x00, 0x00, 0x00, 0x10, 't', 'r', 'a', 'k'};
+        const mp4_box_t root{bytes};
+        mp4_box_t moov{};
+        REQUIRE(root.find(make_fourcc("moov"), moov) == std::errc{});
+        REQUIRE(moov.payload().size() == 8);
+        REQUIRE(moov.find(make_fourcc("trak"), box) == std::errc::protocol_error);
+    }
+    SECTION("largesize") {
+        const uint8_t bytes[] = {0x00, 0x00, 0x00, 0x01, 'f', 'r', 'e', 'e', 0xFF, 0xFF,
+                                 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0, 0x00, 0x00, 0x00, 0x00};
+        REQUIRE(mp4_box_t{bytes}.children(cursor) == std::errc{});
+        REQUIRE(cursor.next(box) == std::errc::protocol_error);
+        REQUIRE(cursor.next(box) == std::errc::no_message_available); // stopped
+    }
+    SECTION("size smaller than the header") {
+        const uint8_t bytes[] = {0x00, 0x00, 0x00, 0x04, 'f', 'r', 'e', 'e'};
+        REQUIRE(mp4_box_t{bytes}.find(make_fourcc("free"), box) == std::errc::protocol_error);
+    }
+    SECTION("sample entry without the fields") {
+        const uint8_t bytes[] = {0x00, 0x00, 0x00, 0x0C, 'a', 'v', 'c', '1', 0x00, 0x00, 0x00, 0x00};
+        mp4_box_t entry{};
+        REQUIRE(mp4_box_t{bytes}.find(make_fourcc("avc1"), entry) == std::errc{});
+        REQUIRE(entry.children(cursor) == std::errc::protocol_error);
+    }
+}
@@ -0,0 +1,58 @@
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include "frame_pool.hpp"
+#include "page_arena.hpp"
+
+TEST_CASE("Page Arena") {
+    SECTION("normal pages") {
+        page_arena_t arena{100'000, false, true};
+        REQUIRE(arena.kind() == page_kind_t::normal);
+        REQUIRE(arena.capacity() >= 100'000);
+        REQUIRE(arena.capacity() % arena.page_size() == 0);
+        void* first = arena.allocate(1000, 64);
+        void* second = arena.allocate(1000, 4096);
+        REQUIRE(first != nullptr);
+        REQUIRE(reinterpret_cast<uintptr_t>(second) % 4096 == 0);
+        REQUIRE(arena.contains(second));
+        REQUIRE(arena.size() == 4096 + 1000);
+        REQUIRE(arena.allocate(arena.capacity(), 64) == nullptr);
+        REQUIRE(arena.size() == 4096 + 1000); // unchanged
+        std::memset(second, 0xFF, 1000);
+        int local = 0;
+        REQUIRE_FALSE(arena.contains(&local));
+    }
+    SECTION("huge pages") {
+        // the kind depends on the system. the fallback must work anyway
+        page_arena_t arena{5 << 20, true, true};
+        REQUIRE(arena.capacity() >= (5 << 20));
+        if (arena.kind() != page_kind_t::normal)
+            REQUIRE(arena.page_size() >= (2 << 20));
+        auto* ptr = static_cast<uint8_t*>(arena.allocate(4 << 20, 64));
+        REQUIRE(ptr != nullptr);
+        std::memset(ptr, 1, 4 << 20);
+    }
+}
+
+TEST_CASE("Frame Pool - arena") {
+    frame_pool_config_t config{};
+    config.arena_size = 8 << 20;
+    config.min_count = 2;
+    frame_pool_t pool{config};
+    const size_t nv12 = 1920 * 1080 * 3 / 2;
+
+    frame_buffer_t buffer{};
+    REQUIRE(pool.acquire(nv12, buffer) == std::errc{});
+    REQUIRE(reinterpret_cast<uintptr_t>(buffer.data()) % config.alignment == 0);
+    const frame_pool_stats_t stats = pool.stats();
+    REQUIRE(stats.arena_used >= buffer.capacity() * 2); // min_count
+    // over the arena. from the heap
+    std::vector<frame_buffer_t> buffers(4);
+    for (frame_buffer_t& item : buffers) {
+        REQUIRE(pool.acquire(nv12, item) == std::errc{});
+        std::memset(item.data(), 0, nv12);
+    }
+    REQUIRE(pool.stats().arena_used == stats.arena_used);
+}
@@ -0,0 +1,108 @@
+#include <catch2/catch.hpp>
+
+#include <cstring>
+
+#include "planar_frame.hpp"
+
+TEST_CASE("Frame Layout") {
+    frame_layout_t layout{};
+    SECTION("NV12 contiguous") {
+        // same with `MFCalculateImageSize` and `MF_MT_DEFAULT_STRIDE`
+        REQUIRE(make_frame_layout(pixel_format_t::nv12, 1920, 1080, 1, layout) == std::errc{});
+        REQUIRE(layout.plane_count == 2);
+        REQUIRE(layout.planes[0].stride == 1920);
+        REQUIRE(layout.planes[1].offset == 1920 * 1080);
+        REQUIRE(layout.planes[1].height == 540);
+        REQUIRE(layout.size == 1920 * 1080 * 3 / 2);
+    }
+    SECTION("NV12 aligned") {
+        REQUIRE(make_frame_layout(pixel_format_t::nv12, 1918, 1081, 64, layout) == std::errc{});
+        for (uint32_t i = 0; i < layout.plane_count; ++i) {
+            const plane_layout_t& plane = layout.planes[i];
+            REQUIRE(plane.offset % 64 == 0);
+            REQUIRE(plane.stride % 64 == 0);
+            REQUIRE(plane.stride >= plane.width);
+        }
+        REQUIRE(layout.planes[0].stride == 1920);
+        REQUIRE(layout.planes[1].width == 1918);
+        REQUIRE(layout.planes[1].height == 541); // rounded up
+        REQUIRE(layout.size == layout.planes[1].offset + size_t{1920} * 541);
+    }
+    SECTION("cache set aliasing") {
+        // 1024 pixels of RGB32 are 4096 bytes. the rows would be in the same cache sets
+        REQUIRE(make_frame_layout(pixel_format_t::rgb32, 1024, 16, 64, layout) == std::errc{});
+        REQUIRE(layout.planes[0].stride == 4096 + 64);
+        REQUIRE(make_frame_layout(pixel_format_t::rgb32, 1024, 16, 1, layout) == std::errc{});
+        REQUIRE(layout.planes[0].stride == 4096);
+    }
+    SECTION("planar") {
+        REQUIRE(make_frame_layout(pixel_format_t::i420, 640, 480, 1, layout) == std::errc{});
+        REQUIRE(layout.plane_count == 3);
+        REQUIRE(layout.planes[1].offset == 640 * 480);
+        REQUIRE(layout.planes[2].offset == 640 * 480 * 5 / 4);
+        REQUIRE(layout.planes[2].stride == 320);
+        REQUIRE(layout.size == 640 * 480 * 3 / 2);
+    }
+    SECTION("packed") {
+        REQUIRE(make_frame_layout(pixel_format_t::yuy2, 641, 2, 1, layout) == std::errc{});
+        REQUIRE(layout.planes[0].width == 321 * 4);
+        REQUIRE(layout.planes[0].samples == 641);
+        REQUIRE(make_frame_layout(pixel_format_t::rgb24, 3, 2, 1, layout) == std::errc{});
+        REQUIRE(layout.planes[0].width == 9);
+        REQUIRE(layout.planes[0].stride == 12); // DWORD-aligned rows
+        REQUIRE(layout.size == 24);
+        REQUIRE(make_frame_layout(pixel_format_t::rgb565, 3, 2, 1, layout) == std::errc{});
+        REQUIRE(layout.planes[0].stride == 8);
+        REQUIRE(make_frame_layout(pixel_format_t::p010, 4, 4, 1, layout) == std::errc{});
+        REQUIRE(layout.planes[1].width == 8);
+        REQUIRE(layout.size == 48);
+    }
+    SECTION("invalid") {
+        REQUIRE(make_frame_layout(pixel_format_t::unknown, 16, 16, 64, layout) == std::errc::not_supported);
+        REQUIRE(make_frame_layout(pixel_format_t::nv12, 0, 16, 64, layout) == std::errc::invalid_argument);
+        REQUIRE(make_frame_layout(pixel_format_t::nv12, 16, 16, 48, layout) == std::errc::invalid_argument);
+        REQUIRE(make_frame_layout(pixel_format_t::y416, UINT32_MAX, 1, 64, layout) == std::errc::value_too_large);
+    }
+    REQUIRE(static_cast<uint32_t>(pixel_format_t::nv12) == 0x3231564E); // MFVideoFormat_NV12.Data1
+}
+
+TEST_CASE("Planar Frame") {
+    frame_layout_t layout{};
+    REQUIRE(make_frame_layout(pixel_format_t::nv12, 1280, 720, 64, layout) == std::errc{});
+
+    SECTION("owned") {
+        planar_frame_t frame{layout};
+        REQUIRE(reinterpret_cast<uintptr_t>(frame.data()) % 64 == 0);
+        plane_view_t<uint8_t> luma = frame.plane(0);
+        plane_view_t<uint8_t> chroma = frame.plane(1);
+        REQUIRE(chroma.data == frame.data() + layout.planes[1].offset);
+        REQUIRE(reinterpret_cast<uintptr_t>(chroma.data) % 64 == 0);
+        // whole strides are writable
+        for (uint32_t y = 0; y < luma.height; ++y)
+            std::memset(luma.row(y), 16, luma.stride);
+        for (uint32_t y = 0; y < chroma.height; ++y)
+            std::memset(chroma.row(y), 128, chroma.stride);
+        const planar_frame_t& view = frame;
+        REQUIRE(view.plane(1).row(359)[1279] == 128);
+        REQUIRE(view.plane(2).data == nullptr);
+    }
+    SECTION("pooled") {
+        frame_pool_t pool{frame_pool_config_t{}};
+        frame_buffer_t buffer{};
+        REQUIRE(pool.acquire(layout.size, buffer) == std::errc{});
+        {
+            planar_frame_t frame{layout, buffer};
+            REQUIRE(frame.data() == buffer.data());
+            REQUIRE(buffer.use_count() == 2);
+        }
+        REQUIRE(buffer.use_count() == 1);
+        frame_buffer_t small{};
+        REQUIRE(pool.acquire(1024, small) == std::errc{});
+        REQUIRE_THROWS_AS(planar_frame_t(layout, small), std::invalid_argument);
+    }
+    SECTION("empty") {
+        REQUIRE_THROWS_AS(planar_frame_t{frame_layout_t{}}, std::invalid_argument);
+        planar_frame_t frame{};
+        REQUIRE(frame.plane(0).data == nullptr);
+    }
+}
@@ -0,0 +1,188 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "presentation_scheduler.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct presented_t final {
+    std::mutex* mtx = nullptr;
+    std::vector<int>* released = nullptr;
+    std::vector<deadline_clock_t::time_point>* times = nullptr;
+    std::atomic<uint32_t>* dropped = nullptr;
+    int id = 0;
+
+    static void invoke(void* context) noexcept {
+        auto self = static_cast<presented_t*>(context);
+        std::lock_guard lck{*self->mtx};
+        self->released->emplace_back(self->id);
+        self->times->emplace_back(deadline_clock_t::now());
+    }
+    static void drop(void* context) noexcept {
+        auto self = static_cast<presented_t*>(context);
+        ++(*self->dropped);
+    }
+};
+
+} // namespace
+
+TEST_CASE("Timer Wheel") {
+    timer_wheel_t wheel{100};
+    SECTION("expire at the tick") {
+        std::mt19937_64 engine{7};
+        std::uniform_int_distribution<uint64_t> distance{1, 300'000}; // over the 3 levels
+        std::vector<timer_entry_t> entries(500);
+        for (timer_entry_t& entry : entries) {
+            entry.expiry = wheel.now() + distance(engine);
+            REQUIRE(wheel.insert(entry));
+        }
+        REQUIRE(wheel.size() == 500);
+        size_t expired = 0;
+        while (wheel.size()) {
+            const uint64_t tick = wheel.next_tick();
+            REQUIRE(tick > wheel.now());
+            for (timer_entry_t* entry = wheel.advance(tick); entry; entry = entry->next) {
+                REQUIRE(entry->expiry == tick);
+                REQUIRE_FALSE(entry->linked);
+                ++expired;
+            }
+        }
+        REQUIRE(expired == 500);
+        REQUIRE(wheel.next_tick() == UINT64_MAX);
+    }
+    SECTION("advance over the expiry") {
+        timer_entry_t entries[3]{};
+        entries[0].expiry = 150;
+        entries[1].expiry = 5'000;
+        entries[2].expiry = 6'000;
+        for (timer_entry_t& entry : entries)
+            REQUIRE(wheel.insert(entry));
+        size_t count = 0;
+        for (timer_entry_t* entry = wheel.advance(5'500); entry; entry = entry->next)
+            ++count;
+        REQUIRE(count == 2);
+        REQUIRE(wheel.now() == 5'500);
+        REQUIRE(wheel.size() == 1);
+        REQUIRE(wheel.advance(6'000) == &entries[2]);
+    }
+    SECTION("remove") {
+        timer_entry_t entries[2]{};
+        entries[0].expiry = 200;
+        entries[1].expiry = 200;
+        REQUIRE(wheel.insert(entries[0]));
+        REQUIRE(wheel.insert(entries[1]));
+        wheel.remove(entries[0]);
+        wheel.remove(entries[0]); // not linked. ignored
+        REQUIRE(wheel.size() == 1);
+        timer_entry_t* expired = wheel.advance(300);
+        REQUIRE(expired == &entries[1]);
+        REQUIRE(expired->next == nullptr);
+    }
+    SECTION("overflow") {
+        timer_entry_t entry{};
+        entry.expiry = 100 + (uint64_t{1} << 30);
+        REQUIRE(wheel.insert(entry));
+        REQUIRE(wheel.advance(entry.expiry - 1) == nullptr);
+        REQUIRE(wheel.advance(entry.expiry) == &entry);
+    }
+    SECTION("past") {
+        timer_entry_t entry{};
+        entry.expiry = 100;
+        REQUIRE_FALSE(wheel.insert(entry));
+        REQUIRE(wheel.size() == 0);
+    }
+}
+
+TEST_CASE("Presentation Scheduler", "[thread]") {
+    std::mutex mtx{};
+    std::vector<int> released{};
+    std::vector<deadline_clock_t::time_point> times{};
+    std::atomic<uint32_t> dropped{0};
+    std::vector<presented_t> frames(8);
+    for (int i = 0; i < 8; ++i)
+        frames[i] = presented_t{&mtx, &released, &times, &dropped, i};
+    auto make_task = [&frames](int i, media_duration_t time) {
+        return presentation_task_t{&presented_t::invoke, &presented_t::drop, &frames[i], time};
+    };
+    auto wait_for = [&](size_t count) {
+        const auto until = deadline_clock_t::now() + 5s;
+        while (deadline_clock_t::now() < until) {
+            std::this_thread::sleep_for(1ms);
+            std::lock_guard lck{mtx};
+            if (released.size() >= count)
+                return true;
+        }
+        return false;
+    };
+
+    SECTION("presentation order") {
+        presentation_scheduler_t scheduler{presentation_config_t{}};
+        const auto origin = deadline_clock_t::now() + 10ms;
+        scheduler.reset(origin, media_duration_t{0});
+        // decoding order of IPBB... the timestamps are not monotonic
+        const int order[8]{0, 3, 1, 2, 6, 4, 5, 7};
+        for (int i : order)
+            REQUIRE(scheduler.schedule(make_task(i, media_duration_t{i * 50'000})) == std::errc{}); // 5ms
+        REQUIRE(wait_for(8));
+        REQUIRE(released == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7});
+        for (int i = 0; i < 8; ++i)
+            REQUIRE(times[i] >= origin + i * 5ms);
+        const jitter_stats_t stats = scheduler.stats();
+        REQUIRE(stats.released == 8);
+        REQUIRE(stats.max >= stats.mean);
+        REQUIRE(scheduler.pending() == 0);
+    }
+    SECTION("rate") {
+        presentation_scheduler_t scheduler{presentation_config_t{100us, 4.0, 8}};
+        const auto start = deadline_clock_t::now();
+        for (int i = 0; i < 8; ++i)
+            REQUIRE(scheduler.schedule(make_task(i, media_duration_t{i * 333'333})) == std::errc{});
+        REQUIRE(wait_for(8));
+        const auto elapsed = times.back() - start;
+        REQUIRE(elapsed >= 58ms); // 7 frames of 33.3ms at 4x
+        REQUIRE(scheduler.set_rate(0) == std::errc::invalid_argument);
+    }
+    SECTION("change rate") {
+        presentation_scheduler_t scheduler{presentation_config_t{}};
+        REQUIRE(scheduler.schedule(make_task(0, media_duration_t{0})) == std::errc{});
+        REQUIRE(scheduler.schedule(make_task(1, 10s)) == std::errc{});
+        REQUIRE(wait_for(1));
+        REQUIRE(scheduler.set_rate(1000) == std::errc{}); // the rest of 10s in 10ms
+        REQUIRE(wait_for(2));
+        REQUIRE(released == std::vector<int>{0, 1});
+    }
+    SECTION("capacity and flush") {
+        presentation_scheduler_t scheduler{presentation_config_t{100us, 1.0, 4}};
+        for (int i = 0; i < 4; ++i)
+            REQUIRE(scheduler.schedule(make_task(i, media_duration_t{10s + i * 1s})) == std::errc{});
+        REQUIRE(scheduler.schedule(make_task(4, 20s)) == std::errc::resource_unavailable_try_again);
+        REQUIRE(scheduler.pending() == 4);
+        scheduler.flush();
+        REQUIRE(dropped == 4);
+        REQUIRE(scheduler.pending() == 0);
+        // the next one is mapped to now
+        REQUIRE(scheduler.schedule(make_task(4, 20s)) == std::errc{});
+        REQUIRE(wait_for(1));
+        REQUIRE(released == std::vector<int>{4});
+    }
+    SECTION("destruction") {
+        {
+            presentation_scheduler_t scheduler{presentation_config_t{}};
+            for (int i = 0; i < 3; ++i)
+                REQUIRE(scheduler.schedule(make_task(i, media_duration_t{i * 10s})) == std::errc{});
+            REQUIRE(wait_for(1));
+        }
+        REQUIRE(dropped == 2);
+    }
+    SECTION("invalid task") {
+        presentation_scheduler_t scheduler{presentation_config_t{}};
+        REQUIRE(scheduler.schedule(presentation_task_t{}) == std::errc::invalid_argument);
+    }
+}
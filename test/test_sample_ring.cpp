@@ -0,0 +1,103 @@
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "sample_ring.hpp"
+
+TEST_CASE("SPSC Ring", "[thread]") {
+    spsc_ring_t<std::shared_ptr<uint32_t>> ring{6};
+    REQUIRE(ring.capacity() == 8);
+
+    SECTION("full and empty") {
+        auto item = std::make_shared<uint32_t>(1);
+        for (auto i = 0; i < 8; ++i) {
+            auto copy = item;
+            REQUIRE(ring.try_push(copy));
+            REQUIRE(copy == nullptr); // moved
+        }
+        auto copy = item;
+        REQUIRE_FALSE(ring.try_push(copy));
+        REQUIRE(copy != nullptr); // not moved
+        REQUIRE(ring.size() == 8);
+        REQUIRE(item.use_count() == 10);
+
+        std::shared_ptr<uint32_t> output{};
+        while (ring.try_pop(output))
+            output = nullptr;
+        REQUIRE(ring.size() == 0);
+        REQUIRE(item.use_count() == 2); // the ring doesn't hold the reference
+    }
+    SECTION("close") {
+        REQUIRE(ring.push(std::make_shared<uint32_t>(1)) == std::errc{});
+        ring.close();
+        REQUIRE(ring.push(std::make_shared<uint32_t>(2)) == std::errc::operation_canceled);
+        std::shared_ptr<uint32_t> output{};
+        REQUIRE(ring.pop(output) == std::errc{});
+        REQUIRE(*output == 1);
+        REQUIRE(ring.pop(output) == std::errc::no_message_available);
+    }
+    SECTION("producer and consumer thread") {
+        constexpr uint32_t count = 200'000;
+        std::thread producer{[&ring]() {
+            for (uint32_t i = 0; i < count; ++i)
+                ring.push(std::make_shared<uint32_t>(i));
+            ring.close();
+        }};
+        uint32_t expected = 0;
+        std::shared_ptr<uint32_t> output{};
+        while (ring.pop(output) == std::errc{}) {
+            if (*output != expected)
+                break;
+            ++expected;
+        }
+        producer.join();
+        REQUIRE(expected == count);
+    }
+}
+
+TEST_CASE("MPSC Ring", "[thread]") {
+    mpsc_ring_t<uint64_t> ring{64};
+    REQUIRE(ring.capacity() == 64);
+
+    SECTION("full and empty") {
+        for (uint64_t i = 0; i < 64; ++i)
+            REQUIRE(ring.try_push(i));
+        uint64_t value = 64;
+        REQUIRE_FALSE(ring.try_push(value));
+        for (uint64_t i = 0; i < 64; ++i) {
+            REQUIRE(ring.try_pop(value));
+            REQUIRE(value == i);
+        }
+        REQUIRE_FALSE(ring.try_pop(value));
+        value = 65;
+        REQUIRE(ring.try_push(value)); // wrap around
+    }
+    SECTION("multiple producers") {
+        constexpr uint64_t producer_count = 4;
+        constexpr uint64_t count = 50'000;
+        std::vector<std::thread> producers{};
+        for (uint64_t p = 0; p < producer_count; ++p)
+            producers.emplace_back([&ring, p]() {
+                for (uint64_t i = 0; i < count; ++i)
+                    ring.push((p << 32) | i); // producer in the high bits
+            });
+        // the order of each producer must be kept
+        std::vector<uint64_t> expected(producer_count);
+        uint64_t received = 0;
+        uint64_t value = 0;
+        while (received < producer_count * count && ring.pop(value) == std::errc{}) {
+            const auto p = value >> 32;
+            if (p >= producer_count || (value & 0xFFFF'FFFF) != expected[p])
+                break;
+            ++expected[p];
+            ++received;
+        }
+        for (auto& t : producers)
+            t.join();
+        REQUIRE(received == producer_count * count);
+        ring.close();
+        REQUIRE(ring.pop(value) == std::errc::no_message_available);
+    }
+}
@@ -0,0 +1,153 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <vector>
+
+#include "mp4_box.hpp"
+#include "sample_trace.hpp"
+#include "stage_graph.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct trace_buffer_t final : public fmp4_output_t {
+    std::vector<uint8_t> bytes{};
+
+  public:
+    std::errc write(gsl::span<const io_slice_t> slices) noexcept override {
+        for (const io_slice_t& slice : slices) {
+            auto ptr = static_cast<const uint8_t*>(slice.data);
+            bytes.insert(bytes.end(), ptr, ptr + slice.size);
+        }
+        return std::errc{};
+    }
+};
+
+/// @brief 30 fps with a B frame after each P frame. The decode timestamps are one frame behind
+std::vector<uint8_t> make_trace(uint32_t count, std::vector<std::vector<uint8_t>>& payloads) {
+    trace_buffer_t output{};
+    sample_trace_writer_t writer{output};
+    sample_trace_header_t header{make_fourcc("H264"), 1280, 720, 30, 1, {0, 0, 0, 1, 0x67}};
+    REQUIRE(writer.write_header(header) == std::errc{});
+    payloads.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        payloads[i].assign(100 + i, static_cast<uint8_t>(i));
+        const int64_t order = (i % 2) ? i + 1 : (i ? i - 1 : 0);
+        trace_sample_t sample{payloads[i], order * 333'333, (int64_t{i} - 1) * 333'333, 333'333, i % 30 == 0};
+        sample.discontinuity = i == 0;
+        REQUIRE(writer.append(sample) == std::errc{});
+    }
+    REQUIRE(writer.count() == count);
+    return output.bytes;
+}
+
+} // namespace
+
+TEST_CASE("Sample Trace", "[mp4]") {
+    std::vector<std::vector<uint8_t>> payloads{};
+    const std::vector<uint8_t> trace = make_trace(64, payloads);
+
+    SECTION("round trip") {
+        sample_trace_reader_t reader{trace};
+        sample_trace_header_t header{};
+        REQUIRE(reader.read_header(header) == std::errc{});
+        REQUIRE(header.codec == make_fourcc("H264"));
+        REQUIRE(header.width == 1280);
+        REQUIRE(header.height == 720);
+        REQUIRE(header.frame_rate_numerator == 30);
+        REQUIRE(header.sequence_header == std::vector<uint8_t>{0, 0, 0, 1, 0x67});
+        trace_sample_t sample{};
+        for (uint32_t i = 0; i < 64; ++i) {
+            REQUIRE(reader.next(sample) == std::errc{});
+            REQUIRE(std::equal(sample.data.begin(), sample.data.end(), payloads[i].begin(), payloads[i].end()));
+            REQUIRE(sample.decode_time == (int64_t{i} - 1) * 333'333); // negative for the first
+            REQUIRE(sample.duration == 333'333);
+            REQUIRE(sample.sync == (i % 30 == 0));
+            REQUIRE(sample.discontinuity == (i == 0));
+        }
+        REQUIRE(reader.next(sample) == std::errc::no_message_available);
+        reader.rewind();
+        REQUIRE(reader.next(sample) == std::errc{});
+        REQUIRE(sample.time == 0);
+        REQUIRE(sample.data.size() == 100);
+    }
+    SECTION("compact") {
+        size_t payload_size = 0;
+        for (const auto& payload : payloads)
+            payload_size += payload.size();
+        REQUIRE(trace.size() - payload_size < 64 * 12);
+    }
+    SECTION("header required") {
+        trace_buffer_t output{};
+        sample_trace_writer_t writer{output};
+        REQUIRE(writer.append(trace_sample_t{}) == std::errc::operation_not_permitted);
+        sample_trace_reader_t reader{trace};
+        trace_sample_t sample{};
+        REQUIRE(reader.next(sample) == std::errc::operation_not_permitted);
+    }
+    SECTION("invalid") {
+        std::vector<uint8_t> bytes = trace;
+        bytes[0] = 'X';
+        sample_trace_header_t header{};
+        REQUIRE(sample_trace_reader_t{bytes}.read_header(header) == std::errc::protocol_error);
+        bytes = trace;
+        bytes[4] = 2;
+        REQUIRE(sample_trace_reader_t{bytes}.read_header(header) == std::errc::not_supported);
+    }
+    SECTION("truncated") {
+        const auto bytes = gsl::span<const uint8_t>{trace}.first(trace.size() - 1);
+        sample_trace_reader_t reader{bytes};
+        sample_trace_header_t header{};
+        REQUIRE(reader.read_header(header) == std::errc{});
+        trace_sample_t sample{};
+        for (uint32_t i = 0; i < 63; ++i)
+            REQUIRE(reader.next(sample) == std::errc{});
+        REQUIRE(reader.next(sample) == std::errc::protocol_error);
+    }
+}
+
+TEST_CASE("Trace Replayer", "[mp4][thread]") {
+    std::vector<std::vector<uint8_t>> payloads{};
+    const std::vector<uint8_t> trace = make_trace(8, payloads);
+    sample_trace_reader_t reader{trace};
+    sample_trace_header_t header{};
+    REQUIRE(reader.read_header(header) == std::errc{});
+
+    SECTION("as fast as possible") {
+        trace_replayer_t replayer{reader, replay_config_t{0, 3}};
+        trace_sample_t sample{};
+        std::vector<int64_t> times{};
+        while (replayer.next(sample) == std::errc{})
+            times.emplace_back(sample.decode_time);
+        REQUIRE(times.size() == 24);
+        REQUIRE(std::is_sorted(times.begin(), times.end()));
+        REQUIRE(times[8] == times[7] + 333'333); // the next pass continues
+        const replay_stats_t stats = replayer.stats();
+        REQUIRE(stats.samples == 24);
+        REQUIRE(stats.late == 0);
+        REQUIRE(replayer.next(sample) == std::errc::no_message_available);
+    }
+    SECTION("paced") {
+        // 8 frames at 10x speed. 7 intervals of 3.3ms
+        trace_replayer_t replayer{reader, replay_config_t{10, 1}};
+        trace_sample_t sample{};
+        const auto start = deadline_clock_t::now();
+        deadline_clock_t::time_point previous{};
+        while (replayer.next(sample) == std::errc{}) {
+            REQUIRE(deadline_clock_t::now() >= replayer.release_time());
+            REQUIRE(replayer.release_time() > previous);
+            previous = replayer.release_time();
+        }
+        REQUIRE(deadline_clock_t::now() - start >= 23ms);
+        REQUIRE(replayer.stats().samples == 8);
+        REQUIRE(replayer.stats().elapsed >= 23ms);
+    }
+    SECTION("stage_graph_t") {
+        trace_replayer_t replayer{reader, replay_config_t{0, 2}};
+        stage_graph_t<trace_sample_t> graph{std::ref(replayer)};
+        REQUIRE(graph.run() == std::errc{});
+        REQUIRE(graph.stats(0).output_count == 16);
+        REQUIRE(replayer.stats().bytes == 2 * (100 + 101 + 102 + 103 + 104 + 105 + 106 + 107));
+    }
+}
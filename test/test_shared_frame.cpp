@@ -0,0 +1,159 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "shared_frame.hpp"
+#include "stage_graph.hpp"
+
+namespace {
+
+shared_frame_t make_shared_frame(uint8_t value) {
+    frame_layout_t layout{};
+    REQUIRE(make_frame_layout(pixel_format_t::nv12, 320, 240, 64, layout) == std::errc{});
+    planar_frame_t frame{layout};
+    std::memset(frame.data(), value, layout.size);
+    return shared_frame_t{std::move(frame)};
+}
+
+/// @brief Check the frame's first byte and count the distinct frames
+class inspect_node_t final : public stage_node_t<shared_frame_t> {
+  public:
+    std::vector<const uint8_t*> frames{};
+    uint8_t expected = 0;
+    uint32_t mismatch = 0;
+
+  public:
+    std::errc process(shared_frame_t input, stage_emitter_t<shared_frame_t>& output) noexcept override {
+        if (input->data()[0] != expected)
+            ++mismatch;
+        frames.emplace_back(input->data());
+        return output.emit(std::move(input));
+    }
+};
+
+/// @brief Mutate the frame after `make_writable`
+class overlay_node_t final : public stage_node_t<shared_frame_t> {
+  public:
+    uint32_t copied = 0;
+
+  public:
+    std::errc process(shared_frame_t input, stage_emitter_t<shared_frame_t>& output) noexcept override {
+        const uint8_t* before = input->data();
+        if (auto ec = input.make_writable(); ec != std::errc{})
+            return ec;
+        if (input->data() != before)
+            ++copied;
+        plane_view_t<uint8_t> luma = input.writable()->plane(0);
+        for (uint32_t y = 0; y < luma.height; ++y)
+            std::memset(luma.row(y), 0xFF, luma.width);
+        return output.emit(std::move(input));
+    }
+};
+
+} // namespace
+
+TEST_CASE("Shared Frame") {
+    shared_frame_t frame = make_shared_frame(1);
+    REQUIRE(frame.use_count() == 1);
+    REQUIRE(frame.writable() != nullptr);
+
+    SECTION("copy is a reference") {
+        shared_frame_t other = frame;
+        REQUIRE(frame.use_count() == 2);
+        REQUIRE(other->data() == frame->data());
+        REQUIRE(frame.writable() == nullptr);
+        other.reset();
+        REQUIRE(frame.writable() != nullptr);
+    }
+    SECTION("copy on write") {
+        shared_frame_t other = frame;
+        const uint8_t* original = frame->data();
+        REQUIRE(frame.make_writable() == std::errc{});
+        REQUIRE(frame->data() != original);
+        REQUIRE(other->data() == original);
+        REQUIRE(frame.use_count() == 1);
+        REQUIRE(other.use_count() == 1);
+        REQUIRE(std::memcmp(frame->data(), original, frame->layout().size) == 0);
+        frame.writable()->data()[0] = 2;
+        REQUIRE(other->data()[0] == 1);
+        // already unique. no copy
+        const uint8_t* copied = frame->data();
+        REQUIRE(frame.make_writable() == std::errc{});
+        REQUIRE(frame->data() == copied);
+    }
+    SECTION("copy to the pool") {
+        frame_pool_config_t config{};
+        config.max_count = 1;
+        frame_pool_t pool{config};
+        shared_frame_t other = frame;
+        REQUIRE(frame.make_writable(&pool) == std::errc{});
+        REQUIRE(pool.stats().outstanding == 1);
+        shared_frame_t third = frame;
+        REQUIRE(third.make_writable(&pool) == std::errc::resource_unavailable_try_again);
+        REQUIRE(third->data() == frame->data()); // unchanged
+        frame.reset();
+        third.reset();
+        REQUIRE(pool.stats().outstanding == 0);
+    }
+    SECTION("empty") {
+        shared_frame_t empty{};
+        REQUIRE(empty.make_writable() == std::errc::invalid_argument);
+        REQUIRE(empty.writable() == nullptr);
+        REQUIRE(empty.use_count() == 0);
+    }
+}
+
+TEST_CASE("Shared Frame - fan-out", "[thread]") {
+    constexpr uint32_t count = 100;
+    uint32_t produced = 0;
+    auto source = [&produced](shared_frame_t& item) {
+        if (produced == count)
+            return std::errc::no_message_available;
+        ++produced;
+        item = make_shared_frame(1);
+        return std::errc{};
+    };
+    fanout_node_t<shared_frame_t> fanout{3, 2};
+    inspect_node_t main_inspector{};
+    main_inspector.expected = 1;
+    stage_graph_t<shared_frame_t> graph{source};
+    graph.then(fanout).then(main_inspector);
+
+    // 2 read-only branches and 1 branch which mutates
+    inspect_node_t inspectors[2]{};
+    inspectors[0].expected = inspectors[1].expected = 1;
+    overlay_node_t overlay{};
+    inspect_node_t overlay_inspector{};
+    overlay_inspector.expected = 0xFF;
+    stage_graph_t<shared_frame_t> branch0{fanout.source(0)};
+    stage_graph_t<shared_frame_t> branch1{fanout.source(1)};
+    stage_graph_t<shared_frame_t> branch2{fanout.source(2)};
+    branch0.then(inspectors[0]);
+    branch1.then(inspectors[1]);
+    branch2.then(overlay).then(overlay_inspector);
+
+    std::atomic<uint32_t> failures{0};
+    std::vector<std::thread> threads{};
+    for (auto* branch : {&branch0, &branch1, &branch2})
+        threads.emplace_back([branch, &failures]() {
+            if (branch->run() != std::errc{})
+                ++failures;
+        });
+    REQUIRE(graph.run() == std::errc{});
+    for (auto& thread : threads)
+        thread.join();
+    REQUIRE(failures == 0);
+
+    REQUIRE(main_inspector.frames.size() == count);
+    REQUIRE(main_inspector.mismatch == 0); // the overlay didn't touch the shared frames
+    for (const inspect_node_t& inspector : inspectors) {
+        REQUIRE(inspector.mismatch == 0);
+        REQUIRE(inspector.frames == main_inspector.frames); // same memory. no copy
+    }
+    REQUIRE(overlay_inspector.frames.size() == count);
+    REQUIRE(overlay_inspector.mismatch == 0);
+    REQUIRE(overlay.copied <= count);
+}
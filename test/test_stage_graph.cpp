@@ -0,0 +1,115 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <vector>
+
+#include "stage_graph.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/// @brief Emit the input twice. The last one is held until the next input, like the decoder with reorder
+class doubler_node_t final : public stage_node_t<uint32_t> {
+    bool holding = false;
+    uint32_t held = 0;
+
+  public:
+    bool started = false;
+
+  public:
+    std::errc start() noexcept override {
+        started = true;
+        return std::errc{};
+    }
+    std::errc process(uint32_t input, stage_emitter_t<uint32_t>& output) noexcept override {
+        if (holding)
+            if (auto ec = output.emit(held); ec != std::errc{})
+                return ec;
+        held = input;
+        holding = true;
+        return output.emit(input);
+    }
+    std::errc drain(stage_emitter_t<uint32_t>& output) noexcept override {
+        if (holding == false)
+            return std::errc{};
+        holding = false;
+        return output.emit(held);
+    }
+};
+
+class collect_node_t final : public stage_node_t<uint32_t> {
+  public:
+    std::vector<uint32_t> items{};
+    std::chrono::microseconds delay{};
+    uint32_t fail_at = UINT32_MAX;
+
+  public:
+    std::errc process(uint32_t input, stage_emitter_t<uint32_t>& output) noexcept override {
+        if (items.size() == fail_at)
+            return std::errc::io_error;
+        if (delay.count())
+            std::this_thread::sleep_for(delay);
+        items.emplace_back(input);
+        return output.emit(input);
+    }
+};
+
+} // namespace
+
+TEST_CASE("Stage Graph", "[thread]") {
+    std::atomic<uint32_t> produced{0};
+    auto source = [&produced](uint32_t& item) {
+        if (produced == 1000)
+            return std::errc::no_message_available;
+        item = produced++;
+        return std::errc{};
+    };
+    stage_graph_t<uint32_t> graph{source};
+    doubler_node_t doubler{};
+    collect_node_t sink{};
+
+    SECTION("order and drain") {
+        graph.then(doubler, 4).then(sink, 2);
+        REQUIRE(graph.size() == 3);
+        REQUIRE(graph.run() == std::errc{});
+        REQUIRE(doubler.started);
+        REQUIRE(sink.items.size() == 2000);
+        for (uint32_t i = 0; i < 1000; ++i) {
+            REQUIRE(sink.items[2 * i] == i);
+            REQUIRE(sink.items[2 * i + 1] == i); // the last one came from `drain`
+        }
+        REQUIRE(graph.stats(0).output_count == 1000);
+        REQUIRE(graph.stats(1).input_count == 1000);
+        REQUIRE(graph.stats(1).output_count == 2000);
+        REQUIRE(graph.stats(2).output_count == 2000); // discarded after the last node
+    }
+    SECTION("backpressure") {
+        // the slow stage bounds the number of the items in flight
+        struct observer_t final : public stage_node_t<uint32_t> {
+            std::atomic<uint32_t>* produced = nullptr;
+            uint32_t max_ahead = 0;
+
+          public:
+            std::errc process(uint32_t input, stage_emitter_t<uint32_t>&) noexcept override {
+                std::this_thread::sleep_for(50us);
+                max_ahead = std::max(max_ahead, produced->load() - input);
+                return std::errc{};
+            }
+        } observer{};
+        observer.produced = &produced;
+        graph.then(observer, 4);
+        REQUIRE(graph.run() == std::errc{});
+        REQUIRE(graph.stats(0).full_count > 0);
+        REQUIRE(observer.max_ahead <= 4 + 2); // the queue, the item in `pop` and the one in `source`
+    }
+    SECTION("failure") {
+        sink.fail_at = 100;
+        collect_node_t last{};
+        graph.then(doubler, 2).then(sink, 2).then(last, 2);
+        REQUIRE(graph.run() == std::errc::io_error);
+        REQUIRE(sink.items.size() == 100);
+        REQUIRE(last.items.size() <= 100);
+        REQUIRE(produced < 1000); // the source is stopped
+    }
+}
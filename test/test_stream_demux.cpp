@@ -0,0 +1,206 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "fmp4_muxer.hpp"
+#include "stream_demux.hpp"
+
+namespace {
+
+/// @brief Memory stream which returns a few bytes for each `read` like a pipe
+struct chunk_input_t final : public stream_input_t {
+    std::vector<uint8_t> bytes{};
+    size_t offset = 0;
+    size_t chunk = 0;
+
+  public:
+    std::errc read(gsl::span<uint8_t> buffer, size_t& count) noexcept override {
+        count = std::min({buffer.size(), bytes.size() - offset, chunk});
+        std::memcpy(buffer.data(), bytes.data() + offset, count);
+        offset += count;
+        return std::errc{};
+    }
+};
+
+struct memory_output_t final : public fmp4_output_t {
+    std::vector<uint8_t> bytes{};
+
+  public:
+    std::errc write(gsl::span<const io_slice_t> slices) noexcept override {
+        for (const io_slice_t& slice : slices) {
+            auto ptr = static_cast<const uint8_t*>(slice.data);
+            bytes.insert(bytes.end(), ptr, ptr + slice.size);
+        }
+        return std::errc{};
+    }
+};
+
+} // namespace
+
+// SPS/PPS of test-sample-0.mp4
+static const uint8_t sequence_header[] = {
+    0x00, 0x00, 0x00, 0x01, 0x27, 0x4d, 0x00, 0x1f, 0x97, 0x60, 0x28, 0x02, 0xdd, 0x80, 0xa2, 0x40, 0x00,
+    0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x0f, 0x3a, 0x10, 0x00, 0x78, 0x88, 0x00, 0x01, 0xe2, 0x2d, 0xef,
+    0x7b, 0xe0, 0xed, 0x0e, 0x18, 0x9c, 0x00, 0x00, 0x00, 0x01, 0x28, 0xee, 0xbc, 0x80};
+
+TEST_CASE("Stream Demux - Annex B", "[mp4]") {
+    chunk_input_t input{};
+    input.chunk = 5;
+    auto append = [&input](std::initializer_list<uint8_t> bytes) {
+        input.bytes.insert(input.bytes.end(), bytes.begin(), bytes.end());
+    };
+    input.bytes.assign(std::begin(sequence_header), std::end(sequence_header));
+    append({0x00, 0x00, 0x00, 0x01, 0x25, 0x88, 0x80, 0x40}); // IDR. first_mb_in_slice == 0
+    append({0x00, 0x00, 0x01, 0x25, 0x11, 0x22});             // the 2nd slice of the same picture
+    append({0x00, 0x00, 0x00, 0x01, 0x09, 0x30});             // AUD starts the next access unit
+    append({0x00, 0x00, 0x01, 0x21, 0x9a, 0x02});
+    append({0x00, 0x00, 0x00, 0x01, 0x21, 0x9a, 0x05}); // the next picture without AUD
+
+    stream_demux_t demux{input, 128};
+    std::vector<stream_sample_t> samples{};
+    std::vector<std::vector<uint8_t>> copies{};
+    stream_sample_t sample{};
+    std::errc ec{};
+    while ((ec = demux.next(sample)) == std::errc{}) {
+        samples.emplace_back(sample);
+        copies.emplace_back(sample.data.begin(), sample.data.end());
+    }
+    REQUIRE(ec == std::errc::no_message_available);
+    REQUIRE(demux.format() == stream_format_t::annexb);
+    REQUIRE(demux.length_size() == 0);
+    REQUIRE(samples.size() == 3);
+    REQUIRE(samples[0].sync);
+    REQUIRE(samples[0].decode_time == 0);
+    REQUIRE_FALSE(samples[1].sync);
+    REQUIRE(samples[2].decode_time == 2);
+    REQUIRE(copies[1].size() == 12); // AUD, slice and the leading zero of the next 4 byte start code
+    REQUIRE(copies[2].size() == 6);
+
+    auto header = demux.sequence_header();
+    REQUIRE(std::equal(header.begin(), header.end(), std::begin(sequence_header), std::end(sequence_header)));
+
+    SECTION("access unit larger than the buffer") {
+        chunk_input_t large{};
+        large.chunk = 64;
+        large.bytes = {0x00, 0x00, 0x01, 0x25, 0x88};
+        large.bytes.resize(100, 0xFF);
+        stream_demux_t bounded{large, 64};
+        REQUIRE(bounded.next(sample) == std::errc::value_too_large);
+    }
+    SECTION("unknown format") {
+        chunk_input_t garbage{};
+        garbage.chunk = 64;
+        garbage.bytes.resize(32, 0xFF);
+        stream_demux_t unknown{garbage};
+        REQUIRE(unknown.next(sample) == std::errc::not_supported);
+    }
+}
+
+static std::vector<uint8_t> make_fmp4(size_t count) {
+    memory_output_t output{};
+    fmp4_muxer_config_t config{};
+    config.timescale = 30;
+    config.fragment_duration = 3;
+    config.sequence_header.assign(std::begin(sequence_header), std::end(sequence_header));
+    fmp4_muxer_t muxer{output, config};
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t frame[] = {0x00, 0x00, 0x01, static_cast<uint8_t>((i % 3) ? 0x21 : 0x25), 0x88,
+                                 static_cast<uint8_t>(i + 1)};
+        fmp4_sample_t sample{};
+        sample.data = frame;
+        sample.decode_time = static_cast<int64_t>(i);
+        sample.presentation_time = static_cast<int64_t>(i) + 1;
+        sample.sync = (i % 3) == 0;
+        REQUIRE(muxer.append(sample) == std::errc{});
+        REQUIRE(muxer.flush() == std::errc{}); // `frame` is on the stack
+    }
+    REQUIRE(muxer.finalize() == std::errc{});
+    return output.bytes;
+}
+
+TEST_CASE("Stream Demux - fMP4", "[mp4]") {
+    chunk_input_t input{};
+    input.chunk = 7;
+    input.bytes = make_fmp4(7);
+
+    stream_demux_t demux{input, 1024};
+    stream_sample_t sample{};
+    size_t count = 0;
+    std::errc ec{};
+    while ((ec = demux.next(sample)) == std::errc{}) {
+        CAPTURE(count);
+        REQUIRE(demux.format() == stream_format_t::fmp4);
+        REQUIRE(sample.decode_time == static_cast<int64_t>(count));
+        REQUIRE(sample.presentation_time == sample.decode_time + 1);
+        REQUIRE(sample.sync == ((count % 3) == 0));
+        // 4 byte length prefix and the NAL unit
+        const uint8_t expected[] = {0x00, 0x00, 0x00, 0x03, static_cast<uint8_t>((count % 3) ? 0x21 : 0x25), 0x88,
+                                    static_cast<uint8_t>(count + 1)};
+        REQUIRE(std::equal(sample.data.begin(), sample.data.end(), std::begin(expected), std::end(expected)));
+        ++count;
+    }
+    REQUIRE(ec == std::errc::no_message_available);
+    REQUIRE(count == 7);
+    REQUIRE(demux.timescale() == 30);
+    REQUIRE(demux.length_size() == 4);
+    REQUIRE(demux.sequence_header().size() > 7);
+
+    SECTION("truncated") {
+        chunk_input_t truncated{};
+        truncated.chunk = 64;
+        truncated.bytes = input.bytes;
+        truncated.bytes.resize(truncated.bytes.size() - 2);
+        stream_demux_t broken{truncated, 1024};
+        while ((ec = broken.next(sample)) == std::errc{})
+            continue;
+        REQUIRE(ec == std::errc::protocol_error);
+    }
+    SECTION("moov larger than the buffer") {
+        chunk_input_t small{};
+        small.chunk = 64;
+        small.bytes = input.bytes;
+        stream_demux_t bounded{small, 128};
+        REQUIRE(bounded.next(sample) == std::errc::value_too_large);
+    }
+}
+
+TEST_CASE("Stream Demux - pipe", "[mp4]") {
+    int fds[2]{};
+#if defined(_WIN32)
+    REQUIRE(_pipe(fds, 4096, _O_BINARY) == 0);
+    auto close_fd = [](int fd) { _close(fd); };
+#else
+    REQUIRE(pipe(fds) == 0);
+    auto close_fd = [](int fd) { close(fd); };
+#endif
+    const std::vector<uint8_t> bytes = make_fmp4(30);
+    std::thread writer{[&bytes, fd = fds[1], close_fd]() {
+        fmp4_fd_output_t output{fd};
+        io_slice_t slice{bytes.data(), bytes.size()};
+        output.write({&slice, 1});
+        close_fd(fd); // the reader will see the end of the stream
+    }};
+    auto on_return = gsl::finally([&writer, fd = fds[0], close_fd]() {
+        writer.join();
+        close_fd(fd);
+    });
+
+    stream_fd_input_t input{fds[0]};
+    stream_demux_t demux{input, 4096};
+    stream_sample_t sample{};
+    size_t count = 0;
+    std::errc ec{};
+    while ((ec = demux.next(sample)) == std::errc{})
+        ++count;
+    REQUIRE(ec == std::errc::no_message_available);
+    REQUIRE(count == 30);
+}
@@ -0,0 +1,136 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include "stream_executor.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct counter_t final {
+    std::atomic<uint32_t> count{0};
+    std::promise<void> done{};
+    uint32_t expected = 0;
+
+    static void invoke(void* context) noexcept {
+        auto self = static_cast<counter_t*>(context);
+        if (++self->count == self->expected)
+            self->done.set_value();
+    }
+};
+
+/// @brief Holds the worker until `release`
+struct stall_t final {
+    std::shared_future<void> release{};
+
+    static void invoke(void* context) noexcept {
+        static_cast<stall_t*>(context)->release.wait();
+    }
+};
+
+} // namespace
+
+TEST_CASE("CPU Topology", "[thread]") {
+    cpu_topology_t topology{};
+    REQUIRE(get_cpu_topology(topology) == std::errc{});
+    REQUIRE(topology.processor_count() > 0);
+
+    SECTION("group size") {
+        const auto groups = make_core_groups(topology, 2, false);
+        size_t count = 0;
+        for (const auto& group : groups) {
+            REQUIRE(group.empty() == false);
+            REQUIRE(group.size() <= 2);
+            count += group.size();
+        }
+        REQUIRE(count == topology.processor_count());
+    }
+    SECTION("NUMA aware") {
+        topology.numa_nodes = {0, 0, 0, 1, 1, 1};
+        const auto groups = make_core_groups(topology, 2, true);
+        REQUIRE(groups == std::vector<std::vector<uint32_t>>{{0, 1}, {2}, {3, 4}, {5}});
+        REQUIRE(make_core_groups(topology, 4, false) == std::vector<std::vector<uint32_t>>{{0, 1, 2, 3}, {4, 5}});
+    }
+}
+
+TEST_CASE("Stream Executor", "[thread]") {
+    // the groups may share a processor. the test doesn't depend on the number of the processors
+    stream_executor_t executor{{{0}, {0}}, stream_executor_config_t{4, true}};
+    REQUIRE(executor.group_count() == 2);
+
+    SECTION("spread the streams") {
+        executor_stream_t* stream0 = nullptr;
+        executor_stream_t* stream1 = nullptr;
+        REQUIRE(executor.open(2, stream0) == std::errc{});
+        REQUIRE(executor.open(2, stream1) == std::errc{});
+        REQUIRE(stream0->stats().group != stream1->stats().group);
+        REQUIRE(executor.close(stream0) == std::errc{});
+        REQUIRE(executor.close(stream1) == std::errc{});
+        REQUIRE(executor.open(0, stream0) == std::errc::invalid_argument);
+    }
+    SECTION("in-flight limit") {
+        executor_stream_t* stream = nullptr;
+        REQUIRE(executor.open(2, stream) == std::errc{});
+        std::promise<void> release{};
+        stall_t stall{release.get_future().share()};
+        REQUIRE(executor.submit(*stream, work_item_t{&stall_t::invoke, &stall}) == std::errc{});
+        REQUIRE(executor.submit(*stream, work_item_t{&stall_t::invoke, &stall}) == std::errc{});
+        REQUIRE(executor.submit(*stream, work_item_t{&stall_t::invoke, &stall}) ==
+                std::errc::resource_unavailable_try_again);
+        release.set_value();
+        REQUIRE(executor.close(stream) == std::errc{});
+    }
+    SECTION("many frames") {
+        executor_stream_t* stream = nullptr;
+        REQUIRE(executor.open(4, stream) == std::errc{});
+        counter_t counter{};
+        counter.expected = 1000;
+        auto future = counter.done.get_future();
+        for (uint32_t i = 0; i < counter.expected;) {
+            const auto ec = executor.submit(*stream, work_item_t{&counter_t::invoke, &counter});
+            if (ec == std::errc::resource_unavailable_try_again) {
+                std::this_thread::yield();
+                continue;
+            }
+            REQUIRE(ec == std::errc{});
+            ++i;
+        }
+        REQUIRE(future.wait_for(10s) == std::future_status::ready);
+        const auto stats = stream->stats();
+        REQUIRE(stats.submitted == 1000);
+        REQUIRE(executor.close(stream) == std::errc{});
+    }
+    SECTION("move away from the stalled stream") {
+        executor_stream_t* stalled = nullptr;
+        executor_stream_t* other = nullptr;
+        executor_stream_t* moving = nullptr;
+        REQUIRE(executor.open(4, stalled) == std::errc{});
+        REQUIRE(executor.open(4, other) == std::errc{});
+        REQUIRE(executor.open(4, moving) == std::errc{});
+        const uint32_t group = stalled->stats().group;
+        REQUIRE(moving->stats().group == group);
+
+        std::promise<void> release{};
+        stall_t stall{release.get_future().share()};
+        for (auto i = 0; i < 4; ++i)
+            REQUIRE(executor.submit(*stalled, work_item_t{&stall_t::invoke, &stall}) == std::errc{});
+        REQUIRE(executor.group_load(group) == 4);
+
+        counter_t counter{};
+        counter.expected = 1;
+        auto future = counter.done.get_future();
+        REQUIRE(executor.submit(*moving, work_item_t{&counter_t::invoke, &counter}) == std::errc{});
+        REQUIRE(future.wait_for(10s) == std::future_status::ready); // not blocked by the stalled stream
+        REQUIRE(moving->stats().group != group);
+        REQUIRE(moving->stats().migrations == 1);
+        REQUIRE(other->stats().migrations == 0);
+
+        release.set_value();
+        REQUIRE(executor.close(stalled) == std::errc{});
+        REQUIRE(executor.close(other) == std::errc{});
+        REQUIRE(executor.close(moving) == std::errc{});
+    }
+}
@@ -0,0 +1,165 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <vector>
+
+#include "tile_pipeline.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/// @brief Marks the finished tiles of each frame and checks the source tiles were finished before
+struct plane_t final {
+    const tile_stage_t* stage = nullptr;
+    const plane_t* source = nullptr; // previous stage
+    std::vector<std::atomic<uint32_t>> done;     // frame + 1 of the tile. 0 if not yet
+    std::atomic<uint32_t>* failed = nullptr;
+    std::atomic<uint32_t>* clock = nullptr;      // sequence of the events
+    std::atomic<uint32_t> first_start{UINT32_MAX};
+    std::atomic<uint32_t> last_end{0};
+    std::chrono::milliseconds slow_row_delay{};  // for the last row of the first stage
+
+  public:
+    explicit plane_t(size_t count) : done(count) {
+    }
+
+    static void invoke(void* context, uint64_t frame, const tile_rect_t& tile) noexcept {
+        auto self = static_cast<plane_t*>(context);
+        const uint32_t now = (*self->clock)++;
+        uint32_t expected = UINT32_MAX;
+        if (frame == 0)
+            self->first_start.compare_exchange_strong(expected, now);
+        if (self->source) {
+            // every source pixel of the tile must be ready. the same mapping with the pipeline
+            const tile_stage_t& input = *self->source->stage;
+            const uint32_t x0 = tile.x * input.width / self->stage->width;
+            const uint32_t y0 = tile.y * input.height / self->stage->height;
+            const uint32_t x1 = ((tile.x + tile.width) * input.width - 1) / self->stage->width;
+            const uint32_t y1 = ((tile.y + tile.height) * input.height - 1) / self->stage->height;
+            for (uint32_t y : {y0, y1})
+                for (uint32_t x : {x0, x1}) {
+                    const uint32_t index = (y / input.tile_height) * input.columns() + x / input.tile_width;
+                    if (self->source->done[index] < frame + 1) // the next frame may have finished it too
+                        ++(*self->failed);
+                }
+        }
+        if (self->slow_row_delay.count() && tile.y + tile.height == self->stage->height)
+            std::this_thread::sleep_for(self->slow_row_delay);
+        const tile_stage_t& output = *self->stage;
+        const uint32_t index = (tile.y / output.tile_height) * output.columns() + tile.x / output.tile_width;
+        self->done[index] = static_cast<uint32_t>(frame + 1);
+        if (frame == 0)
+            self->last_end = (*self->clock)++;
+    }
+};
+
+tile_stage_t make_stage(uint32_t width, uint32_t height, uint32_t tile) {
+    tile_stage_t stage{};
+    stage.width = width;
+    stage.height = height;
+    stage.tile_width = tile;
+    stage.tile_height = tile;
+    return stage;
+}
+
+} // namespace
+
+TEST_CASE("Tile Stage", "[thread]") {
+    tile_stage_t stage = make_stage(1000, 600, 256);
+    REQUIRE(stage.columns() == 4);
+    REQUIRE(stage.rows() == 3);
+    const tile_rect_t last = stage.tile(stage.tile_count() - 1);
+    REQUIRE(last.x == 768);
+    REQUIRE(last.y == 512);
+    REQUIRE(last.width == 1000 - 768);
+    REQUIRE(last.height == 600 - 512);
+}
+
+TEST_CASE("Tile Pipeline - dependency", "[thread]") {
+    work_scheduler_t scheduler{2};
+    auto noop = [](void*, uint64_t, const tile_rect_t&) noexcept {};
+    std::vector<tile_stage_t> stages{make_stage(1024, 1024, 256), make_stage(1024, 1024, 256),
+                                     make_stage(512, 512, 256)};
+    for (auto& stage : stages)
+        stage.invoke = noop;
+
+    SECTION("convert and downscale") {
+        tile_pipeline_t pipeline{scheduler, stages, 1};
+        REQUIRE(pipeline.dependency_count(0, 0) == 0);
+        REQUIRE(pipeline.dependency_count(1, 5) == 1); // same grid
+        REQUIRE(pipeline.dependency_count(2, 0) == 4); // 2x2 source tiles
+    }
+    SECTION("halo") {
+        stages[1].halo = 4; // filter taps cross the tile border
+        tile_pipeline_t pipeline{scheduler, stages, 1};
+        REQUIRE(pipeline.dependency_count(1, 0) == 4);
+        REQUIRE(pipeline.dependency_count(1, 5) == 9);
+    }
+    SECTION("rotation") {
+        stages[1] = make_stage(1024, 512, 256);
+        stages[1].invoke = noop;
+        stages[2] = make_stage(512, 1024, 256);
+        stages[2].invoke = noop;
+        // rotate 90 degrees clockwise. output (x, y) is from input (y, height - x - width)
+        stages[2].source = [](const tile_rect_t& tile) {
+            return tile_rect_t{tile.y, 512 - tile.x - tile.width, tile.height, tile.width};
+        };
+        tile_pipeline_t pipeline{scheduler, stages, 1};
+        REQUIRE(pipeline.dependency_count(2, 0) == 1);
+    }
+    SECTION("invalid stage") {
+        stages[1].invoke = nullptr;
+        REQUIRE_THROWS_AS(tile_pipeline_t(scheduler, stages, 1), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Tile Pipeline - wavefront", "[thread]") {
+    work_scheduler_t scheduler{4};
+    std::atomic<uint32_t> failed{0};
+    std::atomic<uint32_t> clock{0};
+    std::vector<tile_stage_t> stages{make_stage(1024, 1024, 256), make_stage(1024, 1024, 256),
+                                     make_stage(512, 512, 128)};
+    plane_t convert{stages[0].tile_count()};
+    plane_t scale0{stages[1].tile_count()};
+    plane_t scale1{stages[2].tile_count()};
+    plane_t* planes[3]{&convert, &scale0, &scale1};
+    for (auto i = 0; i < 3; ++i) {
+        planes[i]->stage = &stages[i];
+        planes[i]->source = i ? planes[i - 1] : nullptr;
+        planes[i]->failed = &failed;
+        planes[i]->clock = &clock;
+        stages[i].invoke = &plane_t::invoke;
+        stages[i].context = planes[i];
+    }
+    convert.slow_row_delay = 50ms; // the late tiles of the first stage
+
+    SECTION("no barrier between the stages") {
+        tile_pipeline_t pipeline{scheduler, stages, 1};
+        REQUIRE(pipeline.submit(0) == std::errc{});
+        pipeline.wait();
+        REQUIRE(failed == 0);
+        REQUIRE(scale0.first_start < convert.last_end); // the early tiles didn't wait for the slow row
+        const auto stats = pipeline.stats();
+        REQUIRE(stats.frames == 1);
+        REQUIRE(stats.tiles == 16 + 16 + 16);
+    }
+    SECTION("next frame while the current one is finishing") {
+        std::atomic<uint32_t> next_start{UINT32_MAX};
+        tile_pipeline_t pipeline{scheduler, stages, 2};
+        REQUIRE(pipeline.submit(0) == std::errc{});
+        REQUIRE(pipeline.submit(1) == std::errc{});
+        REQUIRE(pipeline.submit(2) == std::errc::resource_unavailable_try_again);
+        next_start = clock.load();
+        pipeline.wait();
+        REQUIRE(failed == 0);
+        REQUIRE(next_start < scale1.last_end); // frame 1 started before frame 0 is done
+        for (uint64_t frame = 2; frame < 6; ++frame)
+            REQUIRE(pipeline.submit_wait(frame) == std::errc{});
+        pipeline.wait();
+        REQUIRE(failed == 0);
+        const auto stats = pipeline.stats();
+        REQUIRE(stats.frames == 6);
+        REQUIRE(stats.max_in_flight == 2);
+    }
+}
@@ -0,0 +1,88 @@
+#include <catch2/catch.hpp>
+
+#include "unicode.hpp"
+
+TEST_CASE("UTF-16 to UTF-8") {
+    std::string output{};
+    SECTION("ASCII") {
+        // over the block, and the remainder
+        const std::u16string input = u"C:/Users/test/Videos/sample-1080p-h264.mp4";
+        REQUIRE(utf16_to_utf8(input, output) == std::errc{});
+        REQUIRE(output == "C:/Users/test/Videos/sample-1080p-h264.mp4");
+        REQUIRE(utf16_to_utf8(u"", output) == std::errc{});
+        REQUIRE(output.empty());
+    }
+    SECTION("mixed") {
+        // non-ASCII in the middle of the blocks
+        const char16_t* input = u"0123456789abcde\u00e9f \uD55C\uAE00 \U0001F3A5 end of the path";
+        REQUIRE(utf16_to_utf8(input, output) == std::errc{});
+        REQUIRE(output == u8"0123456789abcde\u00e9f \uD55C\uAE00 \U0001F3A5 end of the path");
+    }
+    SECTION("unpaired surrogate") {
+        const char16_t high_end[]{u'a', 0xD83C};
+        REQUIRE(utf16_to_utf8({high_end, 2}, output) == std::errc::illegal_byte_sequence);
+        REQUIRE(output == "a"); // converted part
+        const char16_t low_only[]{0xDFA5, u'a'};
+        REQUIRE(utf16_to_utf8({low_only, 2}, output) == std::errc::illegal_byte_sequence);
+        const char16_t high_high[]{0xD83C, 0xD83C};
+        REQUIRE(utf16_to_utf8({high_high, 2}, output) == std::errc::illegal_byte_sequence);
+    }
+}
+
+TEST_CASE("UTF-8 to UTF-16") {
+    std::u16string output{};
+    SECTION("ASCII") {
+        REQUIRE(utf8_to_utf16("C:/Users/test/Videos/sample-1080p-h264.mp4", output) == std::errc{});
+        REQUIRE(output == u"C:/Users/test/Videos/sample-1080p-h264.mp4");
+    }
+    SECTION("mixed") {
+        const char* input = u8"0123456789abcde\u00e9f \uD55C\uAE00 \U0001F3A5 end of the path";
+        REQUIRE(utf8_to_utf16(input, output) == std::errc{});
+        REQUIRE(output == u"0123456789abcde\u00e9f \uD55C\uAE00 \U0001F3A5 end of the path");
+    }
+#if WCHAR_MAX == 0xFFFF
+    SECTION("wchar_t") {
+        std::wstring text{};
+        const char* input = u8"0123456789abcde\u00e9f \uD55C\uAE00 \U0001F3A5 end of the path";
+        REQUIRE(utf8_to_utf16(input, text) == std::errc{});
+        REQUIRE(text == L"0123456789abcde\u00e9f \uD55C\uAE00 \U0001F3A5 end of the path");
+        REQUIRE(utf8_to_utf16("\xC3\x28", text) == std::errc::illegal_byte_sequence);
+    }
+#endif
+    SECTION("invalid") {
+        const char* inputs[]{
+            "\x80",             // continuation without the lead
+            "\xC0\x80",         // overlong NUL
+            "\xE0\x80\x80",     // overlong
+            "\xED\xA0\x80",     // surrogate
+            "\xF4\x90\x80\x80", // over U+10FFFF
+            "\xF5\x80\x80\x80", // invalid lead
+            "\xE0\xA0",         // truncated
+            "\xC3\x28",         // not a continuation
+        };
+        for (const char* input : inputs) {
+            CAPTURE(input);
+            REQUIRE(utf8_to_utf16(input, output) == std::errc::illegal_byte_sequence);
+        }
+        REQUIRE(utf8_to_utf16("0123456789abcdef\xFF", output) == std::errc::illegal_byte_sequence);
+        REQUIRE(output == u"0123456789abcdef"); // converted part
+    }
+    SECTION("every code point") {
+        std::u16string input{};
+        for (uint32_t code = 1; code <= 0x10FFFF; ++code) {
+            if (code >= 0xD800 && code <= 0xDFFF)
+                continue;
+            if (code < 0x10000) {
+                input.push_back(static_cast<char16_t>(code));
+            } else {
+                input.push_back(static_cast<char16_t>(0xD800 + ((code - 0x10000) >> 10)));
+                input.push_back(static_cast<char16_t>(0xDC00 + ((code - 0x10000) & 0x3FF)));
+            }
+        }
+        std::string utf8{};
+        REQUIRE(utf16_to_utf8(input, utf8) == std::errc{});
+        REQUIRE(utf8.size() == 0x7F + 0x780 * 2 + (0x10000 - 0x800 - 0x800) * 3 + 0x100000 * 4);
+        REQUIRE(utf8_to_utf16(utf8, output) == std::errc{});
+        REQUIRE(output == input);
+    }
+}
@@ -0,0 +1,144 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include "work_scheduler.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct counter_t final {
+    std::atomic<uint32_t> count{0};
+    std::promise<void> done{};
+    uint32_t expected = 0;
+
+    static void invoke(void* context) noexcept {
+        auto self = static_cast<counter_t*>(context);
+        if (++self->count == self->expected)
+            self->done.set_value();
+    }
+};
+
+} // namespace
+
+TEST_CASE("Work Scheduler", "[thread]") {
+    work_scheduler_t scheduler{4};
+    REQUIRE(scheduler.concurrency() == 4);
+
+    SECTION("from multiple threads") {
+        counter_t counter{};
+        counter.expected = 4 * 5000;
+        auto future = counter.done.get_future();
+        std::atomic<uint32_t> failed{0}; // Catch2 assertions are not thread-safe
+        std::vector<std::thread> threads{};
+        for (auto i = 0; i < 4; ++i)
+            threads.emplace_back([&scheduler, &counter, &failed, i]() {
+                for (auto k = 0; k < 5000; ++k)
+                    if (scheduler.put(work_item_t{&counter_t::invoke, &counter}, i - 1) != std::errc{})
+                        ++failed;
+            });
+        for (auto& t : threads)
+            t.join();
+        REQUIRE(failed == 0);
+        REQUIRE(future.wait_for(10s) == std::future_status::ready);
+        const auto stats = scheduler.stats();
+        REQUIRE(stats.submitted == 20000);
+        REQUIRE(stats.depth == std::array<int64_t, 3>{});
+    }
+    SECTION("steal from the busy worker") {
+        struct context_t final {
+            work_scheduler_t* scheduler = nullptr;
+            counter_t counter{};
+        } context{&scheduler};
+        context.counter.expected = 1000;
+        auto future = context.counter.done.get_future();
+        // the children go to the deque of the worker and it holds the worker for a while
+        auto spawn = [](void* ptr) noexcept {
+            auto context = static_cast<context_t*>(ptr);
+            for (auto i = 0; i < 1000; ++i)
+                context->scheduler->put(work_item_t{&counter_t::invoke, &context->counter});
+            std::this_thread::sleep_for(100ms);
+        };
+        REQUIRE(scheduler.put(work_item_t{spawn, &context}) == std::errc{});
+        REQUIRE(future.wait_for(10s) == std::future_status::ready);
+        REQUIRE(scheduler.stats().steals > 0);
+    }
+    SECTION("invalid item") {
+        REQUIRE(scheduler.put(work_item_t{}) == std::errc::invalid_argument);
+    }
+}
+
+TEST_CASE("Work Scheduler - priority", "[thread]") {
+    work_scheduler_t scheduler{1};
+    struct context_t final {
+        std::promise<void> started{};
+        std::promise<void> release{};
+        std::mutex mtx{};
+        std::vector<int> order{};
+    } context{};
+    auto block = [](void* ptr) noexcept {
+        auto context = static_cast<context_t*>(ptr);
+        context->started.set_value();
+        context->release.get_future().wait();
+    };
+    REQUIRE(scheduler.put(work_item_t{block, &context}) == std::errc{});
+    context.started.get_future().wait();
+
+    // the worker is blocked. the items are queued in their lanes
+    struct item_t final {
+        context_t* context;
+        int priority;
+    };
+    item_t items[] = {{&context, -1}, {&context, 0}, {&context, 1}, {&context, 0}, {&context, 1}};
+    auto record = [](void* ptr) noexcept {
+        auto item = static_cast<item_t*>(ptr);
+        std::lock_guard lck{item->context->mtx};
+        item->context->order.emplace_back(item->priority);
+    };
+    for (auto& item : items)
+        REQUIRE(scheduler.put(work_item_t{record, &item}, item.priority) == std::errc{});
+    REQUIRE(scheduler.stats().depth == std::array<int64_t, 3>{1, 2, 2});
+    context.release.set_value();
+
+    scheduler.unlock(); // the last lock. the pending items are still executed
+    REQUIRE(scheduler.put(work_item_t{record, &items[0]}) == std::errc::operation_canceled);
+    while (scheduler.stats().executed != 6)
+        std::this_thread::sleep_for(1ms);
+    REQUIRE(context.order == std::vector<int>{1, 1, 0, 0, -1});
+}
+
+TEST_CASE("Work Scheduler - lock", "[thread]") {
+    work_scheduler_t scheduler{2};
+    {
+        std::lock_guard guard{scheduler}; // same with `MFLockWorkQueue`
+        scheduler.unlock();               // release the initial lock
+        counter_t counter{};
+        counter.expected = 1;
+        REQUIRE(scheduler.put(work_item_t{&counter_t::invoke, &counter}) == std::errc{});
+        REQUIRE(counter.done.get_future().wait_for(10s) == std::future_status::ready);
+    }
+    REQUIRE(scheduler.put(work_item_t{&counter_t::invoke, nullptr}) == std::errc::operation_canceled);
+    REQUIRE_THROWS_AS(scheduler.lock(), std::system_error);
+}
+
+TEST_CASE("Work Scheduler - put while unlock", "[thread]") {
+    // the accepted items must run even if the last `unlock` happens in the middle of `put`
+    for (uint32_t i = 0; i < 100; ++i) {
+        counter_t counter{};
+        uint32_t accepted = 0;
+        {
+            work_scheduler_t scheduler{2};
+            std::thread producer{[&scheduler, &counter, &accepted]() {
+                while (scheduler.put(work_item_t{&counter_t::invoke, &counter}) == std::errc{})
+                    ++accepted;
+            }};
+            std::this_thread::sleep_for(100us);
+            scheduler.unlock();
+            producer.join();
+        } // the workers exited
+        REQUIRE(counter.count == accepted);
+    }
+}
@@ -0,0 +1,164 @@
+#include "tile_pipeline.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+/// @brief The region of the source with the ratio of the sizes
+tile_rect_t scale_region(const tile_rect_t& tile, const tile_stage_t& output, const tile_stage_t& input) noexcept {
+    const uint64_t x0 = uint64_t{tile.x} * input.width / output.width;
+    const uint64_t y0 = uint64_t{tile.y} * input.height / output.height;
+    const uint64_t x1 = (uint64_t{tile.x + tile.width} * input.width + output.width - 1) / output.width;
+    const uint64_t y1 = (uint64_t{tile.y + tile.height} * input.height + output.height - 1) / output.height;
+    return tile_rect_t{static_cast<uint32_t>(x0), static_cast<uint32_t>(y0), static_cast<uint32_t>(x1 - x0),
+                       static_cast<uint32_t>(y1 - y0)};
+}
+
+/// @brief Flat indices of the tiles which overlap the region. The region is extended by `halo` and clipped
+std::vector<uint32_t> find_tiles(const tile_stage_t& stage, tile_rect_t region, uint32_t halo) noexcept(false) {
+    const uint32_t x0 = region.x > halo ? region.x - halo : 0;
+    const uint32_t y0 = region.y > halo ? region.y - halo : 0;
+    const uint32_t x1 = std::min(region.x + region.width + halo, stage.width);
+    const uint32_t y1 = std::min(region.y + region.height + halo, stage.height);
+    std::vector<uint32_t> indices{};
+    if (x1 <= x0 || y1 <= y0)
+        return indices;
+    for (uint32_t row = y0 / stage.tile_height; row <= (y1 - 1) / stage.tile_height; ++row)
+        for (uint32_t column = x0 / stage.tile_width; column <= (x1 - 1) / stage.tile_width; ++column)
+            indices.emplace_back(row * stage.columns() + column);
+    return indices;
+}
+
+} // namespace
+
+tile_rect_t tile_stage_t::tile(uint32_t index) const noexcept {
+    const uint32_t x = (index % columns()) * tile_width;
+    const uint32_t y = (index / columns()) * tile_height;
+    return tile_rect_t{x, y, std::min(tile_width, width - x), std::min(tile_height, height - y)};
+}
+
+tile_pipeline_t::tile_pipeline_t(work_scheduler_t& scheduler, std::vector<tile_stage_t> stage_list,
+                                 uint32_t max_frames) noexcept(false)
+    : scheduler{scheduler}, stages{std::move(stage_list)} {
+    if (stages.empty())
+        throw std::invalid_argument{"no stage"};
+    uint32_t total = 0;
+    for (const tile_stage_t& stage : stages) {
+        if (stage.width == 0 || stage.height == 0 || stage.tile_width == 0 || stage.tile_height == 0)
+            throw std::invalid_argument{"empty stage"};
+        if (stage.invoke == nullptr)
+            throw std::invalid_argument{"no invoke"};
+        offsets.emplace_back(total);
+        total += stage.tile_count();
+    }
+    indegrees.resize(total);
+    dependents.resize(total);
+    for (uint32_t s = 1; s < stages.size(); ++s) {
+        const tile_stage_t& input = stages[s - 1];
+        const tile_stage_t& output = stages[s];
+        for (uint32_t t = 0; t < output.tile_count(); ++t) {
+            const tile_rect_t tile = output.tile(t);
+            const tile_rect_t region = output.source ? output.source(tile) : scale_region(tile, output, input);
+            for (uint32_t source : find_tiles(input, region, output.halo))
+                dependents[offsets[s - 1] + source].emplace_back(offsets[s] + t);
+        }
+    }
+    for (const auto& list : dependents)
+        for (uint32_t index : list)
+            ++indegrees[index];
+
+    for (uint32_t i = 0; i < std::max(max_frames, 1u); ++i) {
+        auto slot = std::make_unique<frame_slot_t>();
+        slot->pending = std::make_unique<std::atomic<uint32_t>[]>(total);
+        slot->tasks.resize(total);
+        for (uint32_t s = 0; s < stages.size(); ++s)
+            for (uint32_t t = 0; t < stages[s].tile_count(); ++t)
+                slot->tasks[offsets[s] + t] = tile_task_t{this, slot.get(), s, t};
+        slots.emplace_back(std::move(slot));
+    }
+}
+
+tile_pipeline_t::~tile_pipeline_t() noexcept {
+    wait();
+}
+
+std::errc tile_pipeline_t::submit(uint64_t frame) noexcept {
+    frame_slot_t* slot = nullptr;
+    {
+        std::lock_guard lck{mtx};
+        for (auto& candidate : slots)
+            if (candidate->busy == false) {
+                slot = candidate.get();
+                break;
+            }
+        if (slot == nullptr)
+            return std::errc::resource_unavailable_try_again;
+        slot->busy = true;
+        slot->frame = frame;
+        counters.max_in_flight = std::max(counters.max_in_flight, ++in_flight);
+    }
+    return start(*slot);
+}
+
+std::errc tile_pipeline_t::submit_wait(uint64_t frame) noexcept {
+    while (true) {
+        if (auto ec = submit(frame); ec != std::errc::resource_unavailable_try_again)
+            return ec;
+        std::unique_lock lck{mtx};
+        cv.wait(lck, [this]() { return in_flight < slots.size(); });
+    }
+}
+
+void tile_pipeline_t::wait() noexcept {
+    std::unique_lock lck{mtx};
+    cv.wait(lck, [this]() { return in_flight == 0; });
+}
+
+tile_pipeline_stats_t tile_pipeline_t::stats() noexcept {
+    std::lock_guard lck{mtx};
+    tile_pipeline_stats_t result = counters;
+    result.tiles = tiles;
+    return result;
+}
+
+std::errc tile_pipeline_t::start(frame_slot_t& slot) noexcept {
+    const auto total = static_cast<uint32_t>(indegrees.size());
+    for (uint32_t i = 0; i < total; ++i)
+        slot.pending[i].store(indegrees[i], std::memory_order_relaxed);
+    slot.remaining.store(total, std::memory_order_release);
+    // the first stage and the tiles without the source region
+    for (uint32_t i = 0; i < total; ++i)
+        if (indegrees[i] == 0)
+            put(slot.tasks[i]);
+    return std::errc{};
+}
+
+void tile_pipeline_t::put(tile_task_t& task) noexcept {
+    if (scheduler.put(work_item_t{&tile_pipeline_t::run, &task}) != std::errc{})
+        run(&task); // the scheduler is stopped. finish the frame on this thread
+}
+
+void tile_pipeline_t::run(void* context) noexcept {
+    auto& task = *static_cast<tile_task_t*>(context);
+    tile_pipeline_t& owner = *task.owner;
+    const tile_stage_t& stage = owner.stages[task.stage];
+    stage.invoke(stage.context, task.slot->frame, stage.tile(task.tile));
+    owner.complete(task);
+}
+
+void tile_pipeline_t::complete(tile_task_t& task) noexcept {
+    frame_slot_t& slot = *task.slot;
+    ++tiles;
+    for (uint32_t index : dependents[offsets[task.stage] + task.tile])
+        if (slot.pending[index].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            put(slot.tasks[index]);
+    if (slot.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    // the last tile of the frame
+    std::lock_guard lck{mtx};
+    slot.busy = false;
+    --in_flight;
+    ++counters.frames;
+    cv.notify_all();
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include "work_scheduler.hpp"
+
+struct tile_rect_t final {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+/**
+ * @brief Per-pixel stage like the color conversion, scaling, rotation. The output plane is split into the tiles
+ * @note  `invoke` is called on the worker thread with the output tile. It must not touch the other tiles
+ */
+struct tile_stage_t final {
+    uint32_t width = 0; // output size of the stage
+    uint32_t height = 0;
+    uint32_t tile_width = 256;
+    uint32_t tile_height = 256;
+    /// @brief Pixels of the source around the mapped region. The filter taps of the scaler
+    uint32_t halo = 0;
+    /// @brief Region of the previous stage's output which is required for the output tile.
+    ///        If empty, the tile is scaled with the ratio of the sizes (the convert and the resize)
+    std::function<tile_rect_t(const tile_rect_t&)> source{};
+    void (*invoke)(void* context, uint64_t frame, const tile_rect_t& tile) noexcept = nullptr;
+    void* context = nullptr;
+
+  public:
+    [[nodiscard]] uint32_t columns() const noexcept {
+        return (width + tile_width - 1) / tile_width;
+    }
+    [[nodiscard]] uint32_t rows() const noexcept {
+        return (height + tile_height - 1) / tile_height;
+    }
+    [[nodiscard]] uint32_t tile_count() const noexcept {
+        return columns() * rows();
+    }
+    [[nodiscard]] tile_rect_t tile(uint32_t index) const noexcept;
+};
+
+struct tile_pipeline_stats_t final {
+    uint64_t frames = 0; // completed frames
+    uint64_t tiles = 0;  // executed tiles
+    uint32_t max_in_flight = 0;
+};
+
+/**
+ * @brief Runs the frames through the tile stages on the `work_scheduler_t` without the barrier between the stages.
+ *        A tile starts when the tiles of the previous stage which cover its source region are finished,
+ *        so the stages run as a wavefront. Up to `max_frames` frames are in flight, and the next frame's early tiles
+ *        start while the current frame's late tiles are finishing.
+ *
+ * @note  The dependencies are resolved once in the constructor. The tasks of each frame slot are allocated
+ *        in the constructor too, so `submit` doesn't allocate
+ * @note  Each in-flight frame must have its own buffers. Use the `frame` argument of `tile_stage_t::invoke`
+ */
+class tile_pipeline_t final {
+    struct frame_slot_t;
+
+    struct tile_task_t final {
+        tile_pipeline_t* owner = nullptr;
+        frame_slot_t* slot = nullptr;
+        uint32_t stage = 0;
+        uint32_t tile = 0;
+    };
+
+    struct frame_slot_t final {
+        uint64_t frame = 0;
+        bool busy = false;                                  // guarded by the pipeline's mutex
+        std::unique_ptr<std::atomic<uint32_t>[]> pending{}; // unfinished source tiles of each tile
+        std::atomic<uint32_t> remaining{0};                 // unfinished tiles of the frame
+        std::vector<tile_task_t> tasks{};
+    };
+
+    work_scheduler_t& scheduler;
+    std::vector<tile_stage_t> stages{};
+    std::vector<uint32_t> offsets{};                 // index of each stage's first tile in the flat arrays
+    std::vector<uint32_t> indegrees{};               // number of the source tiles of each tile
+    std::vector<std::vector<uint32_t>> dependents{}; // flat indices of the next stage's tiles which use the tile
+    std::vector<std::unique_ptr<frame_slot_t>> slots{};
+    std::mutex mtx{};
+    std::condition_variable cv{};
+    uint32_t in_flight = 0;
+    tile_pipeline_stats_t counters{};
+    std::atomic<uint64_t> tiles{0};
+
+  public:
+    /// @throws std::invalid_argument if a stage is empty or doesn't have `invoke`
+    /// @param max_frames the number of the frames in flight. at least 1
+    tile_pipeline_t(work_scheduler_t& scheduler, std::vector<tile_stage_t> stages, uint32_t max_frames) noexcept(false);
+    /// @brief Wait for the in-flight frames
+    ~tile_pipeline_t() noexcept;
+    tile_pipeline_t(const tile_pipeline_t&) = delete;
+    tile_pipeline_t(tile_pipeline_t&&) = delete;
+    tile_pipeline_t& operator=(const tile_pipeline_t&) = delete;
+    tile_pipeline_t& operator=(tile_pipeline_t&&) = delete;
+
+    /// @return `std::errc::resource_unavailable_try_again` if `max_frames` frames are in flight
+    std::errc submit(uint64_t frame) noexcept;
+    /// @brief Wait until a frame slot is available and submit
+    std::errc submit_wait(uint64_t frame) noexcept;
+    /// @brief Wait for all in-flight frames
+    void wait() noexcept;
+
+    /// @brief Number of the previous stage's tiles which the tile waits for
+    [[nodiscard]] uint32_t dependency_count(uint32_t stage, uint32_t tile) const noexcept {
+        return indegrees[offsets[stage] + tile];
+    }
+    [[nodiscard]] tile_pipeline_stats_t stats() noexcept;
+
+  private:
+    std::errc start(frame_slot_t& slot) noexcept;
+    void put(tile_task_t& task) noexcept;
+    static void run(void* context) noexcept;
+    void complete(tile_task_t& task) noexcept;
+};
@@ -0,0 +1,190 @@
+#include "unicode.hpp"
+
+#include <cstdint>
+#include <new>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+namespace {
+
+constexpr size_t block_size = 16;
+
+/// @return the number of the code units which are converted in the ASCII block
+size_t ascii_to_utf8(const char16_t* input, size_t count, char* output) noexcept {
+    size_t i = 0;
+#if defined(USE_SSE2)
+    const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    for (; i + block_size <= count; i += block_size) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 8));
+        __m128i bits = _mm_and_si128(_mm_or_si128(low, high), non_ascii);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(bits, _mm_setzero_si128())) != 0xFFFF)
+            break;
+        // every unit is under 0x80. no saturation
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(low, high));
+    }
+#endif
+    for (; i < count && input[i] < 0x80; ++i)
+        output[i] = static_cast<char>(input[i]);
+    return i;
+}
+
+/// @tparam Char 16 bit code unit. `char16_t` or `wchar_t` of Windows
+template <typename Char>
+size_t ascii_to_utf16(const char* input, size_t count, Char* output) noexcept {
+    static_assert(sizeof(Char) == sizeof(char16_t));
+    size_t i = 0;
+#if defined(USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + block_size <= count; i += block_size) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        if (_mm_movemask_epi8(bytes) != 0) // the most significant bits
+            break;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+#endif
+    for (; i < count && static_cast<uint8_t>(input[i]) < 0x80; ++i)
+        output[i] = static_cast<Char>(input[i]);
+    return i;
+}
+
+bool is_continuation(uint8_t value) noexcept {
+    return (value & 0xC0) == 0x80;
+}
+
+/**
+ * @brief Decode one code point of 2~4 bytes
+ * @see   Unicode Standard, Table 3-7. Well-Formed UTF-8 Byte Sequences
+ * @return the number of the bytes. 0 if the sequence is invalid
+ */
+size_t decode_utf8(const uint8_t* input, size_t count, uint32_t& code) noexcept {
+    const uint8_t lead = input[0];
+    size_t length = 0;
+    uint8_t lower = 0x80, upper = 0xBF; // range of the 2nd byte
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        code = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        code = lead & 0x0F;
+        if (lead == 0xE0)
+            lower = 0xA0; // overlong
+        else if (lead == 0xED)
+            upper = 0x9F; // surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        code = lead & 0x07;
+        if (lead == 0xF0)
+            lower = 0x90; // overlong
+        else if (lead == 0xF4)
+            upper = 0x8F; // over U+10FFFF
+    } else {
+        return 0;
+    }
+    if (count < length || input[1] < lower || input[1] > upper)
+        return 0;
+    for (size_t i = 1; i < length; ++i) {
+        if (is_continuation(input[i]) == false)
+            return 0;
+        code = (code << 6) | (input[i] & 0x3F);
+    }
+    return length;
+}
+
+template <typename Char>
+std::errc transcode_utf8(std::string_view input, std::basic_string<Char>& output) noexcept {
+    try {
+        output.resize(input.size()); // a code unit takes 1 byte at least. the surrogate pair takes 4 bytes
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+    const size_t count = input.size();
+    Char* out = output.data();
+    size_t i = 0, o = 0;
+    std::errc ec{};
+    while (i < count) {
+        const size_t ascii = ascii_to_utf16(input.data() + i, count - i, out + o);
+        i += ascii;
+        o += ascii;
+        while (i < count && in[i] >= 0x80) {
+            uint32_t code = 0;
+            const size_t length = decode_utf8(in + i, count - i, code);
+            if (length == 0) {
+                ec = std::errc::illegal_byte_sequence;
+                break;
+            }
+            i += length;
+            if (code < 0x10000) {
+                out[o++] = static_cast<Char>(code);
+                continue;
+            }
+            code -= 0x10000;
+            out[o++] = static_cast<Char>(0xD800 + (code >> 10));
+            out[o++] = static_cast<Char>(0xDC00 + (code & 0x3FF));
+        }
+        if (ec != std::errc{})
+            break;
+    }
+    output.resize(o);
+    return ec;
+}
+
+} // namespace
+
+std::errc utf16_to_utf8(std::u16string_view input, std::string& output) noexcept {
+    try {
+        output.resize(input.size() * 3); // BMP needs 3 bytes. the surrogate pair needs 4 bytes for 2 units
+    } catch (const std::bad_alloc&) {
+        return std::errc::not_enough_memory;
+    }
+    const char16_t* in = input.data();
+    const size_t count = input.size();
+    uint8_t* out = reinterpret_cast<uint8_t*>(output.data());
+    size_t i = 0, o = 0;
+    std::errc ec{};
+    while (i < count) {
+        const size_t ascii = ascii_to_utf8(in + i, count - i, reinterpret_cast<char*>(out + o));
+        i += ascii;
+        o += ascii;
+        // the others until the next ASCII
+        for (; i < count && in[i] >= 0x80; ++i) {
+            uint32_t code = in[i];
+            if (code < 0x800) {
+                out[o++] = static_cast<uint8_t>(0xC0 | (code >> 6));
+                out[o++] = static_cast<uint8_t>(0x80 | (code & 0x3F));
+                continue;
+            }
+            if (code >= 0xD800 && code <= 0xDFFF) {
+                if (code > 0xDBFF || i + 1 == count || in[i + 1] < 0xDC00 || in[i + 1] > 0xDFFF) {
+                    ec = std::errc::illegal_byte_sequence;
+                    break;
+                }
+                code = 0x10000 + ((code - 0xD800) << 10) + (in[++i] - 0xDC00);
+                out[o++] = static_cast<uint8_t>(0xF0 | (code >> 18));
+                out[o++] = static_cast<uint8_t>(0x80 | ((code >> 12) & 0x3F));
+            } else {
+                out[o++] = static_cast<uint8_t>(0xE0 | (code >> 12));
+            }
+            out[o++] = static_cast<uint8_t>(0x80 | ((code >> 6) & 0x3F));
+            out[o++] = static_cast<uint8_t>(0x80 | (code & 0x3F));
+        }
+        if (ec != std::errc{})
+            break;
+    }
+    output.resize(o);
+    return ec;
+}
+
+std::errc utf8_to_utf16(std::string_view input, std::u16string& output) noexcept {
+    return transcode_utf8(input, output);
+}
+
+#if WCHAR_MAX == 0xFFFF
+std::errc utf8_to_utf16(std::string_view input, std::wstring& output) noexcept {
+    return transcode_utf8(input, output);
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+#include <cwchar>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+/**
+ * @brief UTF-16 to UTF-8 without the locale. The ASCII runs are converted 16 code units at a time with SSE2
+ * @param output replaced with the result. On failure, it has the converted part before the invalid input
+ * @return `std::errc::illegal_byte_sequence` for the unpaired surrogate
+ */
+std::errc utf16_to_utf8(std::u16string_view input, std::string& output) noexcept;
+
+/**
+ * @brief UTF-8 to UTF-16 without the locale. The input is validated like `MB_ERR_INVALID_CHARS`
+ * @param output replaced with the result. On failure, it has the converted part before the invalid input
+ * @return `std::errc::illegal_byte_sequence` for the overlong form, the surrogate, the code point over U+10FFFF
+ *         and the truncated sequence
+ */
+std::errc utf8_to_utf16(std::string_view input, std::u16string& output) noexcept;
+
+#if WCHAR_MAX == 0xFFFF
+/// @brief `utf8_to_utf16` into the 16 bit `wchar_t` of Windows. No copy from `std::u16string`
+std::errc utf8_to_utf16(std::string_view input, std::wstring& output) noexcept;
+#endif
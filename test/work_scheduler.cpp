@@ -0,0 +1,209 @@
+#include "work_scheduler.hpp"
+
+#include <algorithm>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+/// @brief The worker which is running on the current thread
+struct current_worker_t final {
+    const work_scheduler_t* scheduler = nullptr;
+    uint32_t index = 0;
+};
+thread_local current_worker_t current_worker{};
+
+uint32_t get_lane(int32_t priority) noexcept {
+    if (priority > 0)
+        return 2;
+    return priority == 0 ? 1 : 0;
+}
+
+} // namespace
+
+std::errc set_thread_affinity(std::thread& thread, gsl::span<const uint32_t> cpus) noexcept {
+    if (cpus.empty())
+        return std::errc::invalid_argument;
+#if defined(_WIN32)
+    GROUP_AFFINITY affinity{};
+    affinity.Group = static_cast<WORD>(cpus[0] / 64);
+    for (uint32_t cpu : cpus)
+        if (cpu / 64 == affinity.Group)
+            affinity.Mask |= KAFFINITY{1} << (cpu % 64);
+    if (SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr) == FALSE)
+        return std::errc::invalid_argument;
+#else
+    cpu_set_t set{};
+    CPU_ZERO(&set);
+    for (uint32_t cpu : cpus) {
+        if (cpu >= CPU_SETSIZE)
+            return std::errc::invalid_argument;
+        CPU_SET(cpu, &set);
+    }
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0)
+        return std::errc::invalid_argument;
+#endif
+    return std::errc{};
+}
+
+work_scheduler_t::work_scheduler_t(gsl::span<const uint32_t> cpus) noexcept(false)
+    : work_scheduler_t{static_cast<uint32_t>(cpus.size())} {
+    if (cpus.empty())
+        return;
+    // the delegated constructor is complete. the destructor stops the workers if this throws
+    for (auto& worker : workers)
+        if (auto ec = set_thread_affinity(worker->thread, cpus); ec != std::errc{})
+            throw std::system_error{std::make_error_code(ec)};
+}
+
+work_scheduler_t::work_scheduler_t(uint32_t concurrency) noexcept(false) {
+    if (concurrency == 0)
+        concurrency = std::max(std::thread::hardware_concurrency(), 1u);
+    workers.reserve(concurrency);
+    for (uint32_t i = 0; i < concurrency; ++i)
+        workers.emplace_back(std::make_unique<worker_t>());
+    try {
+        for (uint32_t i = 0; i < concurrency; ++i)
+            workers[i]->thread = std::thread{&work_scheduler_t::run, this, i};
+    } catch (...) {
+        stop();
+        throw;
+    }
+}
+
+work_scheduler_t::~work_scheduler_t() noexcept {
+    stop();
+}
+
+void work_scheduler_t::stop() noexcept {
+    {
+        std::lock_guard lck{sleep_mtx};
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    for (auto& worker : workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+}
+
+std::errc work_scheduler_t::put(work_item_t item, int32_t priority) noexcept {
+    if (item.invoke == nullptr)
+        return std::errc::invalid_argument;
+    const uint32_t lane = get_lane(priority);
+    const uint32_t index = current_worker.scheduler == this ? current_worker.index
+                                                            : next_worker++ % static_cast<uint32_t>(workers.size());
+    // count first. the workers may scan for nothing, but never sleep or exit with the pending item.
+    // seq_cst with `stopping`, so the worker which saw `stopping` sees the count unless this sees `stopping`
+    ++depth[lane];
+    if (stopping) {
+        --depth[lane];
+        return std::errc::operation_canceled;
+    }
+    try {
+        worker_t& worker = *workers[index];
+        std::lock_guard lck{worker.mtx};
+        worker.lanes[lane].emplace_back(item);
+    } catch (const std::bad_alloc&) {
+        --depth[lane];
+        return std::errc::not_enough_memory;
+    }
+    ++submitted;
+    // seq_cst with `depth`, so one of this and the sleeping worker sees the other
+    if (sleepers) {
+        std::lock_guard lck{sleep_mtx};
+        sleep_cv.notify_one();
+    }
+    return std::errc{};
+}
+
+void work_scheduler_t::lock() noexcept(false) {
+    uint32_t count = lock_count.load();
+    do {
+        if (count == 0)
+            throw std::system_error{std::make_error_code(std::errc::operation_canceled)};
+    } while (lock_count.compare_exchange_weak(count, count + 1) == false);
+}
+
+void work_scheduler_t::unlock() noexcept {
+    if (lock_count.fetch_sub(1) != 1)
+        return;
+    // the last lock. the workers will exit after the pending items
+    {
+        std::lock_guard lck{sleep_mtx};
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+}
+
+work_scheduler_stats_t work_scheduler_t::stats() const noexcept {
+    work_scheduler_stats_t result{};
+    result.submitted = submitted;
+    result.executed = executed;
+    result.steals = steals;
+    for (uint32_t lane = 0; lane < lane_count; ++lane)
+        result.depth[lane] = depth[lane];
+    return result;
+}
+
+bool work_scheduler_t::pop(uint32_t index, uint32_t lane, work_item_t& item) noexcept {
+    worker_t& worker = *workers[index];
+    std::lock_guard lck{worker.mtx};
+    auto& items = worker.lanes[lane];
+    if (items.empty())
+        return false;
+    item = items.front(); // FIFO for the owner. fair for the streams which share the worker
+    items.pop_front();
+    return true;
+}
+
+bool work_scheduler_t::steal(uint32_t index, uint32_t lane, work_item_t& item) noexcept {
+    const auto count = static_cast<uint32_t>(workers.size());
+    for (uint32_t i = 1; i < count; ++i) {
+        worker_t& victim = *workers[(index + i) % count];
+        std::unique_lock lck{victim.mtx, std::try_to_lock};
+        if (lck.owns_lock() == false)
+            continue; // busy. try the next one
+        auto& items = victim.lanes[lane];
+        if (items.empty())
+            continue;
+        item = items.back();
+        items.pop_back();
+        ++steals;
+        return true;
+    }
+    return false;
+}
+
+void work_scheduler_t::run(uint32_t index) noexcept {
+    current_worker = current_worker_t{this, index};
+    while (true) {
+        work_item_t item{};
+        bool found = false;
+        for (uint32_t lane = lane_count; lane-- > 0 && found == false;) {
+            if (depth[lane] <= 0)
+                continue;
+            found = pop(index, lane, item) || steal(index, lane, item);
+            if (found)
+                --depth[lane];
+        }
+        if (found) {
+            item.invoke(item.context);
+            ++executed;
+            continue;
+        }
+        auto pending = [this]() {
+            return std::any_of(depth.begin(), depth.end(), [](const auto& d) { return d > 0; });
+        };
+        std::unique_lock lck{sleep_mtx};
+        ++sleepers;
+        sleep_cv.wait(lck, [this, &pending]() { return stopping || pending(); });
+        --sleepers;
+        if (stopping && pending() == false)
+            break;
+    }
+    current_worker = current_worker_t{};
+}
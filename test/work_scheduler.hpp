@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <gsl/gsl>
+
+/// @brief Function and its argument. Same role with `IMFAsyncCallback` and `IMFAsyncResult`
+struct work_item_t final {
+    void (*invoke)(void* context) noexcept = nullptr;
+    void* context = nullptr;
+};
+
+struct work_scheduler_stats_t final {
+    uint64_t submitted = 0;
+    uint64_t executed = 0;
+    uint64_t steals = 0;            // items taken from the other worker's deque
+    std::array<int64_t, 3> depth{}; // pending items of each priority lane. low, normal, high
+};
+
+/**
+ * @brief Restrict the thread to the logical processors
+ * @param cpus logical processor numbers. On Windows, the processors out of the first one's group are ignored
+ * @return `std::errc::invalid_argument` if `cpus` is empty or the system rejected it
+ * @see SetThreadGroupAffinity
+ */
+std::errc set_thread_affinity(std::thread& thread, gsl::span<const uint32_t> cpus) noexcept;
+
+/**
+ * @brief Portable work queue with the `put`/`lock`/`unlock` semantics of `mf_scheduler_t`.
+ *        Each worker owns a deque for each priority lane. The items from the worker are pushed to its own deque and
+ *        the others are distributed round-robin. Idle workers steal from the others, from the highest lane.
+ *
+ * @note  The deques are guarded by a per-worker mutex. It is contended only when a steal happens.
+ * @note  Like `MFLockWorkQueue`, the scheduler starts with one lock. When `unlock` releases the last lock, it stops
+ *        accepting the items and the workers exit after the pending items. `std::lock_guard` can be used with it
+ * @see   MFPutWorkItemEx2, MFLockWorkQueue, MFUnlockWorkQueue
+ */
+class work_scheduler_t final {
+  public:
+    static constexpr uint32_t lane_count = 3;
+
+  private:
+    struct alignas(64) worker_t final {
+        std::mutex mtx{};
+        std::array<std::deque<work_item_t>, lane_count> lanes{};
+        std::thread thread{};
+    };
+
+    std::vector<std::unique_ptr<worker_t>> workers{};
+    std::array<std::atomic<int64_t>, lane_count> depth{}; // pending items of each lane. may be larger for a moment
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> steals{0};
+    std::atomic<uint32_t> next_worker{0};
+    std::atomic<uint32_t> lock_count{1};
+    std::atomic<bool> stopping{false};
+    std::mutex sleep_mtx{};
+    std::condition_variable sleep_cv{};
+    std::atomic<uint32_t> sleepers{0};
+
+  public:
+    /// @param concurrency 0 for `std::thread::hardware_concurrency`
+    /// @throws std::system_error if the thread can't be created
+    explicit work_scheduler_t(uint32_t concurrency = 0) noexcept(false);
+    /// @param cpus the workers run only on these logical processors. empty for `hardware_concurrency` workers without the affinity
+    /// @throws std::system_error if the thread can't be created or the affinity is rejected
+    explicit work_scheduler_t(gsl::span<const uint32_t> cpus) noexcept(false);
+    /// @brief Stop regardless of the lock count and wait for the workers
+    ~work_scheduler_t() noexcept;
+    work_scheduler_t(const work_scheduler_t&) = delete;
+    work_scheduler_t(work_scheduler_t&&) = delete;
+    work_scheduler_t& operator=(const work_scheduler_t&) = delete;
+    work_scheduler_t& operator=(work_scheduler_t&&) = delete;
+
+    /// @param priority higher runs first. positive for high lane, 0 for normal, negative for low
+    /// @return `std::errc::operation_canceled` after the last `unlock`
+    std::errc put(work_item_t item, int32_t priority = 0) noexcept;
+
+    /// @throws std::system_error(`std::errc::operation_canceled`) after the last `unlock`
+    void lock() noexcept(false);
+    void unlock() noexcept;
+
+    [[nodiscard]] uint32_t concurrency() const noexcept {
+        return static_cast<uint32_t>(workers.size());
+    }
+    [[nodiscard]] work_scheduler_stats_t stats() const noexcept;
+
+  private:
+    void run(uint32_t index) noexcept;
+    bool pop(uint32_t index, uint32_t lane, work_item_t& item) noexcept;
+    bool steal(uint32_t index, uint32_t lane, work_item_t& item) noexcept;
+    void stop() noexcept;
+};